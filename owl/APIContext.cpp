@@ -17,21 +17,8 @@
 #include "APIContext.h"
 #include "APIHandle.h"
 
-#define LOG(message)                            \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_LIGHT_BLUE                \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
-
-#define LOG_OK(message)                         \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_BLUE                      \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
+#define LOG(message)    OWL_LOG_INFO(OWL_LOG_CATEGORY_CONTEXT,message)
+#define LOG_OK(message) OWL_LOG_INFO(OWL_LOG_CATEGORY_CONTEXT,message)
   
 namespace owl {
   
@@ -46,7 +33,7 @@ namespace owl {
 
   void APIContext::releaseAll()
   {
-    LOG("#owl: context is dying; number of API handles (other than context itself) "
+    LOG("context is dying; number of API handles (other than context itself) "
         << "that have not yet been released: "
         << (activeHandles.size()-1));
     for (auto handle : activeHandles)
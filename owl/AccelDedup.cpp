@@ -0,0 +1,66 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "AccelDedup.h"
+#include "VertexFormats.h"
+#include <cstring>
+
+namespace owl {
+
+  /*! number of elements that get hashed at a time; this is part of
+      the resulting hash, so has to be the same for densely packed
+      and for strided arrays */
+  const size_t dedupHashChunkSize = 16*1024;
+
+  /*! hashes the first 'elementSize' bytes of each of the 'count'
+      elements 'stride' bytes apart */
+  static void hashElements(ContentHasher &hasher,
+                           const void *data,
+                           size_t count,
+                           size_t stride,
+                           size_t elementSize)
+  {
+    const uint8_t *elements = (const uint8_t *)data;
+    std::vector<uint8_t> chunk;
+    for (size_t begin=0;begin<count;begin+=dedupHashChunkSize) {
+      const size_t end = std::min(count,begin+dedupHashChunkSize);
+      if (stride == elementSize) {
+        hasher.add(elements+begin*stride,(end-begin)*elementSize);
+        continue;
+      }
+      chunk.resize((end-begin)*elementSize);
+      for (size_t i=begin;i<end;i++)
+        memcpy(chunk.data()+(i-begin)*elementSize,
+               elements+i*stride,elementSize);
+      hasher.add(chunk.data(),chunk.size());
+    }
+    hasher.add(count);
+  }
+
+  void hashMeshContent(ContentHasher &hasher, const MeshContent &mesh)
+  {
+    hasher
+      .add(mesh.vertices.size())
+      .add(mesh.vertexFormat)
+      .add(mesh.indexFormat);
+    for (auto vertices : mesh.vertices)
+      hashElements(hasher,vertices,mesh.vertexCount,mesh.vertexStride,
+                   vertexFormatSizeOf(mesh.vertexFormat));
+    hashElements(hasher,mesh.indices,mesh.indexCount,mesh.indexStride,
+                 indexFormatSizeOf(mesh.indexFormat));
+  }
+
+} // ::owl
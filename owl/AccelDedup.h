@@ -0,0 +1,113 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "owl/owl.h"
+#include "owl/common.h"
+#include "Hash.h"
+#include <map>
+#include <mutex>
+
+namespace owl {
+
+  /*! everything about a single triangle mesh that determines its
+      accel, with all arrays in host memory */
+  struct MeshContent {
+    /*! one vertex array per motion key */
+    std::vector<const void *> vertices;
+    size_t          vertexCount  = 0;
+    size_t          vertexStride = 0;
+    OWLVertexFormat vertexFormat = OWL_VERTEX_FORMAT_FLOAT3;
+    const void     *indices      = nullptr;
+    size_t          indexCount   = 0;
+    size_t          indexStride  = 0;
+    OWLIndexFormat  indexFormat  = OWL_INDEX_FORMAT_UINT3;
+  };
+
+  /*! adds the given mesh to the hasher. Only the bytes of each
+      vertex and index triplet that the accel builder actually reads
+      get hashed, so two meshes that differ only in their strides,
+      or in what lives in-between their vertices (eg, interleaved
+      normals), hash to the same key - they'd have the very same
+      accel */
+  void hashMeshContent(ContentHasher &hasher, const MeshContent &mesh);
+
+  /*! a table of objects (accels) that get shared between all owners
+      (groups) whose content hashes to the same key. The table itself
+      only keeps weak references, so an entry goes away as soon as
+      the last group using it drops it. Thread-safe.
+
+      For computeStats(), T has to have 'accelBytes' and 'bufferBytes'
+      members, with the memory of the shared object itself, and that
+      of the data it got built from, respectively */
+  template<typename T>
+  struct DedupTable {
+
+    /*! returns the (live) object for given key, or null if there is
+        none */
+    std::shared_ptr<T> find(uint64_t key)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = entries.find(key);
+      if (it == entries.end())
+        return nullptr;
+      std::shared_ptr<T> object = it->second.lock();
+      if (!object)
+        entries.erase(it);
+      return object;
+    }
+
+    /*! registers 'object' under given key, replacing whatever was
+        registered under that key before */
+    void insert(uint64_t key, const std::shared_ptr<T> &object)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      entries[key] = object;
+    }
+
+    /*! how much got saved by sharing, across all live objects:
+        every owner beyond the first one of each object is one that
+        would otherwise have had its own copy */
+    OWLAccelDedupStats computeStats()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      OWLAccelDedupStats stats = {};
+      for (auto it = entries.begin(); it != entries.end(); ) {
+        const long numOwners = it->second.use_count();
+        if (numOwners == 0) {
+          it = entries.erase(it);
+          continue;
+        }
+        std::shared_ptr<T> object = it->second.lock();
+        ++it;
+        if (!object || numOwners < 2)
+          continue;
+        const size_t numDuplicates = size_t(numOwners-1);
+        stats.numSharedAccels++;
+        stats.numDeduplicatedGroups += numDuplicates;
+        stats.accelBytesSaved       += numDuplicates * object->accelBytes;
+        stats.duplicateBufferBytes  += numDuplicates * object->bufferBytes;
+      }
+      return stats;
+    }
+
+  private:
+    std::mutex mutex;
+    std::map<uint64_t,std::weak_ptr<T>> entries;
+  };
+
+} // ::owl
@@ -0,0 +1,139 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "BoundsReduction.h"
+#include "owl/common/parallel/parallel_for.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+# define OWL_HAVE_SSE 1
+# include <xmmintrin.h>
+#endif
+
+namespace owl {
+
+  /*! how many vertices a single parallel task reduces; small arrays
+      are done serially */
+  const size_t hostBoundsReductionBlockSize = 64*1024;
+
+  /*! decodes a single vertex of given (compact) format */
+  inline vec3f decodeVertex(const uint8_t *ptr, OWLVertexFormat format)
+  {
+    switch (format) {
+    case OWL_VERTEX_FORMAT_FLOAT3:
+      return vec3f(((const float*)ptr)[0],
+                   ((const float*)ptr)[1],
+                   ((const float*)ptr)[2]);
+    case OWL_VERTEX_FORMAT_FLOAT2:
+      return vec3f(((const float*)ptr)[0],((const float*)ptr)[1],0.f);
+    case OWL_VERTEX_FORMAT_HALF3:
+      return vec3f(halfToFloat(((const uint16_t*)ptr)[0]),
+                   halfToFloat(((const uint16_t*)ptr)[1]),
+                   halfToFloat(((const uint16_t*)ptr)[2]));
+    case OWL_VERTEX_FORMAT_HALF2:
+      return vec3f(halfToFloat(((const uint16_t*)ptr)[0]),
+                   halfToFloat(((const uint16_t*)ptr)[1]),
+                   0.f);
+    case OWL_VERTEX_FORMAT_SNORM16_3:
+      return vec3f(snorm16ToFloat(((const int16_t*)ptr)[0]),
+                   snorm16ToFloat(((const int16_t*)ptr)[1]),
+                   snorm16ToFloat(((const int16_t*)ptr)[2]));
+    case OWL_VERTEX_FORMAT_SNORM16_2:
+      return vec3f(snorm16ToFloat(((const int16_t*)ptr)[0]),
+                   snorm16ToFloat(((const int16_t*)ptr)[1]),
+                   0.f);
+    default:
+      throw std::runtime_error("invalid vertex format "+toString(format));
+    }
+  }
+
+  /*! reduces vertices [begin,end) of a float3/float2 array */
+  inline box3f reduceFloatVertices(const uint8_t *vertices,
+                                   size_t begin, size_t end,
+                                   size_t stride,
+                                   OWLVertexFormat format)
+  {
+#if OWL_HAVE_SSE
+    __m128 lo = _mm_set1_ps(+std::numeric_limits<float>::infinity());
+    __m128 hi = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+    if (format == OWL_VERTEX_FORMAT_FLOAT3) {
+      // a 16-byte load reads one float past the vertex, which is
+      // fine for all but (possibly) the very last vertex of the
+      // array - so always do the last one of each range separately
+      const size_t vectorEnd = std::max(begin,end-1);
+      size_t i = begin;
+      for (;i<vectorEnd;i++) {
+        const __m128 v = _mm_loadu_ps((const float*)(vertices+i*stride));
+        lo = _mm_min_ps(lo,v);
+        hi = _mm_max_ps(hi,v);
+      }
+      for (;i<end;i++) {
+        const float *f = (const float*)(vertices+i*stride);
+        const __m128 v = _mm_setr_ps(f[0],f[1],f[2],0.f);
+        lo = _mm_min_ps(lo,v);
+        hi = _mm_max_ps(hi,v);
+      }
+    } else {
+      // (z, and the unused w, are zero)
+      const __m128 zero = _mm_setzero_ps();
+      for (size_t i=begin;i<end;i++) {
+        const __m128 v = _mm_loadl_pi(zero,(const __m64*)(vertices+i*stride));
+        lo = _mm_min_ps(lo,v);
+        hi = _mm_max_ps(hi,v);
+      }
+    }
+    float l[4], h[4];
+    _mm_storeu_ps(l,lo);
+    _mm_storeu_ps(h,hi);
+    return box3f(vec3f(l[0],l[1],l[2]),vec3f(h[0],h[1],h[2]));
+#else
+    box3f bounds;
+    for (size_t i=begin;i<end;i++)
+      bounds.extend(decodeVertex(vertices+i*stride,format));
+    return bounds;
+#endif
+  }
+
+  box3f computeVertexBoundsOnHost(const void *vertices,
+                                  size_t count,
+                                  size_t stride,
+                                  OWLVertexFormat format)
+  {
+    const uint8_t *base = (const uint8_t *)vertices;
+    const size_t numBlocks
+      = (count+hostBoundsReductionBlockSize-1)/hostBoundsReductionBlockSize;
+    std::vector<box3f> blockBounds(numBlocks);
+    owl::common::parallel_for_blocked
+      (0,count,hostBoundsReductionBlockSize,
+       [&](size_t begin, size_t end) {
+        box3f &bounds = blockBounds[begin/hostBoundsReductionBlockSize];
+        switch (format) {
+        case OWL_VERTEX_FORMAT_FLOAT3:
+        case OWL_VERTEX_FORMAT_FLOAT2:
+          bounds = reduceFloatVertices(base,begin,end,stride,format);
+          break;
+        default:
+          for (size_t i=begin;i<end;i++)
+            bounds.extend(decodeVertex(base+i*stride,format));
+        }
+      });
+
+    box3f bounds;
+    for (auto &block : blockBounds)
+      bounds.extend(block);
+    return bounds;
+  }
+
+} // ::owl
@@ -0,0 +1,135 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "owl/common.h"
+#include "VertexFormats.h"
+#ifdef __CUDACC__
+# include "DeviceMemory.h"
+#endif
+
+namespace owl {
+
+  /*! computes the bounds of 'count' vertices of given format, that
+      live in host-accessible memory (ie, host-pinned or managed
+      buffers) starting at 'vertices', 'stride' bytes apart. Uses
+      SSE where available, and the owl::common::parallel_for
+      infrastructure for large arrays */
+  box3f computeVertexBoundsOnHost(const void *vertices,
+                                  size_t count,
+                                  size_t stride,
+                                  OWLVertexFormat format);
+
+#ifdef __CUDACC__
+  /*! number of threads per block for the bounds reduction kernels;
+      has to be a multiple of the warp size */
+  enum { boundsReductionBlockSize = 256 };
+
+  /*! maximum number of blocks in the first reduction pass - each
+      thread loops over as many elements as required; the second pass
+      then reduces these per-block bounds in a single block */
+  enum { maxBoundsReductionBlocks = 1024 };
+
+  /*! fetcher for reduceBoundsOnDevice() that reads an array of
+      boxes; empty boxes do not contribute to the bounds */
+  struct BoxArrayFetcher {
+    inline __device__ box3f operator()(size_t i) const { return boxes[i]; }
+    const box3f *boxes;
+  };
+
+  /*! reduces the boxes returned by getBox(0..count-1) into a single
+      box per block, without any atomics: every thread first reduces
+      a (grid-strided) subset of the elements, then each warp reduces
+      via shuffles, and finally the first warp reduces the per-warp
+      results */
+  template<typename GetBox>
+  __global__ void reduceBoundsKernel(box3f *d_blockBounds,
+                                     size_t count,
+                                     GetBox getBox)
+  {
+    enum { numWarps = boundsReductionBlockSize/32 };
+    // (box3f has a constructor, so can't be used in shared mem)
+    __shared__ float warpBounds[6][numWarps];
+
+    box3f bounds;
+    for (size_t i = blockIdx.x*size_t(blockDim.x)+threadIdx.x;
+         i < count;
+         i += size_t(gridDim.x)*blockDim.x)
+      bounds.extend(getBox(i));
+
+    float v[6] = {
+      bounds.lower.x, bounds.lower.y, bounds.lower.z,
+      bounds.upper.x, bounds.upper.y, bounds.upper.z
+    };
+    for (int delta=16;delta>0;delta/=2)
+      for (int c=0;c<6;c++) {
+        const float other = __shfl_down_sync(0xffffffff,v[c],delta);
+        v[c] = (c < 3) ? fminf(v[c],other) : fmaxf(v[c],other);
+      }
+    const int lane = threadIdx.x % 32;
+    const int warp = threadIdx.x / 32;
+    if (lane == 0)
+      for (int c=0;c<6;c++)
+        warpBounds[c][warp] = v[c];
+    __syncthreads();
+
+    if (warp != 0) return;
+    for (int c=0;c<6;c++)
+      v[c] = (lane < numWarps) ? warpBounds[c][lane] : warpBounds[c][0];
+    for (int delta=16;delta>0;delta/=2)
+      for (int c=0;c<6;c++) {
+        const float other = __shfl_down_sync(0xffffffff,v[c],delta);
+        v[c] = (c < 3) ? fminf(v[c],other) : fmaxf(v[c],other);
+      }
+    if (lane == 0)
+      d_blockBounds[blockIdx.x] = box3f(vec3f(v[0],v[1],v[2]),
+                                        vec3f(v[3],v[4],v[5]));
+  }
+
+  /*! computes the bounds over all boxes returned by getBox(i), for
+      i=0..count-1, on the currently active device: a first pass
+      reduces to (at most) maxBoundsReductionBlocks per-block boxes,
+      and a second, single-block pass reduces those to the final
+      result, which then gets downloaded. Blocks until done. */
+  template<typename GetBox>
+  box3f reduceBoundsOnDevice(size_t count, const GetBox &getBox)
+  {
+    if (count == 0)
+      return box3f();
+
+    const int numBlocks
+      = (int)std::min(size_t(maxBoundsReductionBlocks),
+                      (count+boundsReductionBlockSize-1)/boundsReductionBlockSize);
+    DeviceMemory d_blockBounds;
+    // one extra box at the end for the final result
+    d_blockBounds.alloc((numBlocks+1)*sizeof(box3f));
+    box3f *d_boxes = (box3f*)d_blockBounds.get();
+
+    reduceBoundsKernel<<<numBlocks,boundsReductionBlockSize>>>
+      (d_boxes,count,getBox);
+    reduceBoundsKernel<<<1,boundsReductionBlockSize>>>
+      (d_boxes+numBlocks,numBlocks,BoxArrayFetcher{d_boxes});
+
+    box3f bounds;
+    CUDA_CHECK(cudaMemcpy(&bounds,d_boxes+numBlocks,sizeof(bounds),
+                          cudaMemcpyDeviceToHost));
+    d_blockBounds.free();
+    return bounds;
+  }
+#endif
+
+} // ::owl
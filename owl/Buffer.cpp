@@ -115,14 +115,30 @@ namespace owl {
   
   void DeviceBuffer::upload(const void *hostPtr, size_t offset, int64_t count)
   {
+    contentVersion++;
     assert(deviceData.size() == context->deviceCount());
-    for (auto dd : deviceData)
-      dd->as<DeviceBuffer::DeviceData>().uploadAsync(hostPtr, offset, count);
+    const size_t numBytes = ((count == -1) ? elementCount : count)*sizeOf(type);
+    // only raw data is the same on all devices; buffers of textures
+    // or buffers get translated differently for each device
+    if (context->uploadReplicationEnabled
+        && deviceData.size() > 1
+        && type >= _OWL_BEGIN_COPYABLE_TYPES
+        && numBytes >= minReplicatedUploadSize) {
+      std::vector<uint8_t *> devicePointers;
+      for (auto dd : deviceData)
+        devicePointers.push_back((uint8_t *)dd->as<DeviceBuffer::DeviceData>().d_pointer
+                                 + offset);
+      context->replicateUploadAsync(devicePointers,hostPtr,numBytes);
+    } else {
+      for (auto dd : deviceData)
+        dd->as<DeviceBuffer::DeviceData>().uploadAsync(hostPtr, offset, count);
+    }
     CUDA_SYNC_CHECK();
   }
   
   void DeviceBuffer::upload(const int deviceID, const void *hostPtr, size_t offset, int64_t count) 
   {
+    contentVersion++;
     assert(deviceID < (int)deviceData.size());
     deviceData[deviceID]->as<DeviceBuffer::DeviceData>().uploadAsync(hostPtr, offset, count);
     CUDA_SYNC_CHECK();
@@ -136,6 +152,7 @@ namespace owl {
 
   void DeviceBuffer::resize(size_t newElementCount)
   {
+    contentVersion++;
     elementCount = newElementCount;
     for (auto device : context->getDevices()) 
       getDD(device).executeResize();
@@ -170,6 +187,9 @@ namespace owl {
       } else
         hostHandles[i] = nullptr;
 
+    TraceScope trace("upload","upload",device->ID);
+    GpuTimings::Scope timeUpload(device->timings,OWL_TIMING_BUFFER_UPLOAD,
+                                 device->getStream());
     CUDA_CALL(MemcpyAsync((char*)d_pointer + offset, devRep.data(),
                           devRep.size()*sizeof(devRep[0]),
                           cudaMemcpyDefault,
@@ -205,6 +225,8 @@ namespace owl {
         devRep[i].data    = (void*)buffer->getPointer(device);
         devRep[i].type    = buffer->type;
         devRep[i].count   = buffer->getElementCount();
+        // device programs can now write to it
+        buffer->pointerExposed = true;
         
         hostHandles[i] = buffer;
       } else {
@@ -213,6 +235,9 @@ namespace owl {
         devRep[i].count   = 0;
       }
 
+    TraceScope trace("upload","upload",device->ID);
+    GpuTimings::Scope timeUpload(device->timings,OWL_TIMING_BUFFER_UPLOAD,
+                                 device->getStream());
     CUDA_CALL(MemcpyAsync((char*)d_pointer + offset,devRep.data(),
                           devRep.size()*sizeof(devRep[0]),
                           cudaMemcpyDefault,
@@ -236,6 +261,9 @@ namespace owl {
   {
     SetActiveGPU forLifeTime(device);
     
+    TraceScope trace("upload","upload",device->ID);
+    GpuTimings::Scope timeUpload(device->timings,OWL_TIMING_BUFFER_UPLOAD,
+                                 device->getStream());
     CUDA_CALL(MemcpyAsync((char*)d_pointer + offset,hostDataPtr,
                           ((count == -1) ? parent->elementCount : count)*sizeOf(parent->type),
                           cudaMemcpyDefault,
@@ -263,6 +291,7 @@ namespace owl {
 
   void HostPinnedBuffer::resize(size_t newElementCount)
   {
+    contentVersion++;
     if (cudaHostPinnedMem) {
       CUDA_CALL_NOTHROW(FreeHost(cudaHostPinnedMem));
       cudaHostPinnedMem = nullptr;
@@ -279,6 +308,7 @@ namespace owl {
   
   void HostPinnedBuffer::upload(const void *sourcePtr, size_t offset, int64_t count)
   {
+    contentVersion++;
     assert(cudaHostPinnedMem);
     memcpy((char*)cudaHostPinnedMem + offset, sourcePtr, (count == -1) ? sizeInBytes() : count * sizeOf(type));
   }
@@ -306,6 +336,7 @@ namespace owl {
 
   void ManagedMemoryBuffer::resize(size_t newElementCount)
   {
+    contentVersion++;
     if (cudaManagedMem) {
       CUDA_CALL_NOTHROW(Free(cudaManagedMem));
       cudaManagedMem = 0;
@@ -330,17 +361,14 @@ namespace owl {
             cudaError_t rc = cudaMemAdvise((void*)begin, end-begin,
                                            cudaMemAdviseSetPreferredLocation, cudaDevID);
             if (rc != cudaSuccess) {
-#ifndef NDEBUG
               static bool alreadyWarned = false;
               if (!alreadyWarned) {
-                std::cout << OWL_TERMINAL_RED
-                          << "#owl: Warning - error in trying to memadvise a managed "
-                          << "memory buffer: " << cudaGetErrorString(rc)
-                          << " (should be OK, ignoring this)."
-                          << OWL_TERMINAL_DEFAULT << std::endl;
+                OWL_LOG_WARNING(OWL_LOG_CATEGORY_MEMORY,
+                                "error in trying to memadvise a managed "
+                                << "memory buffer: " << cudaGetErrorString(rc)
+                                << " (should be OK, ignoring this).");
                 alreadyWarned = true;
               }
-#endif
               /* clear this error */cudaGetLastError();
             }
           
@@ -354,6 +382,7 @@ namespace owl {
   
   void ManagedMemoryBuffer::upload(const void *hostPtr, size_t offset, int64_t count)
   {
+    contentVersion++;
     assert(cudaManagedMem);
     cudaMemcpy((char*)cudaManagedMem + offset, hostPtr,
                (count == -1) ? sizeInBytes() : count * sizeOf(type), cudaMemcpyDefault);
@@ -384,6 +413,7 @@ namespace owl {
 
   void GraphicsBuffer::resize(size_t newElementCount)
   {
+    contentVersion++;
     elementCount = newElementCount;
   }
 
@@ -76,6 +76,18 @@ namespace owl {
     /*! creates the device-specific data for this group */
     RegisteredObject::DeviceData::SP createOn(const DeviceContext::SP &device) override;
 
+    /*! pointer through which the host can directly read this buffer's
+        data (for host-pinned and managed buffers), or null if the
+        data is only accessible on the device(s) */
+    virtual const void *getHostPointer() const { return nullptr; }
+
+    /*! whether every change to this buffer's contents is guaranteed
+        to go through resize() or upload() (and thus, bump
+        contentVersion); this is not the case for buffers whose memory
+        is directly writable by the host, or whose pointer has been
+        handed out to the app or to device programs */
+    virtual bool contentsTracked() const { return !pointerExposed; }
+
     /*! destroy whatever resouces this buffer may own on the device,
         but do NOT destroy this class itself. baiscally that's a
         resize(0), but that buffer can not - and shoult not - be used
@@ -87,6 +99,17 @@ namespace owl {
 
     /*! number of elements */
     size_t      elementCount { 0 };
+
+    /*! incremented upon every resize() and upload(), so derived data
+        (such as bounds) can be cached until the buffer next changes;
+        only meaningful if contentsTracked() */
+    uint64_t    contentVersion { 0 };
+
+    /*! set once the app has asked for this buffer's raw pointer, or
+        once it got bound to a buffer (pointer) variable or uploaded
+        into a buffer of buffers - after which the app, or any of its
+        device programs, may write to it without us knowing */
+    bool        pointerExposed { false };
   };
 
 
@@ -220,6 +243,9 @@ namespace owl {
     void upload(const void *hostPtr, size_t offset, int64_t count) override;
     void upload(const int deviceID, const void *hostPtr, size_t offset, int64_t count) override;
 
+    const void *getHostPointer() const override { return cudaHostPinnedMem; }
+    bool contentsTracked() const override { return false; }
+
     /*! pointer to the (shared) cuda pinned mem - this gets alloced
         once and is valid on both host and devices */
     void *cudaHostPinnedMem { 0 };
@@ -240,6 +266,9 @@ namespace owl {
     void upload(const void *hostPtr, size_t offset, int64_t count) override;
     void upload(const int deviceID, const void *hostPtr, size_t offset, int64_t count) override;
 
+    const void *getHostPointer() const override { return cudaManagedMem; }
+    bool contentsTracked() const override { return false; }
+
     /*! pretty-printer, for debugging */
     std::string toString() const override;
 
@@ -265,6 +294,9 @@ namespace owl {
     void upload(const void *hostPtr, size_t offset, int64_t count) override;
     void upload(const int deviceID, const void *hostPtr, size_t offset, int64_t count) override;
 
+    /*! the graphics api can write to it at any time */
+    bool contentsTracked() const override { return false; }
+
     /*! the cuda graphics resource to map to - note that this is
         probably valid on only one GPU */
     cudaGraphicsResource_t resource;
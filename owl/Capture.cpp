@@ -0,0 +1,304 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "Capture.h"
+#include "Hash.h"
+#include <cstring>
+
+namespace owl {
+
+  // ------------------------------------------------------------------
+  // CaptureArgs
+  // ------------------------------------------------------------------
+  
+  CaptureArgs &CaptureArgs::putBytes(const void *ptr, size_t numBytes)
+  {
+    put((uint32_t)numBytes);
+    const uint8_t *begin = (const uint8_t *)ptr;
+    if (numBytes)
+      data.insert(data.end(),begin,begin+numBytes);
+    return *this;
+  }
+  
+  CaptureArgs &CaptureArgs::putString(const char *s)
+  {
+    return putBytes(s,s ? strlen(s) : 0);
+  }
+  
+  CaptureArgs &CaptureArgs::putHandles(const std::vector<CaptureHandle> &handles)
+  {
+    return putBytes(handles.data(),handles.size()*sizeof(CaptureHandle));
+  }
+
+  CaptureArgs &CaptureArgs::putVarDecls(const std::vector<OWLVarDecl> &varDecls)
+  {
+    put((uint32_t)varDecls.size());
+    for (auto &decl : varDecls) {
+      putString(decl.name);
+      put((uint32_t)decl.type);
+      put((uint32_t)decl.offset);
+    }
+    return *this;
+  }
+  
+  // ------------------------------------------------------------------
+  // CaptureWriter
+  // ------------------------------------------------------------------
+  
+  CaptureWriter::CaptureWriter(const std::string &fileName)
+    : file(new std::ofstream(fileName,std::ios::binary)),
+      out(*file)
+  {
+    if (!file->good())
+      throw std::runtime_error("could not create capture file '"+fileName+"'");
+    writeHeader();
+  }
+  
+  CaptureWriter::CaptureWriter(std::ostream &out)
+    : out(out)
+  {
+    writeHeader();
+  }
+
+  void CaptureWriter::writeHeader()
+  {
+    out.write(captureMagic,sizeof(captureMagic));
+    out.write((const char *)&captureVersion,sizeof(captureVersion));
+  }
+  
+  CaptureHandle CaptureWriter::newHandle(const void *handle)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    // a handle that got released may get re-used by a new object,
+    // so always assign a fresh ID
+    return handleIDsByPointer[handle] = nextHandleID++;
+  }
+
+  CaptureHandle CaptureWriter::handleID(const void *handle)
+  {
+    if (!handle)
+      return 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = handleIDsByPointer.find(handle);
+    if (it != handleIDsByPointer.end())
+      return it->second;
+    return handleIDsByPointer[handle] = nextHandleID++;
+  }
+  
+  uint64_t CaptureWriter::blob(const void *data, size_t numBytes)
+  {
+    if (!data)
+      return 0;
+    uint64_t key = ContentHasher().add(numBytes).add(data,numBytes).get();
+    // 0 is 'null'
+    if (key == 0) key = 1;
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    if (blobSizes.find(key) != blobSizes.end()) {
+      stats.blobBytesSaved += numBytes;
+      return key;
+    }
+    blobSizes[key] = numBytes;
+    const uint8_t  tag  = CAPTURE_RECORD_BLOB;
+    const uint64_t size = numBytes;
+    out.write((const char *)&tag,sizeof(tag));
+    out.write((const char *)&key,sizeof(key));
+    out.write((const char *)&size,sizeof(size));
+    out.write((const char *)data,numBytes);
+    stats.numBlobs++;
+    stats.blobBytes += numBytes;
+    return key;
+  }
+  
+  void CaptureWriter::call(CaptureCall call, const CaptureArgs &args)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    const uint8_t  tag     = CAPTURE_RECORD_CALL;
+    const uint16_t callID  = call;
+    const uint32_t argSize = (uint32_t)args.data.size();
+    out.write((const char *)&tag,sizeof(tag));
+    out.write((const char *)&callID,sizeof(callID));
+    out.write((const char *)&argSize,sizeof(argSize));
+    out.write((const char *)args.data.data(),argSize);
+    stats.numCalls++;
+  }
+
+  void CaptureWriter::flush()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    out.flush();
+    if (!out.good())
+      throw std::runtime_error("error writing capture");
+  }
+  
+  CaptureWriter::Stats CaptureWriter::getStats()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+  }
+  
+  // ------------------------------------------------------------------
+  // CaptureArgsReader
+  // ------------------------------------------------------------------
+  
+  void CaptureArgsReader::read(void *out, size_t numBytes)
+  {
+    if (numBytes > data.size()-pos)
+      throw std::runtime_error("invalid capture: call arguments truncated");
+    if (numBytes)
+      memcpy(out,data.data()+pos,numBytes);
+    pos += numBytes;
+  }
+  
+  std::vector<uint8_t> CaptureArgsReader::getBytes()
+  {
+    std::vector<uint8_t> bytes(get<uint32_t>());
+    read(bytes.data(),bytes.size());
+    return bytes;
+  }
+  
+  std::string CaptureArgsReader::getString()
+  {
+    const std::vector<uint8_t> bytes = getBytes();
+    return std::string(bytes.begin(),bytes.end());
+  }
+
+  std::vector<CaptureHandle> CaptureArgsReader::getHandles()
+  {
+    const std::vector<uint8_t> bytes = getBytes();
+    if (bytes.size() % sizeof(CaptureHandle))
+      throw std::runtime_error("invalid capture: malformed handle list");
+    std::vector<CaptureHandle> handles(bytes.size()/sizeof(CaptureHandle));
+    if (!handles.empty())
+      memcpy(handles.data(),bytes.data(),bytes.size());
+    return handles;
+  }
+
+  std::vector<OWLVarDecl>
+  CaptureArgsReader::getVarDecls(std::vector<std::string> &names)
+  {
+    const uint32_t count = get<uint32_t>();
+    if (count > data.size()-pos)
+      throw std::runtime_error("invalid capture: call arguments truncated");
+    names.resize(count);
+    std::vector<OWLVarDecl> varDecls(count);
+    for (uint32_t i=0;i<count;i++) {
+      names[i]           = getString();
+      varDecls[i].type   = (OWLDataType)get<uint32_t>();
+      varDecls[i].offset = get<uint32_t>();
+    }
+    // only now that 'names' won't get resized any more
+    for (uint32_t i=0;i<count;i++)
+      varDecls[i].name = names[i].c_str();
+    return varDecls;
+  }
+  
+  // ------------------------------------------------------------------
+  // CaptureReader
+  // ------------------------------------------------------------------
+  
+  CaptureReader::CaptureReader(const std::string &fileName)
+    : file(new std::ifstream(fileName,std::ios::binary)),
+      in(*file)
+  {
+    if (!file->good())
+      throw std::runtime_error("could not open capture file '"+fileName+"'");
+    readHeader();
+  }
+  
+  CaptureReader::CaptureReader(std::istream &in)
+    : in(in)
+  {
+    readHeader();
+  }
+
+  void CaptureReader::readHeader()
+  {
+    char     magic[sizeof(captureMagic)];
+    uint32_t version;
+    if (!read(magic,sizeof(magic),true)
+        || memcmp(magic,captureMagic,sizeof(magic)) != 0)
+      throw std::runtime_error("not an owl capture");
+    read(&version,sizeof(version));
+    if (version != captureVersion)
+      throw std::runtime_error("unsupported owl capture version "
+                               +std::to_string(version));
+  }
+  
+  bool CaptureReader::read(void *out, size_t numBytes, bool endOK)
+  {
+    in.read((char *)out,numBytes);
+    const size_t numRead = (size_t)in.gcount();
+    if (numRead == numBytes)
+      return true;
+    if (numRead == 0 && endOK)
+      return false;
+    throw std::runtime_error("invalid capture: truncated");
+  }
+  
+  bool CaptureReader::next(CaptureRecord &record)
+  {
+    while (1) {
+      uint8_t tag;
+      if (!read(&tag,sizeof(tag),true))
+        return false;
+      
+      if (tag == CAPTURE_RECORD_BLOB) {
+        uint64_t key, size;
+        read(&key,sizeof(key));
+        read(&size,sizeof(size));
+        std::vector<uint8_t> &blob = blobs[key];
+        // don't trust the size to allocate all at once
+        const size_t chunkSize = size_t(1)<<24;
+        blob.clear();
+        while (blob.size() < size) {
+          const size_t begin = blob.size();
+          blob.resize(begin+std::min(chunkSize,size_t(size-begin)));
+          read(blob.data()+begin,blob.size()-begin);
+        }
+        continue;
+      }
+      
+      if (tag != CAPTURE_RECORD_CALL)
+        throw std::runtime_error("invalid capture: unknown record tag "
+                                 +std::to_string(int(tag)));
+      uint16_t callID;
+      uint32_t argSize;
+      read(&callID,sizeof(callID));
+      read(&argSize,sizeof(argSize));
+      if (callID == 0 || callID >= CAPTURE_NUM_CALLS)
+        throw std::runtime_error("invalid capture: unknown call ID "
+                                 +std::to_string(callID));
+      record.call = (CaptureCall)callID;
+      record.args.pos = 0;
+      record.args.data.resize(argSize);
+      read(record.args.data.data(),argSize);
+      return true;
+    }
+  }
+
+  const std::vector<uint8_t> *CaptureReader::getBlob(uint64_t key) const
+  {
+    if (key == 0)
+      return nullptr;
+    auto it = blobs.find(key);
+    if (it == blobs.end())
+      throw std::runtime_error("invalid capture: reference to unknown blob "
+                               +toHexString(key));
+    return &it->second;
+  }
+  
+} // ::owl
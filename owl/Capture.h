@@ -0,0 +1,368 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "owl/owl.h"
+#include "owl/common.h"
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+/*! \file Capture.h - a compact binary format for recording the stream
+    of owl api calls (owlCaptureBegin/End), and replaying it (see the
+    owlReplay tool).
+
+    A capture file is a header (magic plus version), followed by a
+    sequence of records, each starting with a one-byte tag:
+
+    - a *blob* record (tag CAPTURE_RECORD_BLOB) holds a block of data
+    that got passed to the api (buffer contents, ptx code, transforms,
+    texels, ...), stored as its 64-bit content key, its size, and
+    the data itself. Every distinct content gets written only once;
+    calls refer to it by key, so a frame loop that keeps uploading
+    the same data adds only a few bytes per frame.
+
+    - a *call* record (tag CAPTURE_RECORD_CALL) holds the ID of the
+    api call (CaptureCall), the size of its arguments, and the
+    arguments themselves: plain values, strings, blob keys, and
+    handles. Handles are numbered in order of creation, starting at
+    1, with 0 meaning 'null'.
+
+    All values are stored in the byte order of the capturing machine
+    (ie, little endian on all platforms owl runs on). Nothing in here
+    depends on cuda or optix, so captures can be written and parsed
+    anywhere. */
+
+namespace owl {
+
+  /*! identifies which api call a call record is for; arguments of
+      each are listed in order (-> means the call creates a handle,
+      which is always the first argument) */
+  enum CaptureCall : uint16_t {
+    /*! -> context, int32 numRequested, bytes deviceIDs */
+    CAPTURE_CONTEXT_CREATE = 1,
+    /*! context */
+    CAPTURE_CONTEXT_DESTROY,
+    /*! context, int64 value - for each of the respective setters */
+    CAPTURE_CONTEXT_SET_RAY_TYPE_COUNT,
+    CAPTURE_CONTEXT_SET_MAX_INSTANCING_DEPTH,
+    CAPTURE_CONTEXT_SET_MAX_TRACE_DEPTH,
+    CAPTURE_CONTEXT_SET_NUM_PAYLOAD_VALUES,
+    CAPTURE_CONTEXT_SET_NUM_ATTRIBUTE_VALUES,
+    CAPTURE_CONTEXT_SET_MAX_REGISTER_COUNT,
+    /*! context */
+    CAPTURE_ENABLE_MOTION_BLUR,
+    CAPTURE_ENABLE_ACCEL_RELOCATION,
+    CAPTURE_ENABLE_ACCEL_SPLITTING,
+    CAPTURE_ENABLE_ACCEL_DEDUP,
+    CAPTURE_BUILD_PROGRAMS,
+    CAPTURE_BUILD_PIPELINE,
+    /*! context, uint32 flags */
+    CAPTURE_BUILD_SBT,
+    
+    /*! -> module, context, blob ptxCode */
+    CAPTURE_MODULE_CREATE,
+    /*! -> geomType, context, uint32 kind, uint64 varStructSize, varDecls */
+    CAPTURE_GEOM_TYPE_CREATE,
+    /*! geomType, int32 rayType, module, string progName */
+    CAPTURE_GEOM_TYPE_SET_CLOSEST_HIT,
+    CAPTURE_GEOM_TYPE_SET_ANY_HIT,
+    CAPTURE_GEOM_TYPE_SET_INTERSECT_PROG,
+    /*! geomType, module, string progName */
+    CAPTURE_GEOM_TYPE_SET_BOUNDS_PROG,
+    /*! -> geom, context, geomType */
+    CAPTURE_GEOM_CREATE,
+    /*! geom, uint64 primCount */
+    CAPTURE_GEOM_SET_PRIM_COUNT,
+    /*! geom, buffer */
+    CAPTURE_USER_GEOM_SET_BOUNDS_BUFFER,
+    /*! geom, handles vertexArrays (one per motion key), uint64 count,
+        uint64 stride, uint64 offset */
+    CAPTURE_TRIANGLES_SET_VERTICES,
+    /*! geom, buffer, uint64 count, uint64 stride, uint64 offset */
+    CAPTURE_TRIANGLES_SET_INDICES,
+    /*! geom, uint32 format */
+    CAPTURE_TRIANGLES_SET_VERTEX_FORMAT,
+    CAPTURE_TRIANGLES_SET_INDEX_FORMAT,
+
+    /*! -> group, context, handles children */
+    CAPTURE_TRIANGLES_GEOM_GROUP_CREATE,
+    CAPTURE_USER_GEOM_GROUP_CREATE,
+    CAPTURE_INSTANCE_GROUP_CREATE,
+    /*! group, int32 whichChild, group child */
+    CAPTURE_INSTANCE_GROUP_SET_CHILD,
+    /*! group, int32 whichChild, uint32 matrixFormat, bytes floats */
+    CAPTURE_INSTANCE_GROUP_SET_TRANSFORM,
+    /*! group, uint32 timeStep, uint32 matrixFormat, blob floats */
+    CAPTURE_INSTANCE_GROUP_SET_TRANSFORMS,
+    /*! group, blob values (one per child) */
+    CAPTURE_INSTANCE_GROUP_SET_INSTANCE_IDS,
+    CAPTURE_INSTANCE_GROUP_SET_VISIBILITY_MASKS,
+    CAPTURE_INSTANCE_GROUP_SET_INSTANCE_FLAGS,
+    /*! group */
+    CAPTURE_GROUP_BUILD_ACCEL,
+    CAPTURE_GROUP_REFIT_ACCEL,
+
+    /*! -> buffer, context, uint32 type, uint64 count, buffer data */
+    CAPTURE_DEVICE_BUFFER_CREATE,
+    CAPTURE_MANAGED_MEMORY_BUFFER_CREATE,
+    /*! -> buffer, context, uint32 type, uint64 count */
+    CAPTURE_HOST_PINNED_BUFFER_CREATE,
+    /*! buffer, uint64 newCount */
+    CAPTURE_BUFFER_RESIZE,
+    /*! buffer, uint64 offset, int64 count, buffer data */
+    CAPTURE_BUFFER_UPLOAD,
+    /*! buffer */
+    CAPTURE_BUFFER_DESTROY,
+    /*! -> texture, context, uint32 texelFormat, uint32 sizeX, uint32
+        sizeY, blob texels, uint32 filterMode, uint32 addressMode,
+        uint32 colorSpace, uint32 linePitchInBytes */
+    CAPTURE_TEXTURE_2D_CREATE,
+    /*! texture */
+    CAPTURE_TEXTURE_2D_DESTROY,
+
+    /*! -> rayGen, context, module, string progName, uint64
+        varStructSize, varDecls */
+    CAPTURE_RAY_GEN_CREATE,
+    CAPTURE_MISS_PROG_CREATE,
+    /*! context, int32 rayType, missProg */
+    CAPTURE_MISS_PROG_SET,
+    /*! -> params, context, uint64 varStructSize, varDecls */
+    CAPTURE_PARAMS_CREATE,
+    /*! params, string offsetVarName, uint64 maxTileSize */
+    CAPTURE_PARAMS_ENABLE_LAUNCH_TILING,
+    /*! params, string offsetVarName, int32 tileSize, float smoothing */
+    CAPTURE_PARAMS_ENABLE_LOAD_BALANCING,
+    /*! params, int32 numSlots */
+    CAPTURE_PARAMS_SET_RING_SIZE,
+
+    /*! -> variable, uint8 objectKind, object, string varName */
+    CAPTURE_GET_VARIABLE,
+    /*! variable, uint32 type, bytes value; the value of a plain
+        (non-object) variable, of its declared type */
+    CAPTURE_VARIABLE_SET_VALUE,
+    /*! variable, handle value */
+    CAPTURE_VARIABLE_SET_BUFFER,
+    CAPTURE_VARIABLE_SET_GROUP,
+    CAPTURE_VARIABLE_SET_TEXTURE,
+    /*! variable, bytes value */
+    CAPTURE_VARIABLE_SET_RAW,
+    /*! variable, uint64 value; an app-owned pointer, so only
+        meaningful in the capturing process */
+    CAPTURE_VARIABLE_SET_POINTER,
+    /*! uint8 objectKind, handle */
+    CAPTURE_RELEASE,
+
+    /*! rayGen, params, int32 x, int32 y, int32 z */
+    CAPTURE_ASYNC_LAUNCH,
+    /*! rayGen, int32 x, int32 y, int32 z */
+    CAPTURE_RAY_GEN_LAUNCH,
+    /*! params */
+    CAPTURE_LAUNCH_SYNC,
+
+    /*! context */
+    CAPTURE_COMMAND_LIST_BEGIN,
+    /*! -> commandList, context */
+    CAPTURE_COMMAND_LIST_END,
+    /*! commandList, followed by the buffer data that each of the
+        list's recorded uploads reads in this replay (in order) */
+    CAPTURE_COMMAND_LIST_REPLAY,
+
+    /*! context */
+    CAPTURE_ENABLE_UPLOAD_REPLICATION,
+
+    CAPTURE_NUM_CALLS
+  };
+
+  /*! which kind of object a handle in CAPTURE_GET_VARIABLE and
+      CAPTURE_RELEASE refers to */
+  enum CaptureObjectKind : uint8_t {
+    CAPTURE_OBJECT_RAY_GEN = 1,
+    CAPTURE_OBJECT_MISS_PROG,
+    CAPTURE_OBJECT_GEOM,
+    CAPTURE_OBJECT_PARAMS,
+    CAPTURE_OBJECT_BUFFER,
+    CAPTURE_OBJECT_MODULE,
+    CAPTURE_OBJECT_GROUP,
+    CAPTURE_OBJECT_VARIABLE,
+    CAPTURE_OBJECT_COMMAND_LIST
+  };
+
+  /*! 'buffer data' (in CAPTURE_*_BUFFER_CREATE and
+      CAPTURE_BUFFER_UPLOAD) is a uint8 CaptureBufferData, followed
+      by either a blob key or a list of handles */
+  enum CaptureBufferData : uint8_t {
+    CAPTURE_BUFFER_DATA_NONE = 0,
+    CAPTURE_BUFFER_DATA_BLOB,
+    CAPTURE_BUFFER_DATA_HANDLES
+  };
+  
+  enum CaptureRecordTag : uint8_t {
+    CAPTURE_RECORD_BLOB = 1,
+    CAPTURE_RECORD_CALL = 2
+  };
+
+  /*! written at the start of every capture file */
+  const char     captureMagic[8] = { 'O','W','L','C','A','P','T','\0' };
+  const uint32_t captureVersion  = 2;
+  
+  /*! a handle in a capture */
+  typedef uint32_t CaptureHandle;
+  
+  /*! the arguments of one call, as they get serialized. 'bytes' and
+      'handles' get written as a uint32 count followed by the
+      elements; 'varDecls' as a uint32 count followed by name, type,
+      and offset of each */
+  struct CaptureArgs {
+    template<typename T>
+    CaptureArgs &put(const T &value)
+    {
+      const uint8_t *begin = (const uint8_t *)&value;
+      data.insert(data.end(),begin,begin+sizeof(value));
+      return *this;
+    }
+    CaptureArgs &putBytes(const void *ptr, size_t numBytes);
+    CaptureArgs &putString(const char *s);
+    CaptureArgs &putHandles(const std::vector<CaptureHandle> &handles);
+    CaptureArgs &putVarDecls(const std::vector<OWLVarDecl> &varDecls);
+    
+    std::vector<uint8_t> data;
+  };
+
+  /*! writes a capture. All methods are thread-safe, but note that
+      a thread's call gets written when that thread writes it -
+      calls that race in the app may end up in either order */
+  struct CaptureWriter {
+    typedef std::shared_ptr<CaptureWriter> SP;
+
+    /*! creates a capture in given file; throws if the file can't be
+        created */
+    CaptureWriter(const std::string &fileName);
+    /*! writes the capture into given stream, which has to outlive
+        the writer */
+    CaptureWriter(std::ostream &out);
+    
+    /*! registers a newly created api handle, and returns its ID */
+    CaptureHandle newHandle(const void *handle);
+
+    /*! returns the ID of a previously created handle (0 for null). A
+        handle that got created before the capture started gets a new
+        ID, which the replayer will refuse - captures have to start
+        before the objects they use get created */
+    CaptureHandle handleID(const void *handle);
+    
+    /*! the IDs of the given handles */
+    template<typename T>
+    std::vector<CaptureHandle> handleIDs(const T *handles, size_t count)
+    {
+      std::vector<CaptureHandle> ids(count);
+      for (size_t i=0;i<count;i++)
+        ids[i] = handleID(handles ? (const void *)handles[i] : nullptr);
+      return ids;
+    }
+    
+    /*! writes given data as a blob (unless the same content got
+        written before), and returns its key; 0 for null */
+    uint64_t blob(const void *data, size_t numBytes);
+    
+    /*! writes a call record */
+    void call(CaptureCall call, const CaptureArgs &args);
+
+    /*! flushes everything written so far */
+    void flush();
+    
+    struct Stats {
+      size_t numCalls       = 0;
+      size_t numBlobs       = 0;
+      size_t blobBytes      = 0;
+      /*! bytes of blobs that didn't have to get written because the
+          same content already was */
+      size_t blobBytesSaved = 0;
+    };
+    Stats getStats();
+    
+  private:
+    void writeHeader();
+    
+    std::unique_ptr<std::ofstream> file;
+    std::ostream &out;
+    std::mutex    mutex;
+    CaptureHandle nextHandleID = 1;
+    std::unordered_map<const void *,CaptureHandle> handleIDsByPointer;
+    /*! size of each blob written so far, by key */
+    std::unordered_map<uint64_t,size_t> blobSizes;
+    Stats stats;
+  };
+
+  /*! reads the arguments of one call record, in the order they got
+      put; throws if reading past the end */
+  struct CaptureArgsReader {
+    template<typename T>
+    T get()
+    {
+      T value;
+      read(&value,sizeof(value));
+      return value;
+    }
+    std::vector<uint8_t>       getBytes();
+    std::string                getString();
+    std::vector<CaptureHandle> getHandles();
+    /*! the var decls; their names point into 'names', which has to
+        live as long as they're used */
+    std::vector<OWLVarDecl>    getVarDecls(std::vector<std::string> &names);
+    bool atEnd() const { return pos == data.size(); }
+    
+    std::vector<uint8_t> data;
+    size_t               pos = 0;
+  private:
+    void read(void *out, size_t numBytes);
+  };
+
+  struct CaptureRecord {
+    CaptureCall       call;
+    CaptureArgsReader args;
+  };
+
+  /*! reads a capture, one call at a time; the blobs get collected
+      along the way. Throws on anything that isn't a valid capture */
+  struct CaptureReader {
+    CaptureReader(const std::string &fileName);
+    /*! reads the capture from given stream, which has to outlive the
+        reader */
+    CaptureReader(std::istream &in);
+
+    /*! reads the next call; returns false at the end of the capture */
+    bool next(CaptureRecord &record);
+
+    /*! the blob of given key, or null for key 0; throws if no such
+        blob got read (yet) */
+    const std::vector<uint8_t> *getBlob(uint64_t key) const;
+    
+  private:
+    void readHeader();
+    /*! reads exactly 'numBytes'; returns false if at the end of the
+        capture before reading anything, and throws if it ends
+        in-between */
+    bool read(void *out, size_t numBytes, bool endOK = false);
+    
+    std::unique_ptr<std::ifstream> file;
+    std::istream &in;
+    std::unordered_map<uint64_t,std::vector<uint8_t>> blobs;
+  };
+  
+} // ::owl
@@ -0,0 +1,316 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "CommandList.h"
+#include "Context.h"
+#include "Buffer.h"
+#include "Group.h"
+#include "RayGen.h"
+#include <cstring>
+
+namespace owl {
+
+  // ------------------------------------------------------------------
+  // CommandList::DeviceData
+  // ------------------------------------------------------------------
+
+  CommandList::DeviceData::CommandData::~CommandData()
+  {
+    if (pinnedMemory)
+      cudaFreeHost(pinnedMemory);
+  }
+  
+  CommandList::DeviceData::DeviceData(const DeviceContext::SP &device)
+    : Object::DeviceData(device)
+  {
+    SetActiveGPU forLifeTime(device);
+    CUDA_CALL(EventCreateWithFlags(&doneEvent,cudaEventDisableTiming));
+  }
+
+  CommandList::DeviceData::~DeviceData()
+  {
+    SetActiveGPU forLifeTime(device);
+    if (inFlight)
+      cudaEventSynchronize(doneEvent);
+    destroyGraph();
+    commandData.clear();
+    cudaEventDestroy(doneEvent);
+  }
+
+  void CommandList::DeviceData::destroyGraph()
+  {
+    if (graphExec)
+      cudaGraphExecDestroy(graphExec);
+    if (graph)
+      cudaGraphDestroy(graph);
+    graphExec = nullptr;
+    graph     = nullptr;
+  }
+
+  // ------------------------------------------------------------------
+  // CommandList
+  // ------------------------------------------------------------------
+  
+  CommandList::CommandList(Context *const context,
+                           std::vector<RecordedCommand> &&commands)
+    : ContextObject(context),
+      commands(std::move(commands)),
+      plan(planReplay(this->commands))
+  {
+    // even with a graph plan, since replay() falls back to these if
+    // the list's launches stop being capturable
+    for (auto &command : this->commands)
+      switch (command.kind) {
+      case COMMAND_BUFFER_UPLOAD: {
+        Buffer::SP buffer = std::static_pointer_cast<Buffer>(command.object);
+        const void *hostPtr = command.hostPtr;
+        const size_t offset = command.offset;
+        const int64_t count = command.count;
+        resolved.push_back([buffer,hostPtr,offset,count]()
+                           { buffer->upload(hostPtr,offset,count); });
+      } break;
+      case COMMAND_GROUP_BUILD_ACCEL: {
+        Group::SP group = std::static_pointer_cast<Group>(command.object);
+        resolved.push_back([group]() { group->buildAccel(); });
+      } break;
+      case COMMAND_GROUP_REFIT_ACCEL: {
+        Group::SP group = std::static_pointer_cast<Group>(command.object);
+        resolved.push_back([group]() { group->refitAccel(); });
+      } break;
+      case COMMAND_LAUNCH: {
+        RayGen::SP rayGen = std::static_pointer_cast<RayGen>(command.object);
+        LaunchParams::SP lp = std::static_pointer_cast<LaunchParams>(command.params);
+        const vec3i dims = command.dims;
+        resolved.push_back([rayGen,lp,dims]() { rayGen->launchAsync(dims,lp); });
+      } break;
+      case COMMAND_LAUNCH_SYNC: {
+        LaunchParams::SP lp = std::static_pointer_cast<LaunchParams>(command.params);
+        resolved.push_back([lp]() { lp->sync(); });
+      } break;
+      }
+  }
+
+  Object::DeviceData::SP CommandList::createOn(const DeviceContext::SP &device)
+  {
+    return std::make_shared<DeviceData>(device);
+  }
+  
+  size_t CommandList::uploadSize(const RecordedCommand &command)
+  {
+    assert(command.kind == COMMAND_BUFFER_UPLOAD);
+    Buffer::SP buffer = std::static_pointer_cast<Buffer>(command.object);
+    // same as DeviceBuffer::upload: offset in bytes, count in elements
+    const size_t numBytes
+      = ((command.count == -1) ? buffer->elementCount : size_t(command.count))
+      * sizeOf(buffer->type);
+    if (command.offset+numBytes > buffer->sizeInBytes())
+      throw std::runtime_error("recorded buffer upload of "+std::to_string(numBytes)
+                               +" bytes at offset "+std::to_string(command.offset)
+                               +" exceeds buffer size of "
+                               +std::to_string(buffer->sizeInBytes())+" bytes");
+    return numBytes;
+  }
+  
+  bool CommandList::launchesStillCapturable() const
+  {
+    for (auto &command : commands)
+      if (command.kind == COMMAND_LAUNCH
+          && !std::static_pointer_cast<LaunchParams>(command.params)
+          ->launchIsCapturable(command.dims))
+        return false;
+    return true;
+  }
+  
+  void CommandList::replay()
+  {
+    if (plan.useGraph && launchesStillCapturable()) {
+      replayGraph();
+      return;
+    }
+
+    // a previous graph replay may still read buffers this one writes
+    if (plan.useGraph)
+      for (auto device : context->getDevices()) {
+        SetActiveGPU forLifeTime(device);
+        DeviceData &dd = getDD(device);
+        if (dd.inFlight) {
+          CUDA_CALL(EventSynchronize(dd.doneEvent));
+          dd.inFlight = false;
+        }
+      }
+    for (auto &command : resolved)
+      command();
+  }
+
+  std::vector<uint64_t> CommandList::computeCaptureKey(const DeviceContext::SP &device)
+  {
+    std::vector<uint64_t> key;
+    key.push_back((uint64_t)device->pipeline);
+    key.push_back((uint64_t)device->sbt.missProgRecordsBuffer.get());
+    key.push_back((uint64_t)device->sbt.missProgRecordCount);
+    key.push_back((uint64_t)device->sbt.missProgRecordSize);
+    key.push_back((uint64_t)device->sbt.hitGroupRecordsBuffer.get());
+    key.push_back((uint64_t)device->sbt.hitGroupRecordCount);
+    key.push_back((uint64_t)device->sbt.hitGroupRecordSize);
+    for (auto &command : commands) {
+      switch (command.kind) {
+      case COMMAND_BUFFER_UPLOAD: {
+        Buffer::SP buffer = std::static_pointer_cast<Buffer>(command.object);
+        key.push_back((uint64_t)buffer->getPointer(device));
+        key.push_back((uint64_t)buffer->sizeInBytes());
+      } break;
+      case COMMAND_LAUNCH: {
+        RayGen::SP rayGen = std::static_pointer_cast<RayGen>(command.object);
+        key.push_back((uint64_t)rayGen->getDD(device).sbtRecordBuffer.d_pointer);
+      } break;
+      default:
+        break;
+      }
+    }
+    return key;
+  }
+  
+  void CommandList::captureGraph(const DeviceContext::SP &device)
+  {
+    DeviceData &dd = getDD(device);
+    dd.destroyGraph();
+    dd.commandData.resize(commands.size());
+
+    // (re-)alloc all staging and params memory first
+    for (size_t i=0;i<commands.size();i++) {
+      const RecordedCommand &command = commands[i];
+      size_t size = 0;
+      if (command.kind == COMMAND_BUFFER_UPLOAD)
+        size = uploadSize(command);
+      else if (command.kind == COMMAND_LAUNCH)
+        size = std::static_pointer_cast<LaunchParams>(command.params)
+          ->getDD(device).dataSize;
+      
+      auto &cd = dd.commandData[i];
+      if (!cd || cd->size != size) {
+        cd.reset(new DeviceData::CommandData);
+        cd->size = size;
+        if (size)
+          CUDA_CALL(MallocHost((void**)&cd->pinnedMemory,size));
+        if (command.kind == COMMAND_LAUNCH)
+          cd->paramsMemory.alloc(size);
+      }
+      if (command.kind == COMMAND_LAUNCH) {
+        RayGen::SP rayGen = std::static_pointer_cast<RayGen>(command.object);
+        rayGen->setupLaunchSBT(cd->sbt,device);
+        if (!dd.stream)
+          dd.stream = std::static_pointer_cast<LaunchParams>(command.params)
+            ->getCudaStream(device);
+      }
+    }
+
+    // then capture all device work in order
+    CUDA_CALL(StreamBeginCapture(dd.stream,cudaStreamCaptureModeThreadLocal));
+    try {
+      for (size_t i=0;i<commands.size();i++) {
+        const RecordedCommand &command = commands[i];
+        auto &cd = dd.commandData[i];
+        switch (command.kind) {
+        case COMMAND_BUFFER_UPLOAD: {
+          Buffer::SP buffer = std::static_pointer_cast<Buffer>(command.object);
+          if (cd->size)
+            CUDA_CALL(MemcpyAsync((uint8_t*)buffer->getPointer(device)+command.offset,
+                                  cd->pinnedMemory,cd->size,
+                                  cudaMemcpyHostToDevice,dd.stream));
+        } break;
+        case COMMAND_LAUNCH: {
+          if (cd->size)
+            CUDA_CALL(MemcpyAsync((void*)cd->paramsMemory.d_pointer,
+                                  cd->pinnedMemory,cd->size,
+                                  cudaMemcpyHostToDevice,dd.stream));
+          OPTIX_CALL(Launch(device->pipeline,
+                            dd.stream,
+                            cd->paramsMemory.d_pointer,
+                            cd->size,
+                            &cd->sbt,
+                            command.dims.x,command.dims.y,command.dims.z));
+        } break;
+        default:
+          // syncs are implicit in the graph's order
+          break;
+        }
+      }
+    } catch (...) {
+      cudaGraph_t aborted = nullptr;
+      cudaStreamEndCapture(dd.stream,&aborted);
+      if (aborted) cudaGraphDestroy(aborted);
+      throw;
+    }
+    CUDA_CALL(StreamEndCapture(dd.stream,&dd.graph));
+#if CUDART_VERSION >= 12000
+    CUDA_CALL(GraphInstantiate(&dd.graphExec,dd.graph,0));
+#else
+    CUDA_CALL(GraphInstantiate(&dd.graphExec,dd.graph,nullptr,nullptr,0));
+#endif
+  }
+
+  void CommandList::replayGraph()
+  {
+    for (auto &command : commands)
+      if (command.kind == COMMAND_BUFFER_UPLOAD)
+        std::static_pointer_cast<Buffer>(command.object)->contentVersion++;
+    
+    for (auto device : context->getDevices()) {
+      SetActiveGPU forLifeTime(device);
+      DeviceData &dd = getDD(device);
+
+      // the previous replay has to be done reading the staging memory
+      if (dd.inFlight) {
+        CUDA_CALL(EventSynchronize(dd.doneEvent));
+        dd.inFlight = false;
+      }
+      
+      std::vector<uint64_t> key = computeCaptureKey(device);
+      if (!dd.graphExec || key != dd.captureKey) {
+        captureGraph(device);
+        dd.captureKey = std::move(key);
+      }
+
+      // stage this replay's data
+      for (size_t i=0;i<commands.size();i++) {
+        const RecordedCommand &command = commands[i];
+        auto &cd = dd.commandData[i];
+        if (!cd->size)
+          continue;
+        if (command.kind == COMMAND_BUFFER_UPLOAD)
+          memcpy(cd->pinnedMemory,command.hostPtr,cd->size);
+        else if (command.kind == COMMAND_LAUNCH) {
+          LaunchParams::SP lp = std::static_pointer_cast<LaunchParams>(command.params);
+          lp->updateHostMemory(device);
+          memcpy(cd->pinnedMemory,lp->getDD(device).hostMemory.data(),cd->size);
+        }
+      }
+      
+      CUDA_CALL(GraphLaunch(dd.graphExec,dd.stream));
+      CUDA_CALL(EventRecord(dd.doneEvent,dd.stream));
+      dd.inFlight = true;
+    }
+
+    if (plan.syncAtEnd)
+      for (auto device : context->getDevices()) {
+        SetActiveGPU forLifeTime(device);
+        DeviceData &dd = getDD(device);
+        CUDA_CALL(EventSynchronize(dd.doneEvent));
+        dd.inFlight = false;
+      }
+  }
+  
+} // ::owl
@@ -0,0 +1,131 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "CommandRecorder.h"
+#include "Object.h"
+#include "DeviceMemory.h"
+#include <functional>
+
+namespace owl {
+
+  /*! a recorded sequence of owl operations (buffer uploads, accel
+      builds and refits, launches, and launch syncs) that can get
+      replayed with minimal host overhead: as one cuda graph per
+      device if all its commands can get captured, or as a loop over
+      pre-resolved commands (no handle lookups, no validation)
+      otherwise. Launches that got tiling or load balancing turned
+      on after recording make a graph list fall back to the latter,
+      since those split up at launch time.
+
+      Replays read buffer upload data from the recorded host pointers,
+      and launch params from their variables' values, at the time of
+      the replay - so an app only has to update those between
+      replays */
+  struct CommandList : public ContextObject {
+    typedef std::shared_ptr<CommandList> SP;
+
+    /*! graph replay state for one device */
+    struct DeviceData : public Object::DeviceData {
+      /*! what each recorded command needs on this device for graph
+          replay */
+      struct CommandData {
+        ~CommandData();
+        
+        /*! pinned memory the host stages the command's data in
+            (buffer data, or launch params) before each replay */
+        uint8_t                *pinnedMemory = nullptr;
+        size_t                  size         = 0;
+        
+        /*! for launches: where the captured launch reads its launch
+            params from, and the SBT it got captured with */
+        DeviceMemory            paramsMemory;
+        OptixShaderBindingTable sbt = {};
+      };
+      
+      DeviceData(const DeviceContext::SP &device);
+      ~DeviceData();
+
+      /*! frees the graph, if there is one */
+      void destroyGraph();
+      
+      std::vector<std::unique_ptr<CommandData>> commandData;
+      cudaGraph_t     graph     = nullptr;
+      cudaGraphExec_t graphExec = nullptr;
+
+      /*! everything the graph's captured device work depends on
+          (pipeline, SBT, buffer and params memory); if that changed
+          the graph needs re-capturing */
+      std::vector<uint64_t> captureKey;
+
+      /*! stream the graph gets captured and replayed on - that of the
+          list's first launch, so syncing those launch params also
+          waits for the replay */
+      cudaStream_t    stream    = nullptr;
+
+      /*! recorded after each graph replay; the next replay has to wait
+          for that before it can overwrite the pinned staging memory */
+      cudaEvent_t     doneEvent = nullptr;
+      bool            inFlight  = false;
+    };
+
+    CommandList(Context *const context,
+                std::vector<RecordedCommand> &&commands);
+    
+    /*! pretty-printer, for printf-debugging */
+    std::string toString() const override { return "CommandList"; }
+
+    /*! creates the device-specific data for this list */
+    Object::DeviceData::SP createOn(const DeviceContext::SP &device) override;
+
+    /*! get reference to given device-specific data for this object */
+    inline DeviceData &getDD(const DeviceContext::SP &device) const
+    {
+      assert(device && device->ID >= 0 && device->ID < (int)deviceData.size());
+      return deviceData[device->ID]->as<DeviceData>();
+    }
+    
+    /*! replay all recorded commands */
+    void replay();
+
+    const std::vector<RecordedCommand> commands;
+    const ReplayPlan                   plan;
+    
+  private:
+    /*! replay as a cuda graph per device */
+    void replayGraph();
+
+    /*! whether all recorded launches can still get replayed from a
+        graph, ie, didn't get tiling or load balancing turned on since
+        they got recorded */
+    bool launchesStillCapturable() const;
+
+    /*! what the graph on given device depends on, \see
+        DeviceData::captureKey */
+    std::vector<uint64_t> computeCaptureKey(const DeviceContext::SP &device);
+    
+    /*! (re-)captures the graph on given device */
+    void captureGraph(const DeviceContext::SP &device);
+
+    /*! number of bytes a recorded buffer upload copies */
+    static size_t uploadSize(const RecordedCommand &command);
+    
+    /*! the non-graph version: one pre-resolved function per command */
+    std::vector<std::function<void()>> resolved;
+  };
+  
+} // ::owl
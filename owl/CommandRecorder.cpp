@@ -0,0 +1,100 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "CommandRecorder.h"
+
+namespace owl {
+
+  void CommandRecorder::begin()
+  {
+    if (recording)
+      throw std::runtime_error("owlCommandListBegin: already recording a command list");
+    recording = true;
+    commands.clear();
+  }
+
+  void CommandRecorder::record(const RecordedCommand &command)
+  {
+    if (!recording)
+      throw std::runtime_error("trying to record a command outside of"
+                               " owlCommandListBegin/owlCommandListEnd");
+    switch (command.kind) {
+    case COMMAND_BUFFER_UPLOAD:
+      if (!command.object)
+        throw std::runtime_error("recorded buffer upload: no buffer");
+      if (!command.hostPtr)
+        throw std::runtime_error("recorded buffer upload: null host pointer");
+      break;
+    case COMMAND_GROUP_BUILD_ACCEL:
+    case COMMAND_GROUP_REFIT_ACCEL:
+      if (!command.object)
+        throw std::runtime_error("recorded accel build/refit: no group");
+      break;
+    case COMMAND_LAUNCH:
+      if (!command.object || !command.params)
+        throw std::runtime_error("recorded launch: no raygen or launch params");
+      if (command.dims.x <= 0 || command.dims.y <= 0 || command.dims.z <= 0)
+        throw std::runtime_error("recorded launch: invalid launch dims "
+                                 +std::to_string(command.dims.x)+"x"
+                                 +std::to_string(command.dims.y)+"x"
+                                 +std::to_string(command.dims.z));
+      break;
+    case COMMAND_LAUNCH_SYNC:
+      if (!command.params)
+        throw std::runtime_error("recorded launch sync: no launch params");
+      break;
+    default:
+      throw std::runtime_error("recorded command of unknown kind");
+    }
+    commands.push_back(command);
+  }
+
+  std::vector<RecordedCommand> CommandRecorder::end()
+  {
+    if (!recording)
+      throw std::runtime_error("owlCommandListEnd without owlCommandListBegin");
+    recording = false;
+    if (commands.empty())
+      throw std::runtime_error("owlCommandListEnd: no commands got recorded");
+    std::vector<RecordedCommand> result;
+    result.swap(commands);
+    return result;
+  }
+
+  ReplayPlan planReplay(const std::vector<RecordedCommand> &commands)
+  {
+    ReplayPlan plan;
+    bool allCapturable = true;
+    bool anyLaunch     = false;
+    for (auto &command : commands) {
+      allCapturable &= command.capturable;
+      anyLaunch     |= (command.kind == COMMAND_LAUNCH);
+      plan.syncAtEnd |= (command.kind == COMMAND_LAUNCH_SYNC);
+    }
+    plan.useGraph = allCapturable && anyLaunch;
+    return plan;
+  }
+
+  bool launchIsCapturable(const vec3i &dims,
+                          size_t maxLaunchSize,
+                          bool tiled,
+                          bool loadBalanced)
+  {
+    return !tiled && !loadBalanced
+      && size_t(dims.x)*size_t(dims.y)*size_t(dims.z) <= maxLaunchSize;
+  }
+  
+} // ::owl
@@ -0,0 +1,117 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "owl/owl.h"
+#include "owl/common.h"
+#include <memory>
+#include <vector>
+
+namespace owl {
+
+  /*! the kinds of operations a command list can record */
+  typedef enum {
+    COMMAND_BUFFER_UPLOAD,
+    COMMAND_GROUP_BUILD_ACCEL,
+    COMMAND_GROUP_REFIT_ACCEL,
+    COMMAND_LAUNCH,
+    COMMAND_LAUNCH_SYNC
+  } CommandKind;
+
+  /*! one recorded operation, with everything needed to replay it
+      already resolved */
+  struct RecordedCommand {
+    CommandKind kind;
+
+    /*! the buffer, group, or raygen this works on; held on to so it
+        stays alive as long as the list does */
+    std::shared_ptr<void> object;
+    
+    /*! the launch params, for launches and launch syncs */
+    std::shared_ptr<void> params;
+
+    /*! for uploads: where the data gets read from *at replay time*,
+        and where in the buffer it goes; same meaning as in
+        owlBufferUpload */
+    const void *hostPtr = nullptr;
+    size_t      offset  = 0;
+    int64_t     count   = -1;
+
+    /*! for launches */
+    vec3i       dims    = vec3i(0);
+
+    /*! whether this command's device work can get captured into a
+        cuda graph (set by whoever records it, who knows the
+        objects) */
+    bool        capturable = false;
+  };
+
+  /*! records commands between begin() and end(), checking that each
+      one makes sense, and that begin/end get used in pairs. Contains
+      no cuda code, so all recording and validation logic can get
+      tested on the host */
+  struct CommandRecorder {
+    
+    /*! starts recording; throws if already recording */
+    void begin();
+
+    /*! checks given command, and appends it; throws if not
+        recording, or if the command is invalid */
+    void record(const RecordedCommand &command);
+
+    /*! ends recording, and returns what got recorded; throws if not
+        recording, or if nothing got recorded */
+    std::vector<RecordedCommand> end();
+
+    /*! whether we're in between begin() and end() */
+    bool isRecording() const { return recording; }
+
+  private:
+    bool recording = false;
+    std::vector<RecordedCommand> commands;
+  };
+
+  /*! how a recorded list of commands gets replayed */
+  struct ReplayPlan {
+    /*! replay everything as one cuda graph per device; otherwise, as
+        a loop over the pre-resolved commands */
+    bool useGraph  = false;
+    
+    /*! whether replay has to wait for all device work at the end,
+        because the list contains a launch sync */
+    bool syncAtEnd = false;
+  };
+
+  /*! decides how to replay the given commands: as a cuda graph if
+      all of them are capturable (and there's at least one launch,
+      which is what makes a graph worth it); syncs in the middle of a
+      graph don't need any host wait, since a graph executes in order
+      anyway - only the one at the end does */
+  ReplayPlan planReplay(const std::vector<RecordedCommand> &commands);
+
+  /*! whether a launch of given dims can get captured into a cuda
+      graph: tiled and load-balanced launches decide how to split up
+      (into tiles, or across devices) at launch time, and a graph
+      would freeze that into one full-size launch on every device;
+      neither can launches that are too big for a single optix
+      launch */
+  bool launchIsCapturable(const vec3i &dims,
+                          size_t maxLaunchSize,
+                          bool tiled,
+                          bool loadBalanced);
+  
+} // ::owl
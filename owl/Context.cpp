@@ -22,22 +22,16 @@
 #include "Texture.h"
 #include "TrianglesGeomGroup.h"
 #include "UserGeomGroup.h"
+#include "owl/common/parallel/parallel_for.h"
+#include <atomic>
+#include <fstream>
+#ifdef __linux__
+# include <sched.h>
+# include <sys/stat.h>
+#endif
 
-#define LOG(message)                            \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_LIGHT_BLUE                \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
-
-#define LOG_OK(message)                         \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_BLUE                      \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
+#define LOG(message)    OWL_LOG_INFO(OWL_LOG_CATEGORY_CONTEXT,message)
+#define LOG_OK(message) OWL_LOG_INFO(OWL_LOG_CATEGORY_CONTEXT,message)
 
 namespace owl {
 
@@ -61,6 +55,13 @@ namespace owl {
   {
     enablePeerAccess();
 
+    deviceWorkers = std::make_shared<DeviceWorkers>
+      ((int)devices.size(),
+       [this](int deviceID) {
+        // each worker permanently runs on "its" GPU
+        CUDA_CHECK(cudaSetDevice(devices[deviceID]->cudaDeviceID));
+      });
+
     LaunchParamsType::SP emptyLPType
       = createLaunchParamsType(0,{});
     dummyLaunchParams = createLaunchParams(emptyLPType);
@@ -68,10 +69,64 @@ namespace owl {
   
   Context::~Context()
   {
+    if (uploadReplication.staging) {
+      cudaFreeHost(uploadReplication.staging);
+      for (auto event : uploadReplication.chunkReady)
+        cudaEventDestroy(event);
+      for (auto &slot : uploadReplication.stagingDone)
+        for (auto event : slot)
+          cudaEventDestroy(event);
+    }
+    deviceWorkers = nullptr;
     devices.clear();
   }
+
+  void Context::parallelForEachDevice(const std::function<void(const DeviceContext::SP &)> &task)
+  {
+    deviceWorkers->parallelFor([&](int deviceID) {
+        const DeviceContext::SP &device = devices[deviceID];
+        SetActiveGPU forLifeTime(device);
+        task(device);
+      });
+  }
   
 
+#ifdef __linux__
+  /*! the NUMA node that the given cuda device is attached to, or -1
+      if unknown */
+  static int getNumaNodeOf(int cudaDeviceID)
+  {
+    int domain = 0, bus = 0, dev = 0;
+    if (cudaDeviceGetAttribute(&domain,cudaDevAttrPciDomainId,cudaDeviceID) != cudaSuccess ||
+        cudaDeviceGetAttribute(&bus,cudaDevAttrPciBusId,cudaDeviceID)       != cudaSuccess ||
+        cudaDeviceGetAttribute(&dev,cudaDevAttrPciDeviceId,cudaDeviceID)    != cudaSuccess)
+      return -1;
+    char pciID[32];
+    snprintf(pciID,sizeof(pciID),"%04x:%02x:%02x.0",domain,bus,dev);
+    std::ifstream in(std::string("/sys/bus/pci/devices/")+pciID+"/numa_node");
+    int node = -1;
+    in >> node;
+    return in ? node : -1;
+  }
+
+  /*! the NUMA node of the cpu the calling thread runs on, or -1 if
+      unknown */
+  static int getNumaNodeOfCallingThread()
+  {
+    const int cpu = sched_getcpu();
+    if (cpu < 0)
+      return -1;
+    const std::string cpuDir
+      = "/sys/devices/system/cpu/cpu"+std::to_string(cpu)+"/node";
+    for (int node=0;node<1024;node++) {
+      struct stat st;
+      if (stat((cpuDir+std::to_string(node)).c_str(),&st) == 0)
+        return node;
+    }
+    return -1;
+  }
+#endif
+  
   void Context::enablePeerAccess()
   {
     LOG("enabling peer access ('.'=self, '+'=can access other device)");
@@ -81,6 +136,18 @@ namespace owl {
     LOG("found " << deviceCount << " CUDA capable devices");
     for (auto device : devices) 
       LOG(" - device #" << device->ID << " : " << device->getDeviceName());
+
+    // devices on another NUMA node than the one creating the context
+    // are "further away" for host uploads
+    topology.resize(deviceCount);
+#ifdef __linux__
+    const int hostNode = getNumaNodeOfCallingThread();
+    for (auto device : devices) {
+      const int deviceNode = getNumaNodeOf(device->getCudaDeviceID());
+      if (hostNode >= 0 && deviceNode >= 0 && deviceNode != hostNode)
+        topology.hostDistance[device->ID] = 1;
+    }
+#endif
     LOG("enabling peer access:");
     
     for (auto device : devices) {
@@ -113,6 +180,15 @@ namespace owl {
             throw std::runtime_error("cuda error in cudaDeviceEnablePeerAccess: "
                                      +std::to_string(rc));
           ss << " +";
+
+          // device i can now pull device j's memory directly. There's
+          // no direct way of asking whether that goes over NVLink,
+          // but native peer atomics are only supported over NVLink
+          int nativeAtomics = 0;
+          cudaDeviceGetP2PAttribute(&nativeAtomics,
+                                    cudaDevP2PAttrNativeAtomicSupported,
+                                    cuda_i,cuda_j);
+          topology.setLink(j,i,nativeAtomics ? PEER_LINK_NVLINK : PEER_LINK_PCIE);
         }
       }
       LOG(ss.str()); 
@@ -217,6 +293,14 @@ namespace owl {
     return lp;
   }
 
+  CommandList::SP
+  Context::createCommandList(std::vector<RecordedCommand> &&commands)
+  {
+    CommandList::SP list = std::make_shared<CommandList>(this,std::move(commands));
+    list->createDeviceData(getDevices());
+    return list;
+  }
+
   MissProg::SP
   Context::createMissProg(const std::shared_ptr<MissProgType> &type)
   {
@@ -349,7 +433,8 @@ namespace owl {
 
   void Context::buildHitGroupRecordsOn(const DeviceContext::SP &device)
   {
-    LOG("building SBT hit group records");
+    TraceScope trace("buildHitGroupRecords","sbt",device->ID);
+    OWL_LOG_DEBUG(OWL_LOG_CATEGORY_BUILD,"building SBT hit group records");
     SetActiveGPU forLifeTime(device);
     if (device->sbt.hitGroupRecordsBuffer.alloced())
       device->sbt.hitGroupRecordsBuffer.free();
@@ -414,13 +499,14 @@ namespace owl {
     device->sbt.hitGroupRecordsBuffer.alloc(hitGroupRecords.size());
     device->sbt.hitGroupRecordsBuffer.upload(hitGroupRecords);
     
-    LOG_OK("done building (and uploading) SBT hit group records");
+    OWL_LOG_DEBUG(OWL_LOG_CATEGORY_BUILD,"done building (and uploading) SBT hit group records");
   }
   
   
   void Context::buildMissProgRecordsOn(const DeviceContext::SP &device)
   {
-    LOG("building SBT miss group records");
+    TraceScope trace("buildMissProgRecords","sbt",device->ID);
+    OWL_LOG_DEBUG(OWL_LOG_CATEGORY_BUILD,"building SBT miss group records");
     SetActiveGPU forLifeTime(device);
     
     size_t numMissProgRecords = numRayTypes;
@@ -461,13 +547,14 @@ namespace owl {
     }
     device->sbt.missProgRecordsBuffer.alloc(missProgRecords.size());
     device->sbt.missProgRecordsBuffer.upload(missProgRecords);
-    LOG_OK("done building (and uploading) SBT miss group records");
+    OWL_LOG_DEBUG(OWL_LOG_CATEGORY_BUILD,"done building (and uploading) SBT miss group records");
   }
 
 
   void Context::buildRayGenRecordsOn(const DeviceContext::SP &device)
   {
-    LOG("building SBT rayGen prog records");
+    TraceScope trace("buildRayGenRecords","sbt",device->ID);
+    OWL_LOG_DEBUG(OWL_LOG_CATEGORY_BUILD,"building SBT rayGen prog records");
     SetActiveGPU forLifeTime(device);
 
     for (size_t rgID=0;rgID<rayGens.size();rgID++) {
@@ -500,24 +587,60 @@ namespace owl {
 
   void Context::buildPipeline()
   {
-    for (auto device : getDevices()) {
-      device->destroyPipeline();
-      device->buildPipeline();
-    }
+    const double t0 = getCurrentTime();
+    parallelForEachDevice([&](const DeviceContext::SP &device) {
+        device->buildPipeline();
+      });
+    buildStats.pipelineBuildTime  = getCurrentTime()-t0;
+    buildStats.numPipelinesBuilt  = 0;
+    buildStats.numPipelinesReused = 0;
+    for (auto device : getDevices())
+      if (device->lastBuild.pipelineReused)
+        buildStats.numPipelinesReused++;
+      else
+        buildStats.numPipelinesBuilt++;
   }
   
   void Context::buildModules()
   {
-    destroyModules();
-    for (auto device : getDevices()) {
-      device->configurePipelineOptions();
-      for (int moduleID=0;moduleID<(int)modules.size();moduleID++) {
-        Module *module = modules.getPtr(moduleID);
-        if (!module) continue;
+    const double t0 = getCurrentTime();
+    std::atomic<int> numBuilt(0), numReused(0);
+    parallelForEachDevice([&](const DeviceContext::SP &device) {
+        TraceScope trace("buildModules","build",device->ID);
+        device->configurePipelineOptions();
+        const uint64_t compileKey = device->computeModuleCompileKey();
+
+        // modules whose ptx (which can't change) and compile options
+        // are the same as last time can be re-used as they are
+        std::vector<Module *> toBuild;
+        for (int moduleID=0;moduleID<(int)modules.size();moduleID++) {
+          Module *module = modules.getPtr(moduleID);
+          if (!module) continue;
+
+          Module::DeviceData &moduleDD = module->getDD(device);
+          if (moduleDD.module && moduleDD.compileKey == compileKey) {
+            numReused++;
+            continue;
+          }
+          moduleDD.destroy();
+          toBuild.push_back(module);
+        }
+        OWL_LOG_DEBUG(OWL_LOG_CATEGORY_BUILD,
+                      "building " << toBuild.size() << " of " << modules.size()
+                      << " module(s) on device #" << device->ID);
         
-        module->getDD(device).build();
-      }
-    }
+        // optix' module compilation is thread-safe, so can build
+        // different modules in parallel
+        owl::common::parallel_for
+          (toBuild.size(),[&](size_t i) {
+            TraceScope trace("buildModule","build",device->ID);
+            toBuild[i]->getDD(device).build(compileKey);
+          });
+        numBuilt += (int)toBuild.size();
+      });
+    buildStats.moduleBuildTime  = getCurrentTime()-t0;
+    buildStats.numModulesBuilt  = numBuilt;
+    buildStats.numModulesReused = numReused;
   }
   
   void Context::setRayTypeCount(size_t rayTypeCount)
@@ -562,19 +685,191 @@ namespace owl {
     } 
   }
 
+  void Context::setMaxTraceDepth(int maxTraceDepth)
+  {
+    if (maxTraceDepth < 0)
+      throw std::runtime_error("invalid max trace depth "
+                               +std::to_string(maxTraceDepth));
+    // (the upper limit is device specific, and gets checked when
+    // building the pipeline)
+    this->maxTraceDepth = maxTraceDepth;
+  }
+
+  void Context::setNumPayloadValues(int numPayloadValues)
+  {
+#if OPTIX_VERSION >= 70400
+    const int maxPayloadValues = 32;
+#else
+    const int maxPayloadValues = 8;
+#endif
+    if (numPayloadValues < 2 || numPayloadValues > maxPayloadValues)
+      throw std::runtime_error("invalid number of payload values "
+                               +std::to_string(numPayloadValues)
+                               +" (must be in 2.."
+                               +std::to_string(maxPayloadValues)+")");
+    this->numPayloadValues = numPayloadValues;
+  }
+
+  void Context::setNumAttributeValues(int numAttributeValues)
+  {
+    if (numAttributeValues < 2 || numAttributeValues > 8)
+      throw std::runtime_error("invalid number of attribute values "
+                               +std::to_string(numAttributeValues)
+                               +" (must be in 2..8)");
+    this->numAttributeValues = numAttributeValues;
+  }
+
+  void Context::setMaxRegisterCount(int maxRegisterCount)
+  {
+    if (maxRegisterCount < 0)
+      throw std::runtime_error("invalid max register count "
+                               +std::to_string(maxRegisterCount));
+    this->maxRegisterCount = maxRegisterCount;
+  }
+
   void Context::enableMotionBlur()
   {
     motionBlurEnabled = true;
   }
 
+  void Context::enableAccelRelocation()
+  {
+    accelRelocationEnabled = true;
+  }
+
+  void Context::enableAccelSplitting()
+  {
+    accelSplittingEnabled = true;
+  }
+
+  void Context::enableAccelDedup()
+  {
+    accelDedupEnabled = true;
+  }
+
+  void Context::enableUploadReplication()
+  {
+    uploadReplicationEnabled = true;
+    uploadReplicationPlan = planReplication(topology);
+    const int numHostUploads = uploadReplicationPlan.numHostUploads();
+    LOG("replicating uploads with " << numHostUploads << " host upload(s) and "
+        << (uploadReplicationPlan.steps.size()-numHostUploads)
+        << " peer copies, in " << uploadReplicationPlan.numRounds << " round(s)");
+  }
+
+  void Context::replicateUploadAsync(const std::vector<uint8_t *> &devicePointers,
+                                     const void *hostPtr,
+                                     size_t numBytes)
+  {
+    assert(devicePointers.size() == devices.size());
+    std::lock_guard<std::mutex> lock(uploadReplication.mutex);
+    if (!uploadReplication.staging) {
+      CUDA_CALL(MallocHost((void**)&uploadReplication.staging,2*replicationChunkSize));
+      for (auto device : devices) {
+        SetActiveGPU forLifeTime(device);
+        cudaEvent_t event;
+        CUDA_CALL(EventCreateWithFlags(&event,cudaEventDisableTiming));
+        uploadReplication.chunkReady.push_back(event);
+        for (auto &slot : uploadReplication.stagingDone) {
+          CUDA_CALL(EventCreateWithFlags(&event,cudaEventDisableTiming));
+          slot.push_back(event);
+        }
+      }
+    }
+    
+    TraceScope trace("replicateUpload","upload");
+    std::vector<std::unique_ptr<GpuTimings::Scope>> timeUploads;
+    for (auto device : devices) {
+      SetActiveGPU forLifeTime(device);
+      timeUploads.emplace_back(new GpuTimings::Scope(device->timings,
+                                                     OWL_TIMING_BUFFER_UPLOAD,
+                                                     device->getStream()));
+    }
+
+    // with more than one host upload (ie, devices without peer
+    // access), stage the data through pinned memory, so each chunk
+    // gets read from pageable memory only once, and copying the next
+    // chunk overlaps with uploading the current one
+    const bool stageHostUploads = uploadReplicationPlan.numHostUploads() > 1;
+    const auto &steps = uploadReplicationPlan.steps;
+    for (size_t begin=0;begin<numBytes;begin+=replicationChunkSize) {
+      const size_t chunkSize = std::min(replicationChunkSize,numBytes-begin);
+      const int    slot      = int((begin/replicationChunkSize) % 2);
+      const uint8_t *hostChunk = (const uint8_t *)hostPtr + begin;
+      if (stageHostUploads) {
+        for (auto &step : steps)
+          if (step.source < 0)
+            CUDA_CALL(EventSynchronize(uploadReplication.stagingDone[slot][step.target]));
+        uint8_t *staging = uploadReplication.staging + slot*replicationChunkSize;
+        memcpy(staging,hostChunk,chunkSize);
+        hostChunk = staging;
+      }
+      // steps are ordered such that a device always has recorded its
+      // 'chunkReady' for this chunk before any other device waits on
+      // it, so one event per device is enough
+      for (auto &step : steps) {
+        DeviceContext::SP target = devices[step.target];
+        SetActiveGPU forLifeTime(target);
+        cudaStream_t stream = target->getStream();
+        if (step.source < 0) {
+          CUDA_CALL(MemcpyAsync(devicePointers[step.target]+begin,hostChunk,chunkSize,
+                                cudaMemcpyHostToDevice,stream));
+          if (stageHostUploads)
+            CUDA_CALL(EventRecord(uploadReplication.stagingDone[slot][step.target],stream));
+        } else {
+          DeviceContext::SP source = devices[step.source];
+          CUDA_CALL(StreamWaitEvent(stream,uploadReplication.chunkReady[step.source],0));
+          CUDA_CALL(MemcpyPeerAsync(devicePointers[step.target]+begin,
+                                    target->getCudaDeviceID(),
+                                    devicePointers[step.source]+begin,
+                                    source->getCudaDeviceID(),
+                                    chunkSize,stream));
+        }
+        CUDA_CALL(EventRecord(uploadReplication.chunkReady[step.target],stream));
+      }
+    }
+    
+    for (auto device : devices) {
+      SetActiveGPU forLifeTime(device);
+      timeUploads[device->ID] = nullptr;
+    }
+  }
+
+  void Context::setModuleCache(const std::string &directory,
+                               size_t maxSizeInBytes)
+  {
+    for (auto device : getDevices())
+      device->setModuleCache(directory,maxSizeInBytes);
+  }
+
+  void Context::setAccelCache(const std::string &directory,
+                              size_t maxSizeInBytes)
+  {
+    if (directory.empty())
+      accelCache = nullptr;
+    else
+      accelCache = std::make_shared<DiskCache>(directory,maxSizeInBytes);
+  }
+
   void Context::buildPrograms()
   {
     buildModules();
-    
+
+    const double t0 = getCurrentTime();
+    parallelForEachDevice([&](const DeviceContext::SP &device) {
+        device->buildPrograms();
+      });
+    buildStats.programGroupBuildTime  = getCurrentTime()-t0;
+    buildStats.numProgramGroupsBuilt  = 0;
+    buildStats.numProgramGroupsReused = 0;
     for (auto device : getDevices()) {
-      SetActiveGPU forLifeTime(device);
-      device->buildPrograms();
+      buildStats.numProgramGroupsBuilt  += device->lastBuild.programGroupsBuilt;
+      buildStats.numProgramGroupsReused += device->lastBuild.programGroupsReused;
     }
+    OWL_LOG_INFO(OWL_LOG_CATEGORY_BUILD,
+                 "built " << buildStats.numProgramGroupsBuilt << " program groups (re-used "
+                 << buildStats.numProgramGroupsReused << ") in "
+                 << prettyDouble(buildStats.programGroupBuildTime) << "s");
   }
 
 
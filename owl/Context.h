@@ -24,6 +24,12 @@
 #include "RayGen.h"
 #include "LaunchParams.h"
 #include "MissProg.h"
+#include "DeviceWorkers.h"
+#include "DiskCache.h"
+#include "CommandList.h"
+#include "Trace.h"
+#include "Log.h"
+#include "UploadReplication.h"
 
 namespace owl {
 
@@ -32,16 +38,6 @@ namespace owl {
   struct Context : public Object {
     typedef std::shared_ptr<Context> SP;
 
-    /*! returns whether logging is enabled */
-    inline static bool logging()
-    {
-#ifdef NDEBUG
-      return false;
-#else
-      return true;
-#endif
-    }
-
     /*! creates a context with the given device IDs. If list of device
       is nullptr, and number requested devices is > 1, then the
       first N devices will get used; invalid device IDs in the list
@@ -57,6 +53,11 @@ namespace owl {
     DeviceContext::SP getDevice(int ID) const
     { assert(ID >= 0 && ID < (int)devices.size()); return devices[ID]; }
 
+    /*! runs the given task once for every device, concurrently on
+        the devices' worker threads (with that device already being
+        the active GPU), and waits for all of them to finish */
+    void parallelForEachDevice(const std::function<void(const DeviceContext::SP &)> &task);
+
     /*! part of the SBT creation - builds the hit group array */
     void buildHitGroupRecordsOn(const DeviceContext::SP &device);
     /*! part of the SBT creation - builds the raygen array */
@@ -72,6 +73,43 @@ namespace owl {
     /*! enables motoin blur - should be done right after context
       creation, and before SBT and pipeline get built */
     void enableMotionBlur();
+
+    /*! enables building geometry accels only once (on the first
+      device), and relocating the result to all other devices */
+    void enableAccelRelocation();
+
+    /*! enables splitting geometry groups whose primitive count
+      exceeds optix' MAX_PRIMITIVES_PER_GAS limit into multiple
+      chunks (rather than throwing an error) */
+    void enableAccelSplitting();
+
+    /*! enables sharing accels between triangle geom groups of
+      identical content */
+    void enableAccelDedup();
+
+    /*! enables replicating device buffer uploads across devices:
+      upload only once from the host, and copy on from there over
+      peer links, following uploadReplicationPlan */
+    void enableUploadReplication();
+
+    /*! copies 'numBytes' of host memory to the given (per-device)
+      device pointers, the way uploadReplicationPlan says; does NOT
+      wait for the copies to complete */
+    void replicateUploadAsync(const std::vector<uint8_t *> &devicePointers,
+                              const void *hostPtr,
+                              size_t numBytes);
+
+    /*! enables a persistent, on-disk cache for geometry accels in
+      the given directory, with given maximum size; an empty
+      directory name disables the cache again */
+    void setAccelCache(const std::string &directory,
+                       size_t maxSizeInBytes);
+
+    /*! enables optix' persistent, on-disk cache for compiled modules
+      in the given directory, with given maximum size; an empty
+      directory name disables the cache again */
+    void setModuleCache(const std::string &directory,
+                        size_t maxSizeInBytes);
     
     /*! sets maximum instancing depth for the given context:
 
@@ -93,6 +131,22 @@ namespace owl {
       instances) */
     void setMaxInstancingDepth(int32_t maxInstanceDepth);
 
+    /*! sets the maximum recursion depth of optixTrace() calls (ie,
+        '1' if only raygen programs trace rays); the pipeline's stack
+        size gets computed from this value and the programs in it */
+    void setMaxTraceDepth(int maxTraceDepth);
+
+    /*! number of 32-bit payload registers (2..32; OWL's own
+        per-ray-data pointer uses the first two) */
+    void setNumPayloadValues(int numPayloadValues);
+
+    /*! number of 32-bit attribute registers (2..8) */
+    void setNumAttributeValues(int numAttributeValues);
+
+    /*! max number of registers per thread that programs get compiled
+        for; '0' means "no limit" */
+    void setMaxRegisterCount(int maxRegisterCount);
+
 
     // ------------------------------------------------------------------
     // internal mechanichs/plumbling that do the actual work
@@ -197,6 +251,11 @@ namespace owl {
     /*! create new instance of a set of launch params of given type */
     LaunchParams::SP
     createLaunchParams(const std::shared_ptr<LaunchParamsType> &type);
+
+    /*! create a command list that replays the given, previously
+      recorded, commands (\see commandRecorder) */
+    CommandList::SP
+    createCommandList(std::vector<RecordedCommand> &&commands);
     
     /*! creates new miss program *type* with given program name (in
       given module), and the given variable declarations that
@@ -259,6 +318,18 @@ namespace owl {
       `setMaxInstancingDepth` */
     int maxInstancingDepth = 1;
 
+    /*! maximum recursion depth of optixTrace() calls, as specified
+      by `setMaxTraceDepth`; also determines the pipeline's stack
+      size */
+    int maxTraceDepth = 2;
+
+    /*! number of 32-bit payload and attribute values, and max
+      registers per thread, that programs get compiled with - change
+      via setNumPayloadValues() etc */
+    int numPayloadValues   = 2;
+    int numAttributeValues = 2;
+    int maxRegisterCount   = 50;
+
     /*! number of ray types - change via setRayTypeCount() */
     int numRayTypes { 1 };
     
@@ -266,14 +337,77 @@ namespace owl {
       via enableMotimBlur() */
     bool motionBlurEnabled = false;
 
+    /*! whether geometry accels get built only on the first device,
+      and then relocated to all other devices - set via
+      enableAccelRelocation() */
+    bool accelRelocationEnabled = false;
+
+    /*! whether geometry groups that exceed optix' primitive limit
+      get split into multiple chunks - set via
+      enableAccelSplitting() */
+    bool accelSplittingEnabled = false;
+
+    /*! whether triangle geom groups with identical content share the
+      same accel - set via enableAccelDedup() */
+    bool accelDedupEnabled = false;
+
+    /*! the shared accels, by content key; \see enableAccelDedup() */
+    DedupTable<SharedAccel> accelDedupTable;
+
+    /*! whether device buffer uploads go to one device only, and get
+      replicated from there - set via enableUploadReplication() */
+    bool uploadReplicationEnabled = false;
+
+    /*! how the devices are connected to each other (and the host),
+      as found in enablePeerAccess() */
+    DeviceTopology topology;
+
+    /*! how replicated uploads get to all devices; planned from
+      'topology' in enableUploadReplication() */
+    ReplicationPlan uploadReplicationPlan;
+
+    /*! records the commands for a command list between
+      owlCommandListBegin and owlCommandListEnd; while it is
+      recording, the API calls it supports get recorded rather than
+      executed */
+    CommandRecorder commandRecorder;
+
+    /*! on-disk cache that geometry accels get stored in (and
+      re-loaded from) across runs; null unless enabled via
+      setAccelCache() */
+    DiskCache::SP accelCache;
+
+    /*! statistics and timings of the most recent buildPrograms()
+      and buildPipeline() */
+    OWLBuildStats buildStats = {};
+
     /*! a set of dummy (ie, empty) launch params. allows us for always
       using the same launch code, *with* launch params, even if th
       user didn't specify any during launch */
     LaunchParams::SP dummyLaunchParams;
 
+    /*! one host worker thread per device, used to run per-device work
+      (accel builds, program compilation, ...) concurrently across all
+      devices */
+    DeviceWorkers::SP deviceWorkers;
+
   private:
     void enablePeerAccess();
     std::vector<DeviceContext::SP> devices;
+
+    /*! what replicateUploadAsync() needs beyond the plan: pinned
+      staging memory for host uploads (two chunks, so filling one
+      overlaps uploading the other), and per-device events. Created
+      upon the first replicated upload */
+    struct {
+      std::mutex               mutex;
+      uint8_t                 *staging = nullptr;
+      /*! per device: recorded after each chunk it received */
+      std::vector<cudaEvent_t> chunkReady;
+      /*! per device and staging chunk: recorded once the device's
+        upload from that chunk is done */
+      std::vector<cudaEvent_t> stagingDone[2];
+    } uploadReplication;
   };
 
 } // ::owl
@@ -16,24 +16,12 @@
 
 #include "Context.h"
 #include "UserGeom.h"
+#include "Hash.h"
 
 #include <optix_function_table_definition.h>
 
-#define LOG(message)                            \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_LIGHT_BLUE                \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
-
-#define LOG_OK(message)                         \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_BLUE                      \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
+#define LOG(message)    OWL_LOG_INFO(OWL_LOG_CATEGORY_CONTEXT,message)
+#define LOG_OK(message) OWL_LOG_INFO(OWL_LOG_CATEGORY_CONTEXT,message)
 
 namespace owl {
 
@@ -166,10 +154,9 @@ namespace owl {
         assert(dev);
         devices.push_back(dev);
       } catch (std::exception &e) {
-        std::cout << OWL_TERMINAL_RED
-                  << "#owl: Error creating optix device on CUDA device #"
-                  << deviceIDs[i] << ": " << e.what() << " ... dropping this device"
-                  << OWL_TERMINAL_DEFAULT << std::endl;
+        OWL_LOG_WARNING(OWL_LOG_CATEGORY_CONTEXT,
+                        "Error creating optix device on CUDA device #"
+                        << deviceIDs[i] << ": " << e.what() << " ... dropping this device");
       }
     }
     
@@ -244,16 +231,56 @@ namespace owl {
     
     OPTIX_CHECK(optixPipelineDestroy(pipeline));
     pipeline = 0;
+    pipelineKey = 0;
   }
   
   
+  uint64_t DeviceContext::computeModuleCompileKey() const
+  {
+    // note: hashing field by field since these structs contain both
+    // pointers and padding
+    ContentHasher hasher;
+    hasher
+      .add(moduleCompileOptions.maxRegisterCount)
+      .add(moduleCompileOptions.optLevel)
+      .add(moduleCompileOptions.debugLevel)
+      .add(pipelineCompileOptions.usesMotionBlur)
+      .add(pipelineCompileOptions.traversableGraphFlags)
+      .add(pipelineCompileOptions.numPayloadValues)
+      .add(pipelineCompileOptions.numAttributeValues)
+      .add(pipelineCompileOptions.exceptionFlags)
+      .add(std::string(pipelineCompileOptions.pipelineLaunchParamsVariableName
+                       ? pipelineCompileOptions.pipelineLaunchParamsVariableName
+                       : ""));
+#if OPTIX_VERSION >= 70100
+    hasher.add(pipelineCompileOptions.usesPrimitiveTypeFlags);
+#endif
+    return hasher.get();
+  }
+
+  void DeviceContext::setModuleCache(const std::string &directory,
+                                     size_t maxSizeInBytes)
+  {
+    if (directory.empty()) {
+      OPTIX_CHECK(optixDeviceContextSetCacheEnabled(optixContext,0));
+      return;
+    }
+    OPTIX_CHECK(optixDeviceContextSetCacheLocation(optixContext,
+                                                   directory.c_str()));
+    // start evicting (down to 3/4 of the max size) once full
+    OPTIX_CHECK(optixDeviceContextSetCacheDatabaseSizes(optixContext,
+                                                        maxSizeInBytes/4*3,
+                                                        maxSizeInBytes));
+    OPTIX_CHECK(optixDeviceContextSetCacheEnabled(optixContext,1));
+  }
+
   void DeviceContext::configurePipelineOptions()
   {
     // ------------------------------------------------------------------
     // configure default module compile options
     // ------------------------------------------------------------------
 #if 1
-    moduleCompileOptions.maxRegisterCount  = 50;
+    moduleCompileOptions.maxRegisterCount  = parent->maxRegisterCount;
     moduleCompileOptions.optLevel          = OPTIX_COMPILE_OPTIMIZATION_LEVEL_3;
     moduleCompileOptions.debugLevel        = OPTIX_COMPILE_DEBUG_LEVEL_NONE;
 #else
@@ -286,8 +313,8 @@ namespace owl {
       break;
     }
     pipelineCompileOptions.usesMotionBlur     = parent->motionBlurEnabled;
-    pipelineCompileOptions.numPayloadValues   = 2;
-    pipelineCompileOptions.numAttributeValues = 2;
+    pipelineCompileOptions.numPayloadValues   = parent->numPayloadValues;
+    pipelineCompileOptions.numAttributeValues = parent->numAttributeValues;
     pipelineCompileOptions.exceptionFlags     = OPTIX_EXCEPTION_FLAG_NONE;
     pipelineCompileOptions.pipelineLaunchParamsVariableName = "optixLaunchParams";
     
@@ -295,17 +322,32 @@ namespace owl {
     // configure default pipeline link options
     // ------------------------------------------------------------------
     // pipelineLinkOptions.overrideUsesMotionBlur = motionBlurEnabled;
-    pipelineLinkOptions.maxTraceDepth          = 2;
+    pipelineLinkOptions.maxTraceDepth          = parent->maxTraceDepth;
     pipelineCompileOptions.pipelineLaunchParamsVariableName = "optixLaunchParams";
   }
   
   void DeviceContext::buildPipeline()
   {
+    TraceScope trace("buildPipeline","build",ID);
     SetActiveGPU forLifeTime(this);
     
     auto &allPGs = allActivePrograms;
     if (allPGs.empty())
       throw std::runtime_error("trying to create a pipeline w/ 0 programs!?");
+
+    const uint64_t newPipelineKey
+      = ContentHasher()
+      .add(allActiveProgramKeys.data(),
+           allActiveProgramKeys.size()*sizeof(allActiveProgramKeys[0]))
+      .add(computeModuleCompileKey())
+      .add(pipelineLinkOptions.maxTraceDepth)
+      .add(pipelineLinkOptions.debugLevel)
+      .add(parent->maxInstancingDepth)
+      .get();
+    lastBuild.pipelineReused = (pipeline && newPipelineKey == pipelineKey);
+    if (lastBuild.pipelineReused)
+      return;
+    destroyPipeline();
     
     char log[2048];
     size_t sizeof_log = sizeof( log );
@@ -330,31 +372,101 @@ namespace owl {
         ("error when building pipeline: "
          "attempting to set max instancing depth to "
          "value that exceeds OptiX's MAX_TRAVERSABLE_GRAPH_DEPTH limit");
-    
+
+    uint32_t maxTraceDepthAllowedByOptix = 0;
+    optixDeviceContextGetProperty
+      (optixContext,
+       OPTIX_DEVICE_PROPERTY_LIMIT_MAX_TRACE_DEPTH,
+       &maxTraceDepthAllowedByOptix,
+       sizeof(maxTraceDepthAllowedByOptix));
+    if (pipelineLinkOptions.maxTraceDepth > maxTraceDepthAllowedByOptix)
+      throw std::runtime_error
+        ("error when building pipeline: "
+         "attempting to set max trace depth to "
+         "value that exceeds OptiX's MAX_TRACE_DEPTH limit");
+
+    const PipelineStackSizes stackSizes = computeStackSizes();
     OPTIX_CHECK(optixPipelineSetStackSize
                 (pipeline,
                  /* [in] The pipeline to configure the stack size for */
-                 2*1024,
+                 stackSizes.directCallableFromTraversal,
                  /* [in] The direct stack size requirement for
                     direct callables invoked from IS or AH. */
-                 2*1024,
+                 stackSizes.directCallableFromState,
                  /* [in] The direct stack size requirement for
                     direct callables invoked from RG, MS, or CH.  */
-                 2*1024,
+                 stackSizes.continuation,
                  /* [in] The continuation stack requirement. */
                  int(parent->maxInstancingDepth+1)
                  /* [in] The maximum depth of a traversable graph
                     passed to trace. */
                  ));
+    pipelineKey = newPipelineKey;
+  }
+
+  /*! computes the pipeline's stack sizes from the stack sizes of
+      all its program groups, for the context's max trace depth; this
+      is the same computation as optixUtilComputeStackSizes() does,
+      for a pipeline without any callables */
+  DeviceContext::PipelineStackSizes DeviceContext::computeStackSizes() const
+  {
+    OptixStackSizes sizes = {};
+    for (auto pg : allActivePrograms) {
+      OptixStackSizes pgSizes = {};
+#if OPTIX_VERSION >= 70700
+      OPTIX_CHECK(optixProgramGroupGetStackSize(pg,&pgSizes,pipeline));
+#else
+      OPTIX_CHECK(optixProgramGroupGetStackSize(pg,&pgSizes));
+#endif
+      sizes.cssRG = std::max(sizes.cssRG,pgSizes.cssRG);
+      sizes.cssMS = std::max(sizes.cssMS,pgSizes.cssMS);
+      sizes.cssCH = std::max(sizes.cssCH,pgSizes.cssCH);
+      sizes.cssAH = std::max(sizes.cssAH,pgSizes.cssAH);
+      sizes.cssIS = std::max(sizes.cssIS,pgSizes.cssIS);
+      sizes.cssCC = std::max(sizes.cssCC,pgSizes.cssCC);
+      sizes.dssDC = std::max(sizes.dssDC,pgSizes.dssDC);
+    }
+
+    const uint32_t maxTraceDepth = pipelineLinkOptions.maxTraceDepth;
+    // what a single (non-final) level of recursion needs: either a
+    // closest hit or a miss program, whichever is larger
+    const uint32_t cssCHOrMS = std::max(sizes.cssCH,sizes.cssMS);
+    
+    PipelineStackSizes result;
+    result.directCallableFromTraversal = 0;
+    result.directCallableFromState     = 0;
+    result.continuation
+      = sizes.cssRG
+      + (std::max(1u,maxTraceDepth)-1) * cssCHOrMS
+      + std::min(1u,maxTraceDepth) * std::max(cssCHOrMS,sizes.cssIS+sizes.cssAH);
+    return result;
   }
 
   void DeviceContext::buildPrograms()
   {
+    TraceScope trace("buildPrograms","build",ID);
     SetActiveGPU forLifeTime(this);
-    destroyPrograms();
+
+    moduleBuildIDs.clear();
+    for (size_t moduleID=0;moduleID<parent->modules.size();moduleID++) {
+      Module *module = parent->modules.getPtr(moduleID);
+      if (!module) continue;
+      Module::DeviceData &moduleDD = module->getDD(shared_from_this());
+      if (moduleDD.module)
+        moduleBuildIDs[moduleDD.module] = moduleDD.buildID;
+    }
+
+    // program groups whose descriptors didn't change since the last
+    // build get re-used (see createProgramGroup()), so don't destroy
+    // anything here
+    allActivePrograms.clear();
+    allActiveProgramKeys.clear();
+    lastBuild.programGroupsBuilt  = 0;
+    lastBuild.programGroupsReused = 0;
     buildMissPrograms();
     buildRayGenPrograms();
     buildHitGroupPrograms();
+    moduleBuildIDs.clear();
   }
 
   void DeviceContext::destroyPrograms()
@@ -366,19 +478,78 @@ namespace owl {
     destroyHitGroupPrograms();
 
     allActivePrograms.clear();
+    allActiveProgramKeys.clear();
+  }
+
+  uint64_t DeviceContext::computeProgramGroupKey(const OptixProgramGroupDesc &pgDesc) const
+  {
+    ContentHasher hasher;
+    auto addEntryPoint = [&](OptixModule module, const char *name) {
+      auto it = moduleBuildIDs.find(module);
+      hasher
+        .add(it == moduleBuildIDs.end() ? uint64_t(0) : it->second)
+        .add(std::string(name ? name : ""));
+    };
+    hasher.add(pgDesc.kind);
+    switch (pgDesc.kind) {
+    case OPTIX_PROGRAM_GROUP_KIND_RAYGEN:
+      addEntryPoint(pgDesc.raygen.module,pgDesc.raygen.entryFunctionName);
+      break;
+    case OPTIX_PROGRAM_GROUP_KIND_MISS:
+      addEntryPoint(pgDesc.miss.module,pgDesc.miss.entryFunctionName);
+      break;
+    case OPTIX_PROGRAM_GROUP_KIND_HITGROUP:
+      addEntryPoint(pgDesc.hitgroup.moduleCH,pgDesc.hitgroup.entryFunctionNameCH);
+      addEntryPoint(pgDesc.hitgroup.moduleAH,pgDesc.hitgroup.entryFunctionNameAH);
+      addEntryPoint(pgDesc.hitgroup.moduleIS,pgDesc.hitgroup.entryFunctionNameIS);
+      break;
+    default:
+      throw std::runtime_error("un-supported program group kind");
+    }
+    return hasher.get();
+  }
+
+  void DeviceContext::createProgramGroup(const OptixProgramGroupDesc &pgDesc,
+                                         OptixProgramGroup &pg,
+                                         uint64_t &pgKey)
+  {
+    const uint64_t newKey = computeProgramGroupKey(pgDesc);
+    if (pg && pgKey == newKey) {
+      lastBuild.programGroupsReused++;
+    } else {
+      if (pg) {
+        // the pipeline may still be using this
+        destroyPipeline();
+        OPTIX_CHECK(optixProgramGroupDestroy(pg));
+        pg = 0;
+      }
+      OptixProgramGroupOptions pgOptions = {};
+      char log[2048];
+      size_t sizeof_log = sizeof( log );
+      OPTIX_CHECK(optixProgramGroupCreate(optixContext,
+                                          &pgDesc,
+                                          1,
+                                          &pgOptions,
+                                          log,&sizeof_log,
+                                          &pg
+                                          ));
+      assert(pg);
+      pgKey = newKey;
+      lastBuild.programGroupsBuilt++;
+    }
+    allActivePrograms.push_back(pg);
+    allActiveProgramKeys.push_back(pgKey);
   }
 
   /*! build all optix progrmas for miss program types */
   void DeviceContext::buildMissPrograms()
   {
     for (size_t progID=0;progID<parent->missProgTypes.size();progID++) {
-      OptixProgramGroupOptions pgOptions = {};
       OptixProgramGroupDesc    pgDesc    = {};
       
       MissProgType *prog = parent->missProgTypes.getPtr(progID);
       if (!prog) continue;
       auto &dd = prog->getDD(shared_from_this());
-      assert(dd.pg == 0);
 
       Module::SP module = prog->module;
       assert(module);
@@ -389,18 +560,8 @@ namespace owl {
       
       pgDesc.miss.module            = optixModule;
       pgDesc.miss.entryFunctionName = prog->annotatedProgName.c_str();
-      
-      char log[2048];
-      size_t sizeof_log = sizeof( log );
-      OPTIX_CHECK(optixProgramGroupCreate(optixContext,
-                                          &pgDesc,
-                                          1,
-                                          &pgOptions,
-                                          log,&sizeof_log,
-                                          &dd.pg
-                                          ));
-      assert(dd.pg);
-      allActivePrograms.push_back(dd.pg);
+
+      createProgramGroup(pgDesc,dd.pg,dd.pgKey);
     }
   }
 
@@ -414,20 +575,19 @@ namespace owl {
 
       OPTIX_CHECK(optixProgramGroupDestroy(dd.pg));
       dd.pg = 0;
+      dd.pgKey = 0;
     }
   }
   
   void DeviceContext::buildRayGenPrograms()
   {
     for (size_t pgID=0;pgID<parent->rayGenTypes.size();pgID++) {
-      OptixProgramGroupOptions pgOptions = {};
       OptixProgramGroupDesc    pgDesc    = {};
       
       RayGenType *prog = parent->rayGenTypes.getPtr(pgID);
       if (!prog) continue;
       
       auto &dd = prog->getDD(shared_from_this());
-      assert(dd.pg == 0);
       
       Module::SP module = prog->module;
       assert(module);
@@ -438,18 +598,8 @@ namespace owl {
       pgDesc.kind                     = OPTIX_PROGRAM_GROUP_KIND_RAYGEN;
       pgDesc.raygen.module            = optixModule;
       pgDesc.raygen.entryFunctionName = prog->annotatedProgName.c_str();
-      
-      char log[2048];
-      size_t sizeof_log = sizeof( log );
-      OPTIX_CHECK(optixProgramGroupCreate(optixContext,
-                                          &pgDesc,
-                                          1,
-                                          &pgOptions,
-                                          log,&sizeof_log,
-                                          &dd.pg
-                                          ));
-      assert(dd.pg);
-      allActivePrograms.push_back(dd.pg);
+
+      createProgramGroup(pgDesc,dd.pg,dd.pgKey);
     }
   }
   
@@ -464,6 +614,7 @@ namespace owl {
       
       OPTIX_CHECK(optixProgramGroupDestroy(dd.pg));
       dd.pg = 0;
+      dd.pgKey = 0;
     }
   }
   
@@ -482,15 +633,21 @@ namespace owl {
       UserGeomType::SP userGeomType
         = geomType->as<UserGeomType>();
       if (userGeomType)
-        userGeomType->buildBoundsProg();
+        userGeomType->buildBoundsProg(shared_from_this());
       
       auto &dd = geomType->getDD(shared_from_this());
-      dd.hgPGs.clear();
-      dd.hgPGs.resize(numRayTypes);
+      // in case the number of ray types went down
+      while ((int)dd.hgPGs.size() > numRayTypes) {
+        destroyPipeline();
+        if (dd.hgPGs.back())
+          OPTIX_CHECK(optixProgramGroupDestroy(dd.hgPGs.back()));
+        dd.hgPGs.pop_back();
+      }
+      dd.hgPGs.resize(numRayTypes,0);
+      dd.hgPGKeys.resize(numRayTypes,0);
       
       for (int rt=0;rt<numRayTypes;rt++) {
         
-        OptixProgramGroupOptions pgOptions = {};
         OptixProgramGroupDesc    pgDesc    = {};
         
         pgDesc.kind      = OPTIX_PROGRAM_GROUP_KIND_HITGROUP;
@@ -507,17 +664,7 @@ namespace owl {
         // now let the type fill in what it has
         dd.fillPGDesc(pgDesc,geomType.get(),rt);
 
-        char log[2048];
-        size_t sizeof_log = sizeof( log );
-        OptixProgramGroup &pg = dd.hgPGs[rt];
-        OPTIX_CHECK(optixProgramGroupCreate(optixContext,
-                                            &pgDesc,
-                                            1,
-                                            &pgOptions,
-                                            log,&sizeof_log,
-                                            &pg
-                                            ));
-        allActivePrograms.push_back(pg);
+        createProgramGroup(pgDesc,dd.hgPGs[rt],dd.hgPGKeys[rt]);
       }
     }
   }
@@ -535,6 +682,7 @@ namespace owl {
           OPTIX_CHECK(optixProgramGroupDestroy(pg));
         }
       dd.hgPGs.clear();
+      dd.hgPGKeys.clear();
     }
   }
   
@@ -20,6 +20,7 @@
 #include "owl/common.h"
 #include "owl/DeviceMemory.h"
 #include "owl/helper/optix.h"
+#include "owl/GpuTimings.h"
 
 namespace owl {
 
@@ -86,6 +87,17 @@ namespace owl {
         based on what values (motion blur on/off, multi-level
         instnacing, etc) are set in the context */
     void configurePipelineOptions();
+
+    /*! returns a key over all the options that affect compiling a
+        module on this device (ie, the module and pipeline compile
+        options, as set by configurePipelineOptions()); a module that
+        was built with the same key can be reused as is */
+    uint64_t computeModuleCompileKey() const;
+
+    /*! enables optix' persistent (on-disk) cache for compiled modules
+        in the given directory; an empty directory name disables it */
+    void setModuleCache(const std::string &directory,
+                        size_t maxSizeInBytes);
       
     void buildPrograms();
     void buildMissPrograms();
@@ -98,13 +110,58 @@ namespace owl {
     void destroyHitGroupPrograms();
 
     void destroyPipeline();
+    /*! (re-)links the pipeline from all active programs - unless
+        the existing pipeline was already linked from the very same
+        programs and options */
     void buildPipeline();
 
+    /*! the stack sizes to configure a pipeline with */
+    struct PipelineStackSizes {
+      uint32_t directCallableFromTraversal;
+      uint32_t directCallableFromState;
+      uint32_t continuation;
+    };
+    
+    /*! computes the stack sizes the current pipeline requires, based
+        on its active programs and the max trace depth */
+    PipelineStackSizes computeStackSizes() const;
+
+    /*! returns a key over everything that goes into creating a
+        program group from the given descriptor: its kind, its
+        entry points, and the builds of the modules it refers to */
+    uint64_t computeProgramGroupKey(const OptixProgramGroupDesc &pgDesc) const;
+
+    /*! creates 'pg' from the given descriptor, unless it already
+        exists and was created from an identical descriptor (as
+        tracked by 'pgKey'), in which case it simply gets re-used;
+        either way, it gets added to the active programs */
+    void createProgramGroup(const OptixProgramGroupDesc &pgDesc,
+                            OptixProgramGroup &pg,
+                            uint64_t &pgKey);
+
     /*! collects all compiled programs during 'buildPrograms', such
         that all active progs can then be passed to optix durign
         pipeline creation */
     std::vector<OptixProgramGroup> allActivePrograms;
 
+    /*! the keys of allActivePrograms, in the same order */
+    std::vector<uint64_t> allActiveProgramKeys;
+
+    /*! maps the optix handles of all currently built modules to their
+        build IDs; (only) valid during buildPrograms() */
+    std::map<OptixModule,uint64_t> moduleBuildIDs;
+
+    /*! key over everything the current pipeline was linked from */
+    uint64_t pipelineKey = 0;
+
+    /*! what the most recent buildPrograms() and buildPipeline() had
+        to (re-)create on this device, and what they could re-use */
+    struct {
+      int  programGroupsBuilt = 0;
+      int  programGroupsReused = 0;
+      bool pipelineReused = false;
+    } lastBuild;
+
     OptixDeviceContext optixContext = nullptr;
     CUcontext          cudaContext  = nullptr;
     CUstream           stream       = nullptr;
@@ -115,6 +172,10 @@ namespace owl {
     OptixPipeline               pipeline               = nullptr;
     SBT                         sbt                    = {};
 
+    /*! gpu timings of the launches, builds and uploads on this
+        device; disabled by default */
+    GpuTimings timings;
+
     /*! the owl context that this device is in */
     Context *const parent;
 
@@ -0,0 +1,179 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "DeviceWorkers.h"
+
+namespace owl {
+
+  /*! the pool (if any) whose worker the current thread is; used to
+      detect (and serialize) nested parallelFor's */
+  static thread_local const DeviceWorkers *currentWorkerPool = nullptr;
+
+  // ------------------------------------------------------------------
+  // WorkerFence
+  // ------------------------------------------------------------------
+
+  WorkerFence::WorkerFence(int numPending)
+    : numPending(numPending)
+  {}
+
+  void WorkerFence::wait()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock,[this]{ return numPending == 0; });
+    if (firstError)
+      std::rethrow_exception(firstError);
+  }
+
+  bool WorkerFence::done()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return numPending == 0;
+  }
+
+  void WorkerFence::signal(std::exception_ptr error)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    assert(numPending > 0);
+    if (error && !firstError)
+      firstError = error;
+    if (--numPending == 0)
+      cv.notify_all();
+  }
+
+  // ------------------------------------------------------------------
+  // DeviceWorkers::Worker
+  // ------------------------------------------------------------------
+
+  /*! a single device's worker thread, with its own task queue */
+  struct DeviceWorkers::Worker {
+    Worker(const DeviceWorkers *pool, int deviceID);
+    ~Worker();
+
+    void push(const Task &task, const WorkerFence::SP &fence);
+
+  private:
+    void run();
+
+    struct Job {
+      Task            task;
+      WorkerFence::SP fence;
+    };
+
+    const DeviceWorkers    *const pool;
+    const int               deviceID;
+    std::mutex              mutex;
+    std::condition_variable cv;
+    std::deque<Job>         jobs;
+    bool                    quit = false;
+    std::thread             thread;
+  };
+
+  DeviceWorkers::Worker::Worker(const DeviceWorkers *pool, int deviceID)
+    : pool(pool),
+      deviceID(deviceID),
+      thread([this]{ run(); })
+  {}
+
+  DeviceWorkers::Worker::~Worker()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      quit = true;
+    }
+    cv.notify_one();
+    thread.join();
+  }
+
+  void DeviceWorkers::Worker::push(const Task &task,
+                                   const WorkerFence::SP &fence)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      jobs.push_back({task,fence});
+    }
+    cv.notify_one();
+  }
+
+  void DeviceWorkers::Worker::run()
+  {
+    currentWorkerPool = pool;
+    while (1) {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        // note we only quit once the queue is drained
+        cv.wait(lock,[this]{ return quit || !jobs.empty(); });
+        if (jobs.empty())
+          return;
+        job = jobs.front();
+        jobs.pop_front();
+      }
+      try {
+        job.task(deviceID);
+        job.fence->signal();
+      } catch (...) {
+        job.fence->signal(std::current_exception());
+      }
+    }
+  }
+
+  // ------------------------------------------------------------------
+  // DeviceWorkers
+  // ------------------------------------------------------------------
+
+  DeviceWorkers::DeviceWorkers(int numDevices, const Task &initWorker)
+  {
+    for (int deviceID=0;deviceID<numDevices;deviceID++)
+      workers.push_back(std::unique_ptr<Worker>(new Worker(this,deviceID)));
+    if (!initWorker)
+      return;
+    // always run this on the workers themselves, even for a single
+    // device, since it sets up per-thread state
+    WorkerFence::SP fence = std::make_shared<WorkerFence>(numDevices);
+    for (auto &worker : workers)
+      worker->push(initWorker,fence);
+    fence->wait();
+  }
+
+  DeviceWorkers::~DeviceWorkers()
+  {
+    workers.clear();
+  }
+
+  WorkerFence::SP DeviceWorkers::submit(int deviceID, const Task &task)
+  {
+    assert(deviceID >= 0 && deviceID < numDevices());
+    WorkerFence::SP fence = std::make_shared<WorkerFence>(1);
+    workers[deviceID]->push(task,fence);
+    return fence;
+  }
+
+  void DeviceWorkers::parallelFor(const Task &task)
+  {
+    if (numDevices() == 1 || currentWorkerPool == this) {
+      for (int deviceID=0;deviceID<numDevices();deviceID++)
+        task(deviceID);
+      return;
+    }
+
+    WorkerFence::SP fence = std::make_shared<WorkerFence>(numDevices());
+    for (auto &worker : workers)
+      worker->push(task,fence);
+    fence->wait();
+  }
+
+} // ::owl
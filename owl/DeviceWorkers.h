@@ -0,0 +1,98 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "owl/common.h"
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <exception>
+
+namespace owl {
+
+  /*! a fence that gets signalled once all the tasks it was issued for
+      have completed. Note this class does not know anything about
+      cuda or devices; it only tracks host-side completion of tasks */
+  struct WorkerFence {
+    typedef std::shared_ptr<WorkerFence> SP;
+
+    /*! create a fence that waits for 'numPending' tasks */
+    WorkerFence(int numPending);
+
+    /*! block until all tasks have completed; re-throws the first
+        exception that any of those tasks threw */
+    void wait();
+
+    /*! non-blocking check whether all tasks have completed */
+    bool done();
+
+    /*! mark one of the tasks as completed, with given error (or
+        nullptr if it completed successfully) */
+    void signal(std::exception_ptr error = nullptr);
+
+  private:
+    std::mutex              mutex;
+    std::condition_variable cv;
+    int                     numPending;
+    std::exception_ptr      firstError;
+  };
+
+  /*! a small pool of host worker threads, exactly one per device,
+      that allows for running per-device work (accel builds, program
+      compilation, ...) concurrently across all devices. Tasks
+      submitted to the same device always execute in submission
+      order, and always on that device's thread.
+
+      The pool itself is agnostic of cuda - the 'initWorker' callback
+      (which each worker runs once, on its own thread, before any
+      other task) is where a real context makes "its" GPU active; a
+      test can instead plug in a simulated device backend */
+  struct DeviceWorkers {
+    typedef std::shared_ptr<DeviceWorkers> SP;
+
+    /*! a task to be run on a given device's worker; the argument is
+        the (owl-, not cuda-) ID of that device */
+    typedef std::function<void(int deviceID)> Task;
+
+    /*! create one worker thread for each of 'numDevices' devices;
+        re-throws any exception that 'initWorker' threw on any of
+        the workers */
+    DeviceWorkers(int numDevices, const Task &initWorker = Task());
+
+    /*! waits for all pending tasks, then terminates all workers */
+    ~DeviceWorkers();
+
+    int numDevices() const { return (int)workers.size(); }
+
+    /*! enqueue a task for the given device, and return immediately;
+        the returned fence can be used to wait for its completion */
+    WorkerFence::SP submit(int deviceID, const Task &task);
+
+    /*! run the given task on every device's worker (concurrently),
+        and wait until all of them are done; re-throws the first
+        exception that any of them threw. If called from within one
+        of the workers, or with only a single device, the tasks get
+        executed serially on the calling thread instead */
+    void parallelFor(const Task &task);
+
+  private:
+    struct Worker;
+    std::vector<std::unique_ptr<Worker>> workers;
+  };
+
+} // ::owl
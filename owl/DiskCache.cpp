@@ -0,0 +1,238 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "DiskCache.h"
+#include "Hash.h"
+#include <fstream>
+#include <stdio.h>
+#ifdef _WIN32
+# include <direct.h>
+#else
+# include <sys/stat.h>
+#endif
+
+namespace owl {
+
+  /*! header at the start of every blob file */
+  struct BlobHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint64_t sizeInBytes;
+    uint64_t contentHash;
+  };
+
+  static const uint32_t blobMagic   = 0x43574f4c; /* "LOWC" */
+  static const uint32_t blobVersion = 1;
+  static const char    *indexHeader = "owl-disk-cache-index";
+
+  /*! create the directory if it doesn't exist yet (single level only) */
+  static void makeDirectory(const std::string &directory)
+  {
+#ifdef _WIN32
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(),0755);
+#endif
+  }
+
+  DiskCache::DiskCache(const std::string &directory,
+                       size_t maxSizeInBytes)
+    : directory(directory),
+      maxSizeInBytes(maxSizeInBytes)
+  {
+    makeDirectory(directory);
+    readIndex();
+  }
+
+  std::string DiskCache::fileNameFor(uint64_t key) const
+  {
+    return directory+"/"+toHexString(key)+".blob";
+  }
+
+  void DiskCache::readIndex()
+  {
+    entries.clear();
+    totalSizeInBytes = 0;
+    useCounter = 0;
+    
+    std::ifstream in(directory+"/index.txt");
+    std::string header;
+    if (!(in >> header >> useCounter) || header != indexHeader)
+      // no (valid) index - start with an empty cache
+      return;
+
+    std::string hexKey;
+    Entry entry;
+    while (in >> hexKey >> entry.sizeInBytes >> entry.lastUsed) {
+      const uint64_t key = std::stoull(hexKey,nullptr,16);
+      // drop entries whose files have gone missing
+      FILE *file = fopen(fileNameFor(key).c_str(),"rb");
+      if (!file) continue;
+      fclose(file);
+      entries[key] = entry;
+      totalSizeInBytes += entry.sizeInBytes;
+    }
+  }
+
+  void DiskCache::writeIndex()
+  {
+    const std::string fileName = directory+"/index.txt";
+    const std::string tmpName  = fileName+".tmp";
+    {
+      std::ofstream out(tmpName);
+      out << indexHeader << " " << useCounter << "\n";
+      for (auto &it : entries)
+        out << toHexString(it.first) << " "
+            << it.second.sizeInBytes << " "
+            << it.second.lastUsed << "\n";
+    }
+    std::remove(fileName.c_str());
+    std::rename(tmpName.c_str(),fileName.c_str());
+  }
+  
+  bool DiskCache::load(uint64_t key, std::vector<uint8_t> &blob)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end())
+      return false;
+
+    bool valid = false;
+    FILE *file = fopen(fileNameFor(key).c_str(),"rb");
+    if (file) {
+      BlobHeader header;
+      if (fread(&header,sizeof(header),1,file) == 1 &&
+          header.magic   == blobMagic &&
+          header.version == blobVersion &&
+          header.key     == key) {
+        blob.resize(header.sizeInBytes);
+        valid
+          = (fread(blob.data(),1,blob.size(),file) == blob.size())
+          && (hash64(blob.data(),blob.size()) == header.contentHash);
+      }
+      fclose(file);
+    }
+    
+    if (!valid) {
+      blob.clear();
+      removeEntry(key);
+      writeIndex();
+      return false;
+    }
+    
+    it->second.lastUsed = ++useCounter;
+    writeIndex();
+    return true;
+  }
+
+  void DiskCache::store(uint64_t key, const void *blob, size_t numBytes)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    removeEntry(key);
+    if (numBytes > maxSizeInBytes) {
+      writeIndex();
+      return;
+    }
+    
+    BlobHeader header;
+    header.magic       = blobMagic;
+    header.version     = blobVersion;
+    header.key         = key;
+    header.sizeInBytes = numBytes;
+    header.contentHash = hash64(blob,numBytes);
+
+    // write to a temp file first, so readers never see partially
+    // written blobs
+    const std::string fileName = fileNameFor(key);
+    const std::string tmpName  = fileName+".tmp";
+    FILE *file = fopen(tmpName.c_str(),"wb");
+    if (!file)
+      throw std::runtime_error("could not create file '"+tmpName
+                               +"' in disk cache");
+    const bool ok
+      =  fwrite(&header,sizeof(header),1,file) == 1
+      && fwrite(blob,1,numBytes,file) == numBytes;
+    fclose(file);
+    // (on windows, rename fails if the target exists)
+    std::remove(fileName.c_str());
+    if (!ok || std::rename(tmpName.c_str(),fileName.c_str()) != 0) {
+      // out of disk space or similar - not fatal, that's only a cache
+      std::remove(tmpName.c_str());
+      writeIndex();
+      return;
+    }
+
+    Entry entry;
+    entry.sizeInBytes = numBytes;
+    entry.lastUsed    = ++useCounter;
+    entries[key] = entry;
+    totalSizeInBytes += numBytes;
+    
+    evict();
+    writeIndex();
+  }
+
+  void DiskCache::remove(uint64_t key)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    removeEntry(key);
+    writeIndex();
+  }
+
+  bool DiskCache::contains(uint64_t key)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.find(key) != entries.end();
+  }
+
+  size_t DiskCache::numEntries()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+  }
+
+  size_t DiskCache::sizeInBytes()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return totalSizeInBytes;
+  }
+
+  /*! remove entry and file, but don't update the index file */
+  void DiskCache::removeEntry(uint64_t key)
+  {
+    auto it = entries.find(key);
+    if (it == entries.end())
+      return;
+    totalSizeInBytes -= it->second.sizeInBytes;
+    entries.erase(it);
+    std::remove(fileNameFor(key).c_str());
+  }
+
+  /*! evict least recently used entries until we're within budget */
+  void DiskCache::evict()
+  {
+    while (totalSizeInBytes > maxSizeInBytes && !entries.empty()) {
+      auto lru = entries.begin();
+      for (auto it = entries.begin(); it != entries.end(); ++it)
+        if (it->second.lastUsed < lru->second.lastUsed)
+          lru = it;
+      removeEntry(lru->first);
+    }
+  }
+  
+} // ::owl
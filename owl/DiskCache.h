@@ -0,0 +1,90 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "owl/common.h"
+
+namespace owl {
+
+  /*! a simple, persistent, content-addressed cache of binary blobs
+      on disk: every blob gets stored in its own file (named after its
+      64-bit key) in the given directory, and an index file in that
+      same directory keeps track of blob sizes and of when each blob
+      was last used. Once the sum of all blob sizes exceeds the
+      configured budget, the least recently used blobs get evicted.
+
+      Every blob gets stored with a header containing its key, size,
+      and a hash of its content, so truncated or otherwise corrupted
+      files simply show up as cache misses.
+
+      Thread-safe within a process; sharing the same directory across
+      multiple processes at the same time is not supported. */
+  struct DiskCache {
+    typedef std::shared_ptr<DiskCache> SP;
+
+    /*! open (or create) the cache in the given directory, with given
+        budget for the sum of all blob sizes */
+    DiskCache(const std::string &directory,
+              size_t maxSizeInBytes);
+
+    /*! look up the blob for the given key; returns false if no valid
+        blob for this key exists */
+    bool load(uint64_t key, std::vector<uint8_t> &blob);
+
+    /*! store given blob under given key (replacing whatever was
+        stored under that key before), then evict least recently used
+        blobs until the cache is within its budget again. Blobs that
+        are larger than the entire budget do not get stored at all */
+    void store(uint64_t key, const void *blob, size_t numBytes);
+
+    /*! remove the blob for the given key, if it exists */
+    void remove(uint64_t key);
+
+    /*! whether there is an entry for given key in the index */
+    bool contains(uint64_t key);
+
+    /*! number of blobs currently in the cache */
+    size_t numEntries();
+
+    /*! sum of sizes of all blobs currently in the cache */
+    size_t sizeInBytes();
+
+    const std::string directory;
+    const size_t      maxSizeInBytes;
+
+  private:
+    struct Entry {
+      size_t   sizeInBytes;
+      /*! value of 'useCounter' when this entry was last stored or
+          loaded; used for LRU eviction */
+      uint64_t lastUsed;
+    };
+
+    std::string fileNameFor(uint64_t key) const;
+    void readIndex();
+    void writeIndex();
+    void removeEntry(uint64_t key);
+    void evict();
+
+    std::map<uint64_t,Entry> entries;
+    size_t   totalSizeInBytes = 0;
+    uint64_t useCounter       = 0;
+    std::mutex mutex;
+  };
+
+} // ::owl
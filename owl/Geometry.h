@@ -62,6 +62,9 @@ namespace owl {
       
       /*! hit group program groups, per ray type */
       std::vector<OptixProgramGroup> hgPGs;
+
+      /*! keys of the descriptors that the hgPGs were created from */
+      std::vector<uint64_t> hgPGKeys;
     };
 
     /*! create new geometry type with given parameters/variables */
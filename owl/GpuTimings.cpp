@@ -0,0 +1,110 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "GpuTimings.h"
+
+namespace owl {
+
+  GpuTimings::Scope::Scope(GpuTimings &timings,
+                           OWLTimingKind kind,
+                           CUstream stream)
+    : kind(kind), stream(stream)
+  {
+    if (!timings.isEnabled())
+      return;
+    std::lock_guard<std::mutex> lock(timings.mutex);
+    start = timings.allocEvent();
+    CUDA_CALL(EventRecord(start,stream));
+    this->timings = &timings;
+  }
+
+  GpuTimings::Scope::~Scope()
+  {
+    if (!timings)
+      return;
+    std::lock_guard<std::mutex> lock(timings->mutex);
+    cudaEvent_t end = timings->allocEvent();
+    CUDA_CALL_NOTHROW(EventRecord(end,stream));
+    timings->pending.push_back({kind,start,end});
+  }
+
+  GpuTimings::~GpuTimings()
+  {
+    for (auto &p : pending) {
+      cudaEventDestroy(p.start);
+      cudaEventDestroy(p.end);
+    }
+    for (auto event : freeEvents)
+      cudaEventDestroy(event);
+  }
+  
+  void GpuTimings::setEnabled(bool enabled)
+  {
+    this->enabled.store(enabled,std::memory_order_relaxed);
+  }
+  
+  cudaEvent_t GpuTimings::allocEvent()
+  {
+    // keep the number of outstanding events bounded even if nobody
+    // ever asks for the stats
+    if (freeEvents.empty() && pending.size() > 2*TimingWindow::defaultWindowSize)
+      collect();
+    if (!freeEvents.empty()) {
+      cudaEvent_t event = freeEvents.back();
+      freeEvents.pop_back();
+      return event;
+    }
+    cudaEvent_t event;
+    CUDA_CALL(EventCreate(&event));
+    return event;
+  }
+  
+  void GpuTimings::collect()
+  {
+    // each stream completes its events in order, but operations of
+    // different streams complete out of order - so look at all of
+    // them, not just the front
+    for (auto it = pending.begin(); it != pending.end(); ) {
+      if (cudaEventQuery(it->end) != cudaSuccess) {
+        ++it;
+        continue;
+      }
+      float ms = 0.f;
+      if (cudaEventElapsedTime(&ms,it->start,it->end) == cudaSuccess)
+        windows[it->kind].add(ms);
+      freeEvents.push_back(it->start);
+      freeEvents.push_back(it->end);
+      it = pending.erase(it);
+    }
+  }
+  
+  OWLTimingStats GpuTimings::getStats(OWLTimingKind kind)
+  {
+    assert(kind >= 0 && kind < OWL_TIMING_NUM_KINDS);
+    std::lock_guard<std::mutex> lock(mutex);
+    collect();
+    return windows[kind].getStats();
+  }
+
+  void GpuTimings::reset()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    collect();
+    for (auto &window : windows)
+      window.reset();
+  }
+  
+} // ::owl
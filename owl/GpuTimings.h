@@ -0,0 +1,83 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "TimingWindow.h"
+#include "owl/helper/cuda.h"
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+namespace owl {
+
+  /*! GPU-side timings of launches, accel builds, and uploads on one
+      device: when enabled, each timed operation gets a pair of cuda
+      events recorded around it in its stream, and the elapsed times
+      of all pairs that have completed get collected into one
+      TimingWindow per kind of operation. Nothing in here ever waits
+      for the GPU. */
+  struct GpuTimings {
+    ~GpuTimings();
+
+    /*! records the start event of a timed operation upon
+        construction, and its end event upon destruction; a no-op if
+        timing is disabled */
+    struct Scope {
+      Scope(GpuTimings &timings, OWLTimingKind kind, CUstream stream);
+      ~Scope();
+    private:
+      GpuTimings   *timings = nullptr;
+      OWLTimingKind kind;
+      CUstream      stream;
+      cudaEvent_t   start;
+    };
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const
+    { return enabled.load(std::memory_order_relaxed); }
+    
+    /*! stats of all operations of given kind that have completed by
+        now */
+    OWLTimingStats getStats(OWLTimingKind kind);
+
+    /*! drops all stats (but not the operations still in flight) */
+    void reset();
+    
+  private:
+    /*! moves the elapsed times of all completed event pairs into
+        their windows; requires the mutex to be held */
+    void collect();
+    
+    cudaEvent_t allocEvent();
+    
+    struct Pending {
+      OWLTimingKind kind;
+      cudaEvent_t   start;
+      cudaEvent_t   end;
+    };
+
+    /*! event pairs that were recorded, in order of recording */
+    std::deque<Pending>      pending;
+    /*! events no longer in use, for re-use */
+    std::vector<cudaEvent_t> freeEvents;
+    TimingWindow             windows[OWL_TIMING_NUM_KINDS];
+    std::mutex               mutex;
+    /*! read by all threads that do timed work, without the mutex */
+    std::atomic<bool>        enabled { false };
+  };
+  
+} // ::owl
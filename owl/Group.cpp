@@ -50,6 +50,356 @@ namespace owl {
     return "Group";
   }
 
+#if OPTIX_VERSION >= 70600
+  typedef OptixRelocationInfo      AccelRelocationInfo;
+#else
+  typedef OptixAccelRelocationInfo AccelRelocationInfo;
+#endif
+
+  /*! chunk size in which hashDeviceData() downloads device memory;
+      this is part of the resulting hash, so must never change without
+      also changing accelCacheHasher() */
+  const size_t deviceHashChunkSize = 64*1024*1024;
+
+  /*! query relocation info for the accel built on given device */
+  static AccelRelocationInfo getRelocationInfo(const DeviceContext::SP &device,
+                                               OptixTraversableHandle traversable)
+  {
+    AccelRelocationInfo relocInfo = {};
+    SetActiveGPU forLifeTime(device);
+    OPTIX_CHECK(optixAccelGetRelocationInfo(device->optixContext,
+                                            traversable,
+                                            &relocInfo));
+    return relocInfo;
+  }
+
+  /*! checks whether an accel with given relocation info can be
+      relocated to the given device */
+  static bool isRelocationCompatible(const DeviceContext::SP &device,
+                                     const AccelRelocationInfo &relocInfo)
+  {
+    SetActiveGPU forLifeTime(device);
+    int compatible = 0;
+#if OPTIX_VERSION >= 70600
+    OPTIX_CHECK(optixCheckRelocationCompatibility(device->optixContext,
+                                                  &relocInfo,
+                                                  &compatible));
+#else
+    OPTIX_CHECK(optixAccelCheckRelocationCompatibility(device->optixContext,
+                                                       &relocInfo,
+                                                       &compatible));
+#endif
+    return compatible != 0;
+  }
+
+  /*! relocates an accel whose memory has already been copied into
+      dd.bvhMemory, and updates the traversable and memory stats
+      accordingly. Has to be called with the device active */
+  static void relocateInPlace(const DeviceContext::SP &device,
+                              Group::DeviceData &dd,
+                              const AccelRelocationInfo &relocInfo)
+  {
+    OPTIX_CHECK(optixAccelRelocate(device->optixContext,
+                                   /* todo: stream */0,
+                                   &relocInfo,
+                                   /* no instance handles to patch in a GAS: */
+                                   0,0,
+                                   (CUdeviceptr)dd.bvhMemory.get(),
+                                   dd.bvhMemory.size(),
+                                   &dd.traversable));
+    CUDA_SYNC_CHECK();
+    
+    dd.memFinal = dd.bvhMemory.size();
+    dd.memPeak  = dd.bvhMemory.size();
+
+    // whatever this device had before, it's no longer split
+    dd.chunkTraversables.clear();
+    dd.chunkMemory.clear();
+    dd.chunkInstanceBuffer.free();
+  }
+  
+  bool Group::relocateAccel(const DeviceContext::SP &source,
+                            const DeviceContext::SP &target)
+  {
+    DeviceData &srcDD = getDD(source);
+    DeviceData &dstDD = getDD(target);
+    assert(srcDD.traversable);
+    if (isSplit(source))
+      // relocation only handles a single accel, not a whole hierarchy
+      return false;
+
+    const AccelRelocationInfo relocInfo
+      = getRelocationInfo(source,srcDD.traversable);
+    if (!isRelocationCompatible(target,relocInfo))
+      return false;
+
+    SetActiveGPU forLifeTime(target);
+    const size_t accelSize = srcDD.bvhMemory.size();
+    if (dstDD.bvhMemory.size() != accelSize)
+      dstDD.bvhMemory.alloc(accelSize);
+    // this works with and without peer access (in the latter case
+    // cuda will stage through host memory)
+    CUDA_CHECK(cudaMemcpyPeer(dstDD.bvhMemory.get(),target->getCudaDeviceID(),
+                              srcDD.bvhMemory.get(),source->getCudaDeviceID(),
+                              accelSize));
+    relocateInPlace(target,dstDD,relocInfo);
+    return true;
+  }
+
+  SharedAccel::SP Group::shareAccel(size_t bufferBytes)
+  {
+    assert(!sharedAccel);
+    SharedAccel::SP accel = std::make_shared<SharedAccel>();
+    for (auto device : context->getDevices()) {
+      DeviceData &dd = getDD(device);
+      assert(!isSplit(device));
+      std::unique_ptr<SharedAccel::DeviceData> shared(new SharedAccel::DeviceData);
+      // hand the memory over, without copying it
+      std::swap(shared->bvhMemory.d_pointer,  dd.bvhMemory.d_pointer);
+      std::swap(shared->bvhMemory.sizeInBytes,dd.bvhMemory.sizeInBytes);
+      shared->traversable = dd.traversable;
+      accel->perDevice.push_back(std::move(shared));
+    }
+    accel->accelBytes  = getDD(context->getDevice(0)).memFinal;
+    accel->bufferBytes = bufferBytes;
+    sharedAccel = accel;
+    return accel;
+  }
+
+  void Group::useSharedAccel(const SharedAccel::SP &accel)
+  {
+    assert(accel);
+    for (auto device : context->getDevices()) {
+      DeviceData &dd = getDD(device);
+      dd.bvhMemory.free();
+      dd.chunkTraversables.clear();
+      dd.chunkMemory.clear();
+      dd.chunkInstanceBuffer.free();
+      dd.traversable = accel->perDevice[device->ID]->traversable;
+      dd.memFinal    = 0;
+      dd.memPeak     = 0;
+    }
+    sharedAccel = accel;
+  }
+
+  void Group::releaseSharedAccel()
+  {
+    if (!sharedAccel)
+      return;
+    // if no other group uses it (any more), we can simply take the
+    // accel back
+    const bool soleUser = (sharedAccel.use_count() == 1);
+    for (auto device : context->getDevices()) {
+      DeviceData &dd = getDD(device);
+      if (soleUser) {
+        SharedAccel::DeviceData &shared = *sharedAccel->perDevice[device->ID];
+        std::swap(shared.bvhMemory.d_pointer,  dd.bvhMemory.d_pointer);
+        std::swap(shared.bvhMemory.sizeInBytes,dd.bvhMemory.sizeInBytes);
+        dd.memFinal = dd.bvhMemory.size();
+      } else {
+        dd.traversable = 0;
+        dd.memFinal    = 0;
+        dd.memPeak     = 0;
+      }
+    }
+    sharedAccel = nullptr;
+  }
+
+  void Group::buildOnAllDevices(const std::function<void(const DeviceContext::SP &)> &buildOn)
+  {
+    if (!context->accelRelocationEnabled || context->deviceCount() == 1) {
+      context->parallelForEachDevice(buildOn);
+      return;
+    }
+    
+    const DeviceContext::SP first = context->getDevice(0);
+    {
+      SetActiveGPU forLifeTime(first);
+      buildOn(first);
+    }
+    context->parallelForEachDevice([&](const DeviceContext::SP &device) {
+        if (device != first && !relocateAccel(first,device))
+          buildOn(device);
+      });
+  }
+
+  void Group::buildOnAllDevicesCached(uint64_t cacheKey,
+                                      const std::function<void(const DeviceContext::SP &)> &buildOn)
+  {
+    if (context->accelCache && loadAccelFromCache(cacheKey))
+      return;
+    
+    buildOnAllDevices(buildOn);
+    
+    if (context->accelCache)
+      storeAccelInCache(cacheKey);
+  }
+
+  void Group::buildChunkInstanceAccelOn(const DeviceContext::SP &device,
+                                       bool fullRebuild)
+  {
+    DeviceData &dd = getDD(device);
+    assert(!dd.chunkTraversables.empty());
+
+    // one identity instance per chunk; all chunks contain all of this
+    // group's build inputs, so they all share its SBT offset
+    std::vector<OptixInstance> instances(dd.chunkTraversables.size());
+    for (size_t chunkID=0;chunkID<instances.size();chunkID++) {
+      OptixInstance &oi = instances[chunkID];
+      oi = {};
+      oi.transform[0*4+0]  = 1.f;
+      oi.transform[1*4+1]  = 1.f;
+      oi.transform[2*4+2]  = 1.f;
+      oi.instanceId        = 0;
+      oi.sbtOffset         = context->numRayTypes * getSBTOffset();
+      oi.visibilityMask    = 255;
+      oi.flags             = OPTIX_INSTANCE_FLAG_NONE;
+      oi.traversableHandle = dd.chunkTraversables[chunkID];
+    }
+    dd.chunkInstanceBuffer.alloc(instances.size()*sizeof(instances[0]));
+    dd.chunkInstanceBuffer.upload(instances.data(),"chunkinstances");
+
+    OptixBuildInput instanceInput = {};
+    instanceInput.type = OPTIX_BUILD_INPUT_TYPE_INSTANCES;
+    instanceInput.instanceArray.instances
+      = (CUdeviceptr)dd.chunkInstanceBuffer.get();
+    instanceInput.instanceArray.numInstances
+      = (int)instances.size();
+
+    OptixAccelBuildOptions accelOptions = {};
+    accelOptions.buildFlags =
+      OPTIX_BUILD_FLAG_PREFER_FAST_TRACE |
+      OPTIX_BUILD_FLAG_ALLOW_UPDATE;
+    accelOptions.motionOptions.numKeys = 1;
+    accelOptions.operation
+      = fullRebuild
+      ? OPTIX_BUILD_OPERATION_BUILD
+      : OPTIX_BUILD_OPERATION_UPDATE;
+
+    OptixAccelBufferSizes bufferSizes;
+    OPTIX_CHECK(optixAccelComputeMemoryUsage(device->optixContext,
+                                             &accelOptions,
+                                             &instanceInput,1,
+                                             &bufferSizes));
+    DeviceMemory tempBuffer;
+    tempBuffer.alloc(fullRebuild
+                     ? bufferSizes.tempSizeInBytes
+                     : bufferSizes.tempUpdateSizeInBytes);
+    if (fullRebuild) {
+      dd.bvhMemory.alloc(bufferSizes.outputSizeInBytes);
+      dd.memPeak  += tempBuffer.size() + dd.bvhMemory.size();
+      dd.memFinal += dd.bvhMemory.size() + dd.chunkInstanceBuffer.size();
+    }
+    {
+      GpuTimings::Scope timeBuild(device->timings,OWL_TIMING_ACCEL_BUILD,
+                                  /* todo: stream */0);
+      OPTIX_CHECK(optixAccelBuild(device->optixContext,
+                                  /* todo: stream */0,
+                                  &accelOptions,
+                                  &instanceInput,1,
+                                  (CUdeviceptr)tempBuffer.get(),
+                                  tempBuffer.size(),
+                                  (CUdeviceptr)dd.bvhMemory.get(),
+                                  dd.bvhMemory.size(),
+                                  &dd.traversable,
+                                  nullptr,0u));
+    }
+    CUDA_SYNC_CHECK();
+    tempBuffer.free();
+  }
+  
+  ContentHasher Group::accelCacheHasher() const
+  {
+    const DeviceContext::SP first = context->getDevice(0);
+    
+    int driverVersion = 0;
+    CUDA_CHECK(cudaDriverGetVersion(&driverVersion));
+    cudaDeviceProp prop;
+    CUDA_CHECK(cudaGetDeviceProperties(&prop,first->getCudaDeviceID()));
+    
+    ContentHasher hasher;
+    hasher
+      .add(std::string("owl-accel-cache-v1"))
+      .add((int)OPTIX_VERSION)
+      .add(driverVersion)
+      .add(std::string(prop.name))
+      .add(prop.major)
+      .add(prop.minor)
+      .add(deviceHashChunkSize);
+    return hasher;
+  }
+
+  void Group::hashDeviceData(ContentHasher &hasher,
+                             const void *d_data,
+                             size_t numBytes) const
+  {
+    SetActiveGPU forLifeTime(context->getDevice(0));
+    std::vector<uint8_t> chunk(std::min(numBytes,deviceHashChunkSize));
+    for (size_t begin=0;begin<numBytes;begin+=deviceHashChunkSize) {
+      const size_t size = std::min(numBytes-begin,deviceHashChunkSize);
+      CUDA_CHECK(cudaMemcpy(chunk.data(),(const uint8_t*)d_data+begin,
+                            size,cudaMemcpyDefault));
+      hasher.add(chunk.data(),size);
+    }
+    hasher.add(numBytes);
+  }
+
+  bool Group::loadAccelFromCache(uint64_t cacheKey)
+  {
+    assert(context->accelCache);
+    // blob layout: relocation info, accel size, accel memory
+    std::vector<uint8_t> blob;
+    if (!context->accelCache->load(cacheKey,blob))
+      return false;
+
+    const size_t headerSize = sizeof(AccelRelocationInfo)+sizeof(uint64_t);
+    if (blob.size() < headerSize)
+      return false;
+    AccelRelocationInfo relocInfo;
+    uint64_t accelSize;
+    memcpy(&relocInfo,blob.data(),sizeof(relocInfo));
+    memcpy(&accelSize,blob.data()+sizeof(relocInfo),sizeof(accelSize));
+    if (blob.size() != headerSize+accelSize)
+      return false;
+    
+    for (auto device : context->getDevices())
+      if (!isRelocationCompatible(device,relocInfo))
+        return false;
+
+    const uint8_t *accel = blob.data()+headerSize;
+    context->parallelForEachDevice([&](const DeviceContext::SP &device) {
+        DeviceData &dd = getDD(device);
+        dd.bvhMemory.alloc(accelSize);
+        dd.bvhMemory.upload(accel);
+        relocateInPlace(device,dd,relocInfo);
+      });
+    return true;
+  }
+
+  void Group::storeAccelInCache(uint64_t cacheKey)
+  {
+    assert(context->accelCache);
+    const DeviceContext::SP first = context->getDevice(0);
+    DeviceData &dd = getDD(first);
+    assert(dd.traversable);
+    if (isSplit(first))
+      // can't relocate a split accel, so no point in caching it
+      return;
+    
+    const AccelRelocationInfo relocInfo
+      = getRelocationInfo(first,dd.traversable);
+    const uint64_t accelSize = dd.bvhMemory.size();
+
+    std::vector<uint8_t> blob(sizeof(relocInfo)+sizeof(accelSize)+accelSize);
+    memcpy(blob.data(),&relocInfo,sizeof(relocInfo));
+    memcpy(blob.data()+sizeof(relocInfo),&accelSize,sizeof(accelSize));
+    {
+      SetActiveGPU forLifeTime(first);
+      dd.bvhMemory.download(blob.data()+sizeof(relocInfo)+sizeof(accelSize));
+    }
+    context->accelCache->store(cacheKey,blob.data(),blob.size());
+  }
+  
   // ------------------------------------------------------------------
   // GeomGroup
   // ------------------------------------------------------------------
@@ -77,6 +427,38 @@ namespace owl {
     geometries[childID] = child;
   }
   
+  std::vector<std::pair<size_t,size_t>>
+  GeomGroup::computeChunkRanges(size_t numPrims, size_t maxPrimsPerChunk)
+  {
+    assert(maxPrimsPerChunk > 0);
+    const size_t numChunks = std::max(size_t(1),divRoundUp(numPrims,maxPrimsPerChunk));
+    std::vector<std::pair<size_t,size_t>> ranges(numChunks);
+    for (size_t chunkID=0;chunkID<numChunks;chunkID++)
+      ranges[chunkID] = { (chunkID*numPrims)/numChunks,
+                          ((chunkID+1)*numPrims)/numChunks };
+    return ranges;
+  }
+
+  void GeomGroup::setNumChunksOn(const DeviceContext::SP &device,
+                                 size_t numChunks,
+                                 bool fullRebuild)
+  {
+    DeviceData &dd = getDD(device);
+    if (!fullRebuild) {
+      if (dd.chunkTraversables.size() != numChunks)
+        throw std::runtime_error("number of primitives in geom group changed "
+                                 "since it was last built; needs a rebuild, "
+                                 "not a refit");
+      return;
+    }
+    dd.chunkTraversables.clear();
+    dd.chunkMemory.clear();
+    dd.chunkInstanceBuffer.free();
+    dd.chunkTraversables.resize(numChunks);
+    for (size_t chunkID=0;chunkID<numChunks;chunkID++)
+      dd.chunkMemory.push_back(std::unique_ptr<DeviceMemory>(new DeviceMemory));
+  }
+  
   /*! pretty-printer, for printf-debugging */
   std::string GeomGroup::toString() const
   {
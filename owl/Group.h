@@ -18,11 +18,32 @@
 
 #include "RegisteredObject.h"
 #include "Geometry.h"
+#include "Hash.h"
+#include "AccelDedup.h"
 // #include "ll/DeviceMemory.h"
 // #include "ll/Device.h"
 
 namespace owl {
 
+  /*! an accel that is shared by several geometry groups of
+      identical content (\see Context::enableAccelDedup); it owns the
+      accel memory on each device, and gets released once the last
+      group using it lets go of it */
+  struct SharedAccel {
+    typedef std::shared_ptr<SharedAccel> SP;
+
+    struct DeviceData {
+      DeviceMemory           bvhMemory;
+      OptixTraversableHandle traversable = 0;
+    };
+    std::vector<std::unique_ptr<DeviceData>> perDevice;
+
+    /*! size of the accel (on each device) */
+    size_t accelBytes  = 0;
+    /*! size of the vertex and index data it got built over */
+    size_t bufferBytes = 0;
+  };
+  
   /*! abstract base class for any sort of group (ie, BVH), BLAS'es and
       IAS'es will be derived from this class */
   struct Group : public RegisteredObject {
@@ -50,6 +71,18 @@ namespace owl {
       
       //! peak memory uesd during building, last time it was built.
       size_t memPeak = 0;
+
+      /*! if this group's accel had to be split into multiple chunks
+          (\see Context::enableAccelSplitting), the traversables of
+          those chunks - 'traversable' then refers to an internal
+          instance accel over these chunks. Empty if not split. */
+      std::vector<OptixTraversableHandle> chunkTraversables;
+
+      /*! the (compacted) accel memory for each chunk, if split */
+      std::vector<std::unique_ptr<DeviceMemory>> chunkMemory;
+
+      /*! the instances of the internal instance accel, if split */
+      DeviceMemory chunkInstanceBuffer;
     };
 
     /*! constructor, that registers this group in the context's registry */
@@ -76,9 +109,75 @@ namespace owl {
     /*! creates the device-specific data for this group */
     RegisteredObject::DeviceData::SP createOn(const DeviceContext::SP &device) override;
 
+    /*! copies this group's accel - which has to already be built on
+        'source' - over to 'target', using optix' accel relocation
+        mechanism. Returns false (without doing anything) if the accel
+        built on 'source' cannot be relocated to 'target' (eg, because
+        the two GPUs are of different architectures), in which case
+        the caller has to build on 'target' itself */
+    bool relocateAccel(const DeviceContext::SP &source,
+                       const DeviceContext::SP &target);
+
+    /*! runs the given per-device build function for every device,
+        concurrently across devices. If accel relocation is enabled
+        in the context, only the first device runs a build, and all
+        others get a relocated copy of its result (or fall back to
+        their own build if they aren't relocation-compatible) */
+    void buildOnAllDevices(const std::function<void(const DeviceContext::SP &)> &buildOn);
+
+    /*! same as buildOnAllDevices(), but if the context has an accel
+        cache (\see Context::setAccelCache) this first looks for an
+        accel stored under the given key, and on a hit relocates that
+        to all devices (without running any builds at all); on a miss
+        it builds as usual, and stores the first device's result in
+        the cache */
+    void buildOnAllDevicesCached(uint64_t cacheKey,
+                                 const std::function<void(const DeviceContext::SP &)> &buildOn);
+
+    /*! returns a hasher that has already been seeded with everything
+        that - apart from the build inputs themselves - determines
+        whether a cached accel can be re-used: optix version, driver
+        version, and the first device's architecture */
+    ContentHasher accelCacheHasher() const;
+
+    /*! add the content of the given memory on the *first* device to
+        the given hasher */
+    void hashDeviceData(ContentHasher &hasher,
+                        const void *d_data,
+                        size_t numBytes) const;
+
+    /*! try to load the accel for the given key from the context's
+        accel cache onto all devices; returns false (and leaves all
+        devices untouched) if there is no such accel, or if it cannot
+        be relocated to each of our devices */
+    bool loadAccelFromCache(uint64_t cacheKey);
+
+    /*! stores the accel built on the first device in the context's
+        accel cache, under given key */
+    void storeAccelInCache(uint64_t cacheKey);
+
     /*! returns the (device-specific) optix traversable handle to traverse this group */
     inline OptixTraversableHandle getTraversable(const DeviceContext::SP &device) const;
 
+    /*! returns the traversables that a parent instance of this group
+        should refer to: one per chunk if this group's accel got split
+        into multiple chunks (so parents can flatten those chunks into
+        their own instances, rather than adding another level of
+        instancing), or just the group's traversable otherwise */
+    inline std::vector<OptixTraversableHandle>
+    getInstanceTargets(const DeviceContext::SP &device) const;
+
+    /*! whether this group's accel on the given device is split into
+        multiple chunks */
+    inline bool isSplit(const DeviceContext::SP &device) const
+    { return !getDD(device).chunkTraversables.empty(); }
+
+    /*! (re-)builds the internal instance accel over all chunks
+        (dd.chunkTraversables) into dd.bvhMemory and dd.traversable.
+        Has to be called with the device active */
+    void buildChunkInstanceAccelOn(const DeviceContext::SP &device,
+                                   bool fullRebuild);
+
     /*! returns the (device) memory used for this group's acceleration
       structure (but _excluding_ the memory for the geometries
       itself). "memFinal" is how much memory is used for the _final_
@@ -92,8 +191,27 @@ namespace owl {
       memPeak  = dd.memPeak;
     }
 
+    /*! turns this group's just-built accel into a shared one, which
+        from then on owns the accel memory; the group itself keeps
+        using it, and other groups can now, too */
+    SharedAccel::SP shareAccel(size_t bufferBytes);
+
+    /*! have this group use the given shared accel, instead of one of
+        its own */
+    void useSharedAccel(const SharedAccel::SP &accel);
+
+    /*! stop using a shared accel, if this group is using one. If no
+        other group uses it, this group takes the accel back as its
+        own; otherwise it has no accel at all until it gets built
+        again */
+    void releaseSharedAccel();
+
     /*! bounding box for t=0 and t=1; for motion blur. */
     box3f bounds[2];
+
+    /*! the shared accel this group uses (in which case its own
+        bvhMemory is empty), or null */
+    SharedAccel::SP sharedAccel;
   };
 
   /*! a group containing geometries (ie, BLASes, whereas the
@@ -118,6 +236,22 @@ namespace owl {
     
     /*! pretty-printer, for printf-debugging */
     std::string toString() const;
+
+    /*! splits 'numPrims' primitives into the fewest possible chunks
+        of consecutive primitives that stay within 'maxPrimsPerChunk'
+        each (and are roughly equally sized); returns each chunk's
+        [begin,end) range. Chunks are index ranges, not spatial
+        clusters, \see owlEnableAccelSplitting */
+    static std::vector<std::pair<size_t,size_t>>
+    computeChunkRanges(size_t numPrims, size_t maxPrimsPerChunk);
+
+    /*! on a full rebuild, (re-)sets up this group's per-chunk data on
+        the given device for given number of chunks (with 0 meaning
+        'not split'); on a refit, checks that the number of chunks
+        hasn't changed */
+    void setNumChunksOn(const DeviceContext::SP &device,
+                        size_t numChunks,
+                        bool fullRebuild);
     
     /*! list of child geometries to use in this BVH */
     std::vector<Geom::SP> geometries;
@@ -142,5 +276,14 @@ namespace owl {
   /*! returns the (device-specific) optix traversable handle to traverse this group */
   inline OptixTraversableHandle Group::getTraversable(const DeviceContext::SP &device) const
   { return getDD(device).traversable; }
+
+  inline std::vector<OptixTraversableHandle>
+  Group::getInstanceTargets(const DeviceContext::SP &device) const
+  {
+    const DeviceData &dd = getDD(device);
+    if (dd.chunkTraversables.empty())
+      return { dd.traversable };
+    return dd.chunkTraversables;
+  }
   
 } // ::owl
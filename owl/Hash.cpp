@@ -0,0 +1,122 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "Hash.h"
+
+namespace owl {
+
+  // ------------------------------------------------------------------
+  // xxHash64, see https://github.com/Cyan4973/xxHash
+  // ------------------------------------------------------------------
+  
+  static const uint64_t PRIME64_1 = 11400714785074694791ULL;
+  static const uint64_t PRIME64_2 = 14029467366897019727ULL;
+  static const uint64_t PRIME64_3 =  1609587929392839161ULL;
+  static const uint64_t PRIME64_4 =  9650029242287828579ULL;
+  static const uint64_t PRIME64_5 =  2870177450012600261ULL;
+
+  inline uint64_t rotl64(uint64_t x, int r)
+  { return (x << r) | (x >> (64-r)); }
+
+  /*! unaligned (little-endian) reads */
+  inline uint64_t read64(const uint8_t *p)
+  { uint64_t v; memcpy(&v,p,sizeof(v)); return v; }
+  inline uint32_t read32(const uint8_t *p)
+  { uint32_t v; memcpy(&v,p,sizeof(v)); return v; }
+
+  inline uint64_t xxhRound(uint64_t acc, uint64_t input)
+  {
+    acc += input * PRIME64_2;
+    acc  = rotl64(acc,31);
+    acc *= PRIME64_1;
+    return acc;
+  }
+
+  inline uint64_t xxhMergeRound(uint64_t acc, uint64_t val)
+  {
+    acc ^= xxhRound(0,val);
+    acc  = acc * PRIME64_1 + PRIME64_4;
+    return acc;
+  }
+  
+  uint64_t hash64(const void *data, size_t numBytes, uint64_t seed)
+  {
+    const uint8_t *p   = (const uint8_t *)data;
+    const uint8_t *end = p + numBytes;
+    uint64_t h64;
+
+    if (numBytes >= 32) {
+      const uint8_t *limit = end - 32;
+      uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+      uint64_t v2 = seed + PRIME64_2;
+      uint64_t v3 = seed + 0;
+      uint64_t v4 = seed - PRIME64_1;
+      do {
+        v1 = xxhRound(v1,read64(p)); p += 8;
+        v2 = xxhRound(v2,read64(p)); p += 8;
+        v3 = xxhRound(v3,read64(p)); p += 8;
+        v4 = xxhRound(v4,read64(p)); p += 8;
+      } while (p <= limit);
+      
+      h64 = rotl64(v1,1) + rotl64(v2,7) + rotl64(v3,12) + rotl64(v4,18);
+      h64 = xxhMergeRound(h64,v1);
+      h64 = xxhMergeRound(h64,v2);
+      h64 = xxhMergeRound(h64,v3);
+      h64 = xxhMergeRound(h64,v4);
+    } else {
+      h64 = seed + PRIME64_5;
+    }
+
+    h64 += (uint64_t)numBytes;
+
+    while (p + 8 <= end) {
+      h64 ^= xxhRound(0,read64(p));
+      h64  = rotl64(h64,27) * PRIME64_1 + PRIME64_4;
+      p += 8;
+    }
+    if (p + 4 <= end) {
+      h64 ^= (uint64_t)read32(p) * PRIME64_1;
+      h64  = rotl64(h64,23) * PRIME64_2 + PRIME64_3;
+      p += 4;
+    }
+    while (p < end) {
+      h64 ^= (*p) * PRIME64_5;
+      h64  = rotl64(h64,11) * PRIME64_1;
+      p++;
+    }
+
+    // final avalanche
+    h64 ^= h64 >> 33;
+    h64 *= PRIME64_2;
+    h64 ^= h64 >> 29;
+    h64 *= PRIME64_3;
+    h64 ^= h64 >> 32;
+    return h64;
+  }
+
+  std::string toHexString(uint64_t key)
+  {
+    char buf[17];
+    for (int i=15;i>=0;--i) {
+      buf[i] = "0123456789abcdef"[key & 0xf];
+      key >>= 4;
+    }
+    buf[16] = 0;
+    return buf;
+  }
+  
+} // ::owl
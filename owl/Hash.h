@@ -0,0 +1,56 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "owl/common.h"
+
+namespace owl {
+
+  /*! computes a 64-bit hash of the given block of memory; this uses
+      the xxHash64 algorithm, so is fast enough to hash large geometry
+      buffers, but is NOT a cryptographic hash */
+  uint64_t hash64(const void *data, size_t numBytes, uint64_t seed = 0);
+
+  /*! helper class to compute a single 64-bit key over many different
+      inputs (blocks of memory, strings, plain values, ...), eg, for
+      content-addressed caches. Note the result depends on both the
+      content *and* the way it was split into different add()'s */
+  struct ContentHasher {
+    /*! add a block of memory to the hash */
+    ContentHasher &add(const void *data, size_t numBytes)
+    { state = hash64(data,numBytes,state); return *this; }
+
+    /*! add a string (its characters, not its address) to the hash */
+    ContentHasher &add(const std::string &s)
+    { return add(s.data(),s.size()); }
+
+    /*! add a plain, trivially copyable value to the hash */
+    template<typename T>
+    ContentHasher &add(const T &value)
+    { return add(&value,sizeof(value)); }
+
+    /*! return the hash of everything added so far */
+    uint64_t get() const { return state; }
+    
+    uint64_t state = 0x4f574c2d68617368ull;
+  };
+
+  /*! returns a 64-bit key as fixed-width, 16-char hex string */
+  std::string toHexString(uint64_t key);
+  
+} // ::owl
@@ -17,21 +17,25 @@
 #include "InstanceGroup.h"
 #include "Context.h"
 
-#define LOG(message)                                    \
-  if (Context::logging())                               \
-    std::cout << "#owl(" << device->ID << "): "         \
-              << message                                \
-              << std::endl
-
-#define LOG_OK(message)                                         \
-  if (Context::logging())                                       \
-    std::cout << OWL_TERMINAL_GREEN                             \
-              << "#owl(" << device->ID << "): "                 \
-              << message << OWL_TERMINAL_DEFAULT << std::endl
-
+#define LOG(message)                                                    \
+  OWL_LOG_DEBUG(OWL_LOG_CATEGORY_ACCEL,                                 \
+                "(device " << device->ID << ") " << message)
+#define LOG_OK(message)                                                 \
+  OWL_LOG_DEBUG(OWL_LOG_CATEGORY_ACCEL,                                 \
+                "(device " << device->ID << ") " << message)
 
 namespace owl {
 
+  static_assert((int)OWL_INSTANCE_FLAG_DISABLE_TRIANGLE_FACE_CULLING
+                == (int)OPTIX_INSTANCE_FLAG_DISABLE_TRIANGLE_FACE_CULLING &&
+                (int)OWL_INSTANCE_FLAG_FLIP_TRIANGLE_FACING
+                == (int)OPTIX_INSTANCE_FLAG_FLIP_TRIANGLE_FACING &&
+                (int)OWL_INSTANCE_FLAG_DISABLE_ANYHIT
+                == (int)OPTIX_INSTANCE_FLAG_DISABLE_ANYHIT &&
+                (int)OWL_INSTANCE_FLAG_ENFORCE_ANYHIT
+                == (int)OPTIX_INSTANCE_FLAG_ENFORCE_ANYHIT,
+                "OWLInstanceFlags have to match optix' instance flags");
+
   /*! constructor */
   InstanceGroup::DeviceData::DeviceData(const DeviceContext::SP &device)
     : Group::DeviceData(device)
@@ -53,7 +57,7 @@ namespace owl {
       }
     }
 
-    transforms[0].resize(children.size());
+    transforms[0].resize(children.size(),identityInstanceTransform());
     // do NOT automatically resize transforms[0] - need these only if
     // we use motion blur for this object
   }
@@ -71,35 +75,61 @@ namespace owl {
     return std::make_shared<DeviceData>(device);
   }
   
-  /*! set transformation matrix of given child */
+  /*! set transformation matrix of given child, in given format */
   void InstanceGroup::setTransform(size_t childID,
-                                   const affine3f &xfm)
+                                   const float *floats,
+                                   OWLMatrixFormat matrixFormat)
   {
     assert(childID < children.size());
-    transforms[0][childID] = xfm;
+    convertTransforms(&transforms[0][childID],floats,1,matrixFormat);
   }
 
   void InstanceGroup::setTransforms(uint32_t timeStep,
                                     const float *floatsForThisStimeStep,
                                     OWLMatrixFormat matrixFormat)
   {
-    switch(matrixFormat) {
-    case OWL_MATRIX_FORMAT_OWL: {
-      transforms[timeStep].resize(children.size());
-      memcpy((char*)transforms[timeStep].data(),floatsForThisStimeStep,
-             children.size()*sizeof(affine3f));
-    } break;
-    default:
-      throw std::runtime_error("used matrix format not yet implmeneted for"
-                               " InstanceGroup::setTransforms");
-    };
+    if (timeStep > 1)
+      throw std::runtime_error("InstanceGroup::setTransforms: currently"
+                               " supporting only time steps 0 and 1");
+    transforms[timeStep].resize(children.size());
+    convertTransforms(transforms[timeStep].data(),floatsForThisStimeStep,
+                      children.size(),matrixFormat);
   }
 
   /* set instance IDs to use for the children - MUST be an array of children.size() items */
   void InstanceGroup::setInstanceIDs(const uint32_t *_instanceIDs)
   {
+    if (!_instanceIDs) {
+      instanceIDs.clear();
+      return;
+    }
+    instanceIDs.resize(children.size());
     std::copy(_instanceIDs,_instanceIDs+instanceIDs.size(),instanceIDs.data());
   }
+
+  /* set visibility masks to use for the children - MUST be an array of children.size() items */
+  void InstanceGroup::setVisibilityMasks(const uint8_t *_visibilityMasks)
+  {
+    if (!_visibilityMasks) {
+      visibilityMasks.clear();
+      return;
+    }
+    visibilityMasks.resize(children.size());
+    std::copy(_visibilityMasks,_visibilityMasks+visibilityMasks.size(),
+              visibilityMasks.data());
+  }
+
+  /* set instance flags to use for the children - MUST be an array of children.size() items */
+  void InstanceGroup::setInstanceFlags(const uint32_t *_instanceFlags)
+  {
+    if (!_instanceFlags) {
+      instanceFlags.clear();
+      return;
+    }
+    instanceFlags.resize(children.size());
+    std::copy(_instanceFlags,_instanceFlags+instanceFlags.size(),
+              instanceFlags.data());
+  }
   
   void InstanceGroup::setChild(size_t childID, Group::SP child)
   {
@@ -109,25 +139,42 @@ namespace owl {
 
   void InstanceGroup::buildAccel()
   {
-    for (auto device : context->getDevices())
-      if (transforms[1].empty())
-        staticBuildOn<true>(device);
-      else
-        motionBlurBuildOn<true>(device);
+    context->parallelForEachDevice([&](const DeviceContext::SP &device) {
+        if (transforms[1].empty())
+          staticBuildOn<true>(device);
+        else
+          motionBlurBuildOn<true>(device);
+      });
   }
   
   void InstanceGroup::refitAccel()
   {
-    for (auto device : context->getDevices())
-      if (transforms[1].empty())
-        staticBuildOn<false>(device);
-      else
-        motionBlurBuildOn<false>(device);
+    context->parallelForEachDevice([&](const DeviceContext::SP &device) {
+        if (transforms[1].empty())
+          staticBuildOn<false>(device);
+        else
+          motionBlurBuildOn<false>(device);
+      });
   }
 
+  std::vector<std::pair<size_t,OptixTraversableHandle>>
+  InstanceGroup::flattenChildren(const DeviceContext::SP &device) const
+  {
+    std::vector<std::pair<size_t,OptixTraversableHandle>> flattened;
+    flattened.reserve(children.size());
+    for (size_t childID=0;childID<children.size();childID++) {
+      const Group::SP &child = children[childID];
+      assert(child);
+      for (auto traversable : child->getInstanceTargets(device))
+        flattened.push_back({childID,traversable});
+    }
+    return flattened;
+  }
+  
   template<bool FULL_REBUILD>
   void InstanceGroup::staticBuildOn(const DeviceContext::SP &device) 
   {
+    TraceScope trace(FULL_REBUILD ? "buildAccel" : "refitAccel","accel",device->ID);
     DeviceData &dd = getDD(device);
     auto optixContext = device->optixContext;
 
@@ -145,7 +192,9 @@ namespace owl {
        &maxInstsPerIAS,
        sizeof(maxInstsPerIAS));
       
-    if (children.size() > maxInstsPerIAS)
+    const std::vector<std::pair<size_t,OptixTraversableHandle>> flattened
+      = flattenChildren(device);
+    if (flattened.size() > maxInstsPerIAS)
       throw std::runtime_error("number of children in instance group exceeds "
                                "OptiX's MAX_INSTANCES_PER_IAS limit");
     
@@ -162,41 +211,28 @@ namespace owl {
     OptixAccelBuildOptions       accelOptions   {};
     
     //! the N build inputs that go into the builder
-    std::vector<OptixInstance>   optixInstances(children.size());
+    std::vector<OptixInstance>   optixInstances(flattened.size());
 
     // now go over all children to set up the buildinputs
-    for (size_t childID=0;childID<children.size();childID++) {
+    for (size_t instID=0;instID<flattened.size();instID++) {
+      const size_t childID = flattened[instID].first;
       Group::SP child = children[childID];
       assert(child);
 
       assert(transforms[1].empty());
-      const affine3f xfm = transforms[0][childID];
 
       OptixInstance oi = {};
-      oi.transform[0*4+0]  = xfm.l.vx.x;
-      oi.transform[0*4+1]  = xfm.l.vy.x;
-      oi.transform[0*4+2]  = xfm.l.vz.x;
-      oi.transform[0*4+3]  = xfm.p.x;
-        
-      oi.transform[1*4+0]  = xfm.l.vx.y;
-      oi.transform[1*4+1]  = xfm.l.vy.y;
-      oi.transform[1*4+2]  = xfm.l.vz.y;
-      oi.transform[1*4+3]  = xfm.p.y;
+      // transforms are already stored in optix' row-major layout
+      memcpy(oi.transform,transforms[0][childID].m,sizeof(oi.transform));
         
-      oi.transform[2*4+0]  = xfm.l.vx.z;
-      oi.transform[2*4+1]  = xfm.l.vy.z;
-      oi.transform[2*4+2]  = xfm.l.vz.z;
-      oi.transform[2*4+3]  = xfm.p.z;
-        
-      oi.flags             = OPTIX_INSTANCE_FLAG_NONE;
+      oi.flags             = (instanceFlags.empty())?OPTIX_INSTANCE_FLAG_NONE:instanceFlags[childID];
       oi.instanceId        = (instanceIDs.empty())?uint32_t(childID):instanceIDs[childID];
-      oi.visibilityMask    = 255;
       oi.sbtOffset         = context->numRayTypes * child->getSBTOffset();
-      oi.visibilityMask    = 255;
-      oi.traversableHandle = child->getTraversable(device);
+      oi.visibilityMask    = (visibilityMasks.empty())?255:visibilityMasks[childID];
+      oi.traversableHandle = flattened[instID].second;
       assert(oi.traversableHandle);
       
-      optixInstances[childID] = oi;
+      optixInstances[instID] = oi;
     }
 
     dd.optixInstanceBuffer.alloc(optixInstances.size()*
@@ -260,22 +296,26 @@ namespace owl {
       dd.memFinal = dd.bvhMemory.size();
     }
       
-    OPTIX_CHECK(optixAccelBuild(optixContext,
-                                /* todo: stream */0,
-                                &accelOptions,
-                                // array of build inputs:
-                                &instanceInput,1,
-                                // buffer of temp memory:
-                                (CUdeviceptr)tempBuffer.get(),
-                                tempBuffer.size(),
-                                // where we store initial, uncomp bvh:
-                                (CUdeviceptr)dd.bvhMemory.get(),
-                                dd.bvhMemory.size(),
-                                /* the traversable we're building: */ 
-                                &dd.traversable,
-                                /* no compaction for instances: */
-                                nullptr,0u
-                                ));
+    {
+      GpuTimings::Scope timeBuild(device->timings,OWL_TIMING_ACCEL_BUILD,
+                                  /* todo: stream */0);
+      OPTIX_CHECK(optixAccelBuild(optixContext,
+                                  /* todo: stream */0,
+                                  &accelOptions,
+                                  // array of build inputs:
+                                  &instanceInput,1,
+                                  // buffer of temp memory:
+                                  (CUdeviceptr)tempBuffer.get(),
+                                  tempBuffer.size(),
+                                  // where we store initial, uncomp bvh:
+                                  (CUdeviceptr)dd.bvhMemory.get(),
+                                  dd.bvhMemory.size(),
+                                  /* the traversable we're building: */ 
+                                  &dd.traversable,
+                                  /* no compaction for instances: */
+                                  nullptr,0u
+                                  ));
+    }
       
     CUDA_SYNC_CHECK();
     
@@ -295,6 +335,7 @@ namespace owl {
   template<bool FULL_REBUILD>
   void InstanceGroup::motionBlurBuildOn(const DeviceContext::SP &device)
   {
+    TraceScope trace(FULL_REBUILD ? "buildAccel" : "refitAccel","accel",device->ID);
     DeviceData &dd = getDD(device);
     auto optixContext = device->optixContext;
     
@@ -312,7 +353,9 @@ namespace owl {
        &maxInstsPerIAS,
        sizeof(maxInstsPerIAS));
     
-    if (children.size() > maxInstsPerIAS)
+    const std::vector<std::pair<size_t,OptixTraversableHandle>> flattened
+      = flattenChildren(device);
+    if (flattened.size() > maxInstsPerIAS)
       throw std::runtime_error("number of children in instnace group exceeds "
                                "OptiX's MAX_INSTANCES_PER_IAS limit");
     
@@ -320,50 +363,39 @@ namespace owl {
     // build motion transforms
     // ==================================================================
     assert(!transforms[1].empty());
-    std::vector<OptixMatrixMotionTransform> motionTransforms(children.size());
+    std::vector<OptixMatrixMotionTransform> motionTransforms(flattened.size());
 #if OPTIX_VERSION >= 70200
     /* since 7.2, optix no longer requires those aabbs (and in fact,
        no longer supports specifying them */
 #else
-    std::vector<box3f> motionAABBs(children.size());
+    std::vector<box3f> motionAABBs(flattened.size());
 #endif
-    for (size_t childID=0;childID<children.size();childID++) {
+    for (size_t instID=0;instID<flattened.size();instID++) {
+      const size_t childID = flattened[instID].first;
       Group::SP child = children[childID];
       assert(child);
       OptixMatrixMotionTransform mt = {};
-      mt.child                      = child->getTraversable(device);
+      mt.child                      = flattened[instID].second;
       mt.motionOptions.numKeys      = 2;
       mt.motionOptions.timeBegin    = 0.f;
       mt.motionOptions.timeEnd      = 1.f;
       mt.motionOptions.flags        = OPTIX_MOTION_FLAG_NONE;
 
-      for (int timeStep = 0; timeStep < 2; timeStep ++ ) {
-        const affine3f xfm = transforms[timeStep][childID];
-        mt.transform[timeStep][0*4+0]  = xfm.l.vx.x;
-        mt.transform[timeStep][0*4+1]  = xfm.l.vy.x;
-        mt.transform[timeStep][0*4+2]  = xfm.l.vz.x;
-        mt.transform[timeStep][0*4+3]  = xfm.p.x;
-          
-        mt.transform[timeStep][1*4+0]  = xfm.l.vx.y;
-        mt.transform[timeStep][1*4+1]  = xfm.l.vy.y;
-        mt.transform[timeStep][1*4+2]  = xfm.l.vz.y;
-        mt.transform[timeStep][1*4+3]  = xfm.p.y;
-          
-        mt.transform[timeStep][2*4+0]  = xfm.l.vx.z;
-        mt.transform[timeStep][2*4+1]  = xfm.l.vy.z;
-        mt.transform[timeStep][2*4+2]  = xfm.l.vz.z;
-        mt.transform[timeStep][2*4+3]  = xfm.p.z;
-      }
+      for (int timeStep = 0; timeStep < 2; timeStep ++ )
+        memcpy(mt.transform[timeStep],transforms[timeStep][childID].m,
+               sizeof(mt.transform[timeStep]));
 
-      motionTransforms[childID] = mt;
+      motionTransforms[instID] = mt;
 
 #if OPTIX_VERSION >= 70200
     /* since 7.2, optix no longer requires those aabbs (and in fact,
        no longer supports specifying them */
 #else
-      motionAABBs[childID]
-        = xfmBounds(transforms[0][childID],child->bounds[0]);
-      motionAABBs[childID].extend(xfmBounds(transforms[1][childID],child->bounds[1]));
+      // (conservatively) uses the whole child's bounds for each chunk
+      motionAABBs[instID]
+        = xfmBounds(toAffine3f(transforms[0][childID]),child->bounds[0]);
+      motionAABBs[instID].extend(xfmBounds(toAffine3f(transforms[1][childID]),
+                                            child->bounds[1]));
 #endif
     }
     // and upload
@@ -385,10 +417,11 @@ namespace owl {
     OptixAccelBuildOptions       accelOptions   {};
       
     //! the N build inputs that go into the builder
-    std::vector<OptixInstance>   optixInstances(children.size());
+    std::vector<OptixInstance>   optixInstances(flattened.size());
 
     // now go over all children to set up the buildinputs
-    for (size_t childID=0;childID<children.size();childID++) {
+    for (size_t instID=0;instID<flattened.size();instID++) {
+      const size_t childID = flattened[instID].first;
       Group::SP child = children[childID];
       assert(child);
 
@@ -396,7 +429,7 @@ namespace owl {
       OPTIX_CHECK(optixConvertPointerToTraversableHandle
                   (optixContext,
                    (CUdeviceptr)(((const uint8_t*)dd.motionTransformsBuffer.get())
-                                 +childID*sizeof(motionTransforms[0])
+                                 +instID*sizeof(motionTransforms[0])
                                  ),
                    OPTIX_TRAVERSABLE_TYPE_MATRIX_MOTION_TRANSFORM,
                    &childMotionHandle));
@@ -417,12 +450,12 @@ namespace owl {
       oi.transform[2*4+2]  = 1.f;//xfm.l.vz.z;
       oi.transform[2*4+3]  = 0.f;//xfm.p.z;
         
-      oi.flags             = OPTIX_INSTANCE_FLAG_NONE;
+      oi.flags             = (instanceFlags.empty())?OPTIX_INSTANCE_FLAG_NONE:instanceFlags[childID];
       oi.instanceId        = (instanceIDs.empty())?uint32_t(childID):instanceIDs[childID];
       oi.sbtOffset         = context->numRayTypes * child->getSBTOffset();
-      oi.visibilityMask    = 1; //255;
+      oi.visibilityMask    = (visibilityMasks.empty())?255:visibilityMasks[childID];
       oi.traversableHandle = childMotionHandle; 
-      optixInstances[childID] = oi;
+      optixInstances[instID] = oi;
     }
 
     dd.optixInstanceBuffer.alloc(optixInstances.size()*
@@ -495,22 +528,26 @@ namespace owl {
     if (FULL_REBUILD)
       dd.bvhMemory.alloc(blasBufferSizes.outputSizeInBytes);
       
-    OPTIX_CHECK(optixAccelBuild(optixContext,
-                                /* todo: stream */0,
-                                &accelOptions,
-                                // array of build inputs:
-                                &instanceInput,1,
-                                // buffer of temp memory:
-                                (CUdeviceptr)tempBuffer.get(),
-                                tempBuffer.size(),
-                                // where we store initial, uncomp bvh:
-                                (CUdeviceptr)dd.bvhMemory.get(),
-                                dd.bvhMemory.size(),
-                                /* the traversable we're building: */ 
-                                &dd.traversable,
-                                /* no compaction for instances: */
-                                nullptr,0u
-                                ));
+    {
+      GpuTimings::Scope timeBuild(device->timings,OWL_TIMING_ACCEL_BUILD,
+                                  /* todo: stream */0);
+      OPTIX_CHECK(optixAccelBuild(optixContext,
+                                  /* todo: stream */0,
+                                  &accelOptions,
+                                  // array of build inputs:
+                                  &instanceInput,1,
+                                  // buffer of temp memory:
+                                  (CUdeviceptr)tempBuffer.get(),
+                                  tempBuffer.size(),
+                                  // where we store initial, uncomp bvh:
+                                  (CUdeviceptr)dd.bvhMemory.get(),
+                                  dd.bvhMemory.size(),
+                                  /* the traversable we're building: */ 
+                                  &dd.traversable,
+                                  /* no compaction for instances: */
+                                  nullptr,0u
+                                  ));
+    }
 
     CUDA_SYNC_CHECK();
     
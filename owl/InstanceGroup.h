@@ -17,6 +17,7 @@
 #pragma once
 
 #include "Group.h"
+#include "Transforms.h"
 
 namespace owl {
 
@@ -51,17 +52,31 @@ namespace owl {
     /*! set given child to given group */
     void setChild(size_t childID, Group::SP child);
                   
-    /*! set transformation matrix of given child */
-    void setTransform(size_t childID, const affine3f &xfm);
+    /*! set transformation matrix of given child, in given format */
+    void setTransform(size_t childID,
+                      const float *floats,
+                      OWLMatrixFormat matrixFormat);
 
-    /*! set transformation matrix of given child */
+    /*! set transformation matrices of all children for given time
+        step; 'floatsForThisStimeStep' is a densely packed array of
+        children.size() matrices in given format, which get converted
+        directly into optix' instance layout */
     void setTransforms(uint32_t timeStep,
                        const float *floatsForThisStimeStep,
                        OWLMatrixFormat matrixFormat);
 
     /* set instance IDs to use for the children - MUST be an array of
-       children.size() items */
+       children.size() items, or null for the defaults */
     void setInstanceIDs(const uint32_t *instanceIDs);
+
+    /* set visibility masks to use for the children - MUST be an array
+       of children.size() items, or null for the defaults */
+    void setVisibilityMasks(const uint8_t *visibilityMasks);
+
+    /* set instance flags (OWLInstanceFlags) to use for the children -
+       MUST be an array of children.size() items, or null for the
+       defaults */
+    void setInstanceFlags(const uint32_t *instanceFlags);
       
     void buildAccel() override;
     void refitAccel() override;
@@ -72,6 +87,13 @@ namespace owl {
     /*! get reference to given device-specific data for this object */
     inline DeviceData &getDD(const DeviceContext::SP &device) const;
 
+    /*! the list of optix instances to create on given device, as
+        pairs of child ID and the traversable to instantiate; usually
+        one per child, but children whose accel got split into chunks
+        get one instance per chunk */
+    std::vector<std::pair<size_t,OptixTraversableHandle>>
+    flattenChildren(const DeviceContext::SP &device) const;
+    
     template<bool FULL_REBUILD>
     void staticBuildOn(const DeviceContext::SP &device);
     template<bool FULL_REBUILD>
@@ -87,13 +109,22 @@ namespace owl {
     std::vector<Group::SP>  children;
     
     /*! set of transform matrices for t=0 and t=1, respectively. if we
-      don't use motion blur, the second one may be unused */
-    std::vector<affine3f>   transforms[2];
+      don't use motion blur, the second one may be unused. Stored in
+      optix' 3x4 row-major layout, so builds can copy them as is */
+    std::vector<InstanceTransform> transforms[2];
 
     /*! vector of instnace IDs to use for these instances - if not
       specified we/optix will fill in automatically using
       instanceID=childID */
     std::vector<uint32_t>   instanceIDs;
+
+    /*! vector of visibility masks to use for these instances - if not
+      specified every instance is visible to all rays */
+    std::vector<uint8_t>    visibilityMasks;
+
+    /*! vector of OWLInstanceFlags to use for these instances - if not
+      specified we use OWL_INSTANCE_FLAG_NONE for all */
+    std::vector<uint32_t>   instanceFlags;
   };
 
   // ------------------------------------------------------------------
@@ -16,6 +16,7 @@
 
 #include "LaunchParams.h"
 #include "Context.h"
+#include <cstring>
 
 namespace owl {
 
@@ -34,6 +35,27 @@ namespace owl {
   // LaunchParams::DeviceData
   // ------------------------------------------------------------------
   
+  /*! alloc's all memory for a slot of given size */
+  LaunchParams::Slot::Slot(size_t dataSize)
+    : uploadedMemory(dataSize)
+  {
+    deviceMemory.alloc(dataSize);
+    if (dataSize)
+      CUDA_CALL(MallocHost((void**)&pinnedMemory,dataSize));
+    CUDA_CALL(EventCreateWithFlags(&doneEvent,cudaEventDisableTiming));
+    CUDA_CALL(EventCreate(&timingStart));
+    CUDA_CALL(EventCreate(&timingEnd));
+  }
+
+  LaunchParams::Slot::~Slot()
+  {
+    if (pinnedMemory)
+      cudaFreeHost(pinnedMemory);
+    cudaEventDestroy(doneEvent);
+    cudaEventDestroy(timingStart);
+    cudaEventDestroy(timingEnd);
+  }
+  
   /*! constructor, which allocs all the device-side data */
   LaunchParams::DeviceData::DeviceData(const DeviceContext::SP &device,
                                        size_t  dataSize)
@@ -44,14 +66,28 @@ namespace owl {
     SetActiveGPU forLifeTime(device);
     
     CUDA_CHECK(cudaStreamCreate(&stream));
-    deviceMemory.alloc(dataSize);
     hostMemory.resize(dataSize);
+    resizeRing(LaunchParams::defaultRingSize);
   }
 
   LaunchParams::DeviceData::~DeviceData()
   {
+    SetActiveGPU forLifeTime(device);
+    slots.clear();
     cudaStreamDestroy(stream);
   }
+
+  /*! re-creates the ring with given number of slots; may only be
+      called when no launch is in flight */
+  void LaunchParams::DeviceData::resizeRing(int numSlots)
+  {
+    assert(numSlots > 0);
+    SetActiveGPU forLifeTime(device);
+    slots.clear();
+    for (int i=0;i<numSlots;i++)
+      slots.push_back(std::unique_ptr<Slot>(new Slot(dataSize)));
+    currentSlotID = 0;
+  }
   
   // ------------------------------------------------------------------
   // LaunchParams
@@ -91,6 +127,180 @@ namespace owl {
     return getDD(device).stream;
   }
 
+  void LaunchParams::updateHostMemory(const DeviceContext::SP &device)
+  {
+    DeviceData &dd = getDD(device);
+    size_t version = 0;
+    bool refersToObjects = false;
+    for (auto var : variables) {
+      version += var->version;
+      refersToObjects |= var->refersToObject();
+    }
+    if (version == dd.writtenVersion && !refersToObjects)
+      return;
+    writeVariables(dd.hostMemory.data(),device);
+    dd.writtenVersion = version;
+  }
+
+  void LaunchParams::uploadChanges(const DeviceContext::SP &device)
+  {
+    DeviceData &dd   = getDD(device);
+    Slot       &slot = dd.currentSlot();
+    const uint8_t *host     = dd.hostMemory.data();
+    uint8_t       *uploaded = slot.uploadedMemory.data();
+    size_t begin = 0, end = dd.dataSize;
+    if (slot.uploadedValid) {
+      while (begin < end && host[begin] == uploaded[begin]) ++begin;
+      while (end > begin && host[end-1] == uploaded[end-1]) --end;
+    }
+    if (begin == end)
+      return;
+    
+    // the first upload of a launch goes through the slot's pinned
+    // memory, which nothing in flight uses any more, so it doesn't
+    // stall. Any later ones in the same launch (tile offsets) can't
+    // re-use that before the first one is done, so copy from
+    // pageable memory, which cuda stages before returning
+    const uint8_t *source = host;
+    if (!dd.pinnedMemoryUsed) {
+      memcpy(slot.pinnedMemory+begin,host+begin,end-begin);
+      source = slot.pinnedMemory;
+      dd.pinnedMemoryUsed = true;
+    }
+    CUDA_CALL(MemcpyAsync((void*)(slot.deviceMemory.d_pointer+begin),
+                          source+begin,end-begin,
+                          cudaMemcpyHostToDevice,dd.stream));
+    memcpy(uploaded+begin,host+begin,end-begin);
+    slot.uploadedValid = true;
+  }
+
+  void LaunchParams::setRingSize(int numSlots)
+  {
+    if (numSlots < 1)
+      throw std::runtime_error("invalid launch params ring size "
+                               +std::to_string(numSlots));
+    sync();
+    for (auto device : context->getDevices())
+      getDD(device).resizeRing(numSlots);
+    ringSize = numSlots;
+  }
+
+  void LaunchParams::beginLaunch(const DeviceContext::SP &device)
+  {
+    DeviceData &dd = getDD(device);
+    Slot &slot = *dd.slots[(dd.currentSlotID+1) % (int)dd.slots.size()];
+    if (slot.inFlight) {
+      // only blocks if all slots are in use
+      CUDA_CALL(EventSynchronize(slot.doneEvent));
+      slot.inFlight = false;
+    }
+    // the slot's launch is done, so its timing is known by now; pass
+    // it on before this launch overwrites it
+    if (loadBalancer)
+      reportTimings(device);
+    slot.timedTiles  = 0;
+    dd.currentSlotID = (dd.currentSlotID+1) % (int)dd.slots.size();
+    dd.pinnedMemoryUsed = false;
+  }
+
+  void LaunchParams::endLaunch(const DeviceContext::SP &device)
+  {
+    DeviceData &dd = getDD(device);
+    Slot &slot = dd.currentSlot();
+    CUDA_CALL(EventRecord(slot.doneEvent,dd.stream));
+    slot.inFlight = true;
+  }
+  
+  void LaunchParams::setTileOffsetVariable(const std::string &offsetVarName)
+  {
+    const int varIdx = type->getVariableIdx(offsetVarName);
+    if (varIdx < 0)
+      throw std::runtime_error("launch tiling: launch params have no variable '"
+                               +offsetVarName+"'");
+    if (type->varDecls[varIdx].type != OWL_INT3)
+      throw std::runtime_error("launch tiling: offset variable '"
+                               +offsetVarName+"' has to be of type OWL_INT3");
+    this->tileOffsetVarIdx = varIdx;
+  }
+  
+  void LaunchParams::enableLaunchTiling(const std::string &offsetVarName,
+                                        size_t maxTileSize)
+  {
+    setTileOffsetVariable(offsetVarName);
+    this->maxTileSize
+      = maxTileSize ? std::min(maxTileSize,optixMaxLaunchSize) : optixMaxLaunchSize;
+  }
+
+  void LaunchParams::enableLoadBalancing(const std::string &offsetVarName,
+                                         int tileSize,
+                                         float smoothing)
+  {
+    if (tileSize <= 0)
+      throw std::runtime_error("load balancing: invalid tile size "
+                               +std::to_string(tileSize));
+    setTileOffsetVariable(offsetVarName);
+    if (maxTileSize == 0)
+      maxTileSize = optixMaxLaunchSize;
+    loadBalancer.reset(new LoadBalancer((int)context->getDevices().size(),
+                                        smoothing));
+    balanceTileSize = tileSize;
+  }
+
+  std::vector<LaunchTile> LaunchParams::assignDeviceRegions(const vec3i &dims)
+  {
+    assert(loadBalancer);
+    const auto &devices = context->getDevices();
+    
+    // feed whatever timings are available by now; launches that are
+    // still running contribute once they're done
+    for (auto device : devices)
+      reportTimings(device);
+
+    // split along the outermost dimension that has any extent
+    const int axis
+      = dims.z > 1 ? 2
+      : dims.y > 1 ? 1
+      : 0;
+    const int numTiles = divRoundUp(dims[axis],balanceTileSize);
+    const std::vector<vec2i> ranges = loadBalancer->assignTiles(numTiles);
+
+    std::vector<LaunchTile> regions(devices.size());
+    for (auto device : devices) {
+      const vec2i range = ranges[device->ID];
+      LaunchTile &region = regions[device->ID];
+      region.offset = vec3i(0);
+      region.dims   = dims;
+      region.offset[axis] = range.x*balanceTileSize;
+      region.dims[axis]
+        = std::min(range.y*balanceTileSize,dims[axis]) - region.offset[axis];
+      if (region.dims[axis] <= 0)
+        region.dims = vec3i(0);
+      
+      DeviceData &dd = getDD(device);
+      dd.assignedTiles = range.y-range.x;
+      dd.workShare     = float(range.y-range.x)/numTiles;
+    }
+    return regions;
+  }
+
+  void LaunchParams::reportTimings(const DeviceContext::SP &device)
+  {
+    assert(loadBalancer);
+    DeviceData &dd = getDD(device);
+    SetActiveGPU forLifeTime(device);
+    loadBalancer->reportCompleted
+      (device->ID,(int)dd.slots.size(),dd.currentSlotID,
+       [&](int slotID) -> int & { return dd.slots[slotID]->timedTiles; },
+       [&](int slotID, float &ms) {
+        const Slot &slot = *dd.slots[slotID];
+        if (cudaEventQuery(slot.timingEnd) != cudaSuccess)
+          return false;
+        if (cudaEventElapsedTime(&ms,slot.timingStart,slot.timingEnd) != cudaSuccess)
+          ms = 0.f;
+        return true;
+      });
+  }
+  
   /*! wait for the latest launch done with these launch params to
       complete, by syncing on the stream associated with these
       params */
@@ -18,9 +18,24 @@
 
 #include "SBTObject.h"
 #include "Module.h"
+#include "LoadBalancer.h"
+#include "CommandRecorder.h"
 
 namespace owl {
 
+  /*! max number of threads (width*height*depth) optix allows in a
+      single launch */
+  const size_t optixMaxLaunchSize = size_t(1)<<30;
+
+  /*! a box-shaped part of a launch - either one sub-launch of a tiled
+      launch, or what one device works on in a load-balanced one */
+  struct LaunchTile {
+    /*! where in the full launch this tile starts */
+    vec3i offset;
+    /*! size of this tile */
+    vec3i dims;
+  };
+
   /*! describes a given *type* of launch params - basically the set of
       variables in the device-side '__global__ <Struct>
       optixLaumchParams' variable. This class describes the types and
@@ -44,6 +59,40 @@ namespace owl {
   struct LaunchParams : public SBTObject<LaunchParamsType> {
     typedef std::shared_ptr<LaunchParams> SP;
 
+    /*! one slot of the ring of launch param copies that each device
+        cycles through, so a new launch never has to wait for (or
+        overwrite) the params of one still in flight */
+    struct Slot {
+      /*! alloc's all memory for a slot of given size */
+      Slot(size_t dataSize);
+      ~Slot();
+      
+      /*! the cuda device memory we copy the launch params to */
+      DeviceMemory         deviceMemory;
+
+      /*! pinned host memory that uploads into this slot get staged
+          in, so they can be truly async */
+      uint8_t             *pinnedMemory  = nullptr;
+      
+      /*! what got last uploaded to deviceMemory, so launches only
+          need to upload what changed since */
+      std::vector<uint8_t> uploadedMemory;
+      bool                 uploadedValid = false;
+
+      /*! recorded after the last launch using this slot; the slot can
+          get re-used once that completed */
+      cudaEvent_t          doneEvent     = nullptr;
+      bool                 inFlight      = false;
+
+      /*! with load balancing: events around this device's part of
+          the last launch using this slot, and how many work tiles
+          that part had (0 once its timing got reported to the
+          balancer) */
+      cudaEvent_t          timingStart   = nullptr;
+      cudaEvent_t          timingEnd     = nullptr;
+      int                  timedTiles    = 0;
+    };
+    
     /*! device-specific data for these lauch params - each instance
         needs its own host- and device-side memory to store the
         parameter values (to avoid messing with other launches if and
@@ -53,6 +102,13 @@ namespace owl {
       /*! constructor, which allocs all the device-side data */
       DeviceData(const DeviceContext::SP &device, size_t  dataSize);
       ~DeviceData();
+
+      /*! re-creates the ring with given number of slots; may only be
+          called when no launch is in flight */
+      void resizeRing(int numSlots);
+
+      /*! the slot that the current (or last) launch uses */
+      inline Slot &currentSlot() { return *slots[currentSlotID]; }
       
       const size_t            dataSize;
       
@@ -63,13 +119,31 @@ namespace owl {
           without having to first wait for the cudaMemcpy to
           complete */
       std::vector<uint8_t> hostMemory;
+
+      /*! the ring of launch param slots */
+      std::vector<std::unique_ptr<Slot>> slots;
+      int                  currentSlotID = 0;
+
+      /*! whether the current launch already staged an upload through
+          its slot's pinned memory; any further ones (tile offsets)
+          then have to get staged by cuda */
+      bool                 pinnedMemoryUsed = false;
       
-      /*! the cuda device memory we copy the launch params to */
-      DeviceMemory         deviceMemory;
+      /*! sum of all variables' versions when hostMemory got last
+          written; size_t(-1) if never */
+      size_t               writtenVersion = size_t(-1);
       
       /*! a cuda stream we can use for the async upload and the
           following async launch */
       cudaStream_t         stream = nullptr;
+
+      /*! with load balancing: number of work tiles the next launch
+          got assigned on this device */
+      int                  assignedTiles = 0;
+
+      /*! with load balancing: fraction of the last launch's work
+          tiles that this device got */
+      float                workShare   = 0.f;
     };
 
     /*! create a new instenace of given launch param type */
@@ -89,6 +163,96 @@ namespace owl {
         launches */
     CUstream getCudaStream(const DeviceContext::SP &device);
 
+    /*! sets the number of launch param slots per device, ie, how
+        many launches with these params can be in flight before
+        another one has to wait for the oldest to complete. Syncs
+        first */
+    void setRingSize(int numSlots);
+
+    /*! called at the start of a launch on given device: moves on to
+        the next slot in the ring, waiting for the launch that used it
+        last (if any) to complete */
+    void beginLaunch(const DeviceContext::SP &device);
+
+    /*! called after all of a launch's work got issued on given device,
+        to mark when its slot becomes free again */
+    void endLaunch(const DeviceContext::SP &device);
+    
+    /*! re-writes the given device's host-side copy of the launch
+        params, unless no variable got set since it was last written
+        (and none of them refers to an object whose device data can
+        change under it, like a buffer) */
+    void updateHostMemory(const DeviceContext::SP &device);
+
+    /*! uploads whatever part of the given device's host-side copy
+        differs from what got uploaded last, if anything, on this
+        device's stream */
+    void uploadChanges(const DeviceContext::SP &device);
+    
+    /*! turns on automatic tiling of launches done with these params:
+        any launch larger than 'maxTileSize' threads (0 meaning the
+        optix limit) gets split into several sub-launches, and before
+        each of those the offset of that sub-launch within the full
+        launch gets written into the given OWL_INT3 variable, so
+        device code can compute its index in the full launch */
+    void enableLaunchTiling(const std::string &offsetVarName,
+                            size_t maxTileSize);
+
+    /*! looks up the variable that tile offsets get written to */
+    void setTileOffsetVariable(const std::string &offsetVarName);
+
+    /*! turns on multi-device load balancing: instead of every device
+        doing the whole launch, the launch gets cut into work tiles of
+        'tileSize' slices along its outermost dimension, and each
+        device only launches over its own contiguous range of
+        those. The ranges get rebalanced on each launch, from the
+        measured times of previous ones. Each device's offset within
+        the full launch gets written to the given OWL_INT3 variable,
+        as with launch tiling (which this implies) */
+    void enableLoadBalancing(const std::string &offsetVarName,
+                             int tileSize,
+                             float smoothing);
+
+    /*! with load balancing, reports the timings of all devices' last
+        launches that completed by now to the balancer, and returns
+        the part of a launch of given dims that each device gets (a
+        tile with zero size for a device that gets nothing) */
+    std::vector<LaunchTile> assignDeviceRegions(const vec3i &dims);
+
+    /*! with load balancing, reports the timings of all of given
+        device's launches that completed by now to the balancer */
+    void reportTimings(const DeviceContext::SP &device);
+
+    /*! whether a launch of given dims with these params can currently
+        get captured into a cuda graph, \see launchIsCapturable */
+    bool launchIsCapturable(const vec3i &dims) const
+    {
+      return owl::launchIsCapturable(dims,optixMaxLaunchSize,
+                                     tileOffsetVarIdx >= 0,
+                                     loadBalancer != nullptr);
+    }
+    
+    /*! index of the variable that launch tiling writes each
+        sub-launch's offset to, or -1 if tiling is off */
+    int    tileOffsetVarIdx = -1;
+
+    /*! max number of threads in any sub-launch, if tiling is on */
+    size_t maxTileSize      = 0;
+
+    /*! the balancer, if load balancing is on */
+    std::unique_ptr<LoadBalancer> loadBalancer;
+    
+    /*! size of a work tile for load balancing */
+    int    balanceTileSize  = 0;
+
+    /*! number of slots in each device's ring */
+    int    ringSize         = defaultRingSize;
+
+    /*! number of launch param slots per device unless set otherwise;
+        enough for a frame being rendered, one being set up, and one
+        being waited on */
+    static const int defaultRingSize = 3;
+
     /*! creates the device-specific data for this group */
     RegisteredObject::DeviceData::SP createOn(const DeviceContext::SP &device) override;
 
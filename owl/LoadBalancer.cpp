@@ -0,0 +1,84 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "LoadBalancer.h"
+#include <algorithm>
+
+namespace owl {
+
+  LoadBalancer::LoadBalancer(int numDevices, float smoothing)
+    : smoothing(smoothing),
+      speed(numDevices,0.f)
+  {
+    assert(numDevices > 0);
+    if (!(smoothing > 0.f && smoothing <= 1.f))
+      throw std::runtime_error("load balancer smoothing has to be in (0,1]");
+  }
+  
+  std::vector<vec2i> LoadBalancer::assignTiles(int numTiles) const
+  {
+    const int numDevices = (int)speed.size();
+
+    // devices not measured yet get the average of those that were
+    float sumMeasured = 0.f;
+    int   numMeasured = 0;
+    for (auto s : speed)
+      if (s > 0.f) { sumMeasured += s; numMeasured++; }
+    const float defaultSpeed = numMeasured ? sumMeasured/numMeasured : 1.f;
+    std::vector<float> weight(numDevices);
+    float sumWeights = 0.f;
+    for (int i=0;i<numDevices;i++)
+      sumWeights += (weight[i] = speed[i] > 0.f ? speed[i] : defaultSpeed);
+
+    // largest remainder rounding of each device's share
+    std::vector<int>   count(numDevices);
+    std::vector<float> remainder(numDevices);
+    int numAssigned = 0;
+    for (int i=0;i<numDevices;i++) {
+      const float share = numTiles * weight[i] / sumWeights;
+      count[i]      = std::min(numTiles-numAssigned,(int)share);
+      remainder[i]  = share - count[i];
+      numAssigned  += count[i];
+    }
+    std::vector<int> order(numDevices);
+    for (int i=0;i<numDevices;i++) order[i] = i;
+    std::stable_sort(order.begin(),order.end(),
+                     [&](int a, int b){ return remainder[a] > remainder[b]; });
+    for (int i=0;numAssigned<numTiles;i=(i+1)%numDevices) {
+      count[order[i]]++;
+      numAssigned++;
+    }
+
+    std::vector<vec2i> ranges(numDevices);
+    int begin = 0;
+    for (int i=0;i<numDevices;i++) {
+      ranges[i] = vec2i(begin,begin+count[i]);
+      begin += count[i];
+    }
+    return ranges;
+  }
+
+  void LoadBalancer::reportTime(int deviceID, int numTiles, float milliseconds)
+  {
+    assert(deviceID >= 0 && deviceID < (int)speed.size());
+    if (numTiles <= 0 || !(milliseconds > 0.f))
+      return;
+    const float measured = numTiles / milliseconds;
+    float &s = speed[deviceID];
+    s = (s > 0.f) ? (smoothing*measured + (1.f-smoothing)*s) : measured;
+  }
+
+} // ::owl
@@ -0,0 +1,87 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "owl/common.h"
+#include <vector>
+
+namespace owl {
+
+  /*! splits the work tiles of a launch into one contiguous range of
+      tiles per device, in proportion to how fast each device has
+      been so far. Speeds are tracked as an exponentially weighted
+      moving average (EWMA) of tiles-per-millisecond over the timings
+      reported for each device's past launches, so the split adapts
+      within a few frames to both mixed-generation GPUs and changes
+      in per-tile cost.
+
+      Contains no cuda code, so it can be driven (and tested) with
+      simulated timings */
+  struct LoadBalancer {
+
+    /*! create balancer for given number of devices; 'smoothing' is
+        the EWMA weight of each new measurement, in (0,1] */
+    LoadBalancer(int numDevices, float smoothing = .25f);
+
+    /*! splits 'numTiles' into one [begin,end) range of tiles per
+        device, in device order. Devices without any measurement yet
+        are assumed to be as fast as the average measured one (or all
+        equally fast, if nothing got measured yet) */
+    std::vector<vec2i> assignTiles(int numTiles) const;
+
+    /*! report that 'deviceID' took 'milliseconds' for a launch
+        over 'numTiles' tiles */
+    void reportTime(int deviceID, int numTiles, float milliseconds);
+
+    /*! reports the timings of all of a device's past launches that
+        completed by now, oldest first. With async launches, several
+        of them can be in flight at once, each in its own slot of a
+        ring of 'numSlots' slots, of which 'newestSlot' got used
+        last. 'pendingTiles(slot)' returns a reference to the number
+        of tiles of that slot's launch whose time hasn't been
+        reported yet (0 if none), which gets reset once reported;
+        'getTime(slot,ms)' returns false if that launch hasn't
+        completed yet, and its time in 'ms' otherwise. Launches that
+        are still running get reported by a later call */
+    template<typename PendingTiles, typename GetTime>
+    void reportCompleted(int deviceID, int numSlots, int newestSlot,
+                         const PendingTiles &pendingTiles,
+                         const GetTime &getTime)
+    {
+      for (int i=1;i<=numSlots;i++) {
+        const int slot = (newestSlot+i) % numSlots;
+        int &numTiles = pendingTiles(slot);
+        float ms = 0.f;
+        if (numTiles == 0 || !getTime(slot,ms))
+          continue;
+        reportTime(deviceID,numTiles,ms);
+        numTiles = 0;
+      }
+    }
+
+    /*! current speed estimate for given device, in tiles per ms; 0
+        if not measured yet */
+    float getSpeed(int deviceID) const { return speed[deviceID]; }
+
+    /*! EWMA weight of each new measurement */
+    const float smoothing;
+
+  private:
+    std::vector<float> speed;
+  };
+
+} // ::owl
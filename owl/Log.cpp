@@ -0,0 +1,236 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "Log.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace owl {
+
+  /*! how long the writer thread sleeps when nobody wakes it up */
+  const std::chrono::milliseconds logWriterInterval(20);
+  
+  // ------------------------------------------------------------------
+  // LogQueue
+  // ------------------------------------------------------------------
+
+  static size_t roundUpToPowerOfTwo(size_t n)
+  {
+    size_t result = 1;
+    while (result < n) result *= 2;
+    return result;
+  }
+  
+  LogQueue::LogQueue(size_t capacity)
+    : capacity(roundUpToPowerOfTwo(std::max(capacity,size_t(2)))),
+      slots(new Slot[this->capacity])
+  {
+    for (size_t i=0;i<this->capacity;i++)
+      slots[i].sequence.store(i,std::memory_order_relaxed);
+  }
+
+  bool LogQueue::push(LogMessage &message)
+  {
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (1) {
+      slot = &slots[pos & (capacity-1)];
+      const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      const intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+      if (diff == 0) {
+        // slot is free; try to claim it
+        if (enqueuePos.compare_exchange_weak(pos,pos+1,std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        // slot still holds a message from one round ago
+        return false;
+      } else
+        pos = enqueuePos.load(std::memory_order_relaxed);
+    }
+    slot->message = std::move(message);
+    slot->sequence.store(pos+1,std::memory_order_release);
+    return true;
+  }
+  
+  bool LogQueue::pop(LogMessage &message)
+  {
+    Slot &slot = slots[dequeuePos & (capacity-1)];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeuePos+1)
+      // empty, or the next message is still being written
+      return false;
+    message = std::move(slot.message);
+    slot.sequence.store(dequeuePos+capacity,std::memory_order_release);
+    dequeuePos++;
+    return true;
+  }
+  
+  // ------------------------------------------------------------------
+  // Logger
+  // ------------------------------------------------------------------
+
+  Logger::Logger(size_t queueCapacity, bool async)
+    : queue(queueCapacity),
+#ifdef NDEBUG
+      level(OWL_LOG_LEVEL_WARNING)
+#else
+      level(OWL_LOG_LEVEL_INFO)
+#endif
+  {
+    if (async)
+      writer = std::thread([this](){ writerLoop(); });
+  }
+
+  Logger::~Logger()
+  {
+    if (writer.joinable()) {
+      quit = true;
+      wake.notify_one();
+      writer.join();
+    }
+    flush();
+  }
+  
+  /*! parses the OWL_LOG_LEVEL environment variable; -1 if not set
+      (or not understood) */
+  static int logLevelFromEnvironment()
+  {
+    const char *value = getenv("OWL_LOG_LEVEL");
+    if (!value)
+      return -1;
+    const char *names[] = { "none", "error", "warning", "info", "debug" };
+    for (int i=0;i<5;i++)
+      if (strcmp(value,names[i]) == 0)
+        return i;
+    return -1;
+  }
+  
+  Logger &Logger::get()
+  {
+    static Logger logger;
+    static bool checkedEnvironment = [](){
+      const int level = logLevelFromEnvironment();
+      if (level >= 0)
+        logger.setLevel((OWLLogLevel)level);
+      return true;
+    }();
+    (void)checkedEnvironment;
+    return logger;
+  }
+
+  void Logger::setLevel(OWLLogLevel level)
+  {
+    this->level = (int)level;
+  }
+  
+  void Logger::setCategories(uint32_t categories)
+  {
+    this->categories = categories;
+  }
+  
+  void Logger::setCallback(OWLLogCallback callback, void *userData)
+  {
+    // whatever got logged so far goes to where it was meant to go
+    flush();
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    this->callback = callback;
+    this->userData = userData;
+  }
+
+  std::ostringstream &Logger::threadStream()
+  {
+    static thread_local std::ostringstream stream;
+    stream.str("");
+    stream.clear();
+    return stream;
+  }
+  
+  void Logger::log(OWLLogLevel level, uint32_t category, std::string &&text)
+  {
+    LogMessage message { level, category, std::move(text) };
+    const bool queued = queue.push(message);
+    if (level == OWL_LOG_LEVEL_ERROR) {
+      // errors usually come right before things go down - make sure
+      // they get seen, even if the queue is full
+      writeOut(queued ? nullptr : &message);
+      return;
+    }
+    if (!queued) {
+      numDropped++;
+      // don't wait for the writer's next round
+      wake.notify_one();
+    }
+  }
+
+  /*! the default sink: everything in one write, and one flush */
+  static void writeToConsole(const std::vector<LogMessage> &messages)
+  {
+    std::ostringstream out;
+    for (auto &message : messages) {
+      switch (message.level) {
+      case OWL_LOG_LEVEL_ERROR:   out << OWL_TERMINAL_RED;        break;
+      case OWL_LOG_LEVEL_WARNING: out << OWL_TERMINAL_YELLOW;     break;
+      case OWL_LOG_LEVEL_INFO:    out << OWL_TERMINAL_LIGHT_BLUE; break;
+      default:                    out << OWL_TERMINAL_BLUE;       break;
+      }
+      out << "#owl: " << message.text << OWL_TERMINAL_DEFAULT << "\n";
+    }
+    std::cout << out.str() << std::flush;
+  }
+  
+  void Logger::flush()
+  {
+    writeOut(nullptr);
+  }
+
+  void Logger::writeOut(LogMessage *last)
+  {
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    std::vector<LogMessage> messages;
+    LogMessage message;
+    while (queue.pop(message))
+      messages.push_back(std::move(message));
+    const size_t numDroppedNow = numDropped.load();
+    if (numDroppedNow != numDroppedReported) {
+      messages.push_back({ OWL_LOG_LEVEL_WARNING, OWL_LOG_CATEGORY_ALL,
+                           std::to_string(numDroppedNow-numDroppedReported)
+                           +" log message(s) dropped - logging faster"
+                           " than they can get written" });
+      numDroppedReported = numDroppedNow;
+    }
+    if (last)
+      messages.push_back(std::move(*last));
+    if (messages.empty())
+      return;
+    
+    if (!callback)
+      writeToConsole(messages);
+    else for (auto &message : messages)
+      callback(message.level,message.category,message.text.c_str(),userData);
+  }
+
+  void Logger::writerLoop()
+  {
+    while (!quit) {
+      {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait_for(lock,logWriterInterval);
+      }
+      flush();
+    }
+  }
+  
+} // ::owl
@@ -0,0 +1,151 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "owl/owl.h"
+#include "owl/common.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace owl {
+
+  struct LogMessage {
+    OWLLogLevel level;
+    uint32_t    category;
+    std::string text;
+  };
+
+  /*! a bounded queue of log messages that any number of threads can
+      push into without locking (after D. Vyukov's bounded MPMC
+      queue), and that one thread at a time pops from. Pushing into
+      a full queue fails rather than waits */
+  struct LogQueue {
+    /*! capacity gets rounded up to a power of two */
+    LogQueue(size_t capacity);
+
+    /*! returns false (leaving 'message' untouched) if full */
+    bool push(LogMessage &message);
+    /*! returns false if empty; only one thread may pop at a time */
+    bool pop(LogMessage &message);
+
+    const size_t capacity;
+  private:
+    struct Slot {
+      std::atomic<size_t> sequence;
+      LogMessage          message;
+    };
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<size_t>     enqueuePos { 0 };
+    size_t                  dequeuePos = 0;
+  };
+
+  /*! owl's logger: messages that pass the level and category filters
+      get queued, and a background thread hands them to the sink (the
+      console, or a user callback) in batches - so logging threads
+      never wait for console i/o. Errors get written right away. If
+      messages come in faster than they get written, the ones that
+      don't fit into the queue get dropped and counted, and a warning
+      says how many - except for errors, which never get dropped */
+  struct Logger {
+    /*! 'async' false means no writer thread; messages then only get
+        written on flush() */
+    Logger(size_t queueCapacity = defaultQueueCapacity,
+           bool async = true);
+    /*! writes out whatever is still queued */
+    ~Logger();
+
+    /*! the process-wide logger that owl logs into */
+    static Logger &get();
+
+    void setLevel(OWLLogLevel level);
+    void setCategories(uint32_t categories);
+    /*! null means the console */
+    void setCallback(OWLLogCallback callback, void *userData);
+    
+    /*! whether a message of given level and category would get
+        logged; two relaxed loads */
+    inline bool isEnabled(OWLLogLevel level, uint32_t category) const
+    {
+      return (int)level <= this->level.load(std::memory_order_relaxed)
+        && (category & categories.load(std::memory_order_relaxed));
+    }
+
+    /*! queues a message (which should have passed isEnabled) */
+    void log(OWLLogLevel level, uint32_t category, std::string &&text);
+    
+    /*! writes out everything queued so far */
+    void flush();
+
+    /*! total number of messages dropped because the queue was full */
+    size_t getNumDropped() const { return numDropped.load(); }
+
+    /*! a cleared, per-thread stream to format messages into, so
+        logging doesn't have to create one every time */
+    static std::ostringstream &threadStream();
+    
+    static const size_t defaultQueueCapacity = 4096;
+
+  private:
+    void writerLoop();
+
+    /*! writes out everything queued so far, followed by 'last' (a
+        message that didn't fit into the queue) if not null */
+    void writeOut(LogMessage *last);
+    
+    LogQueue              queue;
+    std::atomic<int>      level;
+    std::atomic<uint32_t> categories { OWL_LOG_CATEGORY_ALL };
+    std::atomic<size_t>   numDropped { 0 };
+
+    /*! held while writing to the sink; also makes sure only one
+        thread at a time pops from the queue */
+    std::mutex            sinkMutex;
+    OWLLogCallback        callback = nullptr;
+    void                 *userData = nullptr;
+    size_t                numDroppedReported = 0;
+
+    std::thread             writer;
+    std::mutex              wakeMutex;
+    std::condition_variable wake;
+    std::atomic<bool>       quit { false };
+  };
+
+} // ::owl
+
+/*! logs the given message (which can be anything that can be
+    streamed into a std::ostream, like "a " << b << " c") with given
+    level and category; the message only gets formatted if it is
+    going to be logged */
+#define OWL_LOG(level,category,message)                                 \
+  do {                                                                  \
+    owl::Logger &_owlLogger = owl::Logger::get();                       \
+    if (_owlLogger.isEnabled(level,category)) {                         \
+      std::ostringstream &_owlLogStream = owl::Logger::threadStream();  \
+      _owlLogStream << message;                                         \
+      _owlLogger.log(level,category,_owlLogStream.str());               \
+    }                                                                   \
+  } while (0)
+
+#define OWL_LOG_ERROR(category,message)   OWL_LOG(OWL_LOG_LEVEL_ERROR,category,message)
+#define OWL_LOG_WARNING(category,message) OWL_LOG(OWL_LOG_LEVEL_WARNING,category,message)
+#define OWL_LOG_INFO(category,message)    OWL_LOG(OWL_LOG_LEVEL_INFO,category,message)
+#define OWL_LOG_DEBUG(category,message)   OWL_LOG(OWL_LOG_LEVEL_DEBUG,category,message)
@@ -0,0 +1,678 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "MeshOptimizer.h"
+#include "Hash.h"
+#include "owl/common/parallel/parallel_for.h"
+#include <atomic>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define OWL_HAVE_SSE2 1
+# include <emmintrin.h>
+#endif
+#if OWL_HAVE_TBB
+# include <tbb/parallel_sort.h>
+#endif
+
+namespace owl {
+  namespace mesh {
+
+    /*! how many elements a single parallel task processes */
+    const size_t meshOptimizerBlockSize = 16*1024;
+
+    /*! number of hash buckets that de-duplication is parallelized
+        over; has to be a power of two */
+    const int numDedupBuckets = 256;
+
+    inline vec3f positionOf(const uint8_t *vertices, size_t stride, size_t i)
+    {
+      float v[3];
+      memcpy(v,vertices+i*stride,sizeof(v));
+      return vec3f(v[0],v[1],v[2]);
+    }
+
+    inline uint64_t mix64(uint64_t h)
+    {
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdull;
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53ull;
+      h ^= h >> 33;
+      return h;
+    }
+
+    inline uint64_t hashInts(const int32_t *c)
+    {
+      return mix64((uint64_t(uint32_t(c[0])) | (uint64_t(uint32_t(c[1])) << 32))
+                   ^ mix64(uint64_t(uint32_t(c[2])) | (uint64_t(uint32_t(c[3])) << 32)));
+    }
+
+    template<typename T>
+    inline void sortPairs(std::vector<std::pair<uint64_t,T>> &pairs)
+    {
+#if OWL_HAVE_TBB
+      tbb::parallel_sort(pairs.begin(),pairs.end());
+#else
+      std::sort(pairs.begin(),pairs.end());
+#endif
+    }
+
+    /*! for each element, finds the first (ie, lowest-index) element
+        that it is equal to, with equal elements having to have
+        equal keys. This is parallelized over hash buckets, which
+        each get processed in index order */
+    template<typename Equal>
+    std::vector<int32_t> findFirstOccurrences(const std::vector<uint64_t> &keys,
+                                              const Equal &equal)
+    {
+      const size_t N = keys.size();
+      auto bucketOf = [&](size_t i) { return int(keys[i] >> 56) & (numDedupBuckets-1); };
+
+      std::vector<size_t> bucketBegin(numDedupBuckets+1,0);
+      for (size_t i=0;i<N;i++)
+        bucketBegin[bucketOf(i)+1]++;
+      for (int b=0;b<numDedupBuckets;b++)
+        bucketBegin[b+1] += bucketBegin[b];
+      std::vector<int32_t> bucketItems(N);
+      std::vector<size_t> fill(bucketBegin.begin(),bucketBegin.end()-1);
+      for (size_t i=0;i<N;i++)
+        bucketItems[fill[bucketOf(i)]++] = int32_t(i);
+
+      std::vector<int32_t> first(N);
+      owl::common::parallel_for(numDedupBuckets,[&](int b){
+          std::unordered_multimap<uint64_t,int32_t> seen;
+          seen.reserve(bucketBegin[b+1]-bucketBegin[b]);
+          for (size_t k=bucketBegin[b];k<bucketBegin[b+1];k++) {
+            const int32_t i = bucketItems[k];
+            int32_t found = i;
+            auto range = seen.equal_range(keys[i]);
+            for (auto it=range.first;it!=range.second;++it)
+              if (equal(it->second,i)) { found = it->second; break; }
+            if (found == i)
+              seen.emplace(keys[i],i);
+            first[i] = found;
+          }
+        });
+      return first;
+    }
+
+    /*! copies the given ('stride'-byte) records into the order given
+        by 'order', and compacts them to the front of the array */
+    void permuteRecords(uint8_t *records, size_t stride, const Order &order)
+    {
+      std::vector<uint8_t> tmp(order.size()*stride);
+      owl::common::parallel_for_blocked
+        (0,order.size(),meshOptimizerBlockSize,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++)
+            memcpy(tmp.data()+i*stride,records+size_t(order[i])*stride,stride);
+        });
+      if (!tmp.empty())
+        memcpy(records,tmp.data(),tmp.size());
+    }
+
+    template<typename T>
+    void applyOrder(std::vector<T> &items, const Order &order)
+    {
+      std::vector<T> tmp(order.size());
+      owl::common::parallel_for_blocked
+        (0,order.size(),meshOptimizerBlockSize,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++)
+            tmp[i] = items[order[i]];
+        });
+      items.swap(tmp);
+    }
+
+    // ==================================================================
+    // vertex welding
+    // ==================================================================
+
+    /*! the grid cell a vertex position falls into (or, for epsilon ==
+        0, its exact position); the fourth value flags positions that
+        are too far out to be quantized, and get compared exactly */
+    struct WeldCell { int32_t c[4]; };
+
+    inline WeldCell computeWeldCell(const vec3f &p, float epsilon)
+    {
+      // limit beyond which quantized coordinates overflow an int
+      const float maxQuantized = 1e9f;
+      WeldCell cell;
+#if OWL_HAVE_SSE2
+      // (adding zero turns -0 into +0)
+      const __m128 v = _mm_add_ps(_mm_setr_ps(p.x,p.y,p.z,0.f),_mm_setzero_ps());
+      __m128i q;
+      if (epsilon > 0.f) {
+        const __m128 scaled = _mm_mul_ps(v,_mm_set1_ps(1.f/epsilon));
+        const __m128 absScaled = _mm_andnot_ps(_mm_set1_ps(-0.f),scaled);
+        if (_mm_movemask_ps(_mm_cmpge_ps(absScaled,_mm_set1_ps(maxQuantized))))
+          q = _mm_insert_epi16(_mm_castps_si128(v),1,6);
+        else
+          q = _mm_cvtps_epi32(scaled);
+      } else
+        q = _mm_castps_si128(v);
+      _mm_storeu_si128((__m128i*)cell.c,q);
+#else
+      const float v[3] = { p.x+0.f, p.y+0.f, p.z+0.f };
+      bool exact = (epsilon <= 0.f);
+      if (!exact)
+        for (int d=0;d<3;d++)
+          exact |= (fabsf(v[d]/epsilon) >= maxQuantized);
+      for (int d=0;d<3;d++)
+        if (exact)
+          memcpy(&cell.c[d],&v[d],sizeof(float));
+        else
+          cell.c[d] = (int32_t)nearbyintf(v[d]/epsilon);
+      cell.c[3] = (exact && epsilon > 0.f) ? 1 : 0;
+#endif
+      return cell;
+    }
+
+    std::vector<int32_t> computeWeldRemap(const void *_vertices,
+                                          size_t numVertices,
+                                          size_t vertexStride,
+                                          float epsilon,
+                                          size_t &numUniqueVertices)
+    {
+      const uint8_t *vertices = (const uint8_t *)_vertices;
+      // the bytes of each vertex record following the position
+      const size_t attribOffset = sizeof(vec3f);
+      const size_t attribBytes  = vertexStride-attribOffset;
+
+      std::vector<WeldCell> cells(numVertices);
+      std::vector<uint64_t> keys(numVertices);
+      owl::common::parallel_for_blocked
+        (0,numVertices,meshOptimizerBlockSize,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++) {
+            cells[i] = computeWeldCell(positionOf(vertices,vertexStride,i),epsilon);
+            keys[i] = hashInts(cells[i].c);
+            if (attribBytes)
+              keys[i] = hash64(vertices+i*vertexStride+attribOffset,attribBytes,keys[i]);
+          }
+        });
+
+      std::vector<int32_t> first
+        = findFirstOccurrences(keys,[&](int32_t a, int32_t b) {
+            return memcmp(&cells[a],&cells[b],sizeof(WeldCell)) == 0
+              && memcmp(vertices+a*vertexStride+attribOffset,
+                        vertices+b*vertexStride+attribOffset,
+                        attribBytes) == 0;
+          });
+
+      // number the first occurrences in order, and have all
+      // duplicates point to those
+      std::vector<int32_t> remap(numVertices);
+      int32_t numUnique = 0;
+      for (size_t i=0;i<numVertices;i++)
+        remap[i] = (first[i] == int32_t(i)) ? numUnique++ : remap[first[i]];
+      numUniqueVertices = numUnique;
+      return remap;
+    }
+
+    // ==================================================================
+    // degenerate and duplicate triangles
+    // ==================================================================
+
+    Order findValidTriangles(const vec3i *triangles,
+                             size_t numTriangles,
+                             const void *_vertices,
+                             size_t vertexStride)
+    {
+      const uint8_t *vertices = (const uint8_t *)_vertices;
+
+      std::vector<vec3i>    canonical(numTriangles);
+      std::vector<uint64_t> keys(numTriangles);
+      std::vector<uint8_t>  degenerate(numTriangles);
+      owl::common::parallel_for_blocked
+        (0,numTriangles,meshOptimizerBlockSize,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++) {
+            vec3i t = triangles[i];
+            const vec3f a = positionOf(vertices,vertexStride,t.x);
+            const vec3f b = positionOf(vertices,vertexStride,t.y);
+            const vec3f c = positionOf(vertices,vertexStride,t.z);
+            const vec3f N = cross(b-a,c-a);
+            degenerate[i]
+              =  t.x == t.y || t.x == t.z || t.y == t.z
+              || (N.x == 0.f && N.y == 0.f && N.z == 0.f);
+            // rotate the smallest index to the front, so the same
+            // triangle (with the same winding) always looks the same
+            if (t.y < t.x && t.y < t.z)
+              t = vec3i(t.y,t.z,t.x);
+            else if (t.z < t.x && t.z < t.y)
+              t = vec3i(t.z,t.x,t.y);
+            canonical[i] = t;
+            const int32_t c4[4] = { t.x, t.y, t.z, 0 };
+            keys[i] = hashInts(c4);
+          }
+        });
+
+      std::vector<int32_t> first
+        = findFirstOccurrences(keys,[&](int32_t a, int32_t b) {
+            return canonical[a] == canonical[b];
+          });
+
+      Order valid;
+      valid.reserve(numTriangles);
+      for (size_t i=0;i<numTriangles;i++)
+        if (!degenerate[i] && first[i] == int32_t(i))
+          valid.push_back(int32_t(i));
+      return valid;
+    }
+
+    // ==================================================================
+    // spatial (morton) order
+    // ==================================================================
+
+    /*! spreads the lower 21 bits of 'x' to every third bit */
+    inline uint64_t spreadBits3(uint64_t x)
+    {
+      x &= 0x1fffff;
+      x = (x | x << 32) & 0x1f00000000ffffull;
+      x = (x | x << 16) & 0x1f0000ff0000ffull;
+      x = (x | x <<  8) & 0x100f00f00f00f00full;
+      x = (x | x <<  4) & 0x10c30c30c30c30c3ull;
+      x = (x | x <<  2) & 0x1249249249249249ull;
+      return x;
+    }
+
+    Order computeSpatialOrder(const vec3i *triangles,
+                              size_t numTriangles,
+                              const void *_vertices,
+                              size_t vertexStride)
+    {
+      const uint8_t *vertices = (const uint8_t *)_vertices;
+
+      std::vector<vec3f> centroids(numTriangles);
+      const size_t numBlocks
+        = (numTriangles+meshOptimizerBlockSize-1)/meshOptimizerBlockSize;
+      std::vector<box3f> blockBounds(numBlocks);
+      owl::common::parallel_for_blocked
+        (0,numTriangles,meshOptimizerBlockSize,[&](size_t begin, size_t end){
+          box3f &bounds = blockBounds[begin/meshOptimizerBlockSize];
+          for (size_t i=begin;i<end;i++) {
+            const vec3i t = triangles[i];
+            centroids[i]
+              = (positionOf(vertices,vertexStride,t.x)
+                 + positionOf(vertices,vertexStride,t.y)
+                 + positionOf(vertices,vertexStride,t.z)) * (1.f/3.f);
+            bounds.extend(centroids[i]);
+          }
+        });
+      box3f bounds;
+      for (auto &block : blockBounds)
+        bounds.extend(block);
+
+      const float maxCoord = float((1<<21)-1);
+      const vec3f size = max(bounds.size(),vec3f(1e-20f));
+      const vec3f scale = vec3f(maxCoord)/size;
+      std::vector<std::pair<uint64_t,int32_t>> codes(numTriangles);
+      owl::common::parallel_for_blocked
+        (0,numTriangles,meshOptimizerBlockSize,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++) {
+            const vec3f p = min(vec3f(maxCoord),(centroids[i]-bounds.lower)*scale);
+            codes[i].first
+              = (spreadBits3(uint64_t(p.x)) << 2)
+              | (spreadBits3(uint64_t(p.y)) << 1)
+              | (spreadBits3(uint64_t(p.z)) << 0);
+            codes[i].second = int32_t(i);
+          }
+        });
+      sortPairs(codes);
+
+      Order order(numTriangles);
+      for (size_t i=0;i<numTriangles;i++)
+        order[i] = codes[i].second;
+      return order;
+    }
+
+    // ==================================================================
+    // vertex cache order
+    // ==================================================================
+
+    /*! the scoring function from Tom Forsyth's "linear-speed vertex
+        cache optimisation", with the constants as suggested there */
+    inline float forsythVertexScore(int cachePos, int remainingValence)
+    {
+      const int   cacheSize         = 32;
+      const float cacheDecayPower   = 1.5f;
+      const float lastTriScore      = 0.75f;
+      const float valenceBoostScale = 2.f;
+      const float valenceBoostPower = 0.5f;
+
+      if (remainingValence == 0)
+        // no triangle needs this vertex any more
+        return -1.f;
+
+      float score = 0.f;
+      if (cachePos >= 0) {
+        if (cachePos < 3)
+          // the vertices of the last triangle get a fixed score, so
+          // that whichever of them we use, we'd be re-using the
+          // whole triangle's vertices
+          score = lastTriScore;
+        else
+          score = powf(1.f-float(cachePos-3)/float(cacheSize-3),cacheDecayPower);
+      }
+      // bonus for vertices with few triangles left, to get rid of
+      // them before they fall out of the cache
+      score += valenceBoostScale * powf(float(remainingValence),-valenceBoostPower);
+      return score;
+    }
+
+    /*! re-orders the triangles [begin,end) with forsyth's algorithm,
+        and writes their (global) indices into order[begin,end) */
+    void optimizeVertexCacheBatch(const vec3i *triangles,
+                                  size_t begin, size_t end,
+                                  int32_t *order)
+    {
+      const int cacheSize = 32;
+      const int numTris = int(end-begin);
+
+      // local numbering of the vertices used by this batch
+      std::vector<int32_t> vertexIDs(3*numTris);
+      for (int t=0;t<numTris;t++)
+        for (int j=0;j<3;j++)
+          vertexIDs[3*t+j] = triangles[begin+t][j];
+      std::sort(vertexIDs.begin(),vertexIDs.end());
+      vertexIDs.erase(std::unique(vertexIDs.begin(),vertexIDs.end()),vertexIDs.end());
+      const int numVerts = int(vertexIDs.size());
+
+      std::vector<vec3i> tris(numTris);
+      std::vector<int> valence(numVerts,0);
+      for (int t=0;t<numTris;t++)
+        for (int j=0;j<3;j++) {
+          const int v = int(std::lower_bound(vertexIDs.begin(),vertexIDs.end(),
+                                             triangles[begin+t][j])
+                            - vertexIDs.begin());
+          tris[t][j] = v;
+          valence[v]++;
+        }
+
+      // per-vertex lists of the triangles that still use it
+      std::vector<int> adjBegin(numVerts+1,0);
+      for (int v=0;v<numVerts;v++)
+        adjBegin[v+1] = adjBegin[v]+valence[v];
+      std::vector<int> adj(3*numTris);
+      std::vector<int> adjCount(numVerts,0);
+      for (int t=0;t<numTris;t++)
+        for (int j=0;j<3;j++) {
+          const int v = tris[t][j];
+          adj[adjBegin[v]+adjCount[v]++] = t;
+        }
+
+      std::vector<int>   cachePos(numVerts,-1);
+      std::vector<float> vertexScore(numVerts);
+      for (int v=0;v<numVerts;v++)
+        vertexScore[v] = forsythVertexScore(-1,adjCount[v]);
+
+      std::vector<float> triScore(numTris);
+      std::vector<bool>  emitted(numTris,false);
+      int   bestTri   = -1;
+      float bestScore = -1.f;
+      for (int t=0;t<numTris;t++) {
+        triScore[t]
+          = vertexScore[tris[t].x]
+          + vertexScore[tris[t].y]
+          + vertexScore[tris[t].z];
+        if (triScore[t] > bestScore) { bestScore = triScore[t]; bestTri = t; }
+      }
+
+      auto updateVertexScore = [&](int v) {
+        const float newScore = forsythVertexScore(cachePos[v],adjCount[v]);
+        const float delta = newScore-vertexScore[v];
+        vertexScore[v] = newScore;
+        for (int i=0;i<adjCount[v];i++)
+          triScore[adj[adjBegin[v]+i]] += delta;
+      };
+
+      std::vector<int> cache, newCache, evicted;
+      int nextUnemitted = 0;
+      for (int k=0;k<numTris;k++) {
+        if (bestTri < 0) {
+          // nothing in the cache is of any use any more; continue
+          // with the next triangle in input order (which, for a
+          // spatially sorted mesh, is "close by")
+          while (emitted[nextUnemitted]) nextUnemitted++;
+          bestTri = nextUnemitted;
+        }
+        order[begin+k] = int32_t(begin)+bestTri;
+        emitted[bestTri] = true;
+        const vec3i tri = tris[bestTri];
+        for (int j=0;j<3;j++) {
+          const int v = tri[j];
+          int *vertAdj = &adj[adjBegin[v]];
+          for (int i=0;i<adjCount[v];i++)
+            if (vertAdj[i] == bestTri) {
+              vertAdj[i] = vertAdj[--adjCount[v]];
+              break;
+            }
+        }
+
+        // the triangle's vertices go to the front of the (LRU) cache
+        newCache.clear();
+        for (int j=0;j<3;j++)
+          if (std::find(newCache.begin(),newCache.end(),tri[j]) == newCache.end())
+            newCache.push_back(tri[j]);
+        for (int v : cache)
+          if (v != tri.x && v != tri.y && v != tri.z)
+            newCache.push_back(v);
+        evicted.clear();
+        for (size_t i=cacheSize;i<newCache.size();i++) {
+          cachePos[newCache[i]] = -1;
+          evicted.push_back(newCache[i]);
+        }
+        if (newCache.size() > size_t(cacheSize))
+          newCache.resize(cacheSize);
+        for (size_t i=0;i<newCache.size();i++)
+          cachePos[newCache[i]] = int(i);
+
+        for (int v : newCache) updateVertexScore(v);
+        for (int v : evicted)  updateVertexScore(v);
+
+        bestTri   = -1;
+        bestScore = -1.f;
+        for (int v : newCache)
+          for (int i=0;i<adjCount[v];i++) {
+            const int t = adj[adjBegin[v]+i];
+            if (triScore[t] > bestScore) { bestScore = triScore[t]; bestTri = t; }
+          }
+        cache.swap(newCache);
+      }
+    }
+
+    Order computeVertexCacheOrder(const vec3i *triangles,
+                                  size_t numTriangles)
+    {
+      Order order(numTriangles);
+      owl::common::parallel_for_blocked
+        (0,numTriangles,vertexCacheBatchSize,[&](size_t begin, size_t end){
+          optimizeVertexCacheBatch(triangles,begin,end,order.data());
+        });
+      return order;
+    }
+
+    Order computeVertexFetchOrder(const vec3i *triangles,
+                                  size_t numTriangles,
+                                  size_t numVertices)
+    {
+      Order order;
+      order.reserve(numVertices);
+      std::vector<bool> used(numVertices,false);
+      for (size_t i=0;i<numTriangles;i++)
+        for (int j=0;j<3;j++) {
+          const int v = triangles[i][j];
+          if (used[v]) continue;
+          used[v] = true;
+          order.push_back(v);
+        }
+      return order;
+    }
+
+    float computeACMR(const vec3i *triangles,
+                      size_t numTriangles,
+                      size_t numVertices,
+                      int cacheSize)
+    {
+      if (numTriangles == 0) return 0.f;
+      // a vertex is in the (FIFO) cache if fewer than 'cacheSize'
+      // misses happened since it was last inserted
+      std::vector<size_t> insertedAt(numVertices,0);
+      std::vector<bool>   everInserted(numVertices,false);
+      size_t numMisses = 0;
+      for (size_t i=0;i<numTriangles;i++)
+        for (int j=0;j<3;j++) {
+          const int v = triangles[i][j];
+          if (everInserted[v] && numMisses-insertedAt[v] < size_t(cacheSize))
+            continue;
+          everInserted[v] = true;
+          insertedAt[v] = numMisses++;
+        }
+      return numMisses/float(numTriangles);
+    }
+
+    // ==================================================================
+    // one-call entry point
+    // ==================================================================
+
+    void optimizeMesh(void *vertices,
+                      size_t &numVertices,
+                      size_t vertexStride,
+                      void *indices,
+                      size_t &numTriangles,
+                      size_t indexStride,
+                      uint32_t flags,
+                      float weldEpsilon,
+                      int32_t *vertexRemap,
+                      int32_t *triangleRemap)
+    {
+      if (vertexStride == 0) vertexStride = sizeof(vec3f);
+      if (indexStride == 0)  indexStride  = sizeof(vec3i);
+      if (vertexStride < sizeof(vec3f) || indexStride < sizeof(vec3i))
+        throw std::runtime_error("owlMeshOptimize: vertex and index strides "
+                                 "have to be at least the size of a float3/int3");
+      if (weldEpsilon < 0.f)
+        throw std::runtime_error("owlMeshOptimize: negative weld epsilon");
+      if (numVertices >= size_t(std::numeric_limits<int32_t>::max()) ||
+          numTriangles >= size_t(std::numeric_limits<int32_t>::max()))
+        throw std::runtime_error("owlMeshOptimize: mesh too large");
+
+      uint8_t *vertexRecords = (uint8_t *)vertices;
+      uint8_t *indexRecords  = (uint8_t *)indices;
+      const size_t origNumTriangles = numTriangles;
+
+      std::vector<vec3i> tris(numTriangles);
+      std::atomic<bool> indexOutOfRange(false);
+      owl::common::parallel_for_blocked
+        (0,numTriangles,meshOptimizerBlockSize,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++) {
+            int32_t idx[3];
+            memcpy(idx,indexRecords+i*indexStride,sizeof(idx));
+            tris[i] = vec3i(idx[0],idx[1],idx[2]);
+            for (int j=0;j<3;j++)
+              if (tris[i][j] < 0 || size_t(tris[i][j]) >= numVertices)
+                indexOutOfRange = true;
+          }
+        });
+      if (indexOutOfRange)
+        throw std::runtime_error("owlMeshOptimize: index out of range");
+
+      // for each original triangle, where it currently is, and for
+      // each original vertex, what (current) vertex it maps to
+      Order triOrigin(numTriangles);
+      std::iota(triOrigin.begin(),triOrigin.end(),0);
+      std::vector<int32_t> vertexMap(numVertices);
+      std::iota(vertexMap.begin(),vertexMap.end(),0);
+
+      auto remapIndices = [&](const std::vector<int32_t> &oldToNew) {
+        owl::common::parallel_for_blocked
+          (0,tris.size(),meshOptimizerBlockSize,[&](size_t begin, size_t end){
+            for (size_t i=begin;i<end;i++)
+              tris[i] = vec3i(oldToNew[tris[i].x],
+                              oldToNew[tris[i].y],
+                              oldToNew[tris[i].z]);
+          });
+        for (auto &v : vertexMap)
+          if (v >= 0) v = oldToNew[v];
+      };
+
+      if (flags & OWL_MESH_OPTIMIZE_WELD_VERTICES) {
+        size_t numUnique = 0;
+        std::vector<int32_t> remap
+          = computeWeldRemap(vertexRecords,numVertices,vertexStride,
+                             weldEpsilon,numUnique);
+        Order unique;
+        unique.reserve(numUnique);
+        for (size_t i=0;i<numVertices;i++)
+          if (remap[i] == int32_t(unique.size()))
+            unique.push_back(int32_t(i));
+        permuteRecords(vertexRecords,vertexStride,unique);
+        remapIndices(remap);
+        numVertices = numUnique;
+      }
+
+      if (flags & OWL_MESH_OPTIMIZE_REMOVE_DEGENERATES) {
+        const Order valid
+          = findValidTriangles(tris.data(),tris.size(),vertexRecords,vertexStride);
+        applyOrder(tris,valid);
+        applyOrder(triOrigin,valid);
+      }
+
+      if (flags & OWL_MESH_OPTIMIZE_SPATIAL_ORDER) {
+        const Order order
+          = computeSpatialOrder(tris.data(),tris.size(),vertexRecords,vertexStride);
+        applyOrder(tris,order);
+        applyOrder(triOrigin,order);
+      }
+
+      if (flags & OWL_MESH_OPTIMIZE_VERTEX_CACHE_ORDER) {
+        const Order order
+          = computeVertexCacheOrder(tris.data(),tris.size());
+        applyOrder(tris,order);
+        applyOrder(triOrigin,order);
+      }
+
+      if (flags & OWL_MESH_OPTIMIZE_VERTEX_FETCH_ORDER) {
+        const Order order
+          = computeVertexFetchOrder(tris.data(),tris.size(),numVertices);
+        std::vector<int32_t> oldToNew(numVertices,-1);
+        for (size_t i=0;i<order.size();i++)
+          oldToNew[order[i]] = int32_t(i);
+        permuteRecords(vertexRecords,vertexStride,order);
+        remapIndices(oldToNew);
+        numVertices = order.size();
+      }
+
+      // move the index records (including anything that follows the
+      // indices themselves), then write the new indices into them
+      permuteRecords(indexRecords,indexStride,triOrigin);
+      numTriangles = tris.size();
+      for (size_t i=0;i<numTriangles;i++) {
+        const int32_t idx[3] = { tris[i].x, tris[i].y, tris[i].z };
+        memcpy(indexRecords+i*indexStride,idx,sizeof(idx));
+      }
+
+      if (vertexRemap)
+        std::copy(vertexMap.begin(),vertexMap.end(),vertexRemap);
+      if (triangleRemap) {
+        std::fill(triangleRemap,triangleRemap+origNumTriangles,-1);
+        for (size_t i=0;i<numTriangles;i++)
+          triangleRemap[triOrigin[i]] = int32_t(i);
+      }
+    }
+
+  } // ::owl::mesh
+} // ::owl
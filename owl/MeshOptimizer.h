@@ -0,0 +1,104 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "owl/owl.h"
+#include "owl/common.h"
+#include <vector>
+
+namespace owl {
+  /*! host-side preprocessing of triangle meshes, to improve the
+      memory locality of vertex and index arrays (and thus of the
+      attribute fetches in closest hit programs). All functions
+      operate on float3 vertex positions that live at the start of
+      each 'vertexStride'-byte vertex record, and on int3 indices */
+  namespace mesh {
+
+    /*! a re-ordering (and possibly, compaction) of a list of
+        elements, given as the (old) indices of the elements, in
+        their new order */
+    typedef std::vector<int32_t> Order;
+
+    /*! how many triangles computeVertexCacheOrder() re-orders as one
+        (independent) batch */
+    enum { vertexCacheBatchSize = 16*1024 };
+
+    /*! computes which vertices are duplicates of each other, and
+        returns, for each input vertex, the index of the (unique)
+        output vertex it gets merged into; output vertices are the
+        first occurrences of each set of duplicates, in their
+        original order. Vertices get merged if their positions are
+        equal (or, for epsilon > 0, snap to the same cell of a grid
+        of that cell size) *and* the rest of their vertex records
+        (normals, etc) are bitwise identical */
+    std::vector<int32_t> computeWeldRemap(const void *vertices,
+                                          size_t numVertices,
+                                          size_t vertexStride,
+                                          float epsilon,
+                                          size_t &numUniqueVertices);
+
+    /*! returns the triangles that are neither degenerate (ie, have
+        two identical indices, or zero area) nor a duplicate of an
+        earlier triangle (ie, same vertices, in the same winding
+        order), in their original order */
+    Order findValidTriangles(const vec3i *triangles,
+                             size_t numTriangles,
+                             const void *vertices,
+                             size_t vertexStride);
+
+    /*! orders triangles along a morton curve over their centroids */
+    Order computeSpatialOrder(const vec3i *triangles,
+                              size_t numTriangles,
+                              const void *vertices,
+                              size_t vertexStride);
+
+    /*! re-orders triangles for vertex re-use, using Tom Forsyth's
+        "linear-speed vertex cache optimisation". This is done
+        independently (and in parallel) for consecutive batches of
+        vertexCacheBatchSize triangles, so should be run on an
+        already spatially ordered mesh */
+    Order computeVertexCacheOrder(const vec3i *triangles,
+                                  size_t numTriangles);
+
+    /*! orders vertices by first use in the given triangles;
+        vertices not used by any triangle get dropped */
+    Order computeVertexFetchOrder(const vec3i *triangles,
+                                  size_t numTriangles,
+                                  size_t numVertices);
+
+    /*! average number of vertex cache misses per triangle, for a
+        FIFO cache of given size (lower is better; 0.5 is optimal for
+        large regular grids, 3 is the worst case) */
+    float computeACMR(const vec3i *triangles,
+                      size_t numTriangles,
+                      size_t numVertices,
+                      int cacheSize = 32);
+
+    /*! implements owlMeshOptimize() - see owl_host.h */
+    void optimizeMesh(void *vertices,
+                      size_t &numVertices,
+                      size_t vertexStride,
+                      void *indices,
+                      size_t &numTriangles,
+                      size_t indexStride,
+                      uint32_t flags,
+                      float weldEpsilon,
+                      int32_t *vertexRemap,
+                      int32_t *triangleRemap);
+
+  } // ::owl::mesh
+} // ::owl
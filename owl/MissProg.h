@@ -40,6 +40,9 @@ namespace owl {
       /*! the optix-compiled program group witin the given device's
         optix context */
       OptixProgramGroup pg = 0;
+
+      /*! key of the descriptor that 'pg' was created from */
+      uint64_t pgKey = 0;
     };
 
     /*! get reference to given device-specific data for this object */
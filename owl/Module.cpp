@@ -16,58 +16,14 @@
 
 #include "Module.h"
 #include "Context.h"
+#include "PtxUtils.h"
+#include <atomic>
 
-#define LOG(message)                            \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_LIGHT_BLUE                \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
-
-#define LOG_OK(message)                         \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_BLUE                      \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
-
+#define LOG(message)    OWL_LOG_DEBUG(OWL_LOG_CATEGORY_BUILD,message)
+#define LOG_OK(message) OWL_LOG_DEBUG(OWL_LOG_CATEGORY_BUILD,message)
 
 namespace owl {
 
-  /*! get next single line of PTX code */
-  std::string getNextLine(const char *&s)
-  {
-    std::stringstream line;
-    while (*s) {
-      char c = *s++;
-      line << c;
-      if (c == '\n') break;
-    }
-    return line.str();
-  }
-
-  /*! given the original PTX code, create a version of this PTX code
-      in which all lines that refer to an internal optix symbol (ie,
-      that contains ' _optix_' get commented out. This will make this
-      PTX code invalid for all optix functions, but makes it
-      compilable by cude for the non-optix bounds program */
-  std::string killAllInternalOptixSymbolsFromPtxString(const char *orignalPtxCode)
-  {
-    std::stringstream fixed;
-
-    for (const char *s = orignalPtxCode; *s; ) {
-      std::string line = getNextLine(s);
-      if (line.find(" _optix_") != line.npos)
-        fixed << "//dropped: " << line;
-      else
-        fixed << line;
-    }
-    return fixed.str();
-  }
-
-
   // ------------------------------------------------------------------
   // Module::DeviceData
   // ------------------------------------------------------------------
@@ -82,6 +38,11 @@ namespace owl {
   Module::DeviceData::~DeviceData()
   {
     destroy();
+    if (boundsModule) {
+      SetActiveGPU forLifeTime(device);
+      cuModuleUnload(boundsModule);
+      boundsModule = 0;
+    }
   }
 
   /*! destroy the optix data for this module; the owl data for the
@@ -93,10 +54,11 @@ namespace owl {
     if (module)
       optixModuleDestroy(module);
     module = 0;
+    buildID = 0;
   }
 
   /*! build the optix side of this module on this device */
-  void Module::DeviceData::build()
+  void Module::DeviceData::build(uint64_t compileKey)
   {
     assert(module == 0);
     SetActiveGPU forLifeTime(device);
@@ -116,9 +78,21 @@ namespace owl {
                                              &module
                                              ));
     assert(module != nullptr);
+    static std::atomic<uint64_t> nextBuildID(1);
+    this->compileKey = compileKey;
+    this->buildID    = nextBuildID++;
+    LOG_OK("created module #" << parent->ID);
+  }
 
+  CUmodule Module::DeviceData::getBoundsModule()
+  {
+    if (boundsModule)
+      return boundsModule;
+    
+    SetActiveGPU forLifeTime(device);
+    
     // ------------------------------------------------------------------
-    // Now, build separate cuda-only module that does not contain
+    // build separate cuda-only module that does not contain
     // any optix-internal symbols. Note this does not actually
     // *remove* any potentially existing anyhit/closesthit/etc.
     // programs in this module - it just removed all optix-related
@@ -130,10 +104,9 @@ namespace owl {
     // just leave them in (and as it's in a module that never gets
     // used by optix, this should actually be OK).
     // ------------------------------------------------------------------
-    LOG("generating second, 'non-optix' version of that module, too");
-    CUresult rc = (CUresult)0;
-    const std::string fixedPtxCode
-      = killAllInternalOptixSymbolsFromPtxString(parent->ptxCode.c_str());
+    LOG("generating second, 'non-optix' version of module #" << parent->ID);
+    const std::string &fixedPtxCode = parent->getBoundsPtxCode();
+    char log[2048];
     strcpy(log,"(no log yet)");
     CUjit_option options[] = {
                               CU_JIT_TARGET_FROM_CUCONTEXT,
@@ -146,16 +119,18 @@ namespace owl {
                             (void*)sizeof(log)
     };
     
-    rc = cuModuleLoadDataEx(&boundsModule, (void *)fixedPtxCode.c_str(),
-                            3, options, optionValues);
+    CUresult rc = cuModuleLoadDataEx(&boundsModule, (void *)fixedPtxCode.c_str(),
+                                     3, options, optionValues);
     if (rc != CUDA_SUCCESS) {
       const char *errName = 0;
       cuGetErrorName(rc,&errName);
+      boundsModule = 0;
       throw std::runtime_error("unknown CUDA error when building module "
                                "for bounds program kernel"
                                +std::string(errName));
     }
-    LOG_OK("created module #" << parent->ID << " (both optix and cuda)");
+    LOG_OK("created cuda module for bounds programs of module #" << parent->ID);
+    return boundsModule;
   }
   
 
@@ -190,5 +165,15 @@ namespace owl {
   {
     return "Module";
   }
+
+  const std::string &Module::getBoundsPtxCode()
+  {
+    std::lock_guard<std::mutex> lock(boundsPtxMutex);
+    if (!haveBoundsPtxCode) {
+      boundsPtxCode = killAllInternalOptixSymbolsFromPtxString(ptxCode);
+      haveBoundsPtxCode = true;
+    }
+    return boundsPtxCode;
+  }
     
 } // ::owl
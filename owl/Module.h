@@ -17,6 +17,7 @@
 #pragma once
 
 #include "RegisteredObject.h"
+#include <mutex>
 
 namespace owl {
   
@@ -35,13 +36,21 @@ namespace owl {
       /*! destructor */
       virtual ~DeviceData();
 
-      /*! build the optix side of this module on this device */
-      void build();
+      /*! build the optix side of this module on this device, with the
+          device's current compile options (whose key gets stored in
+          'compileKey') */
+      void build(uint64_t compileKey);
 
       /*! destroy the optix data for this module; the owl data for the
-        module itself remains valid */
+        module itself remains valid. Note this does not destroy the
+        boundsModule, which does not depend on any of the pipeline
+        options, and can thus be reused across builds */
       void destroy();
 
+      /*! returns the cuda module for the bounds program(s) in this
+          module, building it on first use */
+      CUmodule getBoundsModule();
+
       /*! pointer to the non-device specific part of this module */
       Module *const parent;
       
@@ -50,10 +59,21 @@ namespace owl {
        module using optixbuildmodule - this is the result of that
        operation */
       OptixModule module = 0;
+
+      /*! key of the compile options that 'module' was built with (see
+          DeviceContext::computeModuleCompileKey()); if the options
+          don't change, there's no need to re-build the module */
+      uint64_t    compileKey = 0;
+
+      /*! process-wide unique ID of the most recent build of 'module'
+          (or 0 if not built), so program groups can tell whether the
+          module they were created from has been re-built since */
+      uint64_t    buildID = 0;
       
       /*! for the *bounds* function we have to build a *separate*
         module because this one is built outside of optix, and thus
-        does not have the internal _optix_xyz() symbols in it */
+        does not have the internal _optix_xyz() symbols in it. Only
+        gets built on demand, see getBoundsModule() */
       CUmodule    boundsModule = 0;
     };
 
@@ -73,8 +93,18 @@ namespace owl {
     /*! create this object's device-specific data for the device */
     RegisteredObject::DeviceData::SP createOn(const DeviceContext::SP &device) override;
 
+    /*! returns the ptxCode with all optix-internal symbols stripped
+        (as required for building the boundsModule); computed once,
+        on first use, and shared by all devices */
+    const std::string &getBoundsPtxCode();
+    
     /*! the precompiled PTX code supplied by the user */
     const std::string ptxCode;
+
+  private:
+    std::mutex  boundsPtxMutex;
+    bool        haveBoundsPtxCode = false;
+    std::string boundsPtxCode;
   };
   
   // ------------------------------------------------------------------
@@ -126,6 +126,15 @@ namespace owl {
     case OWL_FLOAT4:
       return 4*sizeof(float);
 
+    case OWL_HALF:
+      return sizeof(uint16_t);
+    case OWL_HALF2:
+      return 2*sizeof(uint16_t);
+    case OWL_HALF3:
+      return 3*sizeof(uint16_t);
+    case OWL_HALF4:
+      return 4*sizeof(uint16_t);
+
     case OWL_AFFINE3F:
       return sizeof(affine3f);
 
@@ -240,6 +249,15 @@ namespace owl {
     case OWL_FLOAT4:
       return "float4";
       
+    case OWL_HALF:
+      return "half";
+    case OWL_HALF2:
+      return "half2";
+    case OWL_HALF3:
+      return "half3";
+    case OWL_HALF4:
+      return "half4";
+      
       // ------------------------------------------------------------------
       // 64 bit
       // ------------------------------------------------------------------
@@ -0,0 +1,49 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "PtxUtils.h"
+
+namespace owl {
+
+  std::string killAllInternalOptixSymbolsFromPtxString(const std::string &ptx)
+  {
+    static const std::string optixSymbol = " _optix_";
+    static const std::string dropped     = "//dropped: ";
+    
+    std::string fixed;
+    fixed.reserve(ptx.size()+ptx.size()/64);
+    size_t copied = 0;
+    while (1) {
+      const size_t found = ptx.find(optixSymbol,copied);
+      if (found == ptx.npos)
+        break;
+      // 'copied' always sits at the beginning of a line (ie, right
+      // after a newline), so this never scans back further than that
+      size_t begin = ptx.rfind('\n',found);
+      begin = (begin == ptx.npos || begin < copied) ? copied : begin+1;
+      size_t end = ptx.find('\n',found);
+      end = (end == ptx.npos) ? ptx.size() : end+1;
+      fixed.append(ptx,copied,begin-copied);
+      fixed.append(dropped);
+      fixed.append(ptx,begin,end-begin);
+      copied = end;
+    }
+    fixed.append(ptx,copied,ptx.size()-copied);
+    return fixed;
+  }
+
+} // ::owl
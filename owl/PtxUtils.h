@@ -0,0 +1,35 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include <string>
+
+namespace owl {
+
+  /*! given the original PTX code, create a version of this PTX code
+      in which all lines that refer to an internal optix symbol (ie,
+      that contains ' _optix_' get commented out. This will make this
+      PTX code invalid for all optix functions, but makes it
+      compilable by cude for the non-optix bounds program.
+
+      This is a single pass over the PTX that only ever looks at the
+      lines that actually contain such a symbol; everything in between
+      gets copied over in bulk */
+  std::string killAllInternalOptixSymbolsFromPtxString(const std::string &ptx);
+
+} // ::owl
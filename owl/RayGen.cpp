@@ -16,9 +16,34 @@
 
 #include "RayGen.h"
 #include "Context.h"
+#include <cstring>
 
 namespace owl {
 
+  std::vector<LaunchTile> computeLaunchTiles(const vec3i &dims,
+                                             size_t maxTileSize)
+  {
+    assert(maxTileSize > 0);
+    assert(dims.x > 0 && dims.y > 0 && dims.z > 0);
+    vec3i tileSize;
+    tileSize.x = int(std::min(size_t(dims.x),maxTileSize));
+    tileSize.y = int(std::min(size_t(dims.y),
+                              std::max(size_t(1),maxTileSize/tileSize.x)));
+    tileSize.z = int(std::min(size_t(dims.z),
+                              std::max(size_t(1),maxTileSize/(size_t(tileSize.x)
+                                                             *tileSize.y))));
+    std::vector<LaunchTile> tiles;
+    for (int iz=0;iz<dims.z;iz+=tileSize.z)
+      for (int iy=0;iy<dims.y;iy+=tileSize.y)
+        for (int ix=0;ix<dims.x;ix+=tileSize.x) {
+          LaunchTile tile;
+          tile.offset = vec3i(ix,iy,iz);
+          tile.dims   = min(tileSize,dims-tile.offset);
+          tiles.push_back(tile);
+        }
+    return tiles;
+  }
+
   // ------------------------------------------------------------------
   // RayGenType::DeviceData
   // ------------------------------------------------------------------
@@ -129,9 +154,44 @@ namespace owl {
     writeVariables(sbtRecordData,device);
   }  
 
+  /*! fills in the given SBT for a launch of this raygen on given
+      device, using the device's current miss and hit group records */
+  void RayGen::setupLaunchSBT(OptixShaderBindingTable &sbt,
+                              const DeviceContext::SP &device)
+  {
+    // -------------------------------------------------------
+    // set raygen part of SBT 
+    // -------------------------------------------------------
+    sbt.raygenRecord
+      = (CUdeviceptr)getDD(device).sbtRecordBuffer.d_pointer;
+    assert(sbt.raygenRecord);
+
+    // -------------------------------------------------------
+    // set miss progs part of SBT 
+    // -------------------------------------------------------
+    assert("check miss records built" && device->sbt.missProgRecordCount != 0);
+    sbt.missRecordBase
+      = (CUdeviceptr)device->sbt.missProgRecordsBuffer.get();
+    sbt.missRecordStrideInBytes
+      = (uint32_t)device->sbt.missProgRecordSize;
+    sbt.missRecordCount
+      = (uint32_t)device->sbt.missProgRecordCount;
+    
+    // -------------------------------------------------------
+    // set hit groups part of SBT 
+    // -------------------------------------------------------
+    assert("check hit records built" && device->sbt.hitGroupRecordCount != 0);
+    sbt.hitgroupRecordBase
+      = (CUdeviceptr)device->sbt.hitGroupRecordsBuffer.get();
+    sbt.hitgroupRecordStrideInBytes
+      = (uint32_t)device->sbt.hitGroupRecordSize;
+    sbt.hitgroupRecordCount
+      = (uint32_t)device->sbt.hitGroupRecordCount;
+  }
+
   /*! execute a *synchronous* launch of this raygen program, of given
     dimensions - this will wait for the program to complete */
-  void RayGen::launch(const vec2i &dims)
+  void RayGen::launch(const vec3i &dims)
   {
     launchAsync(dims,context->dummyLaunchParams);
     context->dummyLaunchParams->sync();
@@ -140,61 +200,83 @@ namespace owl {
   /*! *launch* this raygen prog with given launch params, but do NOT
     wait for completion - this means the SBT shuld NOT be changed or
     rebuild until a launchParams->sync() has been done */
-  void RayGen::launchAsync(const vec2i &dims,
+  void RayGen::launchAsync(const vec3i &dims,
                            const LaunchParams::SP &lp)
   {
     assert("check valid launch dims" && dims.x > 0);
     assert("check valid launch dims" && dims.y > 0);
-      
+    assert("check valid launch dims" && dims.z > 0);
+
+    // what each device launches over: the full launch, unless load
+    // balancing splits it up between devices
+    const std::vector<LaunchTile> deviceRegions
+      = lp->loadBalancer
+      ? lp->assignDeviceRegions(dims)
+      : std::vector<LaunchTile>(deviceData.size(),LaunchTile{vec3i(0),dims});
+    const size_t tileOffsetOfs
+      = lp->tileOffsetVarIdx >= 0
+      ? lp->type->varDecls[lp->tileOffsetVarIdx].offset
+      : size_t(-1);
+
     assert(!deviceData.empty());
     for (int deviceID=0;deviceID<(int)deviceData.size();deviceID++) {
+      const LaunchTile &region = deviceRegions[deviceID];
+      if (region.dims.x == 0)
+        continue;
+      
+      std::vector<LaunchTile> tiles;
+      if (tileOffsetOfs != size_t(-1)) {
+        tiles = computeLaunchTiles(region.dims,lp->maxTileSize);
+        for (auto &tile : tiles)
+          tile.offset += region.offset;
+      } else {
+        const size_t launchSize
+          = size_t(region.dims.x)*size_t(region.dims.y)*size_t(region.dims.z);
+        if (launchSize > optixMaxLaunchSize)
+          throw std::runtime_error("launch of "+std::to_string(launchSize)
+                                   +" threads exceeds the optix launch size limit"
+                                   " - enable launch tiling on the launch params"
+                                   " (owlParamsEnableLaunchTiling) to split it up");
+        tiles.push_back(region);
+      }
+      
       DeviceContext::SP device = context->getDevice(deviceID);
+      TraceScope trace("launch","launch",deviceID);
       SetActiveGPU forLifeTime(device);
       
-      RayGen::DeviceData       &rgDD = getDD(device);
       LaunchParams::DeviceData &lpDD = lp->getDD(device);
       
-      lp->writeVariables(lpDD.hostMemory.data(),device);
-      lpDD.deviceMemory.uploadAsync(lpDD.hostMemory.data(),lpDD.stream);
-
-      auto &sbt = lpDD.sbt;
-
-      // -------------------------------------------------------
-      // set raygen part of SBT 
-      // -------------------------------------------------------
-      sbt.raygenRecord
-        = (CUdeviceptr)rgDD.sbtRecordBuffer.d_pointer;
-      assert(sbt.raygenRecord);
-
-      // -------------------------------------------------------
-      // set miss progs part of SBT 
-      // -------------------------------------------------------
-      assert("check miss records built" && device->sbt.missProgRecordCount != 0);
-      sbt.missRecordBase
-        = (CUdeviceptr)device->sbt.missProgRecordsBuffer.get();
-      sbt.missRecordStrideInBytes
-        = (uint32_t)device->sbt.missProgRecordSize;
-      sbt.missRecordCount
-        = (uint32_t)device->sbt.missProgRecordCount;
-      
-      // -------------------------------------------------------
-      // set hit groups part of SBT 
-      // -------------------------------------------------------
-      assert("check hit records built" && device->sbt.hitGroupRecordCount != 0);
-      sbt.hitgroupRecordBase
-        = (CUdeviceptr)device->sbt.hitGroupRecordsBuffer.get();
-      sbt.hitgroupRecordStrideInBytes
-        = (uint32_t)device->sbt.hitGroupRecordSize;
-      sbt.hitgroupRecordCount
-        = (uint32_t)device->sbt.hitGroupRecordCount;
+      lp->beginLaunch(device);
+      lp->updateHostMemory(device);
+      if (tileOffsetOfs == size_t(-1))
+        lp->uploadChanges(device);
+
+      setupLaunchSBT(lpDD.sbt,device);
       
-      OPTIX_CALL(Launch(device->pipeline,
-                        lpDD.stream,
-                        (CUdeviceptr)lpDD.deviceMemory.get(),
-                        lpDD.deviceMemory.sizeInBytes,
-                        &lpDD.sbt,
-                        dims.x,dims.y,1
-                        ));
+      if (lp->loadBalancer) {
+        lpDD.currentSlot().timedTiles = lpDD.assignedTiles;
+        CUDA_CALL(EventRecord(lpDD.currentSlot().timingStart,lpDD.stream));
+      }
+      GpuTimings::Scope timeLaunch(device->timings,OWL_TIMING_LAUNCH,lpDD.stream);
+      for (auto &tile : tiles) {
+        if (tileOffsetOfs != size_t(-1)) {
+          // same stream, so this upload waits for the previous tile's
+          // launch
+          const int32_t offset[3] = { tile.offset.x, tile.offset.y, tile.offset.z };
+          memcpy(lpDD.hostMemory.data()+tileOffsetOfs,offset,sizeof(offset));
+          lp->uploadChanges(device);
+        }
+        OPTIX_CALL(Launch(device->pipeline,
+                          lpDD.stream,
+                          (CUdeviceptr)lpDD.currentSlot().deviceMemory.get(),
+                          lpDD.dataSize,
+                          &lpDD.sbt,
+                          tile.dims.x,tile.dims.y,tile.dims.z
+                          ));
+      }
+      if (lp->loadBalancer)
+        CUDA_CALL(EventRecord(lpDD.currentSlot().timingEnd,lpDD.stream));
+      lp->endLaunch(device);
 
       /* note we do NOT sync here ! */
     }
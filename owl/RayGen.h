@@ -22,6 +22,13 @@
 
 namespace owl {
 
+  /*! splits a launch of given dims into tiles of at most
+      'maxTileSize' threads each, in x-fastest order. Tiles span as
+      much of x, then y, as fits, so a launch that only exceeds the
+      limit in z gets split into slabs along z only */
+  std::vector<LaunchTile> computeLaunchTiles(const vec3i &dims,
+                                             size_t maxTileSize);
+
   /*! type that describes a raygen program's variables and programs */
   struct RayGenType : public SBTObjectType {
     typedef std::shared_ptr<RayGenType> SP;
@@ -38,6 +45,9 @@ namespace owl {
       /*! the optix-compiled program group witin the given device's
         optix context */
       OptixProgramGroup pg = 0;
+
+      /*! key of the descriptor that 'pg' was created from */
+      uint64_t pgKey = 0;
     };
     
     /*! constructor, with all the info to describe this type */
@@ -97,12 +107,21 @@ namespace owl {
 
     /*! execute a *synchronous* launch of this raygen program, of
       given dimensions - this will wait for the program to complete */
-    void launch(const vec2i &dims);
+    void launch(const vec3i &dims);
 
     /*! *launch* this raygen prog with given launch params, but do NOT
          wait for completion - this means the SBT shuld NOT be changed
-         or rebuild until a launchParams->sync() has been done */
-    void launchAsync(const vec2i &dims, const LaunchParams::SP &launchParams);
+         or rebuild until a launchParams->sync() has been done. If
+         launch tiling is enabled on the launch params, launches
+         larger than its tile size get split into several
+         sub-launches (all on the params' stream) */
+    void launchAsync(const vec3i &dims, const LaunchParams::SP &launchParams);
+    
+    /*! fills in the given SBT for a launch of this raygen on given
+        device, using the device's current miss and hit group
+        records */
+    void setupLaunchSBT(OptixShaderBindingTable &sbt,
+                        const DeviceContext::SP &device);
     
     /*! write the given SBT record, using the given device's
         corresponding device-side data represenataion */
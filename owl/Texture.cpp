@@ -26,6 +26,8 @@ namespace owl {
       return sizeof(vec4uc);
     case OWL_TEXEL_FORMAT_RGBA32F:
       return sizeof(vec4f);
+    case OWL_TEXEL_FORMAT_R8:
+      return sizeof(uint8_t);
     case OWL_TEXEL_FORMAT_R32F:
       return sizeof(float);
     default:
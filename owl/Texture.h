@@ -20,6 +20,9 @@
 
 namespace owl {
 
+  /*! size of a single texel of given format, in bytes */
+  size_t bytesPerTexel(OWLTexelFormat texelFormat);
+  
   struct Texture : public RegisteredObject
   {
     typedef std::shared_ptr<Texture> SP;
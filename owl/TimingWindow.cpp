@@ -0,0 +1,70 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "TimingWindow.h"
+#include <algorithm>
+
+namespace owl {
+
+  TimingWindow::TimingWindow(int windowSize)
+    : windowSize(windowSize)
+  {
+    assert(windowSize > 0);
+    samples.reserve(windowSize);
+  }
+    
+  void TimingWindow::add(float ms)
+  {
+    if ((int)samples.size() < windowSize)
+      samples.push_back(ms);
+    else
+      samples[next] = ms;
+    next = (next+1) % windowSize;
+    last = ms;
+    count++;
+  }
+
+  OWLTimingStats TimingWindow::getStats() const
+  {
+    OWLTimingStats stats = {};
+    stats.count      = count;
+    stats.windowSize = (int32_t)samples.size();
+    if (samples.empty())
+      return stats;
+    
+    std::vector<float> sorted = samples;
+    std::sort(sorted.begin(),sorted.end());
+    double sum = 0.;
+    for (auto ms : sorted) sum += ms;
+    // nearest-rank percentile
+    const size_t p99Rank = (size_t)std::ceil(.99 * sorted.size());
+    
+    stats.last = last;
+    stats.min  = sorted.front();
+    stats.mean = float(sum / sorted.size());
+    stats.p99  = sorted[std::max(size_t(1),p99Rank)-1];
+    return stats;
+  }
+
+  void TimingWindow::reset()
+  {
+    samples.clear();
+    next  = 0;
+    count = 0;
+    last  = 0.f;
+  }
+  
+} // ::owl
@@ -0,0 +1,52 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "owl/owl.h"
+#include "owl/common.h"
+#include <vector>
+
+namespace owl {
+
+  /*! keeps the most recent 'windowSize' timing measurements of one
+      kind of operation, and computes stats over them. Contains no cuda
+      code, so it can be tested on the host */
+  struct TimingWindow {
+    TimingWindow(int windowSize = defaultWindowSize);
+    
+    /*! adds a measurement, in milliseconds */
+    void add(float ms);
+
+    /*! stats over the current window */
+    OWLTimingStats getStats() const;
+
+    /*! forgets all measurements */
+    void reset();
+
+    /*! number of measurements kept unless specified otherwise */
+    static const int defaultWindowSize = 256;
+    
+  private:
+    /*! ring buffer of the most recent measurements */
+    std::vector<float> samples;
+    int                windowSize;
+    int                next  = 0;
+    uint64_t           count = 0;
+    float              last  = 0.f;
+  };
+  
+} // ::owl
@@ -0,0 +1,184 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "Trace.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+namespace owl {
+
+  // ------------------------------------------------------------------
+  // TraceRing
+  // ------------------------------------------------------------------
+  
+  TraceRing::TraceRing(int threadID, size_t capacity)
+    : threadID(threadID),
+      owner(std::this_thread::get_id()),
+      ring(capacity)
+  {
+    assert(capacity > 0);
+  }
+
+  void TraceRing::push(const TraceEvent &event)
+  {
+    const uint64_t n = numPushed.load(std::memory_order_relaxed);
+    ring[n % ring.size()] = event;
+    numPushed.store(n+1,std::memory_order_release);
+  }
+
+  size_t TraceRing::drain(std::vector<TraceEvent> &events)
+  {
+    const uint64_t end = numPushed.load(std::memory_order_acquire);
+    const uint64_t begin
+      = std::max(numDrained,end > ring.size() ? end-ring.size() : uint64_t(0));
+    const size_t numOut = events.size();
+    for (uint64_t i=begin;i<end;i++)
+      events.push_back(ring[i % ring.size()]);
+
+    // whatever the owning thread pushed while we were copying may
+    // have overwritten the oldest of the ones we copied
+    const uint64_t endNow = numPushed.load(std::memory_order_acquire);
+    uint64_t numClobbered = 0;
+    if (endNow > ring.size() && endNow-ring.size() > begin)
+      numClobbered = std::min(end,endNow-ring.size()) - begin;
+    events.erase(events.begin()+numOut,events.begin()+numOut+numClobbered);
+    
+    const size_t numDropped = size_t(begin-numDrained + numClobbered);
+    numDrained = end;
+    return numDropped;
+  }
+
+  // ------------------------------------------------------------------
+  // Tracer
+  // ------------------------------------------------------------------
+  
+  static std::atomic<uint64_t> nextTracerID { 1 };
+  
+  Tracer::Tracer(size_t ringCapacity)
+    : ringCapacity(ringCapacity),
+      tracerID(nextTracerID++),
+      t0(std::chrono::steady_clock::now())
+  {}
+
+  Tracer &Tracer::get()
+  {
+    static Tracer tracer;
+    return tracer;
+  }
+  
+  void Tracer::setEnabled(bool enabled)
+  {
+    this->enabled.store(enabled,std::memory_order_relaxed);
+  }
+  
+  TraceRing &Tracer::getThreadRing()
+  {
+    // cache of the ring of the tracer this thread used last; the
+    // tracer (and thus the ring) outlives all of its uses
+    static thread_local uint64_t   cachedTracerID = 0;
+    static thread_local TraceRing *cachedRing     = nullptr;
+    if (cachedTracerID == tracerID)
+      return *cachedRing;
+    
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    cachedTracerID = tracerID;
+    cachedRing     = nullptr;
+    for (auto &ring : rings)
+      if (ring->owner == std::this_thread::get_id())
+        cachedRing = ring.get();
+    if (!cachedRing) {
+      rings.emplace_back(new TraceRing((int)rings.size(),ringCapacity));
+      cachedRing = rings.back().get();
+    }
+    return *cachedRing;
+  }
+  
+  void Tracer::record(const char *name, const char *category,
+                      int deviceID, char phase)
+  {
+    TraceEvent event;
+    event.name     = name;
+    event.category = category;
+    event.deviceID = deviceID;
+    event.phase    = phase;
+    event.timeNs
+      = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>
+      (std::chrono::steady_clock::now()-t0).count();
+    getThreadRing().push(event);
+  }
+
+  /*! writes given string as a json string literal */
+  static void writeJSONString(std::ostream &out, const char *s)
+  {
+    out << '"';
+    for (;s && *s;s++) {
+      const unsigned char c = (unsigned char)*s;
+      if (c == '"' || c == '\\')
+        out << '\\' << c;
+      else if (c < 0x20)
+        out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c)
+            << std::dec << std::setfill(' ');
+      else
+        out << c;
+    }
+    out << '"';
+  }
+  
+  std::string Tracer::flush()
+  {
+    std::stringstream out;
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    size_t numDropped = 0;
+    
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    std::vector<TraceEvent> events;
+    for (auto &ring : rings) {
+      events.clear();
+      numDropped += ring->drain(events);
+      for (auto &event : events) {
+        out << (first ? "\n" : ",\n");
+        first = false;
+        out << "{\"name\":";
+        writeJSONString(out,event.name);
+        out << ",\"cat\":";
+        writeJSONString(out,event.category);
+        // timestamps are in microseconds
+        out << ",\"ph\":\"" << event.phase << "\""
+            << ",\"ts\":" << (event.timeNs/1000) << "."
+            << std::setw(3) << std::setfill('0') << (event.timeNs%1000)
+            << std::setfill(' ')
+            << ",\"pid\":0,\"tid\":" << ring->threadID;
+        if (event.deviceID >= 0)
+          out << ",\"args\":{\"device\":" << event.deviceID << "}";
+        out << "}";
+      }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\""
+        << ",\"otherData\":{\"droppedEvents\":" << numDropped << "}}\n";
+    return out.str();
+  }
+  
+  void Tracer::flush(const std::string &fileName)
+  {
+    std::ofstream file(fileName);
+    if (!file.good())
+      throw std::runtime_error("could not open trace file '"+fileName+"'");
+    file << flush();
+  }
+  
+} // ::owl
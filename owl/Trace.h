@@ -0,0 +1,138 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "owl/owl.h"
+#include "owl/common.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace owl {
+
+  /*! a single begin or end of a traced scope */
+  struct TraceEvent {
+    /*! has to be a string literal (or otherwise live for as long as
+        the trace does) - we only store the pointer */
+    const char *name;
+    const char *category;
+    /*! nanoseconds since the tracer got created */
+    uint64_t    timeNs;
+    /*! device that this was for, or -1 */
+    int32_t     deviceID;
+    /*! 'B' or 'E', as in the chrome trace-event format */
+    char        phase;
+  };
+
+  /*! the fixed-size ring one thread records its events into; only
+      ever written by that one thread, so recording needs no locks. If
+      the thread records more events than fit before they get
+      flushed, the oldest ones get overwritten (and counted as
+      dropped) */
+  struct TraceRing {
+    TraceRing(int threadID, size_t capacity);
+
+    /*! records an event; only to be called by the owning thread */
+    void push(const TraceEvent &event);
+
+    /*! appends all events recorded since the last drain, oldest
+        first, and returns how many got dropped in-between */
+    size_t drain(std::vector<TraceEvent> &events);
+    
+    const int             threadID;
+    /*! the thread that writes into this ring */
+    const std::thread::id owner;
+  private:
+    std::vector<TraceEvent> ring;
+    /*! total number of events ever pushed */
+    std::atomic<uint64_t>   numPushed { 0 };
+    /*! value of numPushed at the last drain */
+    uint64_t                numDrained = 0;
+  };
+  
+  /*! records timestamped begin/end events of api calls and internal
+      phases (builds, uploads, launches) into per-thread rings, and
+      serializes them in the chrome trace-event format (as read by
+      chrome://tracing and ui.perfetto.dev). Disabled by default, in
+      which case recording costs a single relaxed load */
+  struct Tracer {
+    Tracer(size_t ringCapacity = defaultRingCapacity);
+
+    /*! the process-wide tracer that owl records into */
+    static Tracer &get();
+    
+    void setEnabled(bool enabled);
+    inline bool isEnabled() const
+    { return enabled.load(std::memory_order_relaxed); }
+    
+    void begin(const char *name, const char *category, int deviceID = -1)
+    { record(name,category,deviceID,'B'); }
+    void end(const char *name, const char *category, int deviceID = -1)
+    { record(name,category,deviceID,'E'); }
+
+    /*! returns all events recorded since the last flush as a chrome
+        trace-event json document, and forgets them. Best called while
+        no other thread is recording; events a thread overwrites while
+        they're being flushed get dropped */
+    std::string flush();
+
+    /*! flushes into given file */
+    void flush(const std::string &fileName);
+    
+    /*! events per thread that can be recorded between two flushes */
+    static const size_t defaultRingCapacity = 64*1024;
+    
+  private:
+    void record(const char *name, const char *category,
+                int deviceID, char phase);
+    
+    /*! the calling thread's ring, created upon first use */
+    TraceRing &getThreadRing();
+
+    const size_t                            ringCapacity;
+    /*! unique across all tracers ever created, to tell apart which
+        one a thread's cached ring belongs to */
+    const uint64_t                          tracerID;
+    const std::chrono::steady_clock::time_point t0;
+    std::atomic<bool>                       enabled { false };
+    std::mutex                              ringsMutex;
+    std::vector<std::unique_ptr<TraceRing>> rings;
+  };
+
+  /*! traces the lifetime of this object as one scope, if tracing is
+      enabled upon construction */
+  struct TraceScope {
+    inline TraceScope(const char *name, const char *category,
+                      int deviceID = -1,
+                      Tracer &tracer = Tracer::get())
+      : tracer(tracer.isEnabled() ? &tracer : nullptr),
+        name(name), category(category), deviceID(deviceID)
+    { if (this->tracer) this->tracer->begin(name,category,deviceID); }
+    
+    inline ~TraceScope()
+    { if (tracer) tracer->end(name,category,deviceID); }
+    
+  private:
+    Tracer     *const tracer;
+    const char *const name;
+    const char *const category;
+    const int         deviceID;
+  };
+  
+} // ::owl
@@ -0,0 +1,124 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "Transforms.h"
+#include "owl/common/parallel/parallel_for.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+# define OWL_HAVE_SSE 1
+# include <xmmintrin.h>
+#endif
+
+namespace owl {
+
+  /*! how many transforms a single parallel task converts; small
+      arrays are done serially */
+  const size_t transformConversionBlockSize = 16*1024;
+
+  size_t floatsPerMatrix(OWLMatrixFormat matrixFormat)
+  {
+    switch (matrixFormat) {
+    case OWL_MATRIX_FORMAT_COLUMN_MAJOR:
+    case OWL_MATRIX_FORMAT_ROW_MAJOR:
+      return 12;
+    case OWL_MATRIX_FORMAT_COLUMN_MAJOR_4X4:
+      return 16;
+    default:
+      throw std::runtime_error("un-recognized matrix format");
+    }
+  }
+
+  /*! 4x3 column-major (ie, owl::common::affine3f: vx,vy,vz,p) to
+      3x4 row-major */
+  inline void convertColumnMajor4x3(float *out, const float *in, size_t N)
+  {
+    for (size_t i=0;i<N;i++, in += 12, out += 12) {
+#if OWL_HAVE_SSE
+      // a = (vx.x vx.y vx.z vy.x), b = (vy.y vy.z vz.x vz.y),
+      // c = (vz.z  p.x  p.y  p.z)
+      const __m128 a = _mm_loadu_ps(in+0);
+      const __m128 b = _mm_loadu_ps(in+4);
+      const __m128 c = _mm_loadu_ps(in+8);
+      // row0 = (a0 a3 b2 c1)
+      const __m128 t0 = _mm_shuffle_ps(b,c,_MM_SHUFFLE(1,1,2,2));
+      _mm_storeu_ps(out+0,_mm_shuffle_ps(a,t0,_MM_SHUFFLE(2,0,3,0)));
+      // row1 = (a1 b0 b3 c2)
+      const __m128 t1 = _mm_shuffle_ps(a,b,_MM_SHUFFLE(0,0,1,1));
+      const __m128 u1 = _mm_shuffle_ps(b,c,_MM_SHUFFLE(2,2,3,3));
+      _mm_storeu_ps(out+4,_mm_shuffle_ps(t1,u1,_MM_SHUFFLE(2,0,2,0)));
+      // row2 = (a2 b1 c0 c3)
+      const __m128 t2 = _mm_shuffle_ps(a,b,_MM_SHUFFLE(1,1,2,2));
+      const __m128 u2 = _mm_shuffle_ps(c,c,_MM_SHUFFLE(3,3,0,0));
+      _mm_storeu_ps(out+8,_mm_shuffle_ps(t2,u2,_MM_SHUFFLE(2,0,2,0)));
+#else
+      for (int row=0;row<3;row++)
+        for (int col=0;col<4;col++)
+          out[row*4+col] = in[col*3+row];
+#endif
+    }
+  }
+
+  /*! 4x4 column-major (last row ignored) to 3x4 row-major */
+  inline void convertColumnMajor4x4(float *out, const float *in, size_t N)
+  {
+    for (size_t i=0;i<N;i++, in += 16, out += 12) {
+#if OWL_HAVE_SSE
+      __m128 c0 = _mm_loadu_ps(in+0);
+      __m128 c1 = _mm_loadu_ps(in+4);
+      __m128 c2 = _mm_loadu_ps(in+8);
+      __m128 c3 = _mm_loadu_ps(in+12);
+      _MM_TRANSPOSE4_PS(c0,c1,c2,c3);
+      _mm_storeu_ps(out+0,c0);
+      _mm_storeu_ps(out+4,c1);
+      _mm_storeu_ps(out+8,c2);
+#else
+      for (int row=0;row<3;row++)
+        for (int col=0;col<4;col++)
+          out[row*4+col] = in[col*4+row];
+#endif
+    }
+  }
+
+  void convertTransforms(InstanceTransform *out,
+                         const float *in,
+                         size_t numTransforms,
+                         OWLMatrixFormat matrixFormat)
+  {
+    const size_t inStride = floatsPerMatrix(matrixFormat);
+    owl::common::parallel_for_blocked
+      (0,numTransforms,transformConversionBlockSize,
+       [&](size_t begin, size_t end) {
+        float       *blockOut = out[begin].m;
+        const float *blockIn  = in + begin*inStride;
+        const size_t N        = end-begin;
+        switch (matrixFormat) {
+        case OWL_MATRIX_FORMAT_COLUMN_MAJOR:
+          convertColumnMajor4x3(blockOut,blockIn,N);
+          break;
+        case OWL_MATRIX_FORMAT_COLUMN_MAJOR_4X4:
+          convertColumnMajor4x4(blockOut,blockIn,N);
+          break;
+        case OWL_MATRIX_FORMAT_ROW_MAJOR:
+          // already in the right layout
+          memcpy(blockOut,blockIn,N*sizeof(InstanceTransform));
+          break;
+        default:
+          throw std::runtime_error("un-recognized matrix format");
+        }
+      });
+  }
+
+} // ::owl
@@ -0,0 +1,67 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "owl/owl.h"
+#include "owl/common.h"
+
+namespace owl {
+
+  /*! a single instance transform, stored as a 3x4-float *row-major*
+      matrix - ie, exactly the layout that optix expects in
+      OptixInstance::transform and OptixMatrixMotionTransform::transform,
+      so the builders can copy it over without any further
+      conversion */
+  struct InstanceTransform {
+    float m[12];
+  };
+
+  /*! number of floats that a single matrix of given format occupies
+      in a (densely packed) array of such matrices */
+  size_t floatsPerMatrix(OWLMatrixFormat matrixFormat);
+
+  /*! convert 'numTransforms' densely packed matrices of given format
+      (from 'in') into optix' row-major 3x4 layout (in 'out'). Uses
+      SSE where available, and the owl::common::parallel_for
+      infrastructure for large arrays */
+  void convertTransforms(InstanceTransform *out,
+                         const float *in,
+                         size_t numTransforms,
+                         OWLMatrixFormat matrixFormat);
+
+  /*! convert a single instance transform back to a owl::common
+      affine3f (mostly for computing bounds on the host) */
+  inline affine3f toAffine3f(const InstanceTransform &xfm)
+  {
+    affine3f a;
+    a.l.vx = vec3f(xfm.m[0*4+0],xfm.m[1*4+0],xfm.m[2*4+0]);
+    a.l.vy = vec3f(xfm.m[0*4+1],xfm.m[1*4+1],xfm.m[2*4+1]);
+    a.l.vz = vec3f(xfm.m[0*4+2],xfm.m[1*4+2],xfm.m[2*4+2]);
+    a.p    = vec3f(xfm.m[0*4+3],xfm.m[1*4+3],xfm.m[2*4+3]);
+    return a;
+  }
+
+  /*! the identity transform, in instance transform layout */
+  inline InstanceTransform identityInstanceTransform()
+  {
+    InstanceTransform xfm = {{ 1.f,0.f,0.f,0.f,
+                               0.f,1.f,0.f,0.f,
+                               0.f,0.f,1.f,0.f }};
+    return xfm;
+  }
+
+} // ::owl
@@ -16,58 +16,52 @@
 
 #include "Triangles.h"
 #include "Context.h"
+#include "BoundsReduction.h"
 
 namespace owl {
 
-  __device__ static float atomicMax(float* address, float val)
-  {
-    int* address_as_i = (int*) address;
-    int old = *address_as_i, assumed;
-    do {
-      assumed = old;
-      old = ::atomicCAS(address_as_i, assumed,
-                        __float_as_int(::fmaxf(val, __int_as_float(assumed))));
-    } while (assumed != old);
-    return __int_as_float(old);
-  }
-  
-  __device__ static float atomicMin(float* address, float val)
-  {
-    int* address_as_i = (int*) address;
-    int old = *address_as_i, assumed;
-    do {
-      assumed = old;
-      old = ::atomicCAS(address_as_i, assumed,
-                        __float_as_int(::fminf(val, __int_as_float(assumed))));
-    } while (assumed != old);
-    return __int_as_float(old);
-  }
+  /*! fetcher for reduceBoundsOnDevice() that decodes vertices of
+      any of the supported vertex formats */
+  struct VertexFetcher {
+    inline __device__ box3f operator()(size_t i) const
+    {
+      const uint8_t *ptr = vertices + i*stride;
+      vec3f vtx;
+      switch (format) {
+      case OWL_VERTEX_FORMAT_FLOAT2:
+        vtx = vec3f(((const float*)ptr)[0],((const float*)ptr)[1],0.f);
+        break;
+      case OWL_VERTEX_FORMAT_HALF3:
+        vtx = vec3f(halfToFloat(((const uint16_t*)ptr)[0]),
+                    halfToFloat(((const uint16_t*)ptr)[1]),
+                    halfToFloat(((const uint16_t*)ptr)[2]));
+        break;
+      case OWL_VERTEX_FORMAT_HALF2:
+        vtx = vec3f(halfToFloat(((const uint16_t*)ptr)[0]),
+                    halfToFloat(((const uint16_t*)ptr)[1]),
+                    0.f);
+        break;
+      case OWL_VERTEX_FORMAT_SNORM16_3:
+        vtx = vec3f(snorm16ToFloat(((const int16_t*)ptr)[0]),
+                    snorm16ToFloat(((const int16_t*)ptr)[1]),
+                    snorm16ToFloat(((const int16_t*)ptr)[2]));
+        break;
+      case OWL_VERTEX_FORMAT_SNORM16_2:
+        vtx = vec3f(snorm16ToFloat(((const int16_t*)ptr)[0]),
+                    snorm16ToFloat(((const int16_t*)ptr)[1]),
+                    0.f);
+        break;
+      default:
+        vtx = *(const vec3f*)ptr;
+      }
+      return box3f(vtx,vtx);
+    }
+    
+    const uint8_t  *vertices;
+    size_t          stride;
+    OWLVertexFormat format;
+  };
 
-  /*! device kernel to compute bounding box ov vertex array (and thus,
-      bbox of triangle mesh, for motion blur (which for instances
-      requies knowing the bboxes of its objects */
-  __global__ void computeBoundsOfVertices(box3f *d_bounds,
-                                          const void *d_vertices,
-                                          size_t count,
-                                          size_t stride,
-                                          size_t offset)
-  {
-    int tid = blockDim.x * blockIdx.x + threadIdx.x;
-    if (tid >= count) return;
-
-    const uint8_t *ptr = (const uint8_t *)d_vertices;
-    ptr += tid*stride;
-    ptr += offset;
-
-    vec3f vtx = *(const vec3f*)ptr;
-    atomicMin(&d_bounds->lower.x,vtx.x);
-    atomicMin(&d_bounds->lower.y,vtx.y);
-    atomicMin(&d_bounds->lower.z,vtx.z);
-    atomicMax(&d_bounds->upper.x,vtx.x);
-    atomicMax(&d_bounds->upper.y,vtx.y);
-    atomicMax(&d_bounds->upper.z,vtx.z);
-  }
-                                          
   // ------------------------------------------------------------------
   // TrianglesGeomType
   // ------------------------------------------------------------------
@@ -102,39 +96,60 @@ namespace owl {
     return "TrianglesGeom";
   }
 
-  /*! call a cuda kernel that computes the bounds of the vertex buffers */
-  void TrianglesGeom::computeBounds(box3f bounds[2])
+  /*! computes the bounds of the vertex buffers (for both motion
+      keys); on the host if the vertices are host-accessible, else
+      via a cuda reduction on the first GPU. Results get cached until
+      any of the vertex buffers (or the vertex array layout) change */
+  void TrianglesGeom::computeBounds(box3f bounds[2], bool forceRecompute)
   {
     assert(vertex.buffers.size() == 1 || vertex.buffers.size() == 2);
 
-    int numThreads = 1024;
-    int numBlocks = int((vertex.count + numThreads - 1) / numThreads);
+    std::vector<uint64_t> bufferVersions;
+    bool cacheable = true;
+    for (auto buffer : vertex.buffers) {
+      bufferVersions.push_back(buffer->contentVersion);
+      cacheable &= buffer->contentsTracked();
+    }
+    if (cacheable && !forceRecompute && cachedBounds.valid
+        && cachedBounds.bufferVersions == bufferVersions) {
+      bounds[0] = cachedBounds.bounds[0];
+      bounds[1] = cachedBounds.bounds[1];
+      return;
+    }
 
     DeviceContext::SP device = context->getDevice(0);
     assert(device);
     SetActiveGPU forLifeTime(device);
-      
-    DeviceMemory d_bounds;
-    d_bounds.alloc(2*sizeof(box3f));
-    bounds[0] = bounds[1] = box3f();
-    d_bounds.upload(bounds);
-    computeBoundsOfVertices<<<numBlocks,numThreads>>>
-      (((box3f*)d_bounds.get())+0,
-       vertex.buffers[0]->getPointer(device),
-       vertex.count,vertex.stride,vertex.offset);
-    if (vertex.buffers.size() == 2)
-      computeBoundsOfVertices<<<numBlocks,numThreads>>>
-        (((box3f*)d_bounds.get())+1,
-         vertex.buffers[1]->getPointer(device),
-         vertex.count,vertex.stride,vertex.offset);
-    CUDA_SYNC_CHECK();
-    d_bounds.download(&bounds[0]);
-    d_bounds.free();
-    CUDA_SYNC_CHECK();
+
+    const OWLVertexFormat format = getVertexFormat();
+    for (size_t i=0;i<vertex.buffers.size();i++) {
+      const Buffer::SP &buffer = vertex.buffers[i];
+      const uint8_t *h_vertices = (const uint8_t *)buffer->getHostPointer();
+      if (h_vertices) {
+        // managed memory may still be written to by a kernel
+        CUDA_SYNC_CHECK();
+        bounds[i] = computeVertexBoundsOnHost(h_vertices+vertex.offset,
+                                              vertex.count,vertex.stride,
+                                              format);
+      } else {
+        VertexFetcher fetcher;
+        fetcher.vertices = (const uint8_t *)buffer->getPointer(device)
+          + vertex.offset;
+        fetcher.stride   = vertex.stride;
+        fetcher.format   = format;
+        bounds[i] = reduceBoundsOnDevice(vertex.count,fetcher);
+      }
+    }
     if (vertex.buffers.size() == 1)
       bounds[1] = bounds[0];
+
+    cachedBounds.valid          = cacheable;
+    cachedBounds.bufferVersions = bufferVersions;
+    cachedBounds.bounds[0]      = bounds[0];
+    cachedBounds.bounds[1]      = bounds[1];
   }
 
+
   RegisteredObject::DeviceData::SP TrianglesGeom::createOn(const DeviceContext::SP &device) 
   { return std::make_shared<DeviceData>(device); }
 
@@ -151,12 +166,15 @@ namespace owl {
     vertex.count   = count;
     vertex.stride  = stride;
     vertex.offset  = offset;
+    cachedBounds.valid   = false;
+    cachedDedupKey.valid = false;
 
     for (auto device : context->getDevices()) {
       DeviceData &dd = getDD(device);
       dd.vertexPointers.clear();
       for (auto va : vertexArrays)
-        dd.vertexPointers.push_back((CUdeviceptr)va->getPointer(device));
+        dd.vertexPointers.push_back((CUdeviceptr)va->getPointer(device)
+                                    + offset);
     }
   }
   
@@ -169,11 +187,96 @@ namespace owl {
     index.count  = count;
     index.stride = stride;
     index.offset = offset;
+    cachedDedupKey.valid = false;
     
     for (auto device : context->getDevices()) {
       DeviceData &dd = getDD(device);
-      dd.indexPointer = (CUdeviceptr)indices->getPointer(device);
+      dd.indexPointer = (CUdeviceptr)indices->getPointer(device) + offset;
     }
   }
 
+  void TrianglesGeom::setVertexFormat(OWLVertexFormat format)
+  {
+    vertex.format = format;
+    cachedBounds.valid   = false;
+    cachedDedupKey.valid = false;
+  }
+  
+  void TrianglesGeom::setIndexFormat(OWLIndexFormat format)
+  {
+    index.format = format;
+    cachedDedupKey.valid = false;
+  }
+
+  OWLVertexFormat TrianglesGeom::getVertexFormat() const
+  {
+    if (vertex.format != OWL_VERTEX_FORMAT_FROM_BUFFER)
+      return vertex.format;
+    if (vertex.buffers.empty())
+      return OWL_VERTEX_FORMAT_FLOAT3;
+    return vertexFormatFor(vertex.buffers[0]->type);
+  }
+
+  OWLIndexFormat TrianglesGeom::getIndexFormat() const
+  {
+    if (index.format != OWL_INDEX_FORMAT_FROM_BUFFER)
+      return index.format;
+    if (!index.buffer)
+      return OWL_INDEX_FORMAT_UINT3;
+    return indexFormatFor(index.buffer->type);
+  }
+
+  /*! checks that 'count' elements of size 'elementSize' with given
+      stride and offset are valid for given component alignment, and
+      fit into given buffer */
+  static void checkArrayLayout(const std::string &what,
+                               const Buffer::SP &buffer,
+                               size_t count,
+                               size_t stride,
+                               size_t offset,
+                               size_t elementSize,
+                               size_t alignment)
+  {
+    if (stride < elementSize)
+      throw std::runtime_error(what+" stride ("+std::to_string(stride)
+                               +") is smaller than a single element ("
+                               +std::to_string(elementSize)+" bytes)");
+    if (stride % alignment)
+      throw std::runtime_error(what+" stride ("+std::to_string(stride)
+                               +") is not a multiple of "
+                               +std::to_string(alignment));
+    if (offset % alignment)
+      throw std::runtime_error(what+" offset ("+std::to_string(offset)
+                               +") is not a multiple of "
+                               +std::to_string(alignment));
+    if (count == 0)
+      return;
+    const size_t bytesRead = offset + (count-1)*stride + elementSize;
+    if (bytesRead > buffer->sizeInBytes())
+      throw std::runtime_error(what+" array ("+std::to_string(count)
+                               +" elements) exceeds its buffer ("
+                               +std::to_string(buffer->sizeInBytes())
+                               +" bytes)");
+  }
+  
+  void TrianglesGeom::checkVertexAndIndexLayout() const
+  {
+    if (vertex.buffers.empty())
+      throw std::runtime_error("triangles geom has no vertex array");
+    if (!index.buffer)
+      throw std::runtime_error("triangles geom has no index array");
+
+    const OWLVertexFormat vertexFormat = getVertexFormat();
+    for (auto buffer : vertex.buffers)
+      checkArrayLayout("vertex ("+toString(vertexFormat)+")",
+                       buffer,vertex.count,vertex.stride,vertex.offset,
+                       vertexFormatSizeOf(vertexFormat),
+                       vertexComponentSizeOf(vertexFormat));
+    const OWLIndexFormat indexFormat = getIndexFormat();
+    checkArrayLayout("index ("+toString(indexFormat)+")",
+                     index.buffer,index.count,index.stride,index.offset,
+                     indexFormatSizeOf(indexFormat),
+                     indexComponentSizeOf(indexFormat));
+  }
+
 } // ::owl
@@ -17,6 +17,7 @@
 #pragma once
 
 #include "Geometry.h"
+#include "VertexFormats.h"
 
 namespace owl {
 
@@ -52,12 +53,13 @@ namespace owl {
 
       /*! this is a *vector* of vertex arrays, for motion blur
           purposes. ie, for static meshes only one entry is used, for
-          motion blur two (and eventually, maybe more) will be used */
+          motion blur two (and eventually, maybe more) will be
+          used. These already have the vertex offset applied */
       std::vector<CUdeviceptr> vertexPointers;
 
       /*! device poiner to array of indices - the memory for the
           indices will live in some sort of buffer; this only points
-          to that buffer */
+          into that buffer (with the offset already applied) */
       CUdeviceptr indexPointer  = (CUdeviceptr)0;
     };
 
@@ -87,8 +89,35 @@ namespace owl {
                     size_t stride,
                     size_t offset);
 
-    /*! call a cuda kernel that computes the bounds of the vertex buffers */
-    void computeBounds(box3f bounds[2]);
+    /*! explicitly set the vertex format (rather than deriving it from
+        the vertex buffer's type) */
+    void setVertexFormat(OWLVertexFormat format);
+
+    /*! explicitly set the index format (rather than deriving it from
+        the index buffer's type) */
+    void setIndexFormat(OWLIndexFormat format);
+
+    /*! the (explicit) format of the vertex arrays, ie, either the
+        one set via setVertexFormat(), or the one derived from the
+        vertex buffers' type */
+    OWLVertexFormat getVertexFormat() const;
+
+    /*! the (explicit) format of the index array, ie, either the one
+        set via setIndexFormat(), or the one derived from the index
+        buffer's type */
+    OWLIndexFormat getIndexFormat() const;
+
+    /*! checks that vertex and index arrays have been set, and that
+        their strides, offsets, and counts are valid for their
+        respective formats and fit into their buffers; throws an
+        exception if not */
+    void checkVertexAndIndexLayout() const;
+    
+    /*! computes the bounds of the vertex buffers, for both motion
+        keys; results get cached until the vertex buffers or layout
+        change, or 'forceRecompute' is set (eg, because a refit
+        signalled that vertices changed in ways we can't track) */
+    void computeBounds(box3f bounds[2], bool forceRecompute = false);
 
     /*! pretty-print */
     std::string toString() const override;
@@ -98,13 +127,34 @@ namespace owl {
       size_t stride = 0;
       size_t offset = 0;
       Buffer::SP buffer;
+      OWLIndexFormat format = OWL_INDEX_FORMAT_FROM_BUFFER;
     } index;
     struct {
       size_t count  = 0;
       size_t stride = 0;
       size_t offset = 0;
       std::vector<Buffer::SP> buffers;
+      OWLVertexFormat format = OWL_VERTEX_FORMAT_FROM_BUFFER;
     } vertex;
+
+    /*! result of the last computeBounds(), and the vertex buffers'
+        content versions it was computed for */
+    struct {
+      bool valid = false;
+      std::vector<uint64_t> bufferVersions;
+      box3f bounds[2];
+    } cachedBounds;
+
+    /*! this geom's part of its group's accel dedup key (\see
+        TrianglesGeomGroup::computeDedupKey), the number of vertex and
+        index bytes that got hashed for it, and the vertex and index
+        buffers' content versions it was computed for */
+    struct {
+      bool valid = false;
+      std::vector<uint64_t> bufferVersions;
+      uint64_t key         = 0;
+      size_t   bufferBytes = 0;
+    } cachedDedupKey;
   };
 
   // ------------------------------------------------------------------
@@ -17,22 +17,49 @@
 #include "TrianglesGeomGroup.h"
 #include "Triangles.h"
 #include "Context.h"
+#include "VertexFormats.h"
 
-#define LOG(message)                                            \
-  if (Context::logging())                                       \
-    std::cout << "#owl(" << device->ID << "): "                 \
-              << message                                        \
-              << std::endl
-
-#define LOG_OK(message)                                         \
-  if (Context::logging())                                       \
-    std::cout << OWL_TERMINAL_GREEN                             \
-              << "#owl(" << device->ID << "): "                 \
-              << message << OWL_TERMINAL_DEFAULT << std::endl
-
+#define LOG(message)                                                    \
+  OWL_LOG_DEBUG(OWL_LOG_CATEGORY_ACCEL,                                 \
+                "(device " << device->ID << ") " << message)
+#define LOG_OK(message)                                                 \
+  OWL_LOG_DEBUG(OWL_LOG_CATEGORY_ACCEL,                                 \
+                "(device " << device->ID << ") " << message)
 
 namespace owl {
 
+  /*! build flags for all triangle accels */
+  const uint32_t trianglesAccelBuildFlags =
+    OPTIX_BUILD_FLAG_ALLOW_UPDATE |
+    OPTIX_BUILD_FLAG_PREFER_FAST_TRACE |
+    OPTIX_BUILD_FLAG_ALLOW_COMPACTION;
+
+  /*! the optix equivalent of a given (explicit) owl vertex format */
+  static OptixVertexFormat toOptix(OWLVertexFormat format)
+  {
+    switch (format) {
+    case OWL_VERTEX_FORMAT_FLOAT3:    return OPTIX_VERTEX_FORMAT_FLOAT3;
+    case OWL_VERTEX_FORMAT_FLOAT2:    return OPTIX_VERTEX_FORMAT_FLOAT2;
+    case OWL_VERTEX_FORMAT_HALF3:     return OPTIX_VERTEX_FORMAT_HALF3;
+    case OWL_VERTEX_FORMAT_HALF2:     return OPTIX_VERTEX_FORMAT_HALF2;
+    case OWL_VERTEX_FORMAT_SNORM16_3: return OPTIX_VERTEX_FORMAT_SNORM16_3;
+    case OWL_VERTEX_FORMAT_SNORM16_2: return OPTIX_VERTEX_FORMAT_SNORM16_2;
+    default:
+      throw std::runtime_error("invalid vertex format "+toString(format));
+    }
+  }
+  
+  /*! the optix equivalent of a given (explicit) owl index format */
+  static OptixIndicesFormat toOptix(OWLIndexFormat format)
+  {
+    switch (format) {
+    case OWL_INDEX_FORMAT_UINT3:   return OPTIX_INDICES_FORMAT_UNSIGNED_INT3;
+    case OWL_INDEX_FORMAT_USHORT3: return OPTIX_INDICES_FORMAT_UNSIGNED_SHORT3;
+    default:
+      throw std::runtime_error("invalid index format "+toString(format));
+    }
+  }
+  
   /*! pretty-printer, for printf-debugging */
   std::string TrianglesGeomGroup::toString() const
   {
@@ -45,39 +72,201 @@ namespace owl {
     : GeomGroup(context,numChildren)
   {}
   
-  void TrianglesGeomGroup::updateMotionBounds()
+  void TrianglesGeomGroup::updateMotionBounds(bool forceRecompute)
   {
     bounds[0] = bounds[1] = box3f();
     for (auto geom : geometries) {
       TrianglesGeom::SP mesh = geom->as<TrianglesGeom>();
       box3f meshBounds[2];
-      mesh->computeBounds(meshBounds);
+      mesh->computeBounds(meshBounds,forceRecompute);
       for (int i=0;i<2;i++)
         bounds[i].extend(meshBounds[i]);
     }
   }
   
+  uint64_t TrianglesGeomGroup::computeAccelCacheKey()
+  {
+    const DeviceContext::SP first = context->getDevice(0);
+    ContentHasher hasher = accelCacheHasher();
+    hasher
+      .add(std::string("triangles"))
+      .add(trianglesAccelBuildFlags)
+      .add(geometries.size());
+    for (auto geom : geometries) {
+      TrianglesGeom::SP tris = geom->as<TrianglesGeom>();
+      assert(tris);
+      TrianglesGeom::DeviceData &trisDD = tris->getDD(first);
+      const OWLVertexFormat vertexFormat = tris->getVertexFormat();
+      const OWLIndexFormat  indexFormat  = tris->getIndexFormat();
+      hasher
+        .add(tris->vertex.buffers.size())
+        .add(vertexFormat)
+        .add(tris->vertex.count)
+        .add(tris->vertex.stride)
+        .add(indexFormat)
+        .add(tris->index.count)
+        .add(tris->index.stride);
+      // only hash the bytes the builder actually reads - the last
+      // element may well not have a full stride's worth of data
+      if (tris->vertex.count > 0)
+        for (auto d_vertices : trisDD.vertexPointers)
+          hashDeviceData(hasher,(const void *)d_vertices,
+                         (tris->vertex.count-1)*tris->vertex.stride
+                         + vertexFormatSizeOf(vertexFormat));
+      if (tris->index.count > 0)
+        hashDeviceData(hasher,(const void *)trisDD.indexPointer,
+                       (tris->index.count-1)*tris->index.stride
+                       + indexFormatSizeOf(indexFormat));
+    }
+    return hasher.get();
+  }
+  
+  uint64_t TrianglesGeomGroup::computeDedupKey(size_t &bufferBytes)
+  {
+    const DeviceContext::SP first = context->getDevice(0);
+    SetActiveGPU forLifeTime(first);
+
+    auto download = [](std::vector<uint8_t> &host, CUdeviceptr d_data,
+                       size_t count, size_t stride, size_t elementSize) {
+      host.resize(count ? (count-1)*stride+elementSize : 0);
+      if (!host.empty())
+        CUDA_CHECK(cudaMemcpy(host.data(),(const void *)d_data,
+                              host.size(),cudaMemcpyDefault));
+      return host.data();
+    };
+    
+    ContentHasher hasher;
+    hasher
+      .add(std::string("triangles"))
+      .add(trianglesAccelBuildFlags)
+      .add(geometries.size());
+    bufferBytes = 0;
+    for (auto geom : geometries) {
+      TrianglesGeom::SP tris = geom->as<TrianglesGeom>();
+      assert(tris);
+
+      // only re-download and re-hash buffers that (may) have changed
+      // since the last build
+      std::vector<uint64_t> bufferVersions;
+      bool cacheable = true;
+      for (auto buffer : tris->vertex.buffers) {
+        bufferVersions.push_back(buffer->contentVersion);
+        cacheable &= buffer->contentsTracked();
+      }
+      bufferVersions.push_back(tris->index.buffer->contentVersion);
+      cacheable &= tris->index.buffer->contentsTracked();
+      auto &cached = tris->cachedDedupKey;
+      if (cacheable && cached.valid && cached.bufferVersions == bufferVersions) {
+        hasher.add(cached.key);
+        bufferBytes += cached.bufferBytes;
+        continue;
+      }
+      
+      TrianglesGeom::DeviceData &trisDD = tris->getDD(first);
+      size_t meshBytes = 0;
+      MeshContent mesh;
+      mesh.vertexCount  = tris->vertex.count;
+      mesh.vertexStride = tris->vertex.stride;
+      mesh.vertexFormat = tris->getVertexFormat();
+      mesh.indexCount   = tris->index.count;
+      mesh.indexStride  = tris->index.stride;
+      mesh.indexFormat  = tris->getIndexFormat();
+
+      std::vector<std::vector<uint8_t>> vertices(trisDD.vertexPointers.size());
+      for (size_t keyID=0;keyID<vertices.size();keyID++) {
+        mesh.vertices.push_back
+          (download(vertices[keyID],trisDD.vertexPointers[keyID],
+                    mesh.vertexCount,mesh.vertexStride,
+                    vertexFormatSizeOf(mesh.vertexFormat)));
+        meshBytes += vertices[keyID].size();
+      }
+      std::vector<uint8_t> indices;
+      mesh.indices
+        = download(indices,trisDD.indexPointer,
+                   mesh.indexCount,mesh.indexStride,
+                   indexFormatSizeOf(mesh.indexFormat));
+      meshBytes += indices.size();
+      
+      ContentHasher meshHasher;
+      hashMeshContent(meshHasher,mesh);
+      cached.valid          = cacheable;
+      cached.bufferVersions = std::move(bufferVersions);
+      cached.key            = meshHasher.get();
+      cached.bufferBytes    = meshBytes;
+      
+      hasher.add(cached.key);
+      bufferBytes += meshBytes;
+    }
+    return hasher.get();
+  }
+  
   void TrianglesGeomGroup::buildAccel()
   {
-    for (auto device : context->getDevices()) 
+    for (auto geom : geometries)
+      geom->as<TrianglesGeom>()->checkVertexAndIndexLayout();
+
+    // whatever we shared before may not match our content any more
+    releaseSharedAccel();
+    
+    uint64_t dedupKey    = 0;
+    size_t   bufferBytes = 0;
+    if (context->accelDedupEnabled) {
+      dedupKey = computeDedupKey(bufferBytes);
+      if (SharedAccel::SP shared = context->accelDedupTable.find(dedupKey)) {
+        useSharedAccel(shared);
+        if (context->motionBlurEnabled)
+          updateMotionBounds();
+        return;
+      }
+    }
+    
+    auto buildOn = [&](const DeviceContext::SP &device) {
       buildAccelOn<true>(device);
+    };
+    if (context->accelCache)
+      buildOnAllDevicesCached(computeAccelCacheKey(),buildOn);
+    else
+      buildOnAllDevices(buildOn);
 
+    if (context->accelDedupEnabled) {
+      bool split = false;
+      for (auto device : context->getDevices())
+        split |= isSplit(device);
+      if (!split)
+        context->accelDedupTable.insert(dedupKey,shareAccel(bufferBytes));
+    }
+    
     if (context->motionBlurEnabled)
       updateMotionBounds();
   }
   
   void TrianglesGeomGroup::refitAccel()
   {
-    for (auto device : context->getDevices()) 
-      buildAccelOn<false>(device);
+    if (sharedAccel) {
+      // refitting in place would change the accel for all other
+      // groups sharing it, too - so unless we're the only one using
+      // it, get a new one instead
+      releaseSharedAccel();
+      if (getDD(context->getDevice(0)).bvhMemory.empty()) {
+        buildAccel();
+        return;
+      }
+    }
+    
+    buildOnAllDevices([&](const DeviceContext::SP &device) {
+        buildAccelOn<false>(device);
+      });
     
+    // a refit means vertices have moved, possibly in ways that the
+    // buffers' content versions did not pick up
     if (context->motionBlurEnabled)
-      updateMotionBounds();
+      updateMotionBounds(/*forceRecompute*/true);
   }
   
   template<bool FULL_REBUILD>
   void TrianglesGeomGroup::buildAccelOn(const DeviceContext::SP &device) 
   {
+    TraceScope trace(FULL_REBUILD ? "buildAccel" : "refitAccel","accel",device->ID);
     DeviceData &dd = getDD(device);
 
     if (FULL_REBUILD && !dd.bvhMemory.empty())
@@ -101,7 +290,44 @@ namespace owl {
        OPTIX_DEVICE_PROPERTY_LIMIT_MAX_PRIMITIVES_PER_GAS,
        &maxPrimsPerGAS,
        sizeof(maxPrimsPerGAS));
+    for (auto geom : geometries)
+      sumPrims += geom->as<TrianglesGeom>()->index.count;
+
+    if (sumPrims <= maxPrimsPerGAS) {
+      setNumChunksOn(device,0,FULL_REBUILD);
+      buildChunkOn<FULL_REBUILD>(device,0,sumPrims,
+                                 dd.bvhMemory,dd.traversable);
+    } else {
+      if (!context->accelSplittingEnabled)
+        throw std::runtime_error("number of prims in triangles geom group "
+                                 "exceeds OptiX's MAX_PRIMITIVES_PER_GAS "
+                                 "limit (see owlEnableAccelSplitting())");
+      const std::vector<std::pair<size_t,size_t>> chunks
+        = computeChunkRanges(sumPrims,maxPrimsPerGAS);
+      LOG("splitting " << prettyNumber(sumPrims) << " triangles into "
+          << chunks.size() << " chunks");
+      setNumChunksOn(device,chunks.size(),FULL_REBUILD);
+      for (size_t chunkID=0;chunkID<chunks.size();chunkID++)
+        buildChunkOn<FULL_REBUILD>(device,
+                                   chunks[chunkID].first,
+                                   chunks[chunkID].second,
+                                   *dd.chunkMemory[chunkID],
+                                   dd.chunkTraversables[chunkID]);
+      buildChunkInstanceAccelOn(device,FULL_REBUILD);
+    }
+    
+    LOG_OK("successfully build triangles geom group accel");
+  }
 
+  template<bool FULL_REBUILD>
+  void TrianglesGeomGroup::buildChunkOn(const DeviceContext::SP &device,
+                                        size_t primBegin,
+                                        size_t primEnd,
+                                        DeviceMemory &bvhMemory,
+                                        OptixTraversableHandle &traversable)
+  {
+    DeviceData &dd = getDD(device);
+    
     assert(!geometries.empty());
     TrianglesGeom::SP child0 = geometries[0]->as<TrianglesGeom>();
     assert(child0);
@@ -118,7 +344,11 @@ namespace owl {
     // one build flag per build input
     std::vector<uint32_t> triangleInputFlags(geometries.size());
 
-    // now go over all geometries to set up the buildinputs
+    // now go over all geometries to set up the buildinputs. Note that
+    // even if this is only a chunk of the group's prims we always
+    // need one build input per geometry (even if empty), so the SBT
+    // layout stays the same for all chunks
+    size_t geomBegin = 0;
     for (size_t childID=0;childID<geometries.size();childID++) {
       
       // the child wer're setting them with (with sanity checks)
@@ -130,6 +360,12 @@ namespace owl {
                                  "different motion keys in the same "
                                  "triangles geom group");
       TrianglesGeom::DeviceData &trisDD = tris->getDD(device);
+
+      // the range of this geom's triangles that is in this chunk
+      const size_t geomEnd = geomBegin + tris->index.count;
+      const size_t begin   = std::min(std::max(primBegin,geomBegin),geomEnd) - geomBegin;
+      const size_t end     = std::min(std::max(primEnd,  geomBegin),geomEnd) - geomBegin;
+      geomBegin = geomEnd;
       
       CUdeviceptr     *d_vertices    = trisDD.vertexPointers.data();
       assert(d_vertices);
@@ -137,21 +373,19 @@ namespace owl {
       
       triangleInput.type = OPTIX_BUILD_INPUT_TYPE_TRIANGLES;
       auto &ta = triangleInput.triangleArray;
-      ta.vertexFormat        = OPTIX_VERTEX_FORMAT_FLOAT3;
+      ta.vertexFormat        = toOptix(tris->getVertexFormat());
       ta.vertexStrideInBytes = (uint32_t)tris->vertex.stride;
       ta.numVertices         = (uint32_t)tris->vertex.count;
       ta.vertexBuffers       = d_vertices;
       
-      ta.indexFormat         = OPTIX_INDICES_FORMAT_UNSIGNED_INT3;
+      ta.indexFormat         = toOptix(tris->getIndexFormat());
       ta.indexStrideInBytes  = (uint32_t)tris->index.stride;
-      ta.numIndexTriplets    = (uint32_t)tris->index.count;
-      ta.indexBuffer         = trisDD.indexPointer;
+      ta.numIndexTriplets    = (uint32_t)(end-begin);
+      ta.indexBuffer         = trisDD.indexPointer + begin*tris->index.stride;
+      // keeps optixGetPrimitiveIndex() relative to the whole geom
+      ta.primitiveIndexOffset = (uint32_t)begin;
       assert(ta.indexBuffer);
       
-      // -------------------------------------------------------
-      // sanity check that we don't have too many prims
-      // -------------------------------------------------------
-      sumPrims += ta.numIndexTriplets;
       // we always have exactly one SBT entry per shape (i.e., triangle
       // mesh), and no per-primitive materials:
       triangleInputFlags[childID]    = 0;
@@ -167,10 +401,6 @@ namespace owl {
       ta.sbtIndexOffsetStrideInBytes = 0; 
     }
     
-    if (sumPrims > maxPrimsPerGAS) 
-      throw std::runtime_error("number of prim in user geom group exceeds "
-                               "OptiX's MAX_PRIMITIVES_PER_GAS limit");
-    
     // ==================================================================
     // BLAS setup: buildinputs set up, build the blas
     // ==================================================================
@@ -179,10 +409,7 @@ namespace owl {
     // first: compute temp memory for bvh
     // ------------------------------------------------------------------
     OptixAccelBuildOptions accelOptions = {};
-    accelOptions.buildFlags =
-      OPTIX_BUILD_FLAG_ALLOW_UPDATE |
-      OPTIX_BUILD_FLAG_PREFER_FAST_TRACE |
-      OPTIX_BUILD_FLAG_ALLOW_COMPACTION;
+    accelOptions.buildFlags = trianglesAccelBuildFlags;
     
     accelOptions.motionOptions.numKeys   = numKeys;
     accelOptions.motionOptions.flags     = 0;
@@ -235,42 +462,46 @@ namespace owl {
     emitDesc.type = OPTIX_PROPERTY_TYPE_COMPACTED_SIZE;
     emitDesc.result = (CUdeviceptr)compactedSizeBuffer.get();
 
-    if (FULL_REBUILD) {
-      OPTIX_CHECK(optixAccelBuild(device->optixContext,
-                                  /* todo: stream */0,
-                                  &accelOptions,
-                                  // array of build inputs:
-                                  triangleInputs.data(),
-                                  (uint32_t)triangleInputs.size(),
-                                  // buffer of temp memory:
-                                  (CUdeviceptr)tempBuffer.get(),
-                                  tempBuffer.size(),
-                                  // where we store initial, uncomp bvh:
-                                  (CUdeviceptr)outputBuffer.get(),
-                                  outputBuffer.size(),
-                                  /* the traversable we're building: */ 
-                                  &dd.traversable,
-                                  /* we're also querying compacted size: */
-                                  &emitDesc,1u
-                                  ));
-    } else {
-      OPTIX_CHECK(optixAccelBuild(device->optixContext,
-                                  /* todo: stream */0,
-                                  &accelOptions,
-                                  // array of build inputs:
-                                  triangleInputs.data(),
-                                  (uint32_t)triangleInputs.size(),
-                                  // buffer of temp memory:
-                                  (CUdeviceptr)tempBuffer.get(),
-                                  tempBuffer.size(),
-                                  // where we store initial, uncomp bvh:
-                                  (CUdeviceptr)dd.bvhMemory.get(),
-                                  dd.bvhMemory.size(),
-                                  /* the traversable we're building: */ 
-                                  &dd.traversable,
-                                  /* we're also querying compacted size: */
-                                  nullptr,0
-                                  ));
+    {
+      GpuTimings::Scope timeBuild(device->timings,OWL_TIMING_ACCEL_BUILD,
+                                  /* todo: stream */0);
+      if (FULL_REBUILD) {
+        OPTIX_CHECK(optixAccelBuild(device->optixContext,
+                                    /* todo: stream */0,
+                                    &accelOptions,
+                                    // array of build inputs:
+                                    triangleInputs.data(),
+                                    (uint32_t)triangleInputs.size(),
+                                    // buffer of temp memory:
+                                    (CUdeviceptr)tempBuffer.get(),
+                                    tempBuffer.size(),
+                                    // where we store initial, uncomp bvh:
+                                    (CUdeviceptr)outputBuffer.get(),
+                                    outputBuffer.size(),
+                                    /* the traversable we're building: */ 
+                                    &traversable,
+                                    /* we're also querying compacted size: */
+                                    &emitDesc,1u
+                                    ));
+      } else {
+        OPTIX_CHECK(optixAccelBuild(device->optixContext,
+                                    /* todo: stream */0,
+                                    &accelOptions,
+                                    // array of build inputs:
+                                    triangleInputs.data(),
+                                    (uint32_t)triangleInputs.size(),
+                                    // buffer of temp memory:
+                                    (CUdeviceptr)tempBuffer.get(),
+                                    tempBuffer.size(),
+                                    // where we store initial, uncomp bvh:
+                                    (CUdeviceptr)bvhMemory.get(),
+                                    bvhMemory.size(),
+                                    /* the traversable we're building: */ 
+                                    &traversable,
+                                    /* we're also querying compacted size: */
+                                    nullptr,0
+                                    ));
+      }
     }
     CUDA_SYNC_CHECK();
     
@@ -280,21 +511,22 @@ namespace owl {
     
     // alloc the buffer...
     if (FULL_REBUILD) {
+      TraceScope trace("compactAccel","accel",device->ID);
       // download builder's compacted size from device
       uint64_t compactedSize;
       compactedSizeBuffer.download(&compactedSize);
       
-      dd.bvhMemory.alloc(compactedSize);
+      bvhMemory.alloc(compactedSize);
       // ... and perform compaction
       OPTIX_CALL(AccelCompact(device->optixContext,
                               /*TODO: stream:*/0,
                               // OPTIX_COPY_MODE_COMPACT,
-                              dd.traversable,
-                              (CUdeviceptr)dd.bvhMemory.get(),
-                              dd.bvhMemory.size(),
-                              &dd.traversable));
-      dd.memPeak += dd.bvhMemory.size();
-      dd.memFinal = dd.bvhMemory.size();
+                              traversable,
+                              (CUdeviceptr)bvhMemory.get(),
+                              bvhMemory.size(),
+                              &traversable));
+      dd.memPeak += bvhMemory.size();
+      dd.memFinal += bvhMemory.size();
     }
     CUDA_SYNC_CHECK();
       
@@ -306,8 +538,6 @@ namespace owl {
     tempBuffer.free();
     if (FULL_REBUILD)
       compactedSizeBuffer.free();
-
-    LOG_OK("successfully build triangles geom group accel");
   }
   
 } // ::owl
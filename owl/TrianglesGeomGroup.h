@@ -33,12 +33,38 @@ namespace owl {
     void refitAccel() override;
 
     /*! (re-)compute the Group::bounds[2] information for motion blur
-      - ie, our _parent_ node may need this */
-    void updateMotionBounds();
+      - ie, our _parent_ node may need this. Meshes' bounds are
+      cached unless 'forceRecompute' is set */
+    void updateMotionBounds(bool forceRecompute = false);
+
+    /*! computes the key under which this group's accel gets stored
+        in the context's accel cache; this hashes all vertex and index
+        data (as currently on the first device), plus everything else
+        that affects the build */
+    uint64_t computeAccelCacheKey();
+
+    /*! computes the key under which this group's accel gets shared
+        with other groups (\see Context::enableAccelDedup), from its
+        vertex and index data as currently on the first device; also
+        returns the size of that data. Each geom's part of the key
+        gets cached, so only buffers that changed since the last
+        build (or whose changes can't be tracked) get downloaded */
+    uint64_t computeDedupKey(size_t &bufferBytes);
 
     /*! low-level accel structure builder for given device */
     template<bool FULL_REBUILD>
     void buildAccelOn(const DeviceContext::SP &device);
+
+    /*! builds (or refits) a single (compacted) accel over the
+        [primBegin,primEnd) range of this group's triangles (counted
+        across all geometries, in order) into the given memory and
+        traversable */
+    template<bool FULL_REBUILD>
+    void buildChunkOn(const DeviceContext::SP &device,
+                      size_t primBegin,
+                      size_t primEnd,
+                      DeviceMemory &bvhMemory,
+                      OptixTraversableHandle &traversable);
   };
 
 } // ::owl
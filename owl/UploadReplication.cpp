@@ -0,0 +1,156 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "UploadReplication.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace owl {
+
+  void DeviceTopology::resize(int numDevices)
+  {
+    hostDistance.assign(numDevices,0);
+    links.assign(size_t(numDevices)*numDevices,PEER_LINK_NONE);
+  }
+  
+  int ReplicationPlan::numHostUploads() const
+  {
+    int count = 0;
+    for (auto &step : steps)
+      if (step.source < 0)
+        count++;
+    return count;
+  }
+
+  /*! marks all devices reachable from 'device' over peer links */
+  static void markReachable(const DeviceTopology &topology,
+                            int device,
+                            std::vector<bool> &reachable)
+  {
+    if (reachable[device])
+      return;
+    reachable[device] = true;
+    for (int other=0;other<topology.numDevices();other++)
+      if (topology.getLink(device,other) != PEER_LINK_NONE)
+        markReachable(topology,other,reachable);
+  }
+  
+  ReplicationPlan planReplication(const DeviceTopology &topology)
+  {
+    const int numDevices = topology.numDevices();
+    ReplicationPlan plan;
+    if (numDevices == 0)
+      return plan;
+
+    // ------------------------------------------------------------------
+    // first round: upload from the host to the nearest device, plus
+    // to the nearest one of each set of devices that device cannot
+    // reach over peer links
+    // ------------------------------------------------------------------
+    std::vector<int> numNVLinkPeers(numDevices,0);
+    for (int i=0;i<numDevices;i++)
+      for (int j=0;j<numDevices;j++)
+        if (i != j && topology.getLink(i,j) == PEER_LINK_NVLINK)
+          numNVLinkPeers[i]++;
+    auto nearer = [&](int a, int b) {
+      if (topology.hostDistance[a] != topology.hostDistance[b])
+        return topology.hostDistance[a] < topology.hostDistance[b];
+      if (numNVLinkPeers[a] != numNVLinkPeers[b])
+        return numNVLinkPeers[a] > numNVLinkPeers[b];
+      return a < b;
+    };
+    
+    std::vector<bool> reachable(numDevices,false);
+    std::vector<bool> hasData(numDevices,false);
+    while (true) {
+      int root = -1;
+      for (int i=0;i<numDevices;i++)
+        if (!reachable[i] && (root < 0 || nearer(i,root)))
+          root = i;
+      if (root < 0)
+        break;
+      markReachable(topology,root,reachable);
+      plan.steps.push_back({-1,root,PEER_LINK_NONE,0});
+      hasData[root] = true;
+    }
+    plan.numRounds = 1;
+
+    // ------------------------------------------------------------------
+    // then pass it on: in each round, every device that has the data
+    // sends it to at most one other device. PCIe copies are slow, so
+    // they only go to NVLink "islands" that have nothing yet (and get
+    // spread within those over NVLink) - unless there is nothing
+    // else left to do
+    // ------------------------------------------------------------------
+    std::vector<int> islandOf(numDevices);
+    for (int i=0;i<numDevices;i++)
+      islandOf[i] = i;
+    for (bool changed=true;changed;) {
+      changed = false;
+      for (int i=0;i<numDevices;i++)
+        for (int j=0;j<numDevices;j++)
+          if (topology.getLink(i,j) == PEER_LINK_NVLINK
+              && islandOf[i] != islandOf[j]) {
+            islandOf[i] = islandOf[j] = std::min(islandOf[i],islandOf[j]);
+            changed = true;
+          }
+    }
+    
+    int numMissing = numDevices - plan.numHostUploads();
+    while (numMissing > 0) {
+      const int round = plan.numRounds++;
+      std::vector<bool> isSending(numDevices,false);
+      std::vector<bool> isReceiving(numDevices,false);
+      std::vector<bool> islandSeeded(numDevices,false);
+      for (int i=0;i<numDevices;i++)
+        if (hasData[i])
+          islandSeeded[islandOf[i]] = true;
+      int numReceived = 0;
+      auto assign = [&](PeerLink link, bool onlyUnseededIslands) {
+        for (int target=0;target<numDevices;target++) {
+          if (hasData[target] || isReceiving[target]
+              || (onlyUnseededIslands && islandSeeded[islandOf[target]]))
+            continue;
+          for (int source=0;source<numDevices;source++) {
+            if (!hasData[source] || isSending[source]
+                || topology.getLink(source,target) != link)
+              continue;
+            isSending[source]   = true;
+            isReceiving[target] = true;
+            islandSeeded[islandOf[target]] = true;
+            plan.steps.push_back({source,target,link,round});
+            numReceived++;
+            break;
+          }
+        }
+      };
+      assign(PEER_LINK_PCIE,true);
+      assign(PEER_LINK_NVLINK,false);
+      if (numReceived == 0)
+        assign(PEER_LINK_PCIE,false);
+      if (numReceived == 0)
+        throw std::runtime_error("upload replication: could not reach all devices");
+      
+      for (int target=0;target<numDevices;target++)
+        if (isReceiving[target])
+          hasData[target] = true;
+      numMissing -= numReceived;
+    }
+    return plan;
+  }
+
+} // ::owl
@@ -0,0 +1,114 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "owl/common.h"
+#include <vector>
+
+/*! \file UploadReplication.h - planning how to get the same host
+    data onto all devices of a multi-GPU context: rather than pushing
+    it over PCIe once per device, upload it once (to the device
+    nearest to the host), and fan it out from there over NVLink/P2P
+    copies. Nothing in here depends on cuda, so plans can be computed
+    (and tested) for any made-up topology. */
+
+namespace owl {
+
+  /*! how directly one device can copy into another one's memory */
+  enum PeerLink : uint8_t {
+    /*! no peer access - copies would have to go through host memory */
+    PEER_LINK_NONE = 0,
+    /*! peer access over PCIe */
+    PEER_LINK_PCIE,
+    /*! peer access over NVLink */
+    PEER_LINK_NVLINK
+  };
+
+  /*! uploads smaller than this simply go to each device directly;
+      replicating them would only add latency */
+  const size_t minReplicatedUploadSize = size_t(1)<<20;
+
+  /*! replicated uploads get split into chunks of this size, so a
+      device can already pass on one chunk while receiving the next */
+  const size_t replicationChunkSize = size_t(4)<<20;
+
+  /*! what the upload planner needs to know about the devices of a
+      context */
+  struct DeviceTopology {
+    /*! sets up a topology of 'numDevices' devices, all equally near
+        to the host, and with no peer access between any of them */
+    void resize(int numDevices);
+    
+    int numDevices() const { return (int)hostDistance.size(); }
+
+    /*! how device 'source' can copy into device 'target' */
+    PeerLink getLink(int source, int target) const
+    { return links[source*numDevices()+target]; }
+    void setLink(int source, int target, PeerLink link)
+    { links[source*numDevices()+target] = link; }
+    
+    /*! relative cost of uploading from host memory to each device;
+        lower is nearer (eg, 0 for devices on the same NUMA node as
+        the host thread, and 1 for all others) */
+    std::vector<int> hostDistance;
+    
+  private:
+    /*! links[source*numDevices+target] */
+    std::vector<PeerLink> links;
+  };
+
+  /*! one copy of a replicated upload */
+  struct ReplicationStep {
+    /*! the device that the data gets copied from, or -1 for host
+        memory */
+    int      source;
+    int      target;
+    /*! what the copy goes over; PEER_LINK_NONE for host uploads */
+    PeerLink link;
+    /*! copies of the same round can all run at the same time; the
+        source of each got its data in an earlier round */
+    int      round;
+  };
+
+  /*! the copies it takes to get one host array onto all devices,
+      ordered such that every step's source device is the target of
+      an earlier step */
+  struct ReplicationPlan {
+    /*! number of devices that get their data straight from host
+        memory */
+    int numHostUploads() const;
+    
+    std::vector<ReplicationStep> steps;
+    int numRounds = 0;
+  };
+
+  /*! plans replicating host data to all devices of the given
+      topology: the data gets uploaded to the device nearest to the
+      host (preferring, among equally near ones, the one with the most
+      NVLink peers), and then gets passed on in rounds, with each
+      device that already has the data copying it to (at most) one
+      more device per round - so N fully connected devices take
+      1+log2(N) rounds. Each set of devices connected by NVLink only
+      gets one copy over PCIe, and spreads it over NVLink from there.
+      Devices that cannot be reached over peer links at all get their
+      own upload from the host, in the first round; without any peer
+      access, that's one upload per device, same as without
+      replication */
+  ReplicationPlan planReplication(const DeviceTopology &topology);
+
+} // ::owl
@@ -16,63 +16,17 @@
 
 #include "UserGeom.h"
 #include "Context.h"
+#include "BoundsReduction.h"
 
 namespace owl {
 
-#define LOG(message)                                    \
-  if (Context::logging())                               \
-    std::cout << "#owl(" << device->ID << "): "         \
-              << message                                \
-              << std::endl
+#define LOG(message)                                                    \
+  OWL_LOG_DEBUG(OWL_LOG_CATEGORY_BUILD,                                 \
+                "(device " << device->ID << ") " << message)
+#define LOG_OK(message)                                                 \
+  OWL_LOG_DEBUG(OWL_LOG_CATEGORY_BUILD,                                 \
+                "(device " << device->ID << ") " << message)
 
-#define LOG_OK(message)                                         \
-  if (Context::logging())                                       \
-    std::cout << OWL_TERMINAL_GREEN                             \
-              << "#owl(" << device->ID << "): "                 \
-              << message << OWL_TERMINAL_DEFAULT << std::endl
-
-  __device__ static float atomicMax(float* address, float val)
-  {
-    int* address_as_i = (int*) address;
-    int old = *address_as_i, assumed;
-    do {
-      assumed = old;
-      old = ::atomicCAS(address_as_i, assumed,
-                        __float_as_int(::fmaxf(val, __int_as_float(assumed))));
-    } while (assumed != old);
-    return __int_as_float(old);
-  }
-  
-  __device__ static float atomicMin(float* address, float val)
-  {
-    int* address_as_i = (int*) address;
-    int old = *address_as_i, assumed;
-    do {
-      assumed = old;
-      old = ::atomicCAS(address_as_i, assumed,
-                        __float_as_int(::fminf(val, __int_as_float(assumed))));
-    } while (assumed != old);
-    return __int_as_float(old);
-  }
-  
-  __global__ void computeBoundsOfPrimBounds(box3f *d_bounds,
-                                            const box3f *d_primBounds,
-                                            size_t count)
-  {
-    int tid = blockDim.x * blockIdx.x + threadIdx.x;
-    if (tid >= count) return;
-
-    box3f box = d_primBounds[tid];
-    if (!box.empty()) {
-      atomicMin(&d_bounds->lower.x,box.lower.x);
-      atomicMin(&d_bounds->lower.y,box.lower.y);
-      atomicMin(&d_bounds->lower.z,box.lower.z);
-      atomicMax(&d_bounds->upper.x,box.upper.x);
-      atomicMax(&d_bounds->upper.y,box.upper.y);
-      atomicMax(&d_bounds->upper.z,box.upper.z);
-    }
-  }
-                                          
   /*! construct a new device-data for this type */
   UserGeomType::DeviceData::DeviceData(const DeviceContext::SP &device)
     : GeomType::DeviceData(device)
@@ -100,32 +54,16 @@ namespace owl {
   std::string UserGeom::toString() const
   { return "UserGeom"; }
   
-  /*! call a cuda kernel that computes the bounds of the vertex
-      buffers. note we alwyas (and only) do this on the first GPU */
+  /*! reduces the per-primitive boxes (on the first GPU) to the
+      bounds of the entire geometry; empty boxes do not contribute */
   void UserGeom::computeBounds(box3f bounds[2])
   {
-    int numThreads = 1024;
-    int numBlocks = int((primCount + numThreads - 1) / numThreads);
-
     DeviceContext::SP device = context->getDevices()[0];
     SetActiveGPU forLifeTime(device);
 
-    DeviceMemory d_bounds;
-    d_bounds.alloc(sizeof(box3f));
-    bounds[0] = bounds[1] = box3f();
-    d_bounds.upload(bounds);
-
-    DeviceData &dd = getDD(device);
-    
-    computeBoundsOfPrimBounds<<<numBlocks,numThreads>>>
-      (((box3f*)d_bounds.get())+0,
-       (box3f *)dd.internalBufferForBoundsProgram.get(),
-       primCount);
-    CUDA_SYNC_CHECK();
-    d_bounds.download(&bounds[0]);
-    d_bounds.free();
-    CUDA_SYNC_CHECK();
-    bounds[1] = bounds[0];
+    BoxArrayFetcher fetcher;
+    fetcher.boxes = getBoundsPointer(device);
+    bounds[0] = bounds[1] = reduceBoundsOnDevice(primCount,fetcher);
   }
 
   UserGeomType::UserGeomType(Context *const context,
@@ -149,6 +87,28 @@ namespace owl {
     primCount = count;
   }
 
+  void UserGeom::setBoundsBuffer(Buffer::SP buffer)
+  {
+    boundsBuffer = buffer;
+  }
+
+  const box3f *UserGeom::getBoundsPointer(const DeviceContext::SP &device)
+  {
+    if (!boundsBuffer) {
+      DeviceData &dd = getDD(device);
+      assert("user geom has valid bounds buffer"
+             && dd.internalBufferForBoundsProgram.alloced());
+      return (const box3f *)dd.internalBufferForBoundsProgram.get();
+    }
+    
+    if (boundsBuffer->sizeInBytes() < primCount*sizeof(box3f))
+      throw std::runtime_error("user geom's bounds buffer ("
+                               +std::to_string(boundsBuffer->sizeInBytes())
+                               +" bytes) is too small for its "
+                               +std::to_string(primCount)+" prims");
+    return (const box3f *)boundsBuffer->getPointer(device);
+  }
+
   /*! set intersection program to run for this type and given ray type */
   void UserGeomType::setIntersectProg(int rayType,
                                       Module::SP module,
@@ -171,6 +131,10 @@ namespace owl {
   /*! run the bounding box program for all primitives within this geometry */
   void UserGeom::executeBoundsProgOnPrimitives(const DeviceContext::SP &device)
   {
+    if (boundsBuffer)
+      // app gave us the bounds, nothing to do
+      return;
+    
     SetActiveGPU activeGPU(device);
       
     std::vector<uint8_t> userGeomData(geomType->varStructSize);
@@ -250,45 +214,43 @@ namespace owl {
     }
   }
   
-  /*! build the CUDA bounds program kernel (if bounds prog is set) */
-  void UserGeomType::buildBoundsProg()
+  /*! build the CUDA bounds program kernel (if bounds prog is set)
+      on the given device; this is also what triggers building the
+      bounds program's (cuda) module on that device */
+  void UserGeomType::buildBoundsProg(const DeviceContext::SP &device)
   {
     if (!boundsProg.module) return;
     
     Module::SP module = boundsProg.module;
     assert(module);
 
-    for (auto device : context->getDevices()) {
-      LOG("building bounds function ....");
-      SetActiveGPU forLifeTime(device);
-      auto &typeDD = getDD(device);
-      auto &moduleDD = module->getDD(device);
+    LOG("building bounds function ....");
+    SetActiveGPU forLifeTime(device);
+    auto &typeDD = getDD(device);
+    auto &moduleDD = module->getDD(device);
       
-      assert(moduleDD.boundsModule);
-
-      const std::string annotatedProgName
-        = std::string("__boundsFuncKernel__")
-        + boundsProg.progName;
+    const std::string annotatedProgName
+      = std::string("__boundsFuncKernel__")
+      + boundsProg.progName;
     
-      CUresult rc = cuModuleGetFunction(&typeDD.boundsFuncKernel,
-                                        moduleDD.boundsModule,
-                                        annotatedProgName.c_str());
+    CUresult rc = cuModuleGetFunction(&typeDD.boundsFuncKernel,
+                                      moduleDD.getBoundsModule(),
+                                      annotatedProgName.c_str());
       
-      switch(rc) {
-      case CUDA_SUCCESS:
-        /* all OK, nothing to do */
-        LOG_OK("found bounds function " << annotatedProgName << " ... perfect!");
-        break;
-      case CUDA_ERROR_NOT_FOUND:
-        throw std::runtime_error("in "+std::string(__PRETTY_FUNCTION__)
-                                 +": could not find OPTIX_BOUNDS_PROGRAM("
-                                 +boundsProg.progName+")");
-      default:
-        const char *errName = 0;
-        cuGetErrorName(rc,&errName);
-        throw std::runtime_error("unknown CUDA error when building bounds program kernel"
-                                 +std::string(errName));
-      }
+    switch(rc) {
+    case CUDA_SUCCESS:
+      /* all OK, nothing to do */
+      LOG_OK("found bounds function " << annotatedProgName << " ... perfect!");
+      break;
+    case CUDA_ERROR_NOT_FOUND:
+      throw std::runtime_error("in "+std::string(__PRETTY_FUNCTION__)
+                               +": could not find OPTIX_BOUNDS_PROGRAM("
+                               +boundsProg.progName+")");
+    default:
+      const char *errName = 0;
+      cuGetErrorName(rc,&errName);
+      throw std::runtime_error("unknown CUDA error when building bounds program kernel"
+                               +std::string(errName));
     }
   }
 
@@ -63,8 +63,9 @@ namespace owl {
     void setBoundsProg(Module::SP module,
                        const std::string &progName);
 
-    /*! build the CUDA bounds program kernel (if bounds prog is set) */
-    void buildBoundsProg();
+    /*! build the CUDA bounds program kernel (if bounds prog is set)
+        on the given device */
+    void buildBoundsProg(const DeviceContext::SP &device);
 
     /*! pretty-printer, for printf-debugging */
     std::string toString() const override;
@@ -127,17 +128,32 @@ namespace owl {
 
     /*! set number of primitives that this geom will contain */
     void setPrimCount(size_t count);
+
+    /*! use the given buffer of box3f's as this geom's primitive
+        bounds, rather than running the bounds program; a null buffer
+        reverts to the bounds program */
+    void setBoundsBuffer(Buffer::SP buffer);
+
+    /*! device pointer to the primitive bounds that the accel builder
+        uses - either the app-supplied bounds buffer, or the bounds
+        program's output; may only get called after bounds progs have
+        been executed */
+    const box3f *getBoundsPointer(const DeviceContext::SP &device);
     
-    /*! call a cuda kernel that computes the bounds *across* all
+    /*! run a cuda reduction that computes the bounds *across* all
       primitives within this group; may only get caleld after bound
       progs have been executed */
     void computeBounds(box3f bounds[2]);
 
-    /*! run the bounding box program for all primitives within this geometry */
+    /*! run the bounding box program for all primitives within this
+        geometry; a no-op if the app supplied a bounds buffer */
     void executeBoundsProgOnPrimitives(const DeviceContext::SP &device);
 
     /*! number of prims that this geom will contain */
     size_t primCount = 0;
+
+    /*! app-supplied primitive bounds, if any */
+    Buffer::SP boundsBuffer;
   };
 
 
@@ -17,17 +17,12 @@
 #include "UserGeomGroup.h"
 #include "Context.h"
 
-#define LOG(message)                                            \
-  if (Context::logging())                                       \
-    std::cout << "#owl(" << device->ID << "): "                 \
-              << message                                        \
-              << std::endl
-
-#define LOG_OK(message)                                         \
-  if (Context::logging())                                       \
-    std::cout << OWL_TERMINAL_GREEN                             \
-              << "#owl(" << device->ID << "): "                 \
-              << message << OWL_TERMINAL_DEFAULT << std::endl
+#define LOG(message)                                                    \
+  OWL_LOG_DEBUG(OWL_LOG_CATEGORY_ACCEL,                                 \
+                "(device " << device->ID << ") " << message)
+#define LOG_OK(message)                                                 \
+  OWL_LOG_DEBUG(OWL_LOG_CATEGORY_ACCEL,                                 \
+                "(device " << device->ID << ") " << message)
 
 namespace owl {
   
@@ -36,20 +31,77 @@ namespace owl {
     : GeomGroup(context,numChildren)
   {}
 
-  void UserGeomGroup::buildOrRefit(bool FULL_REBUILD)
+  /*! build flags for all user geom accels */
+  const uint32_t userGeomAccelBuildFlags =
+    // OPTIX_BUILD_FLAG_PREFER_FAST_BUILD
+    OPTIX_BUILD_FLAG_ALLOW_UPDATE
+    |
+    OPTIX_BUILD_FLAG_PREFER_FAST_TRACE
+    ;
+  
+  uint64_t UserGeomGroup::computeAccelCacheKey()
   {
+    const DeviceContext::SP first = context->getDevice(0);
+    ContentHasher hasher = accelCacheHasher();
+    hasher
+      .add(std::string("user"))
+      .add(userGeomAccelBuildFlags)
+      .add(geometries.size());
     for (auto child : geometries) {
       UserGeom::SP userGeom = child->as<UserGeom>();
       assert(userGeom);
-      for (auto device : context->getDevices())
+      hasher.add(userGeom->primCount);
+      hashDeviceData(hasher,
+                     userGeom->getBoundsPointer(first),
+                     userGeom->primCount*sizeof(box3f));
+    }
+    return hasher.get();
+  }
+  
+  void UserGeomGroup::buildOrRefit(bool FULL_REBUILD)
+  {
+    auto runBoundsProgs = [&](const DeviceContext::SP &device) {
+      for (auto child : geometries) {
+        UserGeom::SP userGeom = child->as<UserGeom>();
+        assert(userGeom);
         userGeom->executeBoundsProgOnPrimitives(device);
+      }
+    };
+    
+    if (!FULL_REBUILD || !context->accelCache) {
+      // note that devices that get the accel relocated from the first
+      // device don't need to run the bounds programs, either
+      buildOnAllDevices([&](const DeviceContext::SP &device) {
+          runBoundsProgs(device);
+          if (FULL_REBUILD)
+            buildAccelOn<true>(device);
+          else
+            buildAccelOn<false>(device);
+        });
+      return;
     }
+
+    // with an accel cache, the key depends on the bounds, so we
+    // have to run the bounds programs on the first device first
+    const DeviceContext::SP first = context->getDevice(0);
+    {
+      SetActiveGPU forLifeTime(first);
+      runBoundsProgs(first);
+    }
+    buildOnAllDevicesCached(computeAccelCacheKey(),
+                            [&](const DeviceContext::SP &device) {
+                              if (device != first)
+                                runBoundsProgs(device);
+                              buildAccelOn<true>(device);
+                            });
     
-    for (auto device : context->getDevices())
-      if (FULL_REBUILD)
-        buildAccelOn<true>(device);
-      else
-        buildAccelOn<false>(device);
+    // the builder releases the bounds buffers once it's done with
+    // them; on a cache hit it never ran, so do that here
+    for (auto child : geometries) {
+      UserGeom::DeviceData &ugDD = child->as<UserGeom>()->getDD(first);
+      if (ugDD.internalBufferForBoundsProgram.alloced())
+        ugDD.internalBufferForBoundsProgram.free();
+    }
   }
   
   void UserGeomGroup::buildAccel()
@@ -66,8 +118,8 @@ namespace owl {
   template<bool FULL_REBUILD>
   void UserGeomGroup::buildAccelOn(const DeviceContext::SP &device)
   {
+    TraceScope trace(FULL_REBUILD ? "buildAccel" : "refitAccel","accel",device->ID);
     DeviceData &dd = getDD(device);
-    auto optixContext = device->optixContext;
 
     if (FULL_REBUILD && !dd.bvhMemory.empty())
       dd.bvhMemory.free();
@@ -96,6 +148,61 @@ namespace owl {
        OPTIX_DEVICE_PROPERTY_LIMIT_MAX_PRIMITIVES_PER_GAS,
        &maxPrimsPerGAS,
        sizeof(maxPrimsPerGAS));
+    for (auto child : geometries)
+      sumPrims += child->as<UserGeom>()->primCount;
+
+    if (sumPrims <= maxPrimsPerGAS) {
+      setNumChunksOn(device,0,FULL_REBUILD);
+      buildChunkOn<FULL_REBUILD>(device,0,sumPrims,
+                                 dd.bvhMemory,dd.traversable);
+    } else {
+      if (!context->accelSplittingEnabled)
+        throw std::runtime_error("number of prims in user geom group "
+                                 "exceeds OptiX's MAX_PRIMITIVES_PER_GAS "
+                                 "limit (see owlEnableAccelSplitting())");
+      const std::vector<std::pair<size_t,size_t>> chunks
+        = computeChunkRanges(sumPrims,maxPrimsPerGAS);
+      LOG("splitting " << prettyNumber(sumPrims) << " prims into "
+          << chunks.size() << " chunks");
+      setNumChunksOn(device,chunks.size(),FULL_REBUILD);
+      for (size_t chunkID=0;chunkID<chunks.size();chunkID++)
+        buildChunkOn<FULL_REBUILD>(device,
+                                   chunks[chunkID].first,
+                                   chunks[chunkID].second,
+                                   *dd.chunkMemory[chunkID],
+                                   dd.chunkTraversables[chunkID]);
+      buildChunkInstanceAccelOn(device,FULL_REBUILD);
+    }
+
+    LOG_OK("successfully built user geom group accel");
+
+    // size_t sumPrims = 0;
+    size_t sumBoundsMem = 0;
+    for (size_t childID=0;childID<geometries.size();childID++) {
+      UserGeom::SP child = geometries[childID]->as<UserGeom>();
+      assert(child);
+      
+      UserGeom::DeviceData &ugDD = child->getDD(device);
+      
+      sumBoundsMem += ugDD.internalBufferForBoundsProgram.sizeInBytes;
+      if (ugDD.internalBufferForBoundsProgram.alloced())
+        ugDD.internalBufferForBoundsProgram.free();
+    }
+    if (FULL_REBUILD)
+      dd.memPeak += sumBoundsMem;
+
+    CUDA_SYNC_CHECK();
+  }
+    
+  template<bool FULL_REBUILD>
+  void UserGeomGroup::buildChunkOn(const DeviceContext::SP &device,
+                                   size_t primBegin,
+                                   size_t primEnd,
+                                   DeviceMemory &bvhMemory,
+                                   OptixTraversableHandle &traversable)
+  {
+    DeviceData &dd = getDD(device);
+    auto optixContext = device->optixContext;
     
     // ==================================================================
     // create triangle inputs
@@ -109,26 +216,27 @@ namespace owl {
     // for now we use the same flags for all geoms
     std::vector<uint32_t> userGeomInputFlags(geometries.size());
 
-    // now go over all geometries to set up the buildinputs
+    // now go over all geometries to set up the buildinputs. Note that
+    // even if this is only a chunk of the group's prims we always
+    // need one build input per geometry (even if empty), so the SBT
+    // layout stays the same for all chunks
+    size_t geomBegin = 0;
     for (size_t childID=0;childID<geometries.size();childID++) {
       // the three fields we're setting:
 
       UserGeom::SP child = geometries[childID]->as<UserGeom>();
       assert(child);
 
-      sumPrims += child->primCount;
-      if (sumPrims > maxPrimsPerGAS) 
-        throw std::runtime_error("number of prim in user geom group exceeds "
-                                 "OptiX's MAX_PRIMITIVES_PER_GAS limit");
+      // the range of this geom's prims that is in this chunk
+      const size_t geomEnd = geomBegin + child->primCount;
+      const size_t begin   = std::min(std::max(primBegin,geomBegin),geomEnd) - geomBegin;
+      const size_t end     = std::min(std::max(primEnd,  geomBegin),geomEnd) - geomBegin;
+      geomBegin = geomEnd;
 
-      UserGeom::DeviceData &ugDD = child->getDD(device);
-      
       CUdeviceptr     &d_bounds = boundsPointers[childID];
       OptixBuildInput &userGeomInput = userGeomInputs[childID];
 
-      assert("user geom has valid bounds buffer"
-             && ugDD.internalBufferForBoundsProgram.alloced());
-      d_bounds = (CUdeviceptr)ugDD.internalBufferForBoundsProgram.get();
+      d_bounds = (CUdeviceptr)(child->getBoundsPointer(device) + begin);
       
       userGeomInput.type = OPTIX_BUILD_INPUT_TYPE_CUSTOM_PRIMITIVES;
 #if OPTIX_VERSION >= 70100
@@ -137,9 +245,10 @@ namespace owl {
       auto &aa = userGeomInput.aabbArray;
 #endif
       aa.aabbBuffers   = &d_bounds;
-      aa.numPrimitives = (uint32_t)child->primCount;
+      aa.numPrimitives = (uint32_t)(end-begin);
       aa.strideInBytes = sizeof(box3f);
-      aa.primitiveIndexOffset = 0;
+      // keeps optixGetPrimitiveIndex() relative to the whole geom
+      aa.primitiveIndexOffset = (uint32_t)begin;
       
       // we always have exactly one SBT entry per shape (i.e., triangle
       // mesh), and no per-primitive materials:
@@ -164,12 +273,7 @@ namespace owl {
     // first: compute temp memory for bvh
     // ------------------------------------------------------------------
     OptixAccelBuildOptions accelOptions = {};
-    accelOptions.buildFlags             =
-      // OPTIX_BUILD_FLAG_PREFER_FAST_BUILD
-      OPTIX_BUILD_FLAG_ALLOW_UPDATE
-      |
-      OPTIX_BUILD_FLAG_PREFER_FAST_TRACE
-      ;
+    accelOptions.buildFlags             = userGeomAccelBuildFlags;
     accelOptions.motionOptions.numKeys  = 1;
     if (FULL_REBUILD)
       accelOptions.operation            = OPTIX_BUILD_OPERATION_BUILD;
@@ -201,27 +305,31 @@ namespace owl {
     if (FULL_REBUILD) {
       dd.memPeak += tempBuffer.size();
       // alloc only on first rebuild
-      dd.bvhMemory.alloc(blasBufferSizes.outputSizeInBytes);
-      dd.memPeak += dd.bvhMemory.size();
-      dd.memFinal = dd.bvhMemory.size();
+      bvhMemory.alloc(blasBufferSizes.outputSizeInBytes);
+      dd.memPeak += bvhMemory.size();
+      dd.memFinal += bvhMemory.size();
+    }
+    {
+      GpuTimings::Scope timeBuild(device->timings,OWL_TIMING_ACCEL_BUILD,
+                                  /* todo: stream */0);
+      OPTIX_CHECK(optixAccelBuild(optixContext,
+                                  /* todo: stream */0,
+                                  &accelOptions,
+                                  // array of build inputs:
+                                  userGeomInputs.data(),
+                                  (uint32_t)userGeomInputs.size(),
+                                  // buffer of temp memory:
+                                  (CUdeviceptr)tempBuffer.get(),
+                                  tempBuffer.size(),
+                                  // where we store initial, uncomp bvh:
+                                  (CUdeviceptr)bvhMemory.get(),
+                                  bvhMemory.size(),
+                                  /* the traversable we're building: */ 
+                                  &traversable,
+                                  /* we're also querying compacted size: */
+                                  nullptr,0u
+                                  ));
     }
-    OPTIX_CHECK(optixAccelBuild(optixContext,
-                                /* todo: stream */0,
-                                &accelOptions,
-                                // array of build inputs:
-                                userGeomInputs.data(),
-                                (uint32_t)userGeomInputs.size(),
-                                // buffer of temp memory:
-                                (CUdeviceptr)tempBuffer.get(),
-                                tempBuffer.size(),
-                                // where we store initial, uncomp bvh:
-                                (CUdeviceptr)dd.bvhMemory.get(),
-                                dd.bvhMemory.size(),
-                                /* the dd.traversable we're building: */ 
-                                &dd.traversable,
-                                /* we're also querying compacted size: */
-                                nullptr,0u
-                                ));
       
     CUDA_SYNC_CHECK();
 
@@ -230,25 +338,6 @@ namespace owl {
     // ==================================================================
 
     tempBuffer.free();
-
-    LOG_OK("successfully built user geom group accel");
-
-    // size_t sumPrims = 0;
-    size_t sumBoundsMem = 0;
-    for (size_t childID=0;childID<geometries.size();childID++) {
-      UserGeom::SP child = geometries[childID]->as<UserGeom>();
-      assert(child);
-      
-      UserGeom::DeviceData &ugDD = child->getDD(device);
-      
-      sumBoundsMem += ugDD.internalBufferForBoundsProgram.sizeInBytes;
-      if (ugDD.internalBufferForBoundsProgram.alloced())
-        ugDD.internalBufferForBoundsProgram.free();
-    }
-    if (FULL_REBUILD)
-      dd.memPeak += sumBoundsMem;
-
-    CUDA_SYNC_CHECK();
   }
-    
+
 } // ::owl
@@ -34,12 +34,28 @@ namespace owl {
         build vs refit */
     void buildOrRefit(bool FULL_REBUILD);
     
+    /*! computes the key under which this group's accel gets stored
+        in the context's accel cache; this hashes the primitive
+        bounds, so requires the bounds programs to have been run on
+        the first device */
+    uint64_t computeAccelCacheKey();
+    
     void buildAccel() override;
     void refitAccel() override;
 
     /*! low-level accel structure builder for given device */
     template<bool FULL_REBUILD>
     void buildAccelOn(const DeviceContext::SP &device);
+
+    /*! builds (or refits) a single accel over the [primBegin,primEnd)
+        range of this group's prims (counted across all geometries,
+        in order) into the given memory and traversable */
+    template<bool FULL_REBUILD>
+    void buildChunkOn(const DeviceContext::SP &device,
+                      size_t primBegin,
+                      size_t primEnd,
+                      DeviceMemory &bvhMemory,
+                      OptixTraversableHandle &traversable);
   };
 
 } // ::owl
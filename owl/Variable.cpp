@@ -165,6 +165,7 @@ namespace owl {
     void setRaw(const void *ptr) override
     {
       memcpy(data.data(),ptr,data.size());
+      version++;
     }
 
     /*! writes the device specific representation of the given type */
@@ -187,7 +188,7 @@ namespace owl {
       : Variable(varDecl)
     {}
     
-    void set(const T &value) override { this->value = value; }
+    void set(const T &value) override { this->value = value; version++; }
 
     /*! writes the device specific representation of the given type */
     void writeToSBT(uint8_t *sbtEntry,
@@ -207,7 +208,16 @@ namespace owl {
     BufferPointerVariable(const OWLVarDecl *const varDecl)
       : Variable(varDecl)
     {}
-    void set(const Buffer::SP &value) override { this->buffer = value; }
+    void set(const Buffer::SP &value) override
+    {
+      // device programs can now write to it
+      if (value) value->pointerExposed = true;
+      this->buffer = value;
+      version++;
+    }
+
+    /*! the buffer's pointer and size change when it gets resized */
+    bool refersToObject() const override { return true; }
 
     /*! writes the device specific representation of the given type */
     void writeToSBT(uint8_t *sbtEntry,
@@ -231,7 +241,9 @@ namespace owl {
     BufferSizeVariable(const OWLVarDecl *const varDecl)
       : Variable(varDecl)
     {}
-    void set(const Buffer::SP &value) override { this->buffer = value; }
+    void set(const Buffer::SP &value) override { this->buffer = value; version++; }
+
+    bool refersToObject() const override { return true; }
 
     /*! writes the device specific representation of the given type */
     void writeToSBT(uint8_t *sbtEntry,
@@ -255,7 +267,7 @@ namespace owl {
     BufferIDVariable(const OWLVarDecl *const varDecl)
       : Variable(varDecl)
     {}
-    void set(const Buffer::SP &value) override { this->buffer = value; }
+    void set(const Buffer::SP &value) override { this->buffer = value; version++; }
 
     /*! writes the device specific representation of the given type */
     void writeToSBT(uint8_t *sbtEntry,
@@ -303,7 +315,15 @@ namespace owl {
     BufferVariable(const OWLVarDecl *const varDecl)
       : Variable(varDecl)
     {}
-    void set(const Buffer::SP &value) override { this->buffer = value; }
+    void set(const Buffer::SP &value) override
+    {
+      // device programs can now write to it
+      if (value) value->pointerExposed = true;
+      this->buffer = value;
+      version++;
+    }
+
+    bool refersToObject() const override { return true; }
 
     /*! writes the device specific representation of the given type */
     void writeToSBT(uint8_t *sbtEntry,
@@ -338,8 +358,12 @@ namespace owl {
       if (value && !std::dynamic_pointer_cast<InstanceGroup>(value))
         throw std::runtime_error("OWL currently supports only instance groups to be passed to traversal; if you do want to trace rays into a single User or Triangle group, please put them into a single 'dummy' instance with jsut this one child and a identity transform");
       this->group = value;
+      version++;
     }
 
+    /*! the traversable changes whenever the group gets rebuilt */
+    bool refersToObject() const override { return true; }
+
     /*! writes the device specific representation of the given type */
     void writeToSBT(uint8_t *sbtEntry,
                     const DeviceContext::SP &device) const override
@@ -367,8 +391,11 @@ namespace owl {
     void set(const Texture::SP &value) override
     {
       this->texture = value;
+      version++;
     }
 
+    bool refersToObject() const override { return true; }
+
     /*! writes the device specific representation of the given type */
     void writeToSBT(uint8_t *sbtEntry,
                     const DeviceContext::SP &device) const override
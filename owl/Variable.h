@@ -143,8 +143,17 @@ namespace owl {
         that the user passes */
     static Variable::SP createInstanceOf(const OWLVarDecl *decl);
     
+    /*! whether what this variable writes into the SBT can change
+        without the variable itself getting set, because it's derived
+        from another object (eg, a buffer's device pointer) */
+    virtual bool refersToObject() const { return false; }
+    
     /*! the variable we're setting in the given object */
     const OWLVarDecl *const varDecl;
+
+    /*! bumped every time this variable gets set, so whoever wrote it
+        can tell if it has to get re-written */
+    size_t version = 0;
   };
   
 } // ::owl
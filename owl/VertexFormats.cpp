@@ -0,0 +1,348 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "VertexFormats.h"
+#include "owl/common/parallel/parallel_for.h"
+#include <atomic>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define OWL_HAVE_SSE2 1
+# include <emmintrin.h>
+#endif
+#if defined(__F16C__)
+# define OWL_HAVE_F16C 1
+# define OWL_TARGET_F16C
+# include <immintrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+// not enabled for the whole build, but we can still compile this one
+// function for f16c, and pick it at runtime
+# define OWL_HAVE_F16C 1
+# define OWL_F16C_RUNTIME_CHECK 1
+# define OWL_TARGET_F16C __attribute__((target("f16c")))
+# include <immintrin.h>
+#endif
+
+namespace owl {
+
+  /*! how many vertices (or triangles) a single parallel task
+      converts; small arrays are done serially */
+  const size_t vertexConversionBlockSize = 64*1024;
+
+  OWLVertexFormat vertexFormatFor(OWLDataType bufferType)
+  {
+    switch (bufferType) {
+    case OWL_FLOAT2:
+      return OWL_VERTEX_FORMAT_FLOAT2;
+    case OWL_HALF3:
+      return OWL_VERTEX_FORMAT_HALF3;
+    case OWL_HALF2:
+      return OWL_VERTEX_FORMAT_HALF2;
+    case OWL_SHORT3:
+      return OWL_VERTEX_FORMAT_SNORM16_3;
+    case OWL_SHORT2:
+      return OWL_VERTEX_FORMAT_SNORM16_2;
+    default:
+      // float3, float4 (with a stride of 16), and user types
+      return OWL_VERTEX_FORMAT_FLOAT3;
+    }
+  }
+
+  OWLIndexFormat indexFormatFor(OWLDataType bufferType)
+  {
+    switch (bufferType) {
+    case OWL_USHORT3:
+    case OWL_SHORT3:
+      return OWL_INDEX_FORMAT_USHORT3;
+    default:
+      return OWL_INDEX_FORMAT_UINT3;
+    }
+  }
+  
+  size_t vertexComponentSizeOf(OWLVertexFormat format)
+  {
+    switch (format) {
+    case OWL_VERTEX_FORMAT_FLOAT3:
+    case OWL_VERTEX_FORMAT_FLOAT2:
+      return sizeof(float);
+    case OWL_VERTEX_FORMAT_HALF3:
+    case OWL_VERTEX_FORMAT_HALF2:
+    case OWL_VERTEX_FORMAT_SNORM16_3:
+    case OWL_VERTEX_FORMAT_SNORM16_2:
+      return sizeof(uint16_t);
+    default:
+      throw std::runtime_error("invalid vertex format #"
+                               +std::to_string((int)format));
+    }
+  }
+
+  size_t vertexFormatSizeOf(OWLVertexFormat format)
+  {
+    switch (format) {
+    case OWL_VERTEX_FORMAT_FLOAT2:
+    case OWL_VERTEX_FORMAT_HALF2:
+    case OWL_VERTEX_FORMAT_SNORM16_2:
+      return 2*vertexComponentSizeOf(format);
+    default:
+      return 3*vertexComponentSizeOf(format);
+    }
+  }
+  
+  size_t indexComponentSizeOf(OWLIndexFormat format)
+  {
+    switch (format) {
+    case OWL_INDEX_FORMAT_UINT3:
+      return sizeof(uint32_t);
+    case OWL_INDEX_FORMAT_USHORT3:
+      return sizeof(uint16_t);
+    default:
+      throw std::runtime_error("invalid index format #"
+                               +std::to_string((int)format));
+    }
+  }
+
+  size_t indexFormatSizeOf(OWLIndexFormat format)
+  {
+    return 3*indexComponentSizeOf(format);
+  }
+  
+  std::string toString(OWLVertexFormat format)
+  {
+    switch (format) {
+    case OWL_VERTEX_FORMAT_FROM_BUFFER: return "(from buffer)";
+    case OWL_VERTEX_FORMAT_FLOAT3:      return "float3";
+    case OWL_VERTEX_FORMAT_FLOAT2:      return "float2";
+    case OWL_VERTEX_FORMAT_HALF3:       return "half3";
+    case OWL_VERTEX_FORMAT_HALF2:       return "half2";
+    case OWL_VERTEX_FORMAT_SNORM16_3:   return "snorm16_3";
+    case OWL_VERTEX_FORMAT_SNORM16_2:   return "snorm16_2";
+    default: return "(invalid vertex format)";
+    }
+  }
+
+  std::string toString(OWLIndexFormat format)
+  {
+    switch (format) {
+    case OWL_INDEX_FORMAT_FROM_BUFFER: return "(from buffer)";
+    case OWL_INDEX_FORMAT_UINT3:       return "uint3";
+    case OWL_INDEX_FORMAT_USHORT3:     return "ushort3";
+    default: return "(invalid index format)";
+    }
+  }
+  
+  uint16_t floatToHalf(float f)
+  {
+    union { float f; uint32_t u; } bits;
+    bits.f = f;
+    const uint16_t sign = uint16_t((bits.u >> 16) & 0x8000);
+    const uint32_t absBits = bits.u & 0x7fffffff;
+
+    if (absBits >= 0x7f800000)
+      // inf, or nan (which has to remain a nan)
+      return sign | 0x7c00 | (absBits > 0x7f800000 ? 0x200 : 0);
+    if (absBits >= 0x477ff000)
+      // too large, even after rounding: inf
+      return sign | 0x7c00;
+    if (absBits < 0x38800000) {
+      // denormal half (or zero): shift the mantissa (with implicit
+      // leading one) into place, rounding to nearest even
+      if (absBits < 0x33000000)
+        return sign;
+      const uint32_t exponent = absBits >> 23;
+      const uint32_t mantissa = (absBits & 0x7fffff) | 0x800000;
+      const uint32_t shift    = 126 - exponent;
+      uint32_t h = mantissa >> shift;
+      const uint32_t rest = mantissa & ((1u << shift)-1);
+      const uint32_t half = 1u << (shift-1);
+      if (rest > half || (rest == half && (h & 1)))
+        h++;
+      return sign | uint16_t(h);
+    }
+    // normal: re-bias exponent, round mantissa to nearest even (a
+    // carry correctly propagates into the exponent)
+    uint32_t h = (absBits - 0x38000000) >> 13;
+    const uint32_t rest = absBits & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (h & 1)))
+      h++;
+    return sign | uint16_t(h);
+  }
+
+#if OWL_HAVE_F16C
+  /*! converts the first multiple-of-4 of N floats to halfs, and
+      returns how many it converted */
+  OWL_TARGET_F16C
+  static size_t convertToHalfF16C(uint16_t *out, const float *in, size_t N)
+  {
+    size_t i = 0;
+    for (;i+4<=N;i+=4)
+      _mm_storel_epi64((__m128i*)(out+i),
+                       _mm_cvtps_ph(_mm_loadu_ps(in+i),
+                                    _MM_FROUND_TO_NEAREST_INT));
+    return i;
+  }
+#endif
+  
+  /*! converts N floats to N halfs */
+  static void convertToHalf(uint16_t *out, const float *in, size_t N)
+  {
+    size_t i = 0;
+#if OWL_F16C_RUNTIME_CHECK
+    static const bool haveF16C = __builtin_cpu_supports("f16c");
+    if (haveF16C)
+      i = convertToHalfF16C(out,in,N);
+#elif OWL_HAVE_F16C
+    i = convertToHalfF16C(out,in,N);
+#endif
+    for (;i<N;i++)
+      out[i] = floatToHalf(in[i]);
+  }
+
+  /*! converts N floats to N snorm16's */
+  static void convertToSnorm16(int16_t *out, const float *in, size_t N)
+  {
+    size_t i = 0;
+#if OWL_HAVE_SSE2
+    const __m128 lo    = _mm_set1_ps(-1.f);
+    const __m128 hi    = _mm_set1_ps(+1.f);
+    const __m128 scale = _mm_set1_ps(32767.f);
+    for (;i+8<=N;i+=8) {
+      // note _mm_cvtps_epi32 rounds to nearest even, whereas the
+      // scalar version rounds halfway cases away from zero; either is
+      // a valid snorm encoding
+      const __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in+i+0),lo),hi);
+      const __m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in+i+4),lo),hi);
+      const __m128i ia = _mm_cvtps_epi32(_mm_mul_ps(a,scale));
+      const __m128i ib = _mm_cvtps_epi32(_mm_mul_ps(b,scale));
+      _mm_storeu_si128((__m128i*)(out+i),_mm_packs_epi32(ia,ib));
+    }
+#endif
+    for (;i<N;i++)
+      out[i] = floatToSnorm16(in[i]);
+  }
+  
+  /*! converts N int32s to N uint16s; returns false if any of them
+      is out of range */
+  static bool convertToUShort(uint16_t *out, const int32_t *in, size_t N)
+  {
+    size_t i = 0;
+    bool inRange = true;
+#if OWL_HAVE_SSE2
+    const __m128i bias    = _mm_set1_epi32(32768);
+    const __m128i bias16  = _mm_set1_epi16((short)0x8000);
+    const __m128i maxIdx  = _mm_set1_epi32(65535);
+    const __m128i zero    = _mm_setzero_si128();
+    __m128i outOfRange    = _mm_setzero_si128();
+    for (;i+8<=N;i+=8) {
+      const __m128i a = _mm_loadu_si128((const __m128i*)(in+i+0));
+      const __m128i b = _mm_loadu_si128((const __m128i*)(in+i+4));
+      outOfRange = _mm_or_si128(outOfRange,_mm_cmplt_epi32(a,zero));
+      outOfRange = _mm_or_si128(outOfRange,_mm_cmplt_epi32(b,zero));
+      outOfRange = _mm_or_si128(outOfRange,_mm_cmpgt_epi32(a,maxIdx));
+      outOfRange = _mm_or_si128(outOfRange,_mm_cmpgt_epi32(b,maxIdx));
+      // there's no unsigned saturating pack in sse2, so shift into
+      // signed range, pack, and shift back
+      const __m128i packed = _mm_packs_epi32(_mm_sub_epi32(a,bias),
+                                             _mm_sub_epi32(b,bias));
+      _mm_storeu_si128((__m128i*)(out+i),_mm_xor_si128(packed,bias16));
+    }
+    inRange = _mm_movemask_epi8(outOfRange) == 0;
+#endif
+    for (;i<N;i++) {
+      inRange = inRange && (in[i] >= 0 && in[i] <= 65535);
+      out[i] = (uint16_t)in[i];
+    }
+    return inRange;
+  }
+  
+  void convertVertices(void *out,
+                       OWLVertexFormat format,
+                       const float *in,
+                       size_t numVertices)
+  {
+    const size_t outSize = vertexFormatSizeOf(format);
+    owl::common::parallel_for_blocked
+      (0,numVertices,vertexConversionBlockSize,
+       [&](size_t begin, size_t end) {
+        uint8_t     *blockOut = (uint8_t*)out + begin*outSize;
+        const float *blockIn  = in + 3*begin;
+        const size_t N        = end-begin;
+        switch (format) {
+        case OWL_VERTEX_FORMAT_FLOAT3:
+          memcpy(blockOut,blockIn,N*3*sizeof(float));
+          break;
+        case OWL_VERTEX_FORMAT_HALF3:
+          // input and output are both densely packed, so this is just
+          // a flat conversion of 3N values
+          convertToHalf((uint16_t*)blockOut,blockIn,3*N);
+          break;
+        case OWL_VERTEX_FORMAT_SNORM16_3:
+          convertToSnorm16((int16_t*)blockOut,blockIn,3*N);
+          break;
+        case OWL_VERTEX_FORMAT_FLOAT2:
+          for (size_t i=0;i<N;i++)
+            memcpy(blockOut+i*outSize,blockIn+3*i,2*sizeof(float));
+          break;
+        case OWL_VERTEX_FORMAT_HALF2:
+          for (size_t i=0;i<N;i++) {
+            uint16_t *o = (uint16_t*)blockOut+2*i;
+            o[0] = floatToHalf(blockIn[3*i+0]);
+            o[1] = floatToHalf(blockIn[3*i+1]);
+          }
+          break;
+        case OWL_VERTEX_FORMAT_SNORM16_2:
+          for (size_t i=0;i<N;i++) {
+            int16_t *o = (int16_t*)blockOut+2*i;
+            o[0] = floatToSnorm16(blockIn[3*i+0]);
+            o[1] = floatToSnorm16(blockIn[3*i+1]);
+          }
+          break;
+        default:
+          throw std::runtime_error("un-recognized vertex format");
+        }
+      });
+  }
+
+  void convertIndices(void *out,
+                      OWLIndexFormat format,
+                      const int32_t *in,
+                      size_t numTriangles)
+  {
+    if (format != OWL_INDEX_FORMAT_UINT3 &&
+        format != OWL_INDEX_FORMAT_USHORT3)
+      throw std::runtime_error("un-recognized index format");
+    
+    std::atomic<bool> inRange(true);
+    owl::common::parallel_for_blocked
+      (0,numTriangles,vertexConversionBlockSize,
+       [&](size_t begin, size_t end) {
+        const size_t   N       = 3*(end-begin);
+        const int32_t *blockIn = in + 3*begin;
+        if (format == OWL_INDEX_FORMAT_UINT3) {
+          bool blockInRange = true;
+          for (size_t i=0;i<N;i++)
+            blockInRange = blockInRange && blockIn[i] >= 0;
+          memcpy((uint32_t*)out+3*begin,blockIn,N*sizeof(int32_t));
+          if (!blockInRange) inRange = false;
+        } else {
+          if (!convertToUShort((uint16_t*)out+3*begin,blockIn,N))
+            inRange = false;
+        }
+      });
+    if (!inRange)
+      throw std::runtime_error("index out of range for index format "
+                               +toString(format));
+  }
+  
+} // ::owl
@@ -0,0 +1,110 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "owl/owl.h"
+#include "owl/common.h"
+
+namespace owl {
+
+  /*! the vertex format to use for a vertex buffer of given type, if
+      the user didn't explicitly specify one */
+  OWLVertexFormat vertexFormatFor(OWLDataType bufferType);
+
+  /*! the index format to use for an index buffer of given type, if
+      the user didn't explicitly specify one */
+  OWLIndexFormat indexFormatFor(OWLDataType bufferType);
+
+  /*! size of a single vertex in given (explicit) format */
+  size_t vertexFormatSizeOf(OWLVertexFormat format);
+
+  /*! size of a single vertex *component* in given (explicit)
+      format; strides and offsets have to be multiples of this */
+  size_t vertexComponentSizeOf(OWLVertexFormat format);
+
+  /*! size of a single index triplet in given (explicit) format */
+  size_t indexFormatSizeOf(OWLIndexFormat format);
+
+  /*! size of a single index in given (explicit) format; strides and
+      offsets have to be multiples of this */
+  size_t indexComponentSizeOf(OWLIndexFormat format);
+
+  /*! pretty-printer for error messages */
+  std::string toString(OWLVertexFormat format);
+
+  /*! pretty-printer for error messages */
+  std::string toString(OWLIndexFormat format);
+
+  /*! convert 'numVertices' densely packed float3's into given format
+      (densely packed in 'out'); uses SSE/F16C where available, and
+      owl::common::parallel_for for large arrays */
+  void convertVertices(void *out,
+                       OWLVertexFormat format,
+                       const float *in,
+                       size_t numVertices);
+
+  /*! convert 'numTriangles' densely packed int3 index triplets into
+      given format (densely packed in 'out'); throws if any of the
+      indices is negative or doesn't fit into the output format */
+  void convertIndices(void *out,
+                      OWLIndexFormat format,
+                      const int32_t *in,
+                      size_t numTriangles);
+
+  // ------------------------------------------------------------------
+  // scalar conversion helpers; the decoding ones are also used in
+  // device code
+  // ------------------------------------------------------------------
+
+  /*! float to IEEE half, with round-to-nearest-even */
+  uint16_t floatToHalf(float f);
+
+  /*! float to signed normalized 16-bit int, clamping to [-1,+1] */
+  inline int16_t floatToSnorm16(float f)
+  {
+    f = f < -1.f ? -1.f : (f > 1.f ? 1.f : f);
+    return (int16_t)roundf(f*32767.f);
+  }
+
+  /*! IEEE half to float */
+  inline __both__ float halfToFloat(uint16_t h)
+  {
+    const uint32_t sign     = uint32_t(h & 0x8000) << 16;
+    const uint32_t exponent = (h >> 10) & 0x1f;
+    const uint32_t mantissa = h & 0x3ff;
+    union { uint32_t u; float f; } bits;
+    if (exponent == 0x1f) {
+      // inf or nan
+      bits.u = sign | 0x7f800000 | (mantissa << 13);
+    } else if (exponent == 0) {
+      // zero or denormal: mantissa * 2^-24
+      bits.f = mantissa * (1.f/16777216.f);
+      bits.u |= sign;
+    } else {
+      bits.u = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+    return bits.f;
+  }
+
+  /*! signed normalized 16-bit int to float */
+  inline __both__ float snorm16ToFloat(int16_t s)
+  {
+    const float f = s * (1.f/32767.f);
+    return f < -1.f ? -1.f : f;
+  }
+  
+} // ::owl
@@ -33,6 +33,7 @@
 #include <mutex>
 #include <atomic>
 #include <sstream>
+#include <functional>
 
 namespace owl {
   
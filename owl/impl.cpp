@@ -21,31 +21,65 @@
 #include "Triangles.h"
 #include "UserGeom.h"
 #include "InstanceGroup.h"
+#include "MeshOptimizer.h"
+#include "Capture.h"
+#include "Texture.h"
+#include <atomic>
 
 namespace owl {
 
 #if 1
-# define LOG_API_CALL() /* ignore */
+# define LOG_API_CALL() TraceScope traceAPICall(__FUNCTION__,"api")
 #else 
 # define LOG_API_CALL() std::cout << "% " << __FUNCTION__ << "(...)" << std::endl;
 #endif
 
 
-#define LOG(message)                            \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_LIGHT_BLUE                \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
-
-#define LOG_OK(message)                         \
-  if (Context::logging())                       \
-    std::cout                                   \
-      << OWL_TERMINAL_BLUE                      \
-      << "#owl: "                               \
-      << message                                \
-      << OWL_TERMINAL_DEFAULT << std::endl
+#define LOG(message)    OWL_LOG_INFO(OWL_LOG_CATEGORY_API,message)
+#define LOG_OK(message) OWL_LOG_INFO(OWL_LOG_CATEGORY_API,message)
+  
+  /*! the capture all api calls currently get recorded into, if any
+      (see owlCaptureBegin) */
+  static CaptureWriter::SP  activeCapture;
+  static std::mutex         activeCaptureMutex;
+  static std::atomic<bool>  capturing { false };
+
+  /*! returns the active capture, or null if not capturing; cheap
+      unless capturing */
+  inline CaptureWriter::SP getCapture()
+  {
+    if (!capturing.load(std::memory_order_relaxed))
+      return nullptr;
+    std::lock_guard<std::mutex> lock(activeCaptureMutex);
+    return activeCapture;
+  }
+
+  /*! captures a call whose arguments are only the given handle */
+  inline void captureCall(CaptureCall call, const void *handle)
+  {
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(call,CaptureArgs().put(capture->handleID(handle)));
+  }
+  
+  /*! adds 'count' elements of data that are to go into a buffer of
+      given type - buffers of buffers or textures hold handles, which
+      get captured as such */
+  static void putBufferData(CaptureWriter &capture,
+                            CaptureArgs &args,
+                            OWLDataType type,
+                            const void *data,
+                            size_t count)
+  {
+    if (!data) {
+      args.put(CAPTURE_BUFFER_DATA_NONE);
+    } else if (type == OWL_BUFFER || type == OWL_TEXTURE) {
+      args.put(CAPTURE_BUFFER_DATA_HANDLES);
+      args.putHandles(capture.handleIDs((const APIHandle *const *)data,count));
+    } else {
+      args.put(CAPTURE_BUFFER_DATA_BLOB);
+      args.put(capture.blob(data,count*sizeOf(type)));
+    }
+  }
   
   OWL_API OWLContext owlContextCreate(int32_t *requestedDeviceIDs,
                                       int      numRequestedDevices)
@@ -54,7 +88,16 @@ namespace owl {
     APIContext::SP context = std::make_shared<APIContext>(requestedDeviceIDs,
                                                           numRequestedDevices);
     LOG("context created...");
-    return (OWLContext)context->createHandle(context);
+    OWLContext _context = (OWLContext)context->createHandle(context);
+    if (CaptureWriter::SP capture = getCapture()) {
+      const size_t numIDs
+        = requestedDeviceIDs ? std::max(numRequestedDevices,0) : 0;
+      capture->call(CAPTURE_CONTEXT_CREATE,CaptureArgs()
+                    .put(capture->newHandle(_context))
+                    .put((int32_t)numRequestedDevices)
+                    .putBytes(requestedDeviceIDs,numIDs*sizeof(int32_t)));
+    }
+    return _context;
   }
 
   inline APIContext::SP checkGet(OWLContext _context)
@@ -65,6 +108,18 @@ namespace owl {
     return context;
   }
 
+  /*! if the given context is recording a command list, records the
+      given command and returns true, in which case the caller must
+      NOT execute it */
+  inline bool recordIfRecording(Context *context,
+                                const RecordedCommand &command)
+  {
+    if (!context->commandRecorder.isRecording())
+      return false;
+    context->commandRecorder.record(command);
+    return true;
+  }
+
   /* return the cuda stream associated with the given device. */
   OWL_API CUstream owlContextGetStream(OWLContext _context, int deviceID)
   {
@@ -88,6 +143,10 @@ namespace owl {
   {
     LOG_API_CALL();
     checkGet(_context)->setRayTypeCount(numRayTypes);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_CONTEXT_SET_RAY_TYPE_COUNT,CaptureArgs()
+                    .put(capture->handleID(_context))
+                    .put((int64_t)numRayTypes));
   }
 
 
@@ -115,14 +174,128 @@ namespace owl {
   {
     LOG_API_CALL();
     checkGet(_context)->setMaxInstancingDepth(maxInstanceDepth);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_CONTEXT_SET_MAX_INSTANCING_DEPTH,CaptureArgs()
+                    .put(capture->handleID(_context))
+                    .put((int64_t)maxInstanceDepth));
   }
   
 
+  OWL_API void
+  owlContextSetMaxTraceDepth(OWLContext _context,
+                             int maxTraceDepth)
+  {
+    LOG_API_CALL();
+    checkGet(_context)->setMaxTraceDepth(maxTraceDepth);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_CONTEXT_SET_MAX_TRACE_DEPTH,CaptureArgs()
+                    .put(capture->handleID(_context))
+                    .put((int64_t)maxTraceDepth));
+  }
+
+  OWL_API void
+  owlContextSetNumPayloadValues(OWLContext _context,
+                                int numPayloadValues)
+  {
+    LOG_API_CALL();
+    checkGet(_context)->setNumPayloadValues(numPayloadValues);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_CONTEXT_SET_NUM_PAYLOAD_VALUES,CaptureArgs()
+                    .put(capture->handleID(_context))
+                    .put((int64_t)numPayloadValues));
+  }
+
+  OWL_API void
+  owlContextSetNumAttributeValues(OWLContext _context,
+                                  int numAttributeValues)
+  {
+    LOG_API_CALL();
+    checkGet(_context)->setNumAttributeValues(numAttributeValues);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_CONTEXT_SET_NUM_ATTRIBUTE_VALUES,CaptureArgs()
+                    .put(capture->handleID(_context))
+                    .put((int64_t)numAttributeValues));
+  }
+
+  OWL_API void
+  owlContextSetMaxRegisterCount(OWLContext _context,
+                                int maxRegisterCount)
+  {
+    LOG_API_CALL();
+    checkGet(_context)->setMaxRegisterCount(maxRegisterCount);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_CONTEXT_SET_MAX_REGISTER_COUNT,CaptureArgs()
+                    .put(capture->handleID(_context))
+                    .put((int64_t)maxRegisterCount));
+  }
+
   OWL_API void
   owlEnableMotionBlur(OWLContext _context)
   {
     LOG_API_CALL();
     checkGet(_context)->enableMotionBlur();
+    captureCall(CAPTURE_ENABLE_MOTION_BLUR,_context);
+  }
+
+  OWL_API void
+  owlEnableAccelRelocation(OWLContext _context)
+  {
+    LOG_API_CALL();
+    checkGet(_context)->enableAccelRelocation();
+    captureCall(CAPTURE_ENABLE_ACCEL_RELOCATION,_context);
+  }
+
+  OWL_API void
+  owlEnableAccelSplitting(OWLContext _context)
+  {
+    LOG_API_CALL();
+    checkGet(_context)->enableAccelSplitting();
+    captureCall(CAPTURE_ENABLE_ACCEL_SPLITTING,_context);
+  }
+
+  OWL_API void
+  owlEnableAccelDedup(OWLContext _context)
+  {
+    LOG_API_CALL();
+    checkGet(_context)->enableAccelDedup();
+    captureCall(CAPTURE_ENABLE_ACCEL_DEDUP,_context);
+  }
+
+  OWL_API void
+  owlEnableUploadReplication(OWLContext _context)
+  {
+    LOG_API_CALL();
+    checkGet(_context)->enableUploadReplication();
+    captureCall(CAPTURE_ENABLE_UPLOAD_REPLICATION,_context);
+  }
+
+  OWL_API void
+  owlGetAccelDedupStats(OWLContext _context,
+                        OWLAccelDedupStats *stats)
+  {
+    LOG_API_CALL();
+    assert(stats);
+    *stats = checkGet(_context)->accelDedupTable.computeStats();
+  }
+
+  OWL_API void
+  owlContextSetAccelCache(OWLContext _context,
+                          const char *directory,
+                          size_t maxSizeInBytes)
+  {
+    LOG_API_CALL();
+    checkGet(_context)->setAccelCache(directory ? directory : "",
+                                      maxSizeInBytes);
+  }
+
+  OWL_API void
+  owlContextSetModuleCache(OWLContext _context,
+                           const char *directory,
+                           size_t maxSizeInBytes)
+  {
+    LOG_API_CALL();
+    checkGet(_context)->setModuleCache(directory ? directory : "",
+                                       maxSizeInBytes);
   }
   
   OWL_API void owlBuildSBT(OWLContext _context,
@@ -130,12 +303,17 @@ namespace owl {
   {
     LOG_API_CALL();
     checkGet(_context)->buildSBT(flags);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_BUILD_SBT,CaptureArgs()
+                    .put(capture->handleID(_context))
+                    .put((uint32_t)flags));
   }
 
   OWL_API void owlBuildPrograms(OWLContext _context)
   {
     LOG_API_CALL();
     checkGet(_context)->buildPrograms();
+    captureCall(CAPTURE_BUILD_PROGRAMS,_context);
   }
   
   OWL_API void owlBuildPipeline(OWLContext _context)
@@ -143,11 +321,118 @@ namespace owl {
     LOG_API_CALL();
     APIContext::SP context = checkGet(_context);
     context->buildPipeline();
+    captureCall(CAPTURE_BUILD_PIPELINE,_context);
+  }
+
+  OWL_API void owlContextGetBuildStats(OWLContext _context,
+                                       OWLBuildStats *stats)
+  {
+    LOG_API_CALL();
+    assert(stats);
+    *stats = checkGet(_context)->buildStats;
+  }
+
+  OWL_API void owlContextEnableTiming(OWLContext _context, int32_t enabled)
+  {
+    LOG_API_CALL();
+    for (auto device : checkGet(_context)->getDevices())
+      device->timings.setEnabled(enabled != 0);
+  }
+
+  OWL_API void owlContextGetTimingStats(OWLContext _context,
+                                        int32_t deviceID,
+                                        OWLTimingKind kind,
+                                        OWLTimingStats *stats)
+  {
+    LOG_API_CALL();
+    assert(stats);
+    APIContext::SP context = checkGet(_context);
+    if (deviceID < 0 || deviceID >= (int)context->deviceCount())
+      throw std::runtime_error("invalid device ID "+std::to_string(deviceID)
+                               +" for timing stats");
+    if (kind < 0 || kind >= OWL_TIMING_NUM_KINDS)
+      throw std::runtime_error("invalid timing kind");
+    DeviceContext::SP device = context->getDevice(deviceID);
+    SetActiveGPU forLifeTime(device);
+    *stats = device->timings.getStats(kind);
+  }
+
+  OWL_API void owlContextResetTimingStats(OWLContext _context)
+  {
+    LOG_API_CALL();
+    for (auto device : checkGet(_context)->getDevices()) {
+      SetActiveGPU forLifeTime(device);
+      device->timings.reset();
+    }
+  }
+
+  OWL_API void owlEnableTracing(int32_t enabled)
+  {
+    LOG_API_CALL();
+    Tracer::get().setEnabled(enabled != 0);
+  }
+
+  OWL_API void owlFlushTrace(const char *fileName)
+  {
+    assert(fileName);
+    Tracer::get().flush(fileName);
+  }
+
+  OWL_API void owlLogSetLevel(OWLLogLevel level)
+  {
+    Logger::get().setLevel(level);
+  }
+
+  OWL_API void owlLogSetCategories(uint32_t categories)
+  {
+    Logger::get().setCategories(categories);
+  }
+
+  OWL_API void owlLogSetCallback(OWLLogCallback callback,
+                                 void *userData)
+  {
+    Logger::get().setCallback(callback,userData);
+  }
+
+  OWL_API void owlLogFlush()
+  {
+    Logger::get().flush();
+  }
+
+  OWL_API void owlCaptureBegin(const char *fileName)
+  {
+    LOG_API_CALL();
+    assert(fileName);
+    std::lock_guard<std::mutex> lock(activeCaptureMutex);
+    if (activeCapture)
+      throw std::runtime_error("owlCaptureBegin: already capturing");
+    activeCapture = std::make_shared<CaptureWriter>(fileName);
+    capturing = true;
+  }
+
+  OWL_API void owlCaptureEnd()
+  {
+    LOG_API_CALL();
+    CaptureWriter::SP capture;
+    {
+      std::lock_guard<std::mutex> lock(activeCaptureMutex);
+      capture = activeCapture;
+      activeCapture = nullptr;
+      capturing = false;
+    }
+    if (!capture)
+      throw std::runtime_error("owlCaptureEnd: not capturing");
+    capture->flush();
+    const CaptureWriter::Stats stats = capture->getStats();
+    LOG("captured " << stats.numCalls << " calls, with "
+        << prettyNumber(stats.blobBytes) << "B of data ("
+        << prettyNumber(stats.blobBytesSaved) << "B more were duplicates)");
   }
   
-  OWL_API void owlAsyncLaunch2D(OWLRayGen _rayGen,
+  OWL_API void owlAsyncLaunch3D(OWLRayGen _rayGen,
                                 int dims_x,
                                 int dims_y,
+                                int dims_z,
                                 OWLLaunchParams _launchParams)
   {
     LOG_API_CALL();
@@ -162,7 +447,60 @@ namespace owl {
       = ((APIHandle *)_launchParams)->get<LaunchParams>();
     assert(launchParams);
 
-    rayGen->launchAsync(vec2i(dims_x,dims_y),launchParams);
+    RecordedCommand command;
+    command.kind   = COMMAND_LAUNCH;
+    command.object = rayGen;
+    command.params = launchParams;
+    command.dims   = vec3i(dims_x,dims_y,dims_z);
+    command.capturable = launchParams->launchIsCapturable(command.dims);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_ASYNC_LAUNCH,CaptureArgs()
+                    .put(capture->handleID(_rayGen))
+                    .put(capture->handleID(_launchParams))
+                    .put((int32_t)dims_x)
+                    .put((int32_t)dims_y)
+                    .put((int32_t)dims_z));
+    if (recordIfRecording(rayGen->context,command))
+      return;
+    
+    rayGen->launchAsync(vec3i(dims_x,dims_y,dims_z),launchParams);
+  }
+
+  OWL_API void owlAsyncLaunch2D(OWLRayGen _rayGen,
+                                int dims_x,
+                                int dims_y,
+                                OWLLaunchParams _launchParams)
+  {
+    LOG_API_CALL();
+    owlAsyncLaunch3D(_rayGen,dims_x,dims_y,1,_launchParams);
+  }
+
+  OWL_API void owlAsyncLaunch1D(OWLRayGen _rayGen,
+                                int dims_x,
+                                OWLLaunchParams _launchParams)
+  {
+    LOG_API_CALL();
+    owlAsyncLaunch3D(_rayGen,dims_x,1,1,_launchParams);
+  }
+
+  OWL_API void owlLaunch3D(OWLRayGen _rayGen,
+                           int dims_x,
+                           int dims_y,
+                           int dims_z,
+                           OWLLaunchParams _launchParams)
+  {
+    LOG_API_CALL();
+    owlAsyncLaunch3D(_rayGen,dims_x,dims_y,dims_z,_launchParams);
+    owlLaunchSync(_launchParams);
+  }
+
+  OWL_API void owlLaunch1D(OWLRayGen _rayGen,
+                           int dims_x,
+                           OWLLaunchParams _launchParams)
+  {
+    LOG_API_CALL();
+    owlAsyncLaunch3D(_rayGen,dims_x,1,1,_launchParams);
+    owlLaunchSync(_launchParams);
   }
 
   OWL_API void owlLaunch2D(OWLRayGen _rayGen,
@@ -183,17 +521,126 @@ namespace owl {
     LaunchParams::SP launchParams
       = ((APIHandle *)_launchParams)->get<LaunchParams>();
     assert(launchParams);
+
+    RecordedCommand command;
+    command.kind       = COMMAND_LAUNCH_SYNC;
+    command.params     = launchParams;
+    command.capturable = true;
+    captureCall(CAPTURE_LAUNCH_SYNC,_launchParams);
+    if (recordIfRecording(launchParams->context,command))
+      return;
+    
     launchParams->sync();
   }
 
+  /*! synchronous launch without launch params; when recording, gets
+      recorded as an async launch plus sync on the context's dummy
+      launch params */
+  inline void launchWithDummyParams(OWLRayGen _rayGen,
+                                    const vec3i &dims)
+  {
+    assert(_rayGen);
+    RayGen::SP rayGen = ((APIHandle *)_rayGen)->get<RayGen>();
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_RAY_GEN_LAUNCH,CaptureArgs()
+                    .put(capture->handleID(_rayGen))
+                    .put((int32_t)dims.x)
+                    .put((int32_t)dims.y)
+                    .put((int32_t)dims.z));
+    Context *context = rayGen->context;
+    if (!context->commandRecorder.isRecording()) {
+      rayGen->launch(dims);
+      return;
+    }
+    RecordedCommand launch;
+    launch.kind       = COMMAND_LAUNCH;
+    launch.object     = rayGen;
+    launch.params     = context->dummyLaunchParams;
+    launch.dims       = dims;
+    launch.capturable = context->dummyLaunchParams->launchIsCapturable(dims);
+    context->commandRecorder.record(launch);
+    RecordedCommand sync;
+    sync.kind       = COMMAND_LAUNCH_SYNC;
+    sync.params     = context->dummyLaunchParams;
+    sync.capturable = true;
+    context->commandRecorder.record(sync);
+  }
+  
   OWL_API void owlRayGenLaunch2D(OWLRayGen _rayGen,
                                  int dims_x, int dims_y)
   {
     LOG_API_CALL();
+    launchWithDummyParams(_rayGen,vec3i(dims_x,dims_y,1));
+  }
 
-    assert(_rayGen);
-    RayGen::SP rayGen = ((APIHandle *)_rayGen)->get<RayGen>();
-    rayGen->launch(vec2i(dims_x,dims_y));
+  OWL_API void owlRayGenLaunch1D(OWLRayGen _rayGen,
+                                 int dims_x)
+  {
+    LOG_API_CALL();
+    launchWithDummyParams(_rayGen,vec3i(dims_x,1,1));
+  }
+
+  OWL_API void owlRayGenLaunch3D(OWLRayGen _rayGen,
+                                 int dims_x, int dims_y, int dims_z)
+  {
+    LOG_API_CALL();
+    launchWithDummyParams(_rayGen,vec3i(dims_x,dims_y,dims_z));
+  }
+
+  OWL_API void owlParamsEnableLaunchTiling(OWLParams _launchParams,
+                                           const char *offsetVarName,
+                                           size_t maxTileSize)
+  {
+    LOG_API_CALL();
+
+    assert(_launchParams);
+    assert(offsetVarName);
+    LaunchParams::SP launchParams
+      = ((APIHandle *)_launchParams)->get<LaunchParams>();
+    assert(launchParams);
+    launchParams->enableLaunchTiling(offsetVarName,maxTileSize);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_PARAMS_ENABLE_LAUNCH_TILING,CaptureArgs()
+                    .put(capture->handleID(_launchParams))
+                    .putString(offsetVarName)
+                    .put((uint64_t)maxTileSize));
+  }
+
+  OWL_API void owlParamsEnableLoadBalancing(OWLParams _launchParams,
+                                            const char *offsetVarName,
+                                            int tileSize,
+                                            float smoothing)
+  {
+    LOG_API_CALL();
+
+    assert(_launchParams);
+    assert(offsetVarName);
+    LaunchParams::SP launchParams
+      = ((APIHandle *)_launchParams)->get<LaunchParams>();
+    assert(launchParams);
+    launchParams->enableLoadBalancing(offsetVarName,tileSize,smoothing);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_PARAMS_ENABLE_LOAD_BALANCING,CaptureArgs()
+                    .put(capture->handleID(_launchParams))
+                    .putString(offsetVarName)
+                    .put((int32_t)tileSize)
+                    .put(smoothing));
+  }
+
+  OWL_API float owlParamsGetDeviceWorkShare(OWLParams _launchParams,
+                                            int deviceID)
+  {
+    LOG_API_CALL();
+
+    assert(_launchParams);
+    LaunchParams::SP launchParams
+      = ((APIHandle *)_launchParams)->get<LaunchParams>();
+    assert(launchParams);
+    if (deviceID < 0 || deviceID >= (int)launchParams->context->deviceCount())
+      throw std::runtime_error("invalid device ID "+std::to_string(deviceID)
+                               +" for device work share");
+    return launchParams->getDD(launchParams->context->getDevice(deviceID))
+      .workShare;
   }
 
 
@@ -212,7 +659,8 @@ namespace owl {
   template<typename T>
   OWLVariable
   getVariableHelper(APIHandle *handle,
-                    const char *varName)
+                    const char *varName,
+                    CaptureObjectKind objectKind)
   {
     assert(varName);
     assert(handle);
@@ -229,7 +677,14 @@ namespace owl {
     APIContext::SP context = handle->getContext();
     assert(context);
 
-    return(OWLVariable)context->createHandle(var);
+    OWLVariable _var = (OWLVariable)context->createHandle(var);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_GET_VARIABLE,CaptureArgs()
+                    .put(capture->newHandle(_var))
+                    .put(objectKind)
+                    .put(capture->handleID(handle))
+                    .putString(varName));
+    return _var;
   }
   
   
@@ -238,7 +693,8 @@ namespace owl {
                      const char *varName)
   {
     LOG_API_CALL();
-    return getVariableHelper<Geom>((APIHandle*)_geom,varName);
+    return getVariableHelper<Geom>((APIHandle*)_geom,varName,
+                                 CAPTURE_OBJECT_GEOM);
   }
 
   OWL_API OWLVariable
@@ -246,7 +702,8 @@ namespace owl {
                        const char *varName)
   {
     LOG_API_CALL();
-    return getVariableHelper<RayGen>((APIHandle*)_prog,varName);
+    return getVariableHelper<RayGen>((APIHandle*)_prog,varName,
+                                 CAPTURE_OBJECT_RAY_GEN);
   }
 
   OWL_API OWLVariable
@@ -254,7 +711,8 @@ namespace owl {
                          const char *varName)
   {
     LOG_API_CALL();
-    return getVariableHelper<MissProg>((APIHandle*)_prog,varName);
+    return getVariableHelper<MissProg>((APIHandle*)_prog,varName,
+                                 CAPTURE_OBJECT_MISS_PROG);
   }
 
   OWL_API OWLVariable
@@ -262,7 +720,8 @@ namespace owl {
                        const char *varName)
   {
     LOG_API_CALL();
-    return getVariableHelper<LaunchParams>((APIHandle*)_prog,varName);
+    return getVariableHelper<LaunchParams>((APIHandle*)_prog,varName,
+                                 CAPTURE_OBJECT_PARAMS);
   }
   
 
@@ -309,7 +768,16 @@ namespace owl {
                                   checkAndPackVariables(vars,numVars));
     
     RayGen::SP rayGen = context->createRayGen(rayGenType);
-    return (OWLRayGen)context->createHandle(rayGen);
+    OWLRayGen _rayGen = (OWLRayGen)context->createHandle(rayGen);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_RAY_GEN_CREATE,CaptureArgs()
+                    .put(capture->newHandle(_rayGen))
+                    .put(capture->handleID(_context))
+                    .put(capture->handleID(_module))
+                    .putString(programName)
+                    .put((uint64_t)sizeOfVarStruct)
+                    .putVarDecls(rayGenType->varDecls));
+    return _rayGen;
   }
 
   OWL_API OWLParams
@@ -329,7 +797,15 @@ namespace owl {
     LaunchParams::SP  launchParams
       = context->createLaunchParams(launchParamsType);
     assert(launchParams);
-    return (OWLLaunchParams)context->createHandle(launchParams);
+    OWLLaunchParams _launchParams
+      = (OWLLaunchParams)context->createHandle(launchParams);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_PARAMS_CREATE,CaptureArgs()
+                    .put(capture->newHandle(_launchParams))
+                    .put(capture->handleID(_context))
+                    .put((uint64_t)sizeOfVarStruct)
+                    .putVarDecls(launchParamsType->varDecls));
+    return _launchParams;
   }
 
   OWL_API void
@@ -345,6 +821,11 @@ namespace owl {
       ? ((APIHandle *)_miss)->get<MissProg>()
       : MissProg::SP();
     checkGet(_context)->setMissProg(rayType,miss);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_MISS_PROG_SET,CaptureArgs()
+                    .put(capture->handleID(_context))
+                    .put((int32_t)rayType)
+                    .put(capture->handleID(_miss)));
   }
 
   OWL_API OWLMissProg
@@ -371,7 +852,16 @@ namespace owl {
       = checkGet(_context)->createMissProg(missProgType);
     assert(missProg);
 
-    return (OWLMissProg)checkGet(_context)->createHandle(missProg);
+    OWLMissProg _missProg = (OWLMissProg)checkGet(_context)->createHandle(missProg);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_MISS_PROG_CREATE,CaptureArgs()
+                    .put(capture->newHandle(_missProg))
+                    .put(capture->handleID(_context))
+                    .put(capture->handleID(_module))
+                    .putString(programName)
+                    .put((uint64_t)sizeOfVarStruct)
+                    .putVarDecls(missProgType->varDecls));
+    return _missProg;
   }
 
   
@@ -386,6 +876,12 @@ namespace owl {
     assert(group);
     
     OWLGroup _group = (OWLGroup)context->createHandle(group);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_TRIANGLES_GEOM_GROUP_CREATE,CaptureArgs()
+                    .put(capture->newHandle(_group))
+                    .put(capture->handleID(_context))
+                    .putHandles(capture->handleIDs(initValues,
+                                                   initValues ? numGeometries : 0)));
     if (initValues) {
       for (size_t i = 0; i < numGeometries; i++) {
         Geom::SP child = ((APIHandle *)initValues[i])->get<TrianglesGeom>();
@@ -408,6 +904,12 @@ namespace owl {
     assert(group);
     
     OWLGroup _group = (OWLGroup)context->createHandle(group);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_USER_GEOM_GROUP_CREATE,CaptureArgs()
+                    .put(capture->newHandle(_group))
+                    .put(capture->handleID(_context))
+                    .putHandles(capture->handleIDs(initValues,
+                                                   initValues ? numGeometries : 0)));
     if (initValues) {
       for (size_t i = 0; i < numGeometries; i++) {
         Geom::SP child = ((APIHandle *)initValues[i])->get<UserGeom>();
@@ -476,6 +978,13 @@ namespace owl {
 
     OWLGroup _group = (OWLGroup)context->createHandle(group);
     assert(_group);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_INSTANCE_GROUP_CREATE,CaptureArgs()
+                    .put(capture->newHandle(_group))
+                    .put(capture->handleID(_context))
+                    .putHandles(_initGroups
+                                ? capture->handleIDs(_initGroups,numInstances)
+                                : std::vector<CaptureHandle>(numInstances,0)));
 
     if (initTransforms)
       owlInstanceGroupSetTransforms(_group,0,initTransforms,matrixFormat);
@@ -490,6 +999,7 @@ namespace owl {
   {
     LOG_API_CALL();
     APIContext::SP context = checkGet(_context);
+    captureCall(CAPTURE_CONTEXT_DESTROY,_context);
     context->releaseAll();
   }
 
@@ -505,7 +1015,17 @@ namespace owl {
     APIContext::SP context = checkGet(_context);
     Buffer::SP  buffer  = context->deviceBufferCreate(type,count,init);
     assert(buffer);
-    return (OWLBuffer)context->createHandle(buffer);
+    OWLBuffer _buffer = (OWLBuffer)context->createHandle(buffer);
+    if (CaptureWriter::SP capture = getCapture()) {
+      CaptureArgs args;
+      args.put(capture->newHandle(_buffer))
+        .put(capture->handleID(_context))
+        .put((uint32_t)type)
+        .put((uint64_t)count);
+      putBufferData(*capture,args,type,init,count);
+      capture->call(CAPTURE_DEVICE_BUFFER_CREATE,args);
+    }
+    return _buffer;
   }
 
   /*! create new texture of given format and dimensions - for now, we
@@ -539,7 +1059,25 @@ namespace owl {
                                  linePitchInBytes,
                                  texels);
     assert(texture);
-    return (OWLTexture)context->createHandle(texture);
+    OWLTexture _texture = (OWLTexture)context->createHandle(texture);
+    if (CaptureWriter::SP capture = getCapture()) {
+      const size_t pitch
+        = linePitchInBytes
+        ? linePitchInBytes
+        : size_x*bytesPerTexel(texelFormat);
+      capture->call(CAPTURE_TEXTURE_2D_CREATE,CaptureArgs()
+                    .put(capture->newHandle(_texture))
+                    .put(capture->handleID(_context))
+                    .put((uint32_t)texelFormat)
+                    .put(size_x)
+                    .put(size_y)
+                    .put(capture->blob(texels,pitch*size_y))
+                    .put((uint32_t)filterMode)
+                    .put((uint32_t)addressMode)
+                    .put((uint32_t)colorSpace)
+                    .put(linePitchInBytes));
+    }
+    return _texture;
   }
 
   OWL_API CUtexObject
@@ -566,6 +1104,7 @@ namespace owl {
     
     Texture::SP texture = handle->get<Texture>();
     assert(texture);
+    captureCall(CAPTURE_TEXTURE_2D_DESTROY,_texture);
     texture->destroy();
 
     handle->clear();
@@ -585,7 +1124,14 @@ namespace owl {
     assert(context);
     Buffer::SP  buffer  = context->hostPinnedBufferCreate(type,count);
     assert(buffer);
-    return (OWLBuffer)context->createHandle(buffer);
+    OWLBuffer _buffer = (OWLBuffer)context->createHandle(buffer);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_HOST_PINNED_BUFFER_CREATE,CaptureArgs()
+                    .put(capture->newHandle(_buffer))
+                    .put(capture->handleID(_context))
+                    .put((uint32_t)type)
+                    .put((uint64_t)count));
+    return _buffer;
   }
 
   /*! creates a buffer that uses CUDA managed memory; that memory is
@@ -602,7 +1148,17 @@ namespace owl {
     APIContext::SP context = ((APIHandle *)_context)->get<APIContext>();
     assert(context);
     Buffer::SP  buffer  = context->managedMemoryBufferCreate(type,count,init);
-    return (OWLBuffer)context->createHandle(buffer);
+    OWLBuffer _buffer = (OWLBuffer)context->createHandle(buffer);
+    if (CaptureWriter::SP capture = getCapture()) {
+      CaptureArgs args;
+      args.put(capture->newHandle(_buffer))
+        .put(capture->handleID(_context))
+        .put((uint32_t)type)
+        .put((uint64_t)count);
+      putBufferData(*capture,args,type,init,count);
+      capture->call(CAPTURE_MANAGED_MEMORY_BUFFER_CREATE,args);
+    }
+    return _buffer;
   }
 
   OWL_API OWLBuffer
@@ -647,6 +1203,7 @@ namespace owl {
     assert(_buffer);
     Buffer::SP buffer = ((APIHandle *)_buffer)->get<Buffer>();
     assert(buffer);
+    buffer->pointerExposed = true;
     return buffer->getPointer(buffer->context->getDevice(deviceID));
   }
 
@@ -670,6 +1227,77 @@ namespace owl {
     return lp->getCudaStream(lp->context->getDevice(deviceID));
   }
 
+  OWL_API void
+  owlParamsSetRingSize(OWLLaunchParams _lp, int numSlots)
+  {
+    LOG_API_CALL();
+    assert(_lp);
+    LaunchParams::SP lp = ((APIHandle *)_lp)->get<LaunchParams>();
+    assert(lp);
+    lp->setRingSize(numSlots);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_PARAMS_SET_RING_SIZE,CaptureArgs()
+                    .put(capture->handleID(_lp))
+                    .put((int32_t)numSlots));
+  }
+
+  OWL_API void owlCommandListBegin(OWLContext _context)
+  {
+    LOG_API_CALL();
+    checkGet(_context)->commandRecorder.begin();
+    captureCall(CAPTURE_COMMAND_LIST_BEGIN,_context);
+  }
+
+  OWL_API OWLCommandList owlCommandListEnd(OWLContext _context)
+  {
+    LOG_API_CALL();
+    APIContext::SP context = checkGet(_context);
+    CommandList::SP list
+      = context->createCommandList(context->commandRecorder.end());
+    assert(list);
+    OWLCommandList _list = (OWLCommandList)context->createHandle(list);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_COMMAND_LIST_END,CaptureArgs()
+                    .put(capture->newHandle(_list))
+                    .put(capture->handleID(_context)));
+    return _list;
+  }
+
+  OWL_API void owlCommandListReplay(OWLCommandList _list)
+  {
+    LOG_API_CALL();
+    assert(_list);
+    CommandList::SP list = ((APIHandle *)_list)->get<CommandList>();
+    assert(list);
+    if (CaptureWriter::SP capture = getCapture()) {
+      // recorded uploads read their data at replay time, so what
+      // they upload in this replay has to go into the capture, too
+      CaptureArgs args;
+      args.put(capture->handleID(_list));
+      for (auto &command : list->commands) {
+        if (command.kind != COMMAND_BUFFER_UPLOAD)
+          continue;
+        Buffer::SP buffer = std::static_pointer_cast<Buffer>(command.object);
+        putBufferData(*capture,args,buffer->type,command.hostPtr,
+                      command.count == -1
+                      ? buffer->getElementCount()
+                      : size_t(command.count));
+      }
+      capture->call(CAPTURE_COMMAND_LIST_REPLAY,args);
+    }
+    list->replay();
+  }
+
+  OWL_API int32_t owlCommandListUsesGraph(OWLCommandList _list)
+  {
+    LOG_API_CALL();
+    assert(_list);
+    CommandList::SP list = ((APIHandle *)_list)->get<CommandList>();
+    assert(list);
+    return list->plan.useGraph;
+  }
+
+
   OWL_API void 
   owlBufferResize(OWLBuffer _buffer, size_t newItemCount)
   {
@@ -677,7 +1305,11 @@ namespace owl {
     assert(_buffer);
     Buffer::SP buffer = ((APIHandle *)_buffer)->get<Buffer>();
     assert(buffer);
-    return buffer->resize(newItemCount);
+    buffer->resize(newItemCount);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_BUFFER_RESIZE,CaptureArgs()
+                    .put(capture->handleID(_buffer))
+                    .put((uint64_t)newItemCount));
   }
 
   OWL_API void 
@@ -690,6 +1322,31 @@ namespace owl {
     assert(_buffer);
     Buffer::SP buffer = ((APIHandle *)_buffer)->get<Buffer>();
     assert(buffer);
+    
+    RecordedCommand command;
+    command.kind    = COMMAND_BUFFER_UPLOAD;
+    command.object  = buffer;
+    command.hostPtr = hostPtr;
+    command.offset  = offset;
+    command.count   = (int64_t)bytes;
+    // only plain device buffers upload with a single memcpy per device
+    command.capturable
+      = std::dynamic_pointer_cast<DeviceBuffer>(buffer)
+      && buffer->type >= _OWL_BEGIN_COPYABLE_TYPES;
+    if (CaptureWriter::SP capture = getCapture()) {
+      // 'bytes' is actually a count of elements, with -1 meaning 'all'
+      const int64_t count = (int64_t)bytes;
+      CaptureArgs args;
+      args.put(capture->handleID(_buffer))
+        .put((uint64_t)offset)
+        .put(count);
+      putBufferData(*capture,args,buffer->type,hostPtr,
+                    count == -1 ? buffer->getElementCount() : size_t(count));
+      capture->call(CAPTURE_BUFFER_UPLOAD,args);
+    }
+    if (recordIfRecording(buffer->context,command))
+      return;
+    
     return buffer->upload(hostPtr, offset, bytes);
   }
 
@@ -707,6 +1364,7 @@ namespace owl {
     
     Buffer::SP buffer = handle->get<Buffer>();
     assert(buffer);
+    captureCall(CAPTURE_BUFFER_DESTROY,_buffer);
     buffer->destroy();
 
     handle->clear();
@@ -727,7 +1385,15 @@ namespace owl {
       = context->createGeomType(kind,varStructSize,
                                 checkAndPackVariables(vars,numVars));
     assert(geometryType);
-    return (OWLGeomType)context->createHandle(geometryType);
+    OWLGeomType _geomType = (OWLGeomType)context->createHandle(geometryType);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_GEOM_TYPE_CREATE,CaptureArgs()
+                    .put(capture->newHandle(_geomType))
+                    .put(capture->handleID(_context))
+                    .put((uint32_t)kind)
+                    .put((uint64_t)varStructSize)
+                    .putVarDecls(geometryType->varDecls));
+    return _geomType;
   }
   
   OWL_API OWLGeom
@@ -745,7 +1411,13 @@ namespace owl {
       = geometryType->createGeom();
     assert(geometry);
 
-    return (OWLGeom)context->createHandle(geometry);
+    OWLGeom _geom = (OWLGeom)context->createHandle(geometry);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_GEOM_CREATE,CaptureArgs()
+                    .put(capture->newHandle(_geom))
+                    .put(capture->handleID(_context))
+                    .put(capture->handleID(_geometryType)));
+    return _geom;
   }
   
   /*! Set the primitive count for the given user geometry. This _has_
@@ -758,6 +1430,29 @@ namespace owl {
     assert(_geom);
     UserGeom::SP geom = ((APIHandle *)_geom)->get<UserGeom>();
     geom->setPrimCount(primCount);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_GEOM_SET_PRIM_COUNT,CaptureArgs()
+                    .put(capture->handleID(_geom))
+                    .put((uint64_t)primCount));
+  }
+
+  OWL_API void
+  owlUserGeomSetBoundsBuffer(OWLGeom   _geom,
+                             OWLBuffer _boundsBuffer)
+  {
+    LOG_API_CALL();
+    assert(_geom);
+    UserGeom::SP geom = ((APIHandle *)_geom)->get<UserGeom>();
+    assert(geom);
+    Buffer::SP boundsBuffer
+      = _boundsBuffer
+      ? ((APIHandle *)_boundsBuffer)->get<Buffer>()
+      : Buffer::SP();
+    geom->setBoundsBuffer(boundsBuffer);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_USER_GEOM_SET_BOUNDS_BUFFER,CaptureArgs()
+                    .put(capture->handleID(_geom))
+                    .put(capture->handleID(_boundsBuffer)));
   }
 
   
@@ -770,7 +1465,13 @@ namespace owl {
     APIContext::SP context = checkGet(_context);
     Module::SP  module  = context->createModule(ptxCode);
     assert(module);
-    return (OWLModule)context->createHandle(module);
+    OWLModule _module = (OWLModule)context->createHandle(module);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_MODULE_CREATE,CaptureArgs()
+                    .put(capture->newHandle(_module))
+                    .put(capture->handleID(_context))
+                    .put(capture->blob(ptxCode,strlen(ptxCode))));
+    return _module;
   }
 
 
@@ -778,9 +1479,14 @@ namespace owl {
   // "RELEASE" functions
   // ==================================================================
   template<typename T>
-  void releaseObject(APIHandle *handle)
+  void releaseObject(APIHandle *handle,
+                     CaptureObjectKind objectKind)
   {
     assert(handle);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_RELEASE,CaptureArgs()
+                    .put(objectKind)
+                    .put(capture->handleID(handle)));
 
     // we don't actually _need_ this object, but let's do this just
     // for sanity's sake
@@ -794,37 +1500,43 @@ namespace owl {
   OWL_API void owlBufferRelease(OWLBuffer buffer)
   {
     LOG_API_CALL();
-    releaseObject<Buffer>((APIHandle*)buffer);
+    releaseObject<Buffer>((APIHandle*)buffer,CAPTURE_OBJECT_BUFFER);
+  }
+  
+  OWL_API void owlCommandListRelease(OWLCommandList list)
+  {
+    LOG_API_CALL();
+    releaseObject<CommandList>((APIHandle*)list,CAPTURE_OBJECT_COMMAND_LIST);
   }
   
   OWL_API void owlModuleRelease(OWLModule module) 
   {
     LOG_API_CALL();
-    releaseObject<Module>((APIHandle*)module);
+    releaseObject<Module>((APIHandle*)module,CAPTURE_OBJECT_MODULE);
   }
   
   OWL_API void owlGroupRelease(OWLGroup group)
   {
     LOG_API_CALL();
-    releaseObject<Group>((APIHandle*)group);
+    releaseObject<Group>((APIHandle*)group,CAPTURE_OBJECT_GROUP);
   }
   
   OWL_API void owlRayGenRelease(OWLRayGen handle)
   {
     LOG_API_CALL();
-    releaseObject<RayGen>((APIHandle*)handle);
+    releaseObject<RayGen>((APIHandle*)handle,CAPTURE_OBJECT_RAY_GEN);
   }
   
   OWL_API void owlVariableRelease(OWLVariable variable)
   {
     LOG_API_CALL();
-    releaseObject<Variable>((APIHandle*)variable);
+    releaseObject<Variable>((APIHandle*)variable,CAPTURE_OBJECT_VARIABLE);
   }
   
   OWL_API void owlGeomRelease(OWLGeom geometry)
   {
     LOG_API_CALL();
-    releaseObject<Geom>((APIHandle*)geometry);
+    releaseObject<Geom>((APIHandle*)geometry,CAPTURE_OBJECT_GEOM);
   }
 
   // ==================================================================
@@ -851,6 +1563,13 @@ namespace owl {
     assert(buffer);
 
     triangles->setVertices({buffer},count,stride,offset);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_TRIANGLES_SET_VERTICES,CaptureArgs()
+                    .put(capture->handleID(_triangles))
+                    .putHandles({ capture->handleID(_buffer) })
+                    .put((uint64_t)count)
+                    .put((uint64_t)stride)
+                    .put((uint64_t)offset));
   }
 
   OWL_API void
@@ -886,6 +1605,13 @@ namespace owl {
       buffers.push_back(buffer);
     }
     triangles->setVertices(buffers,count,stride,offset);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_TRIANGLES_SET_VERTICES,CaptureArgs()
+                    .put(capture->handleID(_triangles))
+                    .putHandles(capture->handleIDs(vertexArrays,numKeys))
+                    .put((uint64_t)count)
+                    .put((uint64_t)stride)
+                    .put((uint64_t)offset));
   }
 
   OWL_API void owlGroupBuildAccel(OWLGroup _group)
@@ -897,6 +1623,13 @@ namespace owl {
     Group::SP group
       = ((APIHandle *)_group)->get<Group>();
     assert(group);
+
+    RecordedCommand command;
+    command.kind   = COMMAND_GROUP_BUILD_ACCEL;
+    command.object = group;
+    captureCall(CAPTURE_GROUP_BUILD_ACCEL,_group);
+    if (recordIfRecording(group->context,command))
+      return;
     
     group->buildAccel();
   }  
@@ -936,6 +1669,13 @@ namespace owl {
     Group::SP group
       = ((APIHandle *)_group)->get<Group>();
     assert(group);
+
+    RecordedCommand command;
+    command.kind   = COMMAND_GROUP_REFIT_ACCEL;
+    command.object = group;
+    captureCall(CAPTURE_GROUP_REFIT_ACCEL,_group);
+    if (recordIfRecording(group->context,command))
+      return;
     
     group->refitAccel();
   }  
@@ -961,6 +1701,98 @@ namespace owl {
     assert(buffer);
 
     triangles->setIndices(buffer,count,stride,offset);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_TRIANGLES_SET_INDICES,CaptureArgs()
+                    .put(capture->handleID(_triangles))
+                    .put(capture->handleID(_buffer))
+                    .put((uint64_t)count)
+                    .put((uint64_t)stride)
+                    .put((uint64_t)offset));
+  }
+
+  OWL_API void
+  owlTrianglesSetVertexFormat(OWLGeom _triangles,
+                              OWLVertexFormat format)
+  {
+    LOG_API_CALL();
+    
+    assert(_triangles);
+    
+    TrianglesGeom::SP triangles
+      = ((APIHandle *)_triangles)->get<TrianglesGeom>();
+    assert(triangles);
+
+    triangles->setVertexFormat(format);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_TRIANGLES_SET_VERTEX_FORMAT,CaptureArgs()
+                    .put(capture->handleID(_triangles))
+                    .put((uint32_t)format));
+  }
+
+  OWL_API void
+  owlTrianglesSetIndexFormat(OWLGeom _triangles,
+                             OWLIndexFormat format)
+  {
+    LOG_API_CALL();
+    
+    assert(_triangles);
+    
+    TrianglesGeom::SP triangles
+      = ((APIHandle *)_triangles)->get<TrianglesGeom>();
+    assert(triangles);
+
+    triangles->setIndexFormat(format);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_TRIANGLES_SET_INDEX_FORMAT,CaptureArgs()
+                    .put(capture->handleID(_triangles))
+                    .put((uint32_t)format));
+  }
+
+  OWL_API size_t
+  owlVertexFormatSizeOf(OWLVertexFormat format)
+  {
+    LOG_API_CALL();
+    return vertexFormatSizeOf(format);
+  }
+  
+  OWL_API void
+  owlConvertVertices(void *out,
+                     OWLVertexFormat format,
+                     const float *vertices,
+                     size_t numVertices)
+  {
+    LOG_API_CALL();
+    convertVertices(out,format,vertices,numVertices);
+  }
+
+  OWL_API void
+  owlConvertIndices(void *out,
+                    OWLIndexFormat format,
+                    const int32_t *indices,
+                    size_t numTriangles)
+  {
+    LOG_API_CALL();
+    convertIndices(out,format,indices,numTriangles);
+  }
+
+  OWL_API void
+  owlMeshOptimize(void *vertices,
+                  size_t *numVertices,
+                  size_t vertexStride,
+                  void *indices,
+                  size_t *numTriangles,
+                  size_t indexStride,
+                  uint32_t flags,
+                  float weldEpsilon,
+                  int32_t *vertexRemap,
+                  int32_t *triangleRemap)
+  {
+    LOG_API_CALL();
+    assert(numVertices);
+    assert(numTriangles);
+    mesh::optimizeMesh(vertices,*numVertices,vertexStride,
+                       indices,*numTriangles,indexStride,
+                       flags,weldEpsilon,vertexRemap,triangleRemap);
   }
 
   // ==================================================================
@@ -987,6 +1819,12 @@ namespace owl {
     assert(module);
 
     geometryType->setClosestHitProgram(rayType,module,progName);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_GEOM_TYPE_SET_CLOSEST_HIT,CaptureArgs()
+                    .put(capture->handleID(_geometryType))
+                    .put((int32_t)rayType)
+                    .put(capture->handleID(_module))
+                    .putString(progName));
   }
 
   OWL_API void
@@ -1010,6 +1848,12 @@ namespace owl {
     assert(module);
 
     geometryType->setAnyHitProgram(rayType,module,progName);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_GEOM_TYPE_SET_ANY_HIT,CaptureArgs()
+                    .put(capture->handleID(_geometryType))
+                    .put((int32_t)rayType)
+                    .put(capture->handleID(_module))
+                    .putString(progName));
   }
 
   OWL_API void
@@ -1033,6 +1877,12 @@ namespace owl {
     assert(module);
 
     geometryType->setIntersectProg(rayType,module,progName);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_GEOM_TYPE_SET_INTERSECT_PROG,CaptureArgs()
+                    .put(capture->handleID(_geometryType))
+                    .put((int32_t)rayType)
+                    .put(capture->handleID(_module))
+                    .putString(progName));
   }
   
   OWL_API void
@@ -1055,6 +1905,11 @@ namespace owl {
     assert(module);
 
     geometryType->setBoundsProg(module,progName);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_GEOM_TYPE_SET_BOUNDS_PROG,CaptureArgs()
+                    .put(capture->handleID(_geometryType))
+                    .put(capture->handleID(_module))
+                    .putString(progName));
   }
 
 #define FATAL(error) { std::cerr << "FATAL Error: " << error << std::endl; exit(1); }
@@ -1063,6 +1918,26 @@ namespace owl {
   // "VariableSet" functions, for each element type
   // ==================================================================
 
+  /*! captures setting a plain (non-object) variable to given value */
+  template<typename T>
+  void captureVariableValue(APIHandle *handle,
+                            const Variable &variable,
+                            const T &value)
+  {
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_VARIABLE_SET_VALUE,CaptureArgs()
+                    .put(capture->handleID(handle))
+                    .put((uint32_t)variable.varDecl->type)
+                    .putBytes(&value,sizeof(value)));
+  }
+
+  /*! object variables get captured by their setters, by handle */
+  template<typename T>
+  void captureVariableValue(APIHandle *handle,
+                            const Variable &variable,
+                            const std::shared_ptr<T> &value)
+  {}
+  
   template<typename T>
   void setVariable(APIHandle *handle, const T &value)
   {
@@ -1073,6 +1948,7 @@ namespace owl {
     assert(variable);
 
     variable->set(value);
+    captureVariableValue(handle,*variable,value);
   }
 
 
@@ -1298,6 +2174,10 @@ namespace owl {
       : Group::SP();
     
     setVariable((APIHandle *)_variable,group);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_VARIABLE_SET_GROUP,CaptureArgs()
+                    .put(capture->handleID(_variable))
+                    .put(capture->handleID(_group)));
   }
 
   // ----------- set<other> -----------
@@ -1312,6 +2192,10 @@ namespace owl {
       : Texture::SP();
     
     setVariable((APIHandle *)_variable,texture);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_VARIABLE_SET_TEXTURE,CaptureArgs()
+                    .put(capture->handleID(_variable))
+                    .put(capture->handleID(_texture)));
   }
 
   OWL_API void owlVariableSetBuffer(OWLVariable _variable, OWLBuffer _buffer)
@@ -1325,6 +2209,10 @@ namespace owl {
       : Buffer::SP();
 
     setVariable((APIHandle *)_variable,buffer);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_VARIABLE_SET_BUFFER,CaptureArgs()
+                    .put(capture->handleID(_variable))
+                    .put(capture->handleID(_buffer)));
   }
 
   OWL_API void owlVariableSetRaw(OWLVariable _variable, const void *valuePtr)
@@ -1339,6 +2227,10 @@ namespace owl {
     assert(variable);
 
     variable->setRaw(valuePtr);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_VARIABLE_SET_RAW,CaptureArgs()
+                    .put(capture->handleID(_variable))
+                    .putBytes(valuePtr,sizeOf(variable->varDecl->type)));
   }
 
   OWL_API void owlVariableSetPointer(OWLVariable _variable, const void *valuePtr)
@@ -1353,6 +2245,10 @@ namespace owl {
     assert(variable);
 
     variable->set((uint64_t)valuePtr);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_VARIABLE_SET_POINTER,CaptureArgs()
+                    .put(capture->handleID(_variable))
+                    .put((uint64_t)valuePtr));
   }
 
   // -------------------------------------------------------
@@ -1374,6 +2270,11 @@ namespace owl {
     assert(child);
 
     group->setChild(whichChild, child);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_INSTANCE_GROUP_SET_CHILD,CaptureArgs()
+                    .put(capture->handleID(_group))
+                    .put((int32_t)whichChild)
+                    .put(capture->handleID(_child)));
   }
 
   /*! this function allows to set up to N different arrays of trnsforms
@@ -1392,6 +2293,14 @@ namespace owl {
     assert(group);
 
     group->setTransforms(timeStep,floatsForThisStimeStep,matrixFormat);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_INSTANCE_GROUP_SET_TRANSFORMS,CaptureArgs()
+                    .put(capture->handleID(_group))
+                    .put((uint32_t)timeStep)
+                    .put((uint32_t)matrixFormat)
+                    .put(capture->blob(floatsForThisStimeStep,
+                                       group->children.size()
+                                       *floatsPerMatrix(matrixFormat)*sizeof(float))));
   }
   
   /*! this function allows to set up to N different arrays of trnsforms
@@ -1408,6 +2317,44 @@ namespace owl {
     assert(group);
 
     group->setInstanceIDs(instanceIDs);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_INSTANCE_GROUP_SET_INSTANCE_IDS,CaptureArgs()
+                    .put(capture->handleID(_group))
+                    .put(capture->blob(instanceIDs,group->children.size()*sizeof(uint32_t))));
+  }
+
+  OWL_API void
+  owlInstanceGroupSetVisibilityMasks(OWLGroup _group,
+                                     const uint8_t *visibilityMasks)
+  {
+    LOG_API_CALL();
+
+    assert(_group);
+    InstanceGroup::SP group = ((APIHandle*)_group)->get<InstanceGroup>();
+    assert(group);
+
+    group->setVisibilityMasks(visibilityMasks);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_INSTANCE_GROUP_SET_VISIBILITY_MASKS,CaptureArgs()
+                    .put(capture->handleID(_group))
+                    .put(capture->blob(visibilityMasks,group->children.size()*sizeof(uint8_t))));
+  }
+
+  OWL_API void
+  owlInstanceGroupSetInstanceFlags(OWLGroup _group,
+                                   const uint32_t *instanceFlags)
+  {
+    LOG_API_CALL();
+
+    assert(_group);
+    InstanceGroup::SP group = ((APIHandle*)_group)->get<InstanceGroup>();
+    assert(group);
+
+    group->setInstanceFlags(instanceFlags);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_INSTANCE_GROUP_SET_INSTANCE_FLAGS,CaptureArgs()
+                    .put(capture->handleID(_group))
+                    .put(capture->blob(instanceFlags,group->children.size()*sizeof(uint32_t))));
   }
   
   OWL_API void
@@ -1419,26 +2366,17 @@ namespace owl {
     LOG_API_CALL();
 
     assert("check for valid transform" && floats != nullptr);
-    affine3f xfm;
-    switch(matrixFormat) {
-    case OWL_MATRIX_FORMAT_OWL:
-      xfm = *(const affine3f*)floats;
-      break;
-    case OWL_MATRIX_FORMAT_ROW_MAJOR:
-      xfm.l.vx = vec3f(floats[0+0],floats[4+0],floats[8+0]);
-      xfm.l.vy = vec3f(floats[0+1],floats[4+1],floats[8+1]);
-      xfm.l.vz = vec3f(floats[0+2],floats[4+2],floats[8+2]);
-      xfm.p    = vec3f(floats[0+3],floats[4+3],floats[8+3]);
-      break;
-    default: 
-      FATAL("un-recognized matrix format");
-    }
-    
     assert(_group);
     InstanceGroup::SP group = ((APIHandle*)_group)->get<InstanceGroup>();
     assert(group);
 
-    group->setTransform(whichChild, xfm);
+    group->setTransform(whichChild, floats, matrixFormat);
+    if (CaptureWriter::SP capture = getCapture())
+      capture->call(CAPTURE_INSTANCE_GROUP_SET_TRANSFORM,CaptureArgs()
+                    .put(capture->handleID(_group))
+                    .put((int32_t)whichChild)
+                    .put((uint32_t)matrixFormat)
+                    .putBytes(floats,floatsPerMatrix(matrixFormat)*sizeof(float)));
   }
 
   
@@ -40,12 +40,57 @@ namespace owl {
   }
 
   /*! return dimensions of a 2-dimensional optix launch. For 1- or
-    3-dimensional launches we'll need separate functions */
+    3-dimensional launches, use getLaunchDims1D/getLaunchDims3D */
   inline __device__ vec2i getLaunchDims()
   {
     return (vec2i)optixGetLaunchDimensions();
   }
 
+  /*! launch index within a 1-dimensional launch (owlLaunch1D) */
+  inline __device__ int getLaunchIndex1D()
+  {
+    return (int)optixGetLaunchIndex().x;
+  }
+
+  /*! dimensions of a 1-dimensional launch (owlLaunch1D) */
+  inline __device__ int getLaunchDims1D()
+  {
+    return (int)optixGetLaunchDimensions().x;
+  }
+
+  /*! launch index within a 3-dimensional launch (owlLaunch3D) */
+  inline __device__ vec3i getLaunchIndex3D()
+  {
+    return (vec3i)optixGetLaunchIndex();
+  }
+
+  /*! dimensions of a 3-dimensional launch (owlLaunch3D) */
+  inline __device__ vec3i getLaunchDims3D()
+  {
+    return (vec3i)optixGetLaunchDimensions();
+  }
+
+  /*! with launch tiling (owlParamsEnableLaunchTiling), the index
+      within the full launch, given the tile offset variable OWL
+      wrote into the launch params; getLaunchDims* only return the
+      current tile's size */
+  inline __device__ int getLaunchIndex1D(const vec3i &tileOffset)
+  {
+    return getLaunchIndex1D()+tileOffset.x;
+  }
+
+  /*! \see getLaunchIndex1D(const vec3i &) */
+  inline __device__ vec2i getLaunchIndex(const vec3i &tileOffset)
+  {
+    return getLaunchIndex()+vec2i(tileOffset.x,tileOffset.y);
+  }
+
+  /*! \see getLaunchIndex1D(const vec3i &) */
+  inline __device__ vec3i getLaunchIndex3D(const vec3i &tileOffset)
+  {
+    return getLaunchIndex3D()+tileOffset;
+  }
+
   /*! return pointer to currently running program's "SBT Data" (which
       is pretty much what in owl we call the Program Data/Program
       Variables Struct. This method returns an untyped pointer, for
@@ -152,7 +197,11 @@ namespace owl {
   void traceRay(OptixTraversableHandle traversable,
                 const RayType &ray,
                 PRD           &prd,
-                uint32_t rayFlags = 0u)
+                uint32_t rayFlags = 0u,
+                /*! only instances whose visibility mask (see
+                    owlInstanceGroupSetVisibilityMasks) shares at
+                    least one bit with this mask will be visited */
+                uint32_t rayMask = 0xffu)
   {
     unsigned int           p0 = 0;
     unsigned int           p1 = 0;
@@ -164,7 +213,7 @@ namespace owl {
                ray.tmin,
                ray.tmax,
                ray.time,
-               (OptixVisibilityMask)-1,
+               (OptixVisibilityMask)rayMask,
                /*rayFlags     */rayFlags,
                /*SBToffset    */ray.rayType,
                /*SBTstride    */ray.numRayTypes,
@@ -179,7 +228,8 @@ namespace owl {
              const Ray &ray,
              int numRayTypes,
              PRD &prd,
-             int sbtOffset = 0)
+             int sbtOffset = 0,
+             uint32_t rayMask = 0xffu)
   {
     unsigned int           p0 = 0;
     unsigned int           p1 = 0;
@@ -191,7 +241,7 @@ namespace owl {
                ray.tmin,
                ray.tmax,
                ray.time,
-               (OptixVisibilityMask)-1,
+               (OptixVisibilityMask)rayMask,
                /*rayFlags     */0u,
                /*SBToffset    */ray.rayType + numRayTypes*sbtOffset,
                /*SBTstride    */numRayTypes,
@@ -91,10 +91,38 @@ typedef enum
    
    /*! 3x4-float *row-major* layout as preferred by optix; in this
      case it doesn't matter if it's a 4x3 or 4x4 matrix, since the
-     last row in a 4x4 row major matrix can simply be ignored */
-   OWL_MATRIX_FORMAT_ROW_MAJOR
+     last row in a 4x4 row major matrix can simply be ignored. Note
+     that for *arrays* of matrices (owlInstanceGroupSetTransforms)
+     this format expects densely packed 3x4 (ie, 12-float)
+     matrices */
+   OWL_MATRIX_FORMAT_ROW_MAJOR,
+
+   /*! 4x4-float *column-major* layout (ie, 16 floats per matrix, as
+     used by OpenGL and most engines' math libraries); the last row
+     of the matrix is ignored */
+   OWL_MATRIX_FORMAT_COLUMN_MAJOR_4X4
   } OWLMatrixFormat;
 
+/*! per-instance flags that can be specified for the children of an
+  instance group (see owlInstanceGroupSetInstanceFlags); values may
+  be or'ed together, and match the respective OPTIX_INSTANCE_FLAG_*
+  values */
+typedef enum
+  {
+   OWL_INSTANCE_FLAG_NONE                          = 0x0,
+   /*! disable face culling for triangles in this instance */
+   OWL_INSTANCE_FLAG_DISABLE_TRIANGLE_FACE_CULLING = 0x1,
+   /*! flip the facing (ie, the meaning of front vs back face) of
+     triangles in this instance */
+   OWL_INSTANCE_FLAG_FLIP_TRIANGLE_FACING          = 0x2,
+   /*! treat all geometry in this instance as opaque, ie, never call
+     any anyhit programs for it */
+   OWL_INSTANCE_FLAG_DISABLE_ANYHIT                = 0x4,
+   /*! treat all geometry in this instance as non-opaque, ie, always
+     call any anyhit programs */
+   OWL_INSTANCE_FLAG_ENFORCE_ANYHIT                = 0x8
+  } OWLInstanceFlags;
+
 typedef enum
   {
    OWL_SBT_HITGROUPS = 0x1,
@@ -189,6 +217,14 @@ typedef enum
    OWL_BOOL2,
    OWL_BOOL3,
    OWL_BOOL4,
+
+   /*! IEEE 16-bit 'half' floats; currently only supported as buffer
+     element types (eg, for compact vertex arrays), not as
+     variables */
+   OWL_HALF=1100,
+   OWL_HALF2,
+   OWL_HALF3,
+   OWL_HALF4,
    
    /*! just another name for a 64-bit data type - unlike
      OWL_BUFFER_POINTER's (which gets translated from OWLBuffer's
@@ -304,6 +340,57 @@ typedef enum {
 }
 OWLTextureColorSpace;
 
+/*! formats in which triangle vertices can be stored, \see
+    owlTrianglesSetVertexFormat */
+typedef enum {
+  /*! derive the format from the vertex buffer's data type: OWL_FLOAT2,
+    OWL_HALF3/OWL_HALF2, and OWL_SHORT3/OWL_SHORT2 map to the
+    respective formats below; everything else is treated as FLOAT3 */
+  OWL_VERTEX_FORMAT_FROM_BUFFER=0,
+  OWL_VERTEX_FORMAT_FLOAT3,
+  /*! x and y only, with z implicitly 0 */
+  OWL_VERTEX_FORMAT_FLOAT2,
+  OWL_VERTEX_FORMAT_HALF3,
+  OWL_VERTEX_FORMAT_HALF2,
+  /*! signed, normalized 16-bit ints, ie, [-32767,+32767] maps to
+    [-1,+1]; meshes have to be scaled into that range (and placed
+    via an instance transform) */
+  OWL_VERTEX_FORMAT_SNORM16_3,
+  OWL_VERTEX_FORMAT_SNORM16_2
+}
+OWLVertexFormat;
+
+/*! formats in which triangle indices can be stored, \see
+    owlTrianglesSetIndexFormat */
+typedef enum {
+  /*! derive the format from the index buffer's data type: OWL_USHORT3
+    and OWL_SHORT3 map to USHORT3, everything else to UINT3 */
+  OWL_INDEX_FORMAT_FROM_BUFFER=0,
+  OWL_INDEX_FORMAT_UINT3,
+  OWL_INDEX_FORMAT_USHORT3
+}
+OWLIndexFormat;
+
+/*! what owlMeshOptimize() should do; the steps always get applied in
+    this order */
+typedef enum {
+  /*! merge vertices with identical positions (or, with a non-zero
+    weld epsilon, positions that snap to the same grid cell) and
+    identical remaining vertex data */
+  OWL_MESH_OPTIMIZE_WELD_VERTICES       = 1<<0,
+  /*! remove triangles with two identical indices or zero area, and
+    triangles that repeat an earlier one (with the same winding) */
+  OWL_MESH_OPTIMIZE_REMOVE_DEGENERATES  = 1<<1,
+  /*! sort triangles along a morton curve */
+  OWL_MESH_OPTIMIZE_SPATIAL_ORDER       = 1<<2,
+  /*! re-order (spatially close) triangles for vertex re-use */
+  OWL_MESH_OPTIMIZE_VERTEX_CACHE_ORDER  = 1<<3,
+  /*! order vertices by first use, and drop unused ones */
+  OWL_MESH_OPTIMIZE_VERTEX_FETCH_ORDER  = 1<<4,
+  OWL_MESH_OPTIMIZE_ALL                 = 0x1f
+}
+OWLMeshOptimizeFlags;
+
 // ------------------------------------------------------------------
 // device-objects - size of those _HAS_ to match the device-side
 // definition of these types
@@ -333,8 +420,152 @@ typedef struct _OWLMissProg      *OWLMissProg;
   all programs within a given launch */
 typedef struct _OWLLaunchParams  *OWLLaunchParams, *OWLParams, *OWLGlobals;
 
+/*! a recorded sequence of owl operations that can get replayed
+    with minimal host overhead; \see owlCommandListBegin */
+typedef struct _OWLCommandList   *OWLCommandList;
+
 OWL_API void owlBuildPrograms(OWLContext context);
 OWL_API void owlBuildPipeline(OWLContext context);
+
+/*! what the most recent owlBuildPrograms() and owlBuildPipeline()
+  had to (re-)build, and what they could re-use from previous builds
+  (counts are summed over all devices); times are wall-clock seconds
+  for the respective phase */
+typedef struct _OWLBuildStats {
+  double  moduleBuildTime;
+  int32_t numModulesBuilt;
+  int32_t numModulesReused;
+  double  programGroupBuildTime;
+  int32_t numProgramGroupsBuilt;
+  int32_t numProgramGroupsReused;
+  double  pipelineBuildTime;
+  int32_t numPipelinesBuilt;
+  int32_t numPipelinesReused;
+} OWLBuildStats;
+
+OWL_API void owlContextGetBuildStats(OWLContext context,
+                                     OWLBuildStats *stats);
+
+/*! what gets timed on the GPU when timing is enabled (\see
+    owlContextEnableTiming) */
+typedef enum {
+  /*! each launch (all of its sub-launches, if tiled) */
+  OWL_TIMING_LAUNCH = 0,
+  /*! each accel build or refit */
+  OWL_TIMING_ACCEL_BUILD,
+  /*! each owlBufferUpload to a device buffer */
+  OWL_TIMING_BUFFER_UPLOAD,
+  OWL_TIMING_NUM_KINDS
+} OWLTimingKind;
+
+/*! GPU-side timings of one kind of operation on one device, measured
+    with cuda events; all times are in milliseconds. min, mean and
+    p99 are over a sliding window of the most recent 'windowSize'
+    measurements */
+typedef struct _OWLTimingStats {
+  /*! number of measurements since the last reset */
+  uint64_t count;
+  /*! number of (most recent) measurements the stats are over */
+  int32_t  windowSize;
+  float    last;
+  float    min;
+  float    mean;
+  float    p99;
+} OWLTimingStats;
+
+/*! enables (or disables) recording cuda events around every launch,
+    accel build, and buffer upload; off by default */
+OWL_API void owlContextEnableTiming(OWLContext context, int32_t enabled);
+
+/*! returns the timing stats of given kind of operation on given
+    device. Only includes operations that completed on the GPU by the
+    time of this call; does not wait for any */
+OWL_API void owlContextGetTimingStats(OWLContext context,
+                                      int32_t deviceID,
+                                      OWLTimingKind kind,
+                                      OWLTimingStats *stats);
+
+/*! clears all timing stats, on all devices */
+OWL_API void owlContextResetTimingStats(OWLContext context);
+
+/*! enables (or disables) recording a timeline of all api calls and
+    of the internal phases (module, program and SBT builds, accel
+    builds, uploads, launches) they go through, per thread. Off by
+    default; applies to all contexts */
+OWL_API void owlEnableTracing(int32_t enabled);
+
+/*! writes everything traced since the last flush into the given file,
+    in the chrome trace-event json format (for chrome://tracing or
+    ui.perfetto.dev), and starts over */
+OWL_API void owlFlushTrace(const char *fileName);
+
+/*! starts recording all (state-changing) api calls, with their
+    arguments and all data they pass in, into the given file, for
+    later replay with the owlReplay tool. Buffer contents get stored
+    by content, so data that gets uploaded over and over is stored
+    only once. Only objects created after this call can be replayed,
+    so this should be called before owlContextCreate */
+OWL_API void owlCaptureBegin(const char *fileName);
+
+/*! stops recording api calls, and closes the capture file */
+OWL_API void owlCaptureEnd();
+
+/*! how severe a log message is; a message gets logged if its level
+    is at most the current log level */
+typedef enum {
+  /*! as a log level: log nothing */
+  OWL_LOG_LEVEL_NONE = 0,
+  OWL_LOG_LEVEL_ERROR,
+  OWL_LOG_LEVEL_WARNING,
+  /*! once-per-context things: devices found, pipeline built, ... */
+  OWL_LOG_LEVEL_INFO,
+  /*! things that happen on every build: accels, SBTs, modules */
+  OWL_LOG_LEVEL_DEBUG
+} OWLLogLevel;
+
+/*! what part of owl a log message comes from; categories get
+    enabled as a bit mask */
+typedef enum {
+  /*! context and device setup and teardown */
+  OWL_LOG_CATEGORY_CONTEXT = 0x1,
+  /*! modules, programs, pipeline, and SBT */
+  OWL_LOG_CATEGORY_BUILD   = 0x2,
+  /*! acceleration structures */
+  OWL_LOG_CATEGORY_ACCEL   = 0x4,
+  /*! buffers and textures */
+  OWL_LOG_CATEGORY_MEMORY  = 0x8,
+  /*! api-level bookkeeping (captures, ...) */
+  OWL_LOG_CATEGORY_API     = 0x10,
+  OWL_LOG_CATEGORY_ALL     = 0x7fffffff
+} OWLLogCategory;
+
+/*! receives log messages, in the order they got logged (per
+    thread). Gets called from owl's log writer thread, not from the
+    thread that logged, unless for errors */
+typedef void (*OWLLogCallback)(OWLLogLevel level,
+                               uint32_t    category,
+                               const char *message,
+                               void       *userData);
+
+/*! sets the most detailed level of messages that get logged. Defaults
+    to OWL_LOG_LEVEL_INFO in debug builds, and OWL_LOG_LEVEL_WARNING
+    otherwise; the OWL_LOG_LEVEL environment variable ('none',
+    'error', 'warning', 'info', or 'debug') overrides that default */
+OWL_API void owlLogSetLevel(OWLLogLevel level);
+
+/*! sets which categories (a bitwise or of OWLLogCategory values) get
+    logged; all, by default */
+OWL_API void owlLogSetCategories(uint32_t categories);
+
+/*! sends all log messages to the given callback rather than to the
+    console; null restores the console */
+OWL_API void owlLogSetCallback(OWLLogCallback callback,
+                               void *userData);
+
+/*! log messages get queued, and written out by a background thread;
+    this writes out everything logged so far */
+OWL_API void owlLogFlush();
+
 OWL_API void owlBuildSBT(OWLContext context,
                          OWLBuildSBTFlags flags OWL_IF_CPP(=OWL_SBT_ALL));
 
@@ -368,6 +599,127 @@ owlContextCreate(int32_t *requestedDeviceIDs OWL_IF_CPP(=nullptr),
 OWL_API void
 owlEnableMotionBlur(OWLContext _context);
 
+/*! for multi-GPU contexts: build (and compact) triangle and user
+    geometry accels only once, on the first device, and then copy the
+    result to all other devices via optix' accel relocation, rather
+    than running the full build on every device. Devices whose GPU
+    architecture is not relocation-compatible with the first device
+    automatically fall back to building on their own. Has no effect
+    for single-GPU contexts */
+OWL_API void
+owlEnableAccelRelocation(OWLContext context);
+
+/*! allow triangle and user geometry groups whose total primitive
+    count exceeds optix' MAX_PRIMITIVES_PER_GAS limit to get split
+    into several chunks (of consecutive primitives), rather than
+    throwing an error. This is transparent to the application: the
+    group still behaves like a single group (primitive IDs and SBT
+    layout remain the same), and instance groups over split groups
+    simply get one instance per chunk. Note that split groups cannot
+    be relocated or cached.
+
+    Chunks are ranges of consecutive primitives (in the order of the
+    group's geometries, and of each geometry's primitives), *not* a
+    spatial partition - keeping primitive IDs unchanged requires
+    that. Chunks of an unsorted mesh thus overlap, and rays end up
+    traversing all of them; for meshes large enough to get split,
+    callers should sort their triangles spatially first (e.g., with
+    owlMeshOptimize() and OWL_MESH_OPTIMIZE_SPATIAL_ORDER), and
+    user geometries should number their primitives in a spatially
+    coherent order */
+OWL_API void
+owlEnableAccelSplitting(OWLContext context);
+
+/*! share accels between triangle geom groups of identical content:
+    on every (full) build, a group's vertex and index data get hashed,
+    and if another group with the same content (same number of
+    geometries, same formats, same vertex and index values) already
+    has an accel, this group simply re-uses that one instead of
+    building its own. Each group keeps its own SBT entries, so
+    duplicates can still use different materials. Meant for imported
+    scenes that contain the same mesh many times, as separate groups
+    with separate buffers.
+
+    Only whole groups get shared: the same mesh appearing several
+    times as separate geometries *within* one group (or in groups
+    that otherwise differ) still gets built as often as it appears -
+    to share such meshes, give each its own group, and instance
+    those.
+
+    Hashing requires reading back the vertex and index data on the
+    first build, so this is off by default; later builds only read
+    back buffers that got uploaded to or resized since (or whose
+    device pointer got handed out, so they may have changed without
+    OWL knowing). Groups that get split (\see
+    owlEnableAccelSplitting) are never shared */
+OWL_API void
+owlEnableAccelDedup(OWLContext context);
+
+/*! what sharing accels between identical groups (\see
+    owlEnableAccelDedup) currently saves */
+typedef struct _OWLAccelDedupStats {
+  /*! number of accels that are used by more than one group */
+  size_t numSharedAccels;
+  /*! number of groups that use another group's accel instead of
+    their own */
+  size_t numDeduplicatedGroups;
+  /*! accel memory (per device) that those groups did not need */
+  size_t accelBytesSaved;
+  /*! vertex and index buffer memory (per device) of those groups'
+    geometries; these buffers are owned by the application, so OWL
+    cannot release them - but the application could, by having the
+    duplicate geometries use the same buffers */
+  size_t duplicateBufferBytes;
+} OWLAccelDedupStats;
+
+OWL_API void
+owlGetAccelDedupStats(OWLContext context,
+                      OWLAccelDedupStats *stats);
+
+/*! for multi-GPU contexts: rather than uploading device buffer
+    contents from host memory to each device separately, upload them
+    only once, to the device nearest to the host, and copy them on
+    from there to all other devices, over NVLink or PCIe peer access,
+    in a tree (so each device's data gets passed on while it's still
+    arriving). Devices that no other device has peer access to still
+    get their own upload; these then get pipelined through pinned
+    host memory, in chunks. Only applies to buffers of plain data
+    (not buffers of buffers or textures), and not to small uploads;
+    has no effect for single-GPU contexts */
+OWL_API void
+owlEnableUploadReplication(OWLContext context);
+
+/*! enable a persistent, on-disk cache for triangle and user geometry
+    accels: every accel gets stored (in the given directory) under a
+    hash of its build inputs, and later (full) builds over the same
+    content - in this or any later run of the application - simply
+    re-load that accel instead of building it again. Once the cache
+    exceeds 'maxSizeInBytes' the least recently used accels get
+    evicted. Cached accels are only re-used on the same GPU
+    architecture, driver, and optix version they were built
+    with. Passing a null directory disables the cache again. Only one
+    process at a time should use a given cache directory */
+OWL_API void
+owlContextSetAccelCache(OWLContext context,
+                        const char *directory,
+                        size_t maxSizeInBytes);
+
+/*! enable a persistent, on-disk cache for compiled modules, in the
+    given directory: modules get stored under a key of their PTX code,
+    compile options, GPU architecture, and driver version, so later
+    builds of the same modules - in this or any later run of the
+    application - skip the (expensive) compilation. This uses optix'
+    own compilation cache; once it exceeds 'maxSizeInBytes' older
+    entries get evicted. Passing a null directory disables the cache.
+
+    Note that independent of this cache, owlBuildPrograms() only ever
+    re-compiles modules if their compile options changed since the
+    last build, and compiles all others in parallel */
+OWL_API void
+owlContextSetModuleCache(OWLContext context,
+                         const char *directory,
+                         size_t maxSizeInBytes);
+
 /*! set number of ray types to be used in this context; this should be
   done before any programs, pipelines, geometries, etc get
   created */
@@ -400,6 +752,40 @@ owlContextSetRayTypeCount(OWLContext context,
 OWL_API void
 owlSetMaxInstancingDepth(OWLContext context,
                          int32_t maxInstanceDepth);
+
+/*! sets the maximum recursion depth of optixTrace() calls in this
+  context: '1' means only raygen programs trace rays, '2' means that
+  closest hit or miss programs may trace (shadow) rays of their own,
+  etc. Default is 2. The pipeline's stack size gets computed from
+  this value and the stack sizes of the actual programs, so a value
+  larger than required wastes memory (and occupancy), and a value
+  that is too small will crash recursive programs. Takes effect
+  with the next owlBuildPipeline() */
+OWL_API void
+owlContextSetMaxTraceDepth(OWLContext context,
+                           int maxTraceDepth);
+
+/*! sets the number of 32-bit payload values that programs get
+  compiled for (default 2, which is what OWL's per-ray data pointer
+  uses). Takes effect with the next owlBuildPrograms(), which will
+  re-compile all modules if this value changed */
+OWL_API void
+owlContextSetNumPayloadValues(OWLContext context,
+                              int numPayloadValues);
+
+/*! sets the number of 32-bit attribute values that programs get
+  compiled for (2..8, default 2). Takes effect with the next
+  owlBuildPrograms() */
+OWL_API void
+owlContextSetNumAttributeValues(OWLContext context,
+                                int numAttributeValues);
+
+/*! sets the maximum number of registers per thread that programs get
+  compiled for (default 50; 0 means "let optix decide"). Takes effect
+  with the next owlBuildPrograms() */
+OWL_API void
+owlContextSetMaxRegisterCount(OWLContext context,
+                              int maxRegisterCount);
   
 
 OWL_API void
@@ -669,6 +1055,14 @@ owlBufferUpload(OWLBuffer buffer,
 OWL_API void
 owlRayGenLaunch2D(OWLRayGen rayGen, int dims_x, int dims_y);
 
+/*! same as owlRayGenLaunch2D, but for a 1-dimensional launch */
+OWL_API void
+owlRayGenLaunch1D(OWLRayGen rayGen, int dims_x);
+
+/*! same as owlRayGenLaunch2D, but for a 3-dimensional launch */
+OWL_API void
+owlRayGenLaunch3D(OWLRayGen rayGen, int dims_x, int dims_y, int dims_z);
+
 /*! perform a raygen launch with lauch parameters, in a *synchronous*
     way; it, by the time this function returns the launch is completed */
 OWL_API void
@@ -682,10 +1076,104 @@ OWL_API void
 owlAsyncLaunch2D(OWLRayGen rayGen, int dims_x, int dims_y,
                  OWLParams params);
 
+/*! 1- and 3-dimensional versions of owlLaunch2D/owlAsyncLaunch2D;
+    on the device, use getLaunchIndex1D()/getLaunchIndex3D() (and
+    the respective getLaunchDims variants) */
+OWL_API void
+owlLaunch1D(OWLRayGen rayGen, int dims_x, OWLParams params);
+OWL_API void
+owlAsyncLaunch1D(OWLRayGen rayGen, int dims_x, OWLParams params);
+OWL_API void
+owlLaunch3D(OWLRayGen rayGen, int dims_x, int dims_y, int dims_z,
+            OWLParams params);
+OWL_API void
+owlAsyncLaunch3D(OWLRayGen rayGen, int dims_x, int dims_y, int dims_z,
+                 OWLParams params);
+
+/*! enables automatic tiling of launches done with these params: a
+    launch with more than 'maxTileSize' threads (0 meaning the optix
+    launch size limit of 2^30 threads) gets split into several
+    sub-launches. Before each sub-launch, OWL writes that tile's
+    offset within the full launch into the given OWL_INT3 variable
+    of the params, so the device can compute its full-launch index
+    as getLaunchIndex3D()+optixLaunchParams.<offsetVar> (see the
+    getLaunchIndex overloads that take a tile offset); getLaunchDims
+    returns the size of the current tile. Without tiling, launches
+    beyond the optix limit throw an error */
+OWL_API void
+owlParamsEnableLaunchTiling(OWLParams params,
+                            const char *offsetVarName,
+                            size_t maxTileSize OWL_IF_CPP(=0));
+
+/*! enables multi-GPU load balancing for launches done with these
+    params: rather than every device doing the full launch, the
+    launch gets cut into work tiles of 'tileSize' rows (or slices,
+    for 3D launches; or elements, for 1D ones), and each device only
+    launches over its own contiguous range of those. Ranges get
+    rebalanced on every launch, based on an exponentially weighted
+    moving average (with weight 'smoothing' for the newest sample)
+    of each device's measured speed in earlier launches, so faster
+    GPUs get more work. Each device's offset within the full launch
+    gets written into the given OWL_INT3 variable, exactly as with
+    owlParamsEnableLaunchTiling (which this implies); device code
+    has to add it to its launch index (eg, getLaunchIndex(offset)) */
+OWL_API void
+owlParamsEnableLoadBalancing(OWLParams params,
+                             const char *offsetVarName,
+                             int tileSize OWL_IF_CPP(=32),
+                             float smoothing OWL_IF_CPP(=.25f));
+
+/*! with load balancing, the fraction of the last launch's work that
+    the given device got */
+OWL_API float
+owlParamsGetDeviceWorkShare(OWLParams params, int deviceID);
+
 
 OWL_API CUstream
 owlParamsGetCudaStream(OWLParams params, int deviceID);
 
+/*! sets how many launches with these params can be in flight at the
+    same time: each device cycles through a ring of this many copies
+    of the params, so owlAsyncLaunch* can be issued back-to-back, and
+    only has to wait once a launch wants a copy whose previous launch
+    hasn't completed yet (default: 3). Launches with the same params
+    still execute in order, on the params' stream */
+OWL_API void
+owlParamsSetRingSize(OWLParams params, int numSlots);
+
+// ==================================================================
+// command lists
+// ==================================================================
+
+/*! starts recording a command list: until owlCommandListEnd, calls
+    to owlBufferUpload, owlGroupBuildAccel, owlGroupRefitAccel, any
+    of the owlLaunch, owlAsyncLaunch, and owlRayGenLaunch variants,
+    and owlLaunchSync do *not* get executed, but recorded into the
+    list. All other calls execute as usual. */
+OWL_API void
+owlCommandListBegin(OWLContext context);
+
+/*! ends recording, and returns the recorded command list */
+OWL_API OWLCommandList
+owlCommandListEnd(OWLContext context);
+
+/*! replays all commands in the list, in order. Buffer uploads read
+    their data from the recorded host pointers, and launches use
+    their launch params' current values - both at the time of the
+    replay. If the list only contains uploads to device buffers,
+    launches (without tiling or load balancing) and launch syncs, it
+    gets replayed as one cuda graph per device; otherwise, as a loop
+    over the already resolved commands. */
+OWL_API void
+owlCommandListReplay(OWLCommandList list);
+
+/*! returns whether the list gets replayed as a cuda graph */
+OWL_API int32_t
+owlCommandListUsesGraph(OWLCommandList list);
+
+OWL_API void
+owlCommandListRelease(OWLCommandList list);
+
 /*! wait for the async launch to finish */
 OWL_API void
 owlLaunchSync(OWLParams params);
@@ -717,6 +1205,67 @@ OWL_API void owlTrianglesSetIndices(OWLGeom triangles,
                                     size_t stride,
                                     size_t offset);
 
+/*! explicitly specify the format of this geom's vertices (which
+    otherwise gets derived from the vertex buffer's data type). Stride
+    and offset passed to owlTrianglesSetVertices() get checked against
+    this format when the geom's group gets built */
+OWL_API void owlTrianglesSetVertexFormat(OWLGeom triangles,
+                                         OWLVertexFormat format);
+
+/*! explicitly specify the format of this geom's indices (which
+    otherwise gets derived from the index buffer's data type) */
+OWL_API void owlTrianglesSetIndexFormat(OWLGeom triangles,
+                                        OWLIndexFormat format);
+
+/*! returns the size of a single vertex in given format */
+OWL_API size_t owlVertexFormatSizeOf(OWLVertexFormat format);
+
+/*! converts 'numVertices' float3 vertices (densely packed, ie, 3
+    floats each) into given (compact) vertex format, densely packed
+    in 'out' (ie, with a stride of owlVertexFormatSizeOf(format)). For
+    the SNORM16 formats input values get clamped to [-1,+1] */
+OWL_API void owlConvertVertices(void *out,
+                                OWLVertexFormat format,
+                                const float *vertices,
+                                size_t numVertices);
+
+/*! converts 'numTriangles' int3 index triplets (densely packed) into
+    given index format, densely packed in 'out'; throws an error if
+    any index does not fit */
+OWL_API void owlConvertIndices(void *out,
+                               OWLIndexFormat format,
+                               const int32_t *indices,
+                               size_t numTriangles);
+
+/*! host-side optimization of a triangle mesh for memory locality,
+    before it gets uploaded: vertices are float3's at the start of
+    each 'vertexStride'-byte record, and indices int3's at the start
+    of each 'indexStride'-byte record (ie, the same layout as passed
+    to owlTrianglesSetVertices()/owlTrianglesSetIndices(); a stride
+    of 0 means densely packed). Any data following the positions
+    (indices) in a record gets moved along with them.
+
+    Both arrays get modified in place, and '*numVertices' and
+    '*numTriangles' get updated to the new (possibly smaller)
+    counts. If non-null, 'vertexRemap' (of the original vertex
+    count) and 'triangleRemap' (of the original triangle count)
+    receive, for each input vertex and triangle, its index in the
+    output, or -1 if it got removed - eg, for re-ordering other
+    per-vertex or per-primitive arrays the same way.
+
+    'flags' is a combination of OWLMeshOptimizeFlags. All steps run
+    in parallel (if OWL was built with TBB) */
+OWL_API void owlMeshOptimize(void *vertices,
+                             size_t *numVertices,
+                             size_t vertexStride,
+                             void *indices,
+                             size_t *numTriangles,
+                             size_t indexStride,
+                             uint32_t flags,
+                             float weldEpsilon,
+                             int32_t *vertexRemap,
+                             int32_t *triangleRemap);
+
 // -------------------------------------------------------
 // group/hierarchy creation and setting
 // -------------------------------------------------------
@@ -750,11 +1299,31 @@ owlInstanceGroupSetTransforms(OWLGroup group,
     the instance ID of child #i is simply i, but optix allows to
     specify a user-defined instnace ID for each instance, which with
     owl can be done through this array. Array size must match number
-    of instances in the specified group */
+    of instances in the specified group; passing null goes back to
+    the default IDs */
 OWL_API void
 owlInstanceGroupSetInstanceIDs(OWLGroup group,
                                const uint32_t *instanceIDs);
 
+/*! sets the (8-bit) visibility masks to use for the child
+    instances. A ray will only visit instance #i if the bitwise and of
+    the ray's mask (see owl::traceRay) and visibilityMasks[i] is
+    non-zero. By default every instance is visible to every ray. Array
+    size must match number of instances in the specified group;
+    passing null goes back to the default (0xff for all instances) */
+OWL_API void
+owlInstanceGroupSetVisibilityMasks(OWLGroup group,
+                                   const uint8_t *visibilityMasks);
+
+/*! sets the instance flags (a bitwise or of OWLInstanceFlags values)
+    to use for the child instances, eg, to disable anyhit programs for
+    opaque instances. By default, all instances use
+    OWL_INSTANCE_FLAG_NONE. Array size must match number of instances
+    in the specified group; passing null goes back to that default */
+OWL_API void
+owlInstanceGroupSetInstanceFlags(OWLGroup group,
+                                 const uint32_t *instanceFlags);
+
 OWL_API void
 owlGeomTypeSetClosestHit(OWLGeomType type,
                          int rayType,
@@ -784,6 +1353,18 @@ OWL_API void
 owlGeomSetPrimCount(OWLGeom geom,
                     size_t  primCount);
 
+/*! specify the primitive bounds of the given user geometry directly,
+  through a buffer of (at least) primCount box3f's (ie, 6 floats per
+  primitive: lower.xyz, upper.xyz). If set, this buffer gets passed
+  to the accel builder as is, and the geom type's bounds program is
+  never run for this geom (and thus, need not be set or
+  compiled). Passing a null buffer reverts to using the bounds
+  program. Note the buffer's contents have to be valid whenever a
+  group containing this geom gets built or refit. */
+OWL_API void
+owlUserGeomSetBoundsBuffer(OWLGeom   geom,
+                           OWLBuffer boundsBuffer);
+
 
 // -------------------------------------------------------
 // Release for the various types
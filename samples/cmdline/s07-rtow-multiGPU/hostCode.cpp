@@ -200,6 +200,8 @@ int main(int ac, char **av)
 
   int numGPUsFound = owlGetDeviceCount(context);
   LOG("Context created; owl found " << numGPUsFound << " GPUs");
+  // build the geometry BVHs only once, and copy them to all other GPUs
+  owlEnableAccelRelocation(context);
   OWLModule  module  = owlModuleCreate(context,ptxCode);
   
   // ##################################################################
@@ -0,0 +1,108 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+// Checks (and times) the conversion of large arrays of instance
+// transforms - in all supported OWLMatrixFormats - into the 3x4
+// row-major layout that optix expects in its OptixInstances.
+
+#include "Transforms.h"
+
+#include <random>
+
+#define LOG(message)                                            \
+  std::cout << OWL_TERMINAL_BLUE;                               \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+#define LOG_OK(message)                                         \
+  std::cout << OWL_TERMINAL_LIGHT_BLUE;                         \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+
+using namespace owl;
+
+const size_t numTransforms = 1000000;
+const int    numRuns       = 10;
+
+/*! reference value for element (row,col) of the i'th input matrix */
+float reference(const std::vector<float> &in, size_t i, int row, int col,
+                OWLMatrixFormat format)
+{
+  switch (format) {
+  case OWL_MATRIX_FORMAT_COLUMN_MAJOR: {
+    const affine3f &xfm = ((const affine3f*)in.data())[i];
+    const vec3f column
+      = (col == 0) ? xfm.l.vx
+      : (col == 1) ? xfm.l.vy
+      : (col == 2) ? xfm.l.vz
+      : xfm.p;
+    return (&column.x)[row];
+  }
+  case OWL_MATRIX_FORMAT_ROW_MAJOR:
+    return in[i*12+row*4+col];
+  case OWL_MATRIX_FORMAT_COLUMN_MAJOR_4X4:
+    return in[i*16+col*4+row];
+  default:
+    throw std::runtime_error("unknown format");
+  }
+}
+
+void testFormat(OWLMatrixFormat format, const std::string &name)
+{
+  std::mt19937 rng(0x1234);
+  std::uniform_real_distribution<float> rnd(-100.f,100.f);
+  std::vector<float> in(numTransforms*floatsPerMatrix(format));
+  for (auto &f : in) f = rnd(rng);
+
+  std::vector<InstanceTransform> out(numTransforms);
+  double bestTime = 1e20;
+  for (int run=0;run<numRuns;run++) {
+    const double t0 = getCurrentTime();
+    convertTransforms(out.data(),in.data(),numTransforms,format);
+    bestTime = std::min(bestTime,getCurrentTime()-t0);
+  }
+
+  for (size_t i=0;i<numTransforms;i++)
+    for (int row=0;row<3;row++)
+      for (int col=0;col<4;col++)
+        if (out[i].m[row*4+col] != reference(in,i,row,col,format))
+          throw std::runtime_error("wrong conversion result for format "+name);
+
+  LOG_OK("format " << name << ": converted "
+         << prettyNumber(numTransforms) << " transforms in "
+         << prettyDouble(bestTime) << "s ("
+         << prettyDouble(numTransforms/bestTime) << " transforms/s)");
+}
+
+int main(int ac, char **av)
+{
+  LOG("testing conversion of " << prettyNumber(numTransforms)
+      << " instance transforms (best of " << numRuns << " runs)");
+  testFormat(OWL_MATRIX_FORMAT_COLUMN_MAJOR,    "COLUMN_MAJOR (owl)");
+  testFormat(OWL_MATRIX_FORMAT_ROW_MAJOR,       "ROW_MAJOR (3x4)");
+  testFormat(OWL_MATRIX_FORMAT_COLUMN_MAJOR_4X4,"COLUMN_MAJOR_4X4");
+
+  // round-trip through affine3f must be lossless
+  InstanceTransform xfm;
+  affine3f a(linear3f(vec3f(1,2,3),vec3f(4,5,6),vec3f(7,8,9)),vec3f(10,11,12));
+  convertTransforms(&xfm,(const float*)&a,1,OWL_MATRIX_FORMAT_OWL);
+  const affine3f b = toAffine3f(xfm);
+  if (memcmp(&a,&b,sizeof(a)) != 0)
+    throw std::runtime_error("affine3f round-trip failed");
+
+  LOG_OK("all transform conversion tests passed");
+  return 0;
+}
@@ -0,0 +1,148 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+// Tests the per-device worker threads that owl uses to run per-device
+// work (accel builds, program compilation, ...) concurrently across
+// GPUs. Uses a simulated device backend (each "device" is just a
+// thread-local "active device" ID plus some sleeps), so this does not
+// require any GPU.
+
+#include "DeviceWorkers.h"
+
+#include <chrono>
+#include <atomic>
+
+#define LOG(message)                                            \
+  std::cout << OWL_TERMINAL_BLUE;                               \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+#define LOG_OK(message)                                         \
+  std::cout << OWL_TERMINAL_LIGHT_BLUE;                         \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+
+#define CHECK(cond)                                                     \
+  if (!(cond))                                                          \
+    throw std::runtime_error(std::string("check failed: ")+#cond        \
+                             +" ("+__FILE__+":"+std::to_string(__LINE__)+")");
+
+using namespace owl;
+
+/*! the simulated backend: what cudaSetDevice would set in a real
+    context */
+static thread_local int simulatedActiveDevice = -1;
+
+/*! a simulated, per-device "accel build" that takes a while */
+void simulatedBuild(int deviceID, int ms)
+{
+  if (simulatedActiveDevice != deviceID)
+    throw std::runtime_error("task running on wrong device");
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+const int numDevices = 4;
+
+int main(int ac, char **av)
+{
+  std::mutex mutex;
+  std::set<std::thread::id> workerThreads;
+  DeviceWorkers workers(numDevices,[&](int deviceID) {
+      simulatedActiveDevice = deviceID;
+      std::lock_guard<std::mutex> lock(mutex);
+      workerThreads.insert(std::this_thread::get_id());
+    });
+  CHECK(workerThreads.size() == numDevices);
+  CHECK(workerThreads.count(std::this_thread::get_id()) == 0);
+  LOG_OK("created " << numDevices << " device workers");
+
+  // ------------------------------------------------------------------
+  // per-device work has to overlap across devices
+  // ------------------------------------------------------------------
+  const int buildTime = 200;
+  const double t0 = getCurrentTime();
+  workers.parallelFor([&](int deviceID) { simulatedBuild(deviceID,buildTime); });
+  const double elapsed = getCurrentTime()-t0;
+  LOG("parallelFor over " << numDevices << " simulated " << buildTime
+      << "ms builds took " << prettyDouble(elapsed) << "s");
+  CHECK(elapsed < (numDevices-1)*buildTime/1000.);
+  LOG_OK("per-device work runs concurrently");
+
+  // ------------------------------------------------------------------
+  // exceptions on any device get re-thrown on the calling thread
+  // ------------------------------------------------------------------
+  std::atomic<int> numCompleted(0);
+  bool caught = false;
+  try {
+    workers.parallelFor([&](int deviceID) {
+        if (deviceID == 2)
+          throw std::runtime_error("simulated build failure");
+        simulatedBuild(deviceID,10);
+        numCompleted++;
+      });
+  } catch (const std::runtime_error &e) {
+    caught = (std::string(e.what()) == "simulated build failure");
+  }
+  CHECK(caught);
+  // ... and the fence still waited for all other devices
+  CHECK(numCompleted == numDevices-1);
+  LOG_OK("errors are propagated to the caller");
+
+  // ------------------------------------------------------------------
+  // tasks submitted to the same device run in order, and fences
+  // signal once they're done
+  // ------------------------------------------------------------------
+  std::vector<int> order;
+  WorkerFence::SP lastFence;
+  for (int i=0;i<100;i++)
+    lastFence = workers.submit(1,[&order,i](int deviceID) {
+        simulatedBuild(deviceID,0);
+        order.push_back(i);
+      });
+  lastFence->wait();
+  CHECK(lastFence->done());
+  CHECK(order.size() == 100);
+  for (int i=0;i<100;i++)
+    CHECK(order[i] == i);
+  LOG_OK("per-device tasks execute in submission order");
+
+  // ------------------------------------------------------------------
+  // nested parallelFor's (from within a worker) must not deadlock
+  // ------------------------------------------------------------------
+  std::atomic<int> numNested(0);
+  workers.parallelFor([&](int) {
+      workers.parallelFor([&](int) { numNested++; });
+    });
+  CHECK(numNested == numDevices*numDevices);
+  LOG_OK("nested parallelFor executes serially");
+
+  // ------------------------------------------------------------------
+  // a failing init gets reported by the constructor
+  // ------------------------------------------------------------------
+  caught = false;
+  try {
+    DeviceWorkers failing(2,[](int deviceID) {
+        if (deviceID == 1) throw std::runtime_error("no such device");
+      });
+  } catch (const std::runtime_error &) {
+    caught = true;
+  }
+  CHECK(caught);
+  LOG_OK("worker init failures are reported");
+
+  LOG_OK("all device worker tests passed");
+  return 0;
+}
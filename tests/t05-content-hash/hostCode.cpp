@@ -0,0 +1,106 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+// Tests the 64-bit content hashing that owl's accel and module caches
+// use to build their keys; checks against the reference xxHash64
+// values, and that the incremental hasher is sensitive to content,
+// order, and block boundaries.
+
+#include "Hash.h"
+
+#include <random>
+
+#define LOG(message)                                            \
+  std::cout << OWL_TERMINAL_BLUE;                               \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+#define LOG_OK(message)                                         \
+  std::cout << OWL_TERMINAL_LIGHT_BLUE;                         \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+
+#define CHECK(cond)                                                     \
+  if (!(cond))                                                          \
+    throw std::runtime_error(std::string("check failed: ")+#cond        \
+                             +" ("+__FILE__+":"+std::to_string(__LINE__)+")");
+
+using namespace owl;
+
+uint64_t hashString(const char *s, uint64_t seed=0)
+{
+  return hash64(s,strlen(s),seed);
+}
+
+int main(int ac, char **av)
+{
+  // ------------------------------------------------------------------
+  // reference values of the xxHash64 algorithm, covering both the
+  // short-input and the 32-byte-stripe code paths
+  // ------------------------------------------------------------------
+  CHECK(hashString("")    == 0xef46db3751d8e999ull);
+  CHECK(hashString("a")   == 0xd24ec4f1a98c6e5bull);
+  CHECK(hashString("abc") == 0x44bc2cf5ad770999ull);
+  CHECK(hashString("Nobody inspects the spammish repetition")
+        == 0xfbcea83c8a378bf1ull);
+  CHECK(hashString("abc",1) != hashString("abc",0));
+  LOG_OK("hash64 matches reference xxHash64 values");
+
+  // ------------------------------------------------------------------
+  // hash of large buffers: every single bit flip has to change it
+  // ------------------------------------------------------------------
+  std::mt19937 rng(0x1234);
+  std::vector<uint8_t> data(1000003);
+  for (auto &b : data) b = (uint8_t)rng();
+  const uint64_t reference = hash64(data.data(),data.size());
+  for (int i=0;i<1000;i++) {
+    const size_t byte = rng() % data.size();
+    const int    bit  = rng() % 8;
+    data[byte] ^= (1<<bit);
+    CHECK(hash64(data.data(),data.size()) != reference);
+    data[byte] ^= (1<<bit);
+  }
+  CHECK(hash64(data.data(),data.size()) == reference);
+  CHECK(hash64(data.data(),data.size()-1) != reference);
+
+  const double t0 = getCurrentTime();
+  const int numRuns = 10;
+  for (int i=0;i<numRuns;i++)
+    hash64(data.data(),data.size());
+  const double t = (getCurrentTime()-t0)/numRuns;
+  LOG_OK("hashing " << prettyNumber(data.size()) << "B takes "
+         << prettyDouble(t) << "s ("
+         << prettyNumber(size_t(data.size()/t)) << "B/s)");
+
+  // ------------------------------------------------------------------
+  // content hasher
+  // ------------------------------------------------------------------
+  const uint64_t h_ab
+    = ContentHasher().add(std::string("a")).add(std::string("b")).get();
+  CHECK(h_ab == ContentHasher().add(std::string("a")).add(std::string("b")).get());
+  CHECK(h_ab != ContentHasher().add(std::string("b")).add(std::string("a")).get());
+  CHECK(h_ab != ContentHasher().add(std::string("ab")).get());
+  CHECK(ContentHasher().add(1).get() != ContentHasher().add(2).get());
+  CHECK(ContentHasher().add(1).get() != ContentHasher().add(1).add(1).get());
+  CHECK(ContentHasher().get() != ContentHasher().add(data.data(),0).get());
+  LOG_OK("content hasher depends on content, order, and block boundaries");
+
+  CHECK(toHexString(0x0123456789abcdefull) == "0123456789abcdef");
+  CHECK(toHexString(0xfull) == "000000000000000f");
+  
+  LOG_OK("all content hash tests passed");
+  return 0;
+}
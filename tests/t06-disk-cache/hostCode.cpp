@@ -0,0 +1,163 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+// Tests the on-disk, content-addressed blob cache that owl uses to
+// persist accels (and other build products) across runs: lookups,
+// persistence across instances, LRU eviction, and handling of
+// corrupted files.
+
+#include "DiskCache.h"
+
+#include <fstream>
+
+#define LOG(message)                                            \
+  std::cout << OWL_TERMINAL_BLUE;                               \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+#define LOG_OK(message)                                         \
+  std::cout << OWL_TERMINAL_LIGHT_BLUE;                         \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+
+#define CHECK(cond)                                                     \
+  if (!(cond))                                                          \
+    throw std::runtime_error(std::string("check failed: ")+#cond        \
+                             +" ("+__FILE__+":"+std::to_string(__LINE__)+")");
+
+using namespace owl;
+
+const std::string cacheDir = "test06-disk-cache.dir";
+
+std::vector<uint8_t> makeBlob(size_t size, uint8_t seed)
+{
+  std::vector<uint8_t> blob(size);
+  for (size_t i=0;i<size;i++)
+    blob[i] = uint8_t(seed + 7*i);
+  return blob;
+}
+
+void store(DiskCache &cache, uint64_t key, const std::vector<uint8_t> &blob)
+{
+  cache.store(key,blob.data(),blob.size());
+}
+
+bool loadsAs(DiskCache &cache, uint64_t key, const std::vector<uint8_t> &expected)
+{
+  std::vector<uint8_t> blob;
+  return cache.load(key,blob) && blob == expected;
+}
+
+int main(int ac, char **av)
+{
+  const size_t budget = 1000;
+  {
+    // start from a clean slate, in case a previous run left something
+    DiskCache cache(cacheDir,budget);
+    for (uint64_t key=0;key<10;key++)
+      cache.remove(key);
+    CHECK(cache.numEntries() == 0);
+  }
+  
+  // ------------------------------------------------------------------
+  // basic store/load, and persistence across cache instances
+  // ------------------------------------------------------------------
+  const std::vector<uint8_t> blob1 = makeBlob(300,1);
+  const std::vector<uint8_t> blob2 = makeBlob(300,2);
+  {
+    DiskCache cache(cacheDir,budget);
+    std::vector<uint8_t> blob;
+    CHECK(!cache.load(1,blob));
+    store(cache,1,blob1);
+    CHECK(cache.contains(1));
+    CHECK(loadsAs(cache,1,blob1));
+    // replacing an entry
+    store(cache,1,blob2);
+    CHECK(loadsAs(cache,1,blob2));
+    CHECK(cache.numEntries() == 1);
+    CHECK(cache.sizeInBytes() == 300);
+    store(cache,1,blob1);
+  }
+  {
+    DiskCache cache(cacheDir,budget);
+    CHECK(cache.numEntries() == 1);
+    CHECK(loadsAs(cache,1,blob1));
+  }
+  LOG_OK("blobs persist across cache instances");
+
+  // ------------------------------------------------------------------
+  // LRU eviction
+  // ------------------------------------------------------------------
+  {
+    DiskCache cache(cacheDir,budget);
+    store(cache,2,makeBlob(300,2));
+    store(cache,3,makeBlob(300,3));
+    // touch #1, so #2 is now the least recently used one
+    CHECK(loadsAs(cache,1,blob1));
+    store(cache,4,makeBlob(300,4));
+    CHECK(cache.sizeInBytes() <= budget);
+    CHECK(cache.contains(1));
+    CHECK(!cache.contains(2));
+    CHECK(cache.contains(3));
+    CHECK(cache.contains(4));
+    std::vector<uint8_t> blob;
+    CHECK(!cache.load(2,blob));
+
+    // blobs larger than the entire budget don't get stored (and
+    // don't evict anything else)
+    store(cache,5,makeBlob(budget+1,5));
+    CHECK(!cache.contains(5));
+    CHECK(cache.numEntries() == 3);
+  }
+  {
+    // LRU order has to survive a restart, too: #3 is the oldest now
+    DiskCache cache(cacheDir,budget);
+    store(cache,6,makeBlob(300,6));
+    CHECK(!cache.contains(3));
+    CHECK(cache.contains(1) && cache.contains(4) && cache.contains(6));
+  }
+  LOG_OK("least recently used blobs get evicted");
+
+  // ------------------------------------------------------------------
+  // corrupted or missing files are cache misses
+  // ------------------------------------------------------------------
+  {
+    DiskCache cache(cacheDir,budget);
+    {
+      std::fstream file(cacheDir+"/0000000000000004.blob",
+                        std::ios::in|std::ios::out|std::ios::binary);
+      file.seekp(40);
+      file.put((char)0xff);
+    }
+    std::vector<uint8_t> blob;
+    CHECK(!cache.load(4,blob));
+    CHECK(!cache.contains(4));
+
+    std::remove((cacheDir+"/0000000000000006.blob").c_str());
+    CHECK(!cache.load(6,blob));
+  }
+  {
+    DiskCache cache(cacheDir,budget);
+    CHECK(cache.numEntries() == 1);
+    CHECK(loadsAs(cache,1,blob1));
+    cache.remove(1);
+    CHECK(cache.numEntries() == 0);
+  }
+  LOG_OK("corrupted and missing blobs are detected");
+  
+  LOG_OK("all disk cache tests passed");
+  return 0;
+}
@@ -0,0 +1,191 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+// Tests the host-side converters from float3 vertices / int3 indices
+// into the compact vertex and index formats that triangle geoms
+// support (half, snorm16, float2; 16-bit indices): every (vectorized)
+// conversion is checked against the scalar reference, and against
+// the expected round-trip error.
+
+#include "VertexFormats.h"
+
+#include <random>
+
+#define LOG(message)                                            \
+  std::cout << OWL_TERMINAL_BLUE;                               \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+#define LOG_OK(message)                                         \
+  std::cout << OWL_TERMINAL_LIGHT_BLUE;                         \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+
+#define CHECK(cond)                                                     \
+  if (!(cond))                                                          \
+    throw std::runtime_error(std::string("check failed: ")+#cond        \
+                             +" ("+__FILE__+":"+std::to_string(__LINE__)+")");
+
+using namespace owl;
+
+/*! bit-exact float->half reference, going through the (exhaustively
+    checked) half->float direction */
+void testHalfScalar()
+{
+  // every half has to survive the round trip through float
+  for (uint32_t h=0;h<0x10000;h++) {
+    const float f = halfToFloat((uint16_t)h);
+    if (f != f) {
+      // nan stays nan
+      CHECK((floatToHalf(f) & 0x7c00) == 0x7c00 && (floatToHalf(f) & 0x3ff));
+      continue;
+    }
+    CHECK(floatToHalf(f) == h);
+  }
+  CHECK(halfToFloat(0x3c00) == 1.f);
+  CHECK(halfToFloat(0xc000) == -2.f);
+  CHECK(halfToFloat(0x7bff) == 65504.f);
+  CHECK(halfToFloat(0x0001) == 1.f/16777216.f);
+  // overflow, rounding to nearest even, and underflow
+  CHECK(floatToHalf(1e6f) == 0x7c00);
+  CHECK(floatToHalf(65520.f) == 0x7c00);
+  CHECK(floatToHalf(1.f+1.f/2048.f) == 0x3c00);
+  CHECK(floatToHalf(1.f+3.f/2048.f) == 0x3c02);
+  CHECK(floatToHalf(1e-10f) == 0);
+  CHECK(floatToHalf(-1e-10f) == 0x8000);
+  LOG_OK("scalar half conversion is exact and round-trips all halfs");
+}
+
+std::vector<float> randomVertices(size_t N, float range)
+{
+  std::mt19937 rng(0x1234);
+  std::uniform_real_distribution<float> dist(-range,range);
+  std::vector<float> v(3*N);
+  for (auto &f : v) f = dist(rng);
+  return v;
+}
+
+void testVertexFormats()
+{
+  // not a multiple of any simd width, and large enough to go
+  // parallel
+  const size_t N = 1000003;
+  const std::vector<float> in = randomVertices(N,1.1f);
+  
+  const OWLVertexFormat formats[] = {
+    OWL_VERTEX_FORMAT_FLOAT3,
+    OWL_VERTEX_FORMAT_FLOAT2,
+    OWL_VERTEX_FORMAT_HALF3,
+    OWL_VERTEX_FORMAT_HALF2,
+    OWL_VERTEX_FORMAT_SNORM16_3,
+    OWL_VERTEX_FORMAT_SNORM16_2
+  };
+  for (auto format : formats) {
+    const size_t size = vertexFormatSizeOf(format);
+    const int    dims = (int)(size / vertexComponentSizeOf(format));
+    std::vector<uint8_t> out(N*size);
+    const double t0 = getCurrentTime();
+    convertVertices(out.data(),format,in.data(),N);
+    const double t = getCurrentTime()-t0;
+    
+    for (size_t i=0;i<N;i++) {
+      const uint8_t *v = out.data()+i*size;
+      for (int d=0;d<dims;d++) {
+        const float ref = in[3*i+d];
+        switch (format) {
+        case OWL_VERTEX_FORMAT_FLOAT3:
+        case OWL_VERTEX_FORMAT_FLOAT2:
+          CHECK(((const float*)v)[d] == ref);
+          break;
+        case OWL_VERTEX_FORMAT_HALF3:
+        case OWL_VERTEX_FORMAT_HALF2:
+          CHECK(((const uint16_t*)v)[d] == floatToHalf(ref));
+          break;
+        default: {
+          // simd and scalar paths may differ in how they round
+          // halfway cases, but never by more than one step
+          const int16_t s = ((const int16_t*)v)[d];
+          CHECK(std::abs(s - floatToSnorm16(ref)) <= 1);
+          const float clamped = std::max(-1.f,std::min(1.f,ref));
+          CHECK(fabsf(snorm16ToFloat(s) - clamped) <= 1.f/32767.f);
+        }
+        }
+      }
+    }
+    LOG_OK("vertex format " << toString(format) << " ("
+           << size << " bytes/vertex) converts correctly, "
+           << prettyNumber(size_t(N/t)) << " vertices/s");
+  }
+}
+
+void testIndexFormats()
+{
+  const size_t N = 300007;
+  std::mt19937 rng(0x4321);
+  std::vector<int32_t> in(3*N);
+  for (auto &i : in) i = rng() % 65536;
+
+  std::vector<uint16_t> out16(3*N);
+  convertIndices(out16.data(),OWL_INDEX_FORMAT_USHORT3,in.data(),N);
+  for (size_t i=0;i<3*N;i++)
+    CHECK(out16[i] == in[i]);
+
+  std::vector<uint32_t> out32(3*N);
+  convertIndices(out32.data(),OWL_INDEX_FORMAT_UINT3,in.data(),N);
+  for (size_t i=0;i<3*N;i++)
+    CHECK(out32[i] == (uint32_t)in[i]);
+
+  // out-of-range indices have to be detected, in either the simd or
+  // the remainder part of the array
+  for (size_t pos : { (size_t)5, 3*N/2, 3*N-1 }) {
+    for (int32_t bad : { 65536, -1 }) {
+      std::vector<int32_t> badIn = in;
+      badIn[pos] = bad;
+      bool thrown = false;
+      try {
+        convertIndices(out16.data(),OWL_INDEX_FORMAT_USHORT3,badIn.data(),N);
+      } catch (const std::runtime_error &) {
+        thrown = true;
+      }
+      CHECK(thrown);
+    }
+  }
+  LOG_OK("index formats convert correctly, and out-of-range indices get detected");
+}
+
+void testFormatsForBufferTypes()
+{
+  CHECK(vertexFormatFor(OWL_FLOAT3)  == OWL_VERTEX_FORMAT_FLOAT3);
+  CHECK(vertexFormatFor(OWL_FLOAT4)  == OWL_VERTEX_FORMAT_FLOAT3);
+  CHECK(vertexFormatFor(OWL_HALF3)   == OWL_VERTEX_FORMAT_HALF3);
+  CHECK(vertexFormatFor(OWL_SHORT2)  == OWL_VERTEX_FORMAT_SNORM16_2);
+  CHECK(vertexFormatFor(OWL_USER_TYPE(vec3f)) == OWL_VERTEX_FORMAT_FLOAT3);
+  CHECK(indexFormatFor(OWL_INT3)     == OWL_INDEX_FORMAT_UINT3);
+  CHECK(indexFormatFor(OWL_USHORT3)  == OWL_INDEX_FORMAT_USHORT3);
+  CHECK(vertexFormatSizeOf(OWL_VERTEX_FORMAT_HALF3) == 6);
+  CHECK(indexFormatSizeOf(OWL_INDEX_FORMAT_USHORT3) == 6);
+  LOG_OK("formats get derived correctly from buffer types");
+}
+
+int main(int ac, char **av)
+{
+  testHalfScalar();
+  testVertexFormats();
+  testIndexFormats();
+  testFormatsForBufferTypes();
+  LOG_OK("all vertex format tests passed");
+  return 0;
+}
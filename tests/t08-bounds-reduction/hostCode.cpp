@@ -0,0 +1,157 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+// Tests the host-side bounds reduction that is used for vertex
+// arrays in host-pinned or managed memory: for every vertex format,
+// and for various strides and (odd) array sizes, the vectorized and
+// parallel reduction has to exactly match a scalar reference.
+
+#include "BoundsReduction.h"
+
+#include <random>
+
+#define LOG(message)                                            \
+  std::cout << OWL_TERMINAL_BLUE;                               \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+#define LOG_OK(message)                                         \
+  std::cout << OWL_TERMINAL_LIGHT_BLUE;                         \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+
+#define CHECK(cond)                                                     \
+  if (!(cond))                                                          \
+    throw std::runtime_error(std::string("check failed: ")+#cond        \
+                             +" ("+__FILE__+":"+std::to_string(__LINE__)+")");
+
+using namespace owl;
+
+/*! scalar reference, on already-decoded vertices */
+box3f referenceBounds(const std::vector<vec3f> &vertices)
+{
+  box3f bounds;
+  for (auto v : vertices)
+    bounds.extend(v);
+  return bounds;
+}
+
+/*! encodes 'in' into an array of given format and stride (with the
+    padding between elements filled with junk that must not affect
+    the bounds), and returns the vertices as they decode again */
+std::vector<vec3f> encode(std::vector<uint8_t> &out,
+                          const std::vector<vec3f> &in,
+                          OWLVertexFormat format,
+                          size_t stride)
+{
+  const size_t N = in.size();
+  const size_t elementSize = vertexFormatSizeOf(format);
+  // exactly as many bytes as get read - the last element has no padding
+  out.assign(N ? (N-1)*stride+elementSize : 0, 0xff);
+  std::vector<vec3f> decoded(N);
+  for (size_t i=0;i<N;i++) {
+    uint8_t *ptr = out.data()+i*stride;
+    const vec3f v = in[i];
+    switch (format) {
+    case OWL_VERTEX_FORMAT_FLOAT3:
+      memcpy(ptr,&v,sizeof(v));
+      decoded[i] = v;
+      break;
+    case OWL_VERTEX_FORMAT_FLOAT2:
+      memcpy(ptr,&v,2*sizeof(float));
+      decoded[i] = vec3f(v.x,v.y,0.f);
+      break;
+    case OWL_VERTEX_FORMAT_HALF3:
+    case OWL_VERTEX_FORMAT_HALF2: {
+      const int dims = (format == OWL_VERTEX_FORMAT_HALF3) ? 3 : 2;
+      for (int d=0;d<dims;d++)
+        ((uint16_t*)ptr)[d] = floatToHalf((&v.x)[d]);
+      decoded[i] = vec3f(halfToFloat(((uint16_t*)ptr)[0]),
+                         halfToFloat(((uint16_t*)ptr)[1]),
+                         dims == 3 ? halfToFloat(((uint16_t*)ptr)[2]) : 0.f);
+    } break;
+    case OWL_VERTEX_FORMAT_SNORM16_3:
+    case OWL_VERTEX_FORMAT_SNORM16_2: {
+      const int dims = (format == OWL_VERTEX_FORMAT_SNORM16_3) ? 3 : 2;
+      for (int d=0;d<dims;d++)
+        ((int16_t*)ptr)[d] = floatToSnorm16((&v.x)[d]);
+      decoded[i] = vec3f(snorm16ToFloat(((int16_t*)ptr)[0]),
+                         snorm16ToFloat(((int16_t*)ptr)[1]),
+                         dims == 3 ? snorm16ToFloat(((int16_t*)ptr)[2]) : 0.f);
+    } break;
+    default:
+      throw std::runtime_error("unexpected format");
+    }
+  }
+  return decoded;
+}
+
+void testFormat(OWLVertexFormat format, std::mt19937 &rng)
+{
+  // snorm needs [-1,1]; everything else gets a larger, offset range
+  const bool snorm
+    = format == OWL_VERTEX_FORMAT_SNORM16_3
+    || format == OWL_VERTEX_FORMAT_SNORM16_2;
+  std::uniform_real_distribution<float> coord(snorm ? -1.f : -100.f,
+                                              snorm ? +1.f : +300.f);
+  const size_t elementSize = vertexFormatSizeOf(format);
+  // sizes that hit the serial path, exact multiples of the parallel
+  // block size, and odd remainders
+  const size_t counts[] = { 1, 2, 7, 1000, 64*1024, 64*1024+1, 300001 };
+  const size_t strides[] = { elementSize, elementSize+4, 32 };
+  for (size_t count : counts)
+    for (size_t stride : strides) {
+      std::vector<vec3f> vertices(count);
+      for (auto &v : vertices)
+        v = vec3f(coord(rng),coord(rng),coord(rng));
+      // make sure the extremes are somewhere in the middle as well
+      // as on the very last element (which the vector path handles
+      // separately)
+      if (count > 2) {
+        vertices[count/2]   = vec3f(snorm ? -1.f : -500.f);
+        vertices[count-1].y = snorm ? 1.f : 700.f;
+      }
+      std::vector<uint8_t> encoded;
+      const std::vector<vec3f> decoded
+        = encode(encoded,vertices,format,stride);
+      const box3f expected = referenceBounds(decoded);
+      const box3f bounds
+        = computeVertexBoundsOnHost(encoded.data(),count,stride,format);
+      CHECK(bounds.lower == expected.lower);
+      CHECK(bounds.upper == expected.upper);
+    }
+  LOG_OK("bounds of " << toString(format) << " vertices match the reference");
+}
+
+int main(int ac, char **av)
+{
+  std::mt19937 rng(0x1234);
+  const OWLVertexFormat formats[] = {
+    OWL_VERTEX_FORMAT_FLOAT3,
+    OWL_VERTEX_FORMAT_FLOAT2,
+    OWL_VERTEX_FORMAT_HALF3,
+    OWL_VERTEX_FORMAT_HALF2,
+    OWL_VERTEX_FORMAT_SNORM16_3,
+    OWL_VERTEX_FORMAT_SNORM16_2
+  };
+  for (auto format : formats)
+    testFormat(format,rng);
+
+  // no vertices at all gives an empty box
+  CHECK(computeVertexBoundsOnHost(nullptr,0,12,OWL_VERTEX_FORMAT_FLOAT3).empty());
+  LOG_OK("all bounds reduction tests passed");
+  return 0;
+}
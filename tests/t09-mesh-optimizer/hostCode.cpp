@@ -0,0 +1,293 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+// Tests the host-side mesh optimizer: welding has to merge exactly
+// the vertices it should, degenerate and duplicate triangles have to
+// get removed, and the fully optimized mesh has to describe the same
+// surface as the input (as tracked through the remap tables), with
+// better vertex re-use than a randomly shuffled one.
+
+#include "MeshOptimizer.h"
+
+#include <random>
+#include <set>
+#include <cstring>
+
+#define LOG(message)                                            \
+  std::cout << OWL_TERMINAL_BLUE;                               \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+#define LOG_OK(message)                                         \
+  std::cout << OWL_TERMINAL_LIGHT_BLUE;                         \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+
+#define CHECK(cond)                                                     \
+  if (!(cond))                                                          \
+    throw std::runtime_error(std::string("check failed: ")+#cond        \
+                             +" ("+__FILE__+":"+std::to_string(__LINE__)+")");
+
+using namespace owl;
+
+/*! a vertex record as it could come from an app: position plus one
+    extra attribute that has to travel with it */
+struct Vertex {
+  vec3f position;
+  float u;
+};
+
+/*! an index record with some per-primitive data after the indices */
+struct Triangle {
+  vec3i index;
+  int   primID;
+};
+
+/*! a NxN grid of quads, with each triangle having its own three
+    vertices (ie, nothing welded yet), in shuffled order */
+void makeUnweldedGrid(std::vector<Vertex> &vertices,
+                      std::vector<Triangle> &triangles,
+                      int N, std::mt19937 &rng)
+{
+  std::vector<vec3i> quadTris;
+  for (int iy=0;iy<N;iy++)
+    for (int ix=0;ix<N;ix++) {
+      const int v00 = iy*(N+1)+ix, v01 = v00+1;
+      const int v10 = v00+(N+1),   v11 = v10+1;
+      quadTris.push_back(vec3i(v00,v01,v11));
+      quadTris.push_back(vec3i(v00,v11,v10));
+    }
+  std::shuffle(quadTris.begin(),quadTris.end(),rng);
+
+  vertices.clear();
+  triangles.clear();
+  for (auto t : quadTris) {
+    Triangle tri;
+    for (int j=0;j<3;j++) {
+      const int gridID = t[j];
+      Vertex v;
+      v.position = vec3f(float(gridID % (N+1)),float(gridID / (N+1)),0.f);
+      v.u        = float(gridID);
+      tri.index[j] = (int)vertices.size();
+      vertices.push_back(v);
+    }
+    tri.primID = (int)triangles.size();
+    triangles.push_back(tri);
+  }
+}
+
+/*! positions of a triangle, rotated such that the lexicographically
+    smallest vertex comes first (so rotated triangles compare equal) */
+std::vector<float> canonicalPositions(const std::vector<Vertex> &vertices,
+                                      const vec3i &t)
+{
+  std::vector<std::vector<float>> rotations;
+  for (int r=0;r<3;r++) {
+    std::vector<float> p;
+    for (int j=0;j<3;j++) {
+      const Vertex &v = vertices[t[(j+r)%3]];
+      p.push_back(v.position.x); p.push_back(v.position.y);
+      p.push_back(v.position.z); p.push_back(v.u);
+    }
+    rotations.push_back(p);
+  }
+  return *std::min_element(rotations.begin(),rotations.end());
+}
+
+void testWelding(std::mt19937 &rng)
+{
+  const int N = 50;
+  std::vector<Vertex> vertices;
+  std::vector<Triangle> triangles;
+  makeUnweldedGrid(vertices,triangles,N,rng);
+
+  // exact welding merges all copies of each grid vertex
+  {
+    size_t numUnique = 0;
+    std::vector<int32_t> remap
+      = mesh::computeWeldRemap(vertices.data(),vertices.size(),
+                               sizeof(Vertex),0.f,numUnique);
+    CHECK(numUnique == size_t((N+1)*(N+1)));
+    for (size_t i=0;i<vertices.size();i++)
+      for (size_t j : { size_t(0), i/2, i })
+        CHECK((remap[i] == remap[j]) == (vertices[i].u == vertices[j].u));
+  }
+
+  // vertices with the same position but different attributes stay
+  {
+    std::vector<Vertex> split = vertices;
+    for (size_t i=0;i<split.size();i+=3)
+      split[i].u = -1.f-float(i);
+    size_t numUnique = 0;
+    mesh::computeWeldRemap(split.data(),split.size(),
+                           sizeof(Vertex),0.f,numUnique);
+    std::set<float> distinct;
+    for (auto &v : split) distinct.insert(v.u);
+    CHECK(numUnique == distinct.size());
+  }
+
+  // with an epsilon, slightly jittered (and negated-zero) positions
+  // still get merged
+  {
+    std::vector<Vertex> jittered = vertices;
+    std::uniform_real_distribution<float> jitter(-1e-4f,1e-4f);
+    for (auto &v : jittered) {
+      v.position.x += jitter(rng);
+      v.position.y += jitter(rng);
+      v.position.z = -0.f;
+    }
+    size_t numUnique = 0;
+    mesh::computeWeldRemap(jittered.data(),jittered.size(),
+                           sizeof(Vertex),0.5f,numUnique);
+    CHECK(numUnique == size_t((N+1)*(N+1)));
+    mesh::computeWeldRemap(jittered.data(),jittered.size(),
+                           sizeof(Vertex),0.f,numUnique);
+    CHECK(numUnique > size_t((N+1)*(N+1)));
+  }
+  LOG_OK("vertex welding works");
+}
+
+void testDegenerates()
+{
+  std::vector<vec3f> vertices = {
+    vec3f(0,0,0), vec3f(1,0,0), vec3f(0,1,0), vec3f(2,0,0)
+  };
+  std::vector<vec3i> triangles = {
+    vec3i(0,1,2), // valid
+    vec3i(0,0,2), // two identical indices
+    vec3i(0,1,3), // zero area (collinear)
+    vec3i(1,2,0), // same as the first, rotated
+    vec3i(0,2,1), // opposite winding - stays
+    vec3i(2,0,1), // same as the first, rotated
+  };
+  const mesh::Order valid
+    = mesh::findValidTriangles(triangles.data(),triangles.size(),
+                               vertices.data(),sizeof(vec3f));
+  CHECK(valid == mesh::Order({ 0, 4 }));
+  LOG_OK("degenerate and duplicate triangles get removed");
+}
+
+void testFullOptimization(std::mt19937 &rng)
+{
+  const int N = 200;
+  std::vector<Vertex> inVertices;
+  std::vector<Triangle> inTriangles;
+  makeUnweldedGrid(inVertices,inTriangles,N,rng);
+  // a few bad triangles, which should all get dropped
+  const size_t numGood = inTriangles.size();
+  for (int i=0;i<10;i++) {
+    Triangle bad = inTriangles[i];
+    if (i % 2) bad.index.y = bad.index.x;
+    bad.primID = (int)inTriangles.size();
+    inTriangles.push_back(bad);
+  }
+
+  // reference: a welded (but otherwise unoptimized) version, to
+  // compare vertex re-use against
+  std::vector<vec3i> weldedRef;
+  {
+    size_t numUnique = 0;
+    std::vector<int32_t> remap
+      = mesh::computeWeldRemap(inVertices.data(),inVertices.size(),
+                               sizeof(Vertex),0.f,numUnique);
+    for (size_t i=0;i<numGood;i++) {
+      const vec3i t = inTriangles[i].index;
+      weldedRef.push_back(vec3i(remap[t.x],remap[t.y],remap[t.z]));
+    }
+  }
+  const float shuffledACMR
+    = mesh::computeACMR(weldedRef.data(),weldedRef.size(),inVertices.size());
+
+  std::vector<Vertex>   vertices  = inVertices;
+  std::vector<Triangle> triangles = inTriangles;
+  size_t numVertices  = vertices.size();
+  size_t numTriangles = triangles.size();
+  std::vector<int32_t> vertexRemap(numVertices);
+  std::vector<int32_t> triangleRemap(numTriangles);
+  mesh::optimizeMesh(vertices.data(),numVertices,sizeof(Vertex),
+                     triangles.data(),numTriangles,sizeof(Triangle),
+                     OWL_MESH_OPTIMIZE_ALL,0.f,
+                     vertexRemap.data(),triangleRemap.data());
+  vertices.resize(numVertices);
+  triangles.resize(numTriangles);
+
+  CHECK(numVertices == size_t((N+1)*(N+1)));
+  CHECK(numTriangles == numGood);
+
+  // every input vertex maps to an output vertex with the same data
+  for (size_t i=0;i<inVertices.size();i++) {
+    CHECK(vertexRemap[i] >= 0 && vertexRemap[i] < (int)numVertices);
+    CHECK(memcmp(&vertices[vertexRemap[i]],&inVertices[i],sizeof(Vertex)) == 0);
+  }
+  // every good input triangle maps to one describing the same
+  // surface, with its per-primitive data moved along; all bad ones
+  // got removed
+  std::vector<bool> hit(numTriangles,false);
+  for (size_t i=0;i<inTriangles.size();i++) {
+    const int32_t o = triangleRemap[i];
+    if (i >= numGood) {
+      // a duplicate of (or degenerate version of) an earlier one
+      CHECK(o == -1);
+      continue;
+    }
+    CHECK(o >= 0 && o < (int)numTriangles);
+    CHECK(!hit[o]);
+    hit[o] = true;
+    CHECK(triangles[o].primID == inTriangles[i].primID);
+    CHECK(canonicalPositions(vertices,triangles[o].index)
+          == canonicalPositions(inVertices,inTriangles[i].index));
+  }
+
+  std::vector<vec3i> outIndices;
+  for (auto &t : triangles) outIndices.push_back(t.index);
+  const float optimizedACMR
+    = mesh::computeACMR(outIndices.data(),outIndices.size(),numVertices);
+  LOG("ACMR shuffled " << shuffledACMR << ", optimized " << optimizedACMR);
+  CHECK(optimizedACMR < 0.8f);
+  CHECK(optimizedACMR < shuffledACMR);
+
+  // vertices come in order of first use
+  int32_t maxSeen = -1;
+  for (auto &t : outIndices)
+    for (int j=0;j<3;j++) {
+      CHECK(t[j] <= maxSeen+1);
+      maxSeen = std::max(maxSeen,t[j]);
+    }
+  LOG_OK("fully optimized mesh matches the input");
+}
+
+int main(int ac, char **av)
+{
+  std::mt19937 rng(0x1234);
+  testWelding(rng);
+  testDegenerates();
+  testFullOptimization(rng);
+
+  // out-of-range indices get rejected
+  vec3f vertex(0.f);
+  vec3i triangle(0,1,0);
+  size_t numVertices = 1, numTriangles = 1;
+  bool threw = false;
+  try {
+    mesh::optimizeMesh(&vertex,numVertices,0,&triangle,numTriangles,0,
+                       OWL_MESH_OPTIMIZE_ALL,0.f,nullptr,nullptr);
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  CHECK(threw);
+  LOG_OK("all mesh optimizer tests passed");
+  return 0;
+}
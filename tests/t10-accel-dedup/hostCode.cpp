@@ -0,0 +1,192 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+// Tests the host side of accel deduplication: mesh content keys have
+// to depend on exactly what the accel builder reads (and nothing
+// else), and the dedup table has to hand out shared objects by key,
+// forget them once nobody uses them any more, and correctly report
+// what sharing saved.
+
+#include "AccelDedup.h"
+
+#include <random>
+#include <cstring>
+
+#define LOG(message)                                            \
+  std::cout << OWL_TERMINAL_BLUE;                               \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+#define LOG_OK(message)                                         \
+  std::cout << OWL_TERMINAL_LIGHT_BLUE;                         \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+
+#define CHECK(cond)                                                     \
+  if (!(cond))                                                          \
+    throw std::runtime_error(std::string("check failed: ")+#cond        \
+                             +" ("+__FILE__+":"+std::to_string(__LINE__)+")");
+
+using namespace owl;
+
+/*! a mesh, with its arrays in some given layout */
+struct TestMesh {
+  TestMesh(const std::vector<vec3f> &positions,
+           const std::vector<vec3i> &triangles,
+           size_t vertexStride = sizeof(vec3f),
+           size_t indexStride  = sizeof(vec3i),
+           uint8_t padding     = 0)
+  {
+    vertexData.assign(positions.size()*vertexStride,padding);
+    for (size_t i=0;i<positions.size();i++)
+      memcpy(vertexData.data()+i*vertexStride,&positions[i],sizeof(vec3f));
+    indexData.assign(triangles.size()*indexStride,padding);
+    for (size_t i=0;i<triangles.size();i++)
+      memcpy(indexData.data()+i*indexStride,&triangles[i],sizeof(vec3i));
+    content.vertices     = { vertexData.data() };
+    content.vertexCount  = positions.size();
+    content.vertexStride = vertexStride;
+    content.indices      = indexData.data();
+    content.indexCount   = triangles.size();
+    content.indexStride  = indexStride;
+  }
+
+  uint64_t key() const
+  {
+    ContentHasher hasher;
+    hashMeshContent(hasher,content);
+    return hasher.get();
+  }
+
+  std::vector<uint8_t> vertexData, indexData;
+  MeshContent content;
+};
+
+void testContentKeys()
+{
+  std::mt19937 rng(0x1234);
+  std::uniform_real_distribution<float> coord(-1.f,1.f);
+  // large enough to span several hashing chunks
+  const int numVertices = 40000;
+  std::vector<vec3f> positions(numVertices);
+  for (auto &p : positions)
+    p = vec3f(coord(rng),coord(rng),coord(rng));
+  std::vector<vec3i> triangles;
+  for (int i=0;i+2<numVertices;i++)
+    triangles.push_back(vec3i(i,i+1,i+2));
+
+  const uint64_t key = TestMesh(positions,triangles).key();
+
+  // same content, different copy -> same key
+  CHECK(TestMesh(positions,triangles).key() == key);
+
+  // different strides, and junk in-between -> still the same
+  CHECK(TestMesh(positions,triangles,32,16,0xab).key() == key);
+  CHECK(TestMesh(positions,triangles,16,12,0xcd).key() == key);
+
+  // any change to what the builder reads -> different key
+  {
+    std::vector<vec3f> moved = positions;
+    moved[numVertices-1].z += 1e-3f;
+    CHECK(TestMesh(moved,triangles).key() != key);
+  }
+  {
+    std::vector<vec3i> flipped = triangles;
+    std::swap(flipped[17].y,flipped[17].z);
+    CHECK(TestMesh(positions,flipped).key() != key);
+  }
+  {
+    std::vector<vec3i> fewer(triangles.begin(),triangles.end()-1);
+    CHECK(TestMesh(positions,fewer).key() != key);
+  }
+  {
+    TestMesh motion(positions,triangles);
+    motion.content.vertices.push_back(motion.vertexData.data());
+    CHECK(motion.key() != key);
+  }
+  {
+    // same bytes, interpreted differently
+    TestMesh asFloat2(positions,triangles);
+    asFloat2.content.vertexFormat = OWL_VERTEX_FORMAT_FLOAT2;
+    CHECK(asFloat2.key() != key);
+  }
+  LOG_OK("mesh content keys depend on exactly the builder's inputs");
+}
+
+/*! stand-in for a shared accel */
+struct FakeAccel {
+  size_t accelBytes  = 0;
+  size_t bufferBytes = 0;
+};
+
+void testDedupTable()
+{
+  DedupTable<FakeAccel> table;
+  CHECK(table.find(1) == nullptr);
+
+  // three "groups" with the content 1, two with content 2, and one
+  // with content 3
+  std::vector<std::shared_ptr<FakeAccel>> groups;
+  for (uint64_t key : { 1, 2, 1, 3, 1, 2 }) {
+    std::shared_ptr<FakeAccel> accel = table.find(key);
+    if (!accel) {
+      accel = std::make_shared<FakeAccel>();
+      accel->accelBytes  = 1000*key;
+      accel->bufferBytes = 100*key;
+      table.insert(key,accel);
+    }
+    groups.push_back(accel);
+  }
+  CHECK(groups[0] == groups[2] && groups[0] == groups[4]);
+  CHECK(groups[1] == groups[5]);
+  CHECK(groups[0] != groups[1] && groups[3] != groups[0]);
+
+  OWLAccelDedupStats stats = table.computeStats();
+  CHECK(stats.numSharedAccels       == 2);
+  CHECK(stats.numDeduplicatedGroups == 3);
+  CHECK(stats.accelBytesSaved       == 2*1000+1*2000);
+  CHECK(stats.duplicateBufferBytes  == 2*100+1*200);
+
+  // once all groups of content 2 are gone, so is its entry
+  groups[1] = groups[5] = nullptr;
+  CHECK(table.find(2) == nullptr);
+  // ... and groups of content 1 dropping out reduce the savings
+  groups[2] = nullptr;
+  stats = table.computeStats();
+  CHECK(stats.numSharedAccels       == 1);
+  CHECK(stats.numDeduplicatedGroups == 1);
+  CHECK(stats.accelBytesSaved       == 1000);
+
+  // re-inserting under an existing key replaces the old entry
+  std::shared_ptr<FakeAccel> replacement = std::make_shared<FakeAccel>();
+  table.insert(3,replacement);
+  CHECK(table.find(3) == replacement);
+
+  groups.clear();
+  replacement = nullptr;
+  stats = table.computeStats();
+  CHECK(stats.numSharedAccels == 0 && stats.accelBytesSaved == 0);
+  CHECK(table.find(1) == nullptr);
+  LOG_OK("dedup table shares, expires, and reports correctly");
+}
+
+int main(int ac, char **av)
+{
+  testContentKeys();
+  testDedupTable();
+  LOG_OK("all accel dedup tests passed");
+  return 0;
+}
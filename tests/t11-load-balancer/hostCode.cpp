@@ -0,0 +1,237 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+
+// Tests the multi-GPU load balancer with simulated devices: tile
+// ranges have to always exactly cover the launch, and with devices of
+// different speeds (and work that isn't equally expensive everywhere)
+// the per-device times have to converge to being about equal within a
+// few frames - and re-converge when a device's speed changes, also
+// when timings only become available a few launches later.
+
+#include "LoadBalancer.h"
+
+#include <random>
+
+#define LOG(message)                                            \
+  std::cout << OWL_TERMINAL_BLUE;                               \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+#define LOG_OK(message)                                         \
+  std::cout << OWL_TERMINAL_LIGHT_BLUE;                         \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+
+#define CHECK(cond)                                                     \
+  if (!(cond))                                                          \
+    throw std::runtime_error(std::string("check failed: ")+#cond        \
+                             +" ("+__FILE__+":"+std::to_string(__LINE__)+")");
+
+using namespace owl;
+
+/*! checks that the ranges are contiguous, in device order, and cover
+    exactly [0,numTiles) */
+void checkCoverage(const std::vector<vec2i> &ranges, int numTiles)
+{
+  int expectedBegin = 0;
+  for (auto range : ranges) {
+    CHECK(range.x == expectedBegin);
+    CHECK(range.y >= range.x);
+    expectedBegin = range.y;
+  }
+  CHECK(expectedBegin == numTiles);
+}
+
+/*! a simulated frame: every tile has a cost, and a device needs
+    'msPerCost' per unit of cost, plus some noise */
+struct Simulation {
+  Simulation(int numTiles, std::vector<float> msPerCost)
+    : msPerCost(msPerCost), tileCost(numTiles)
+  {
+    // the middle of the frame is much more expensive than its borders
+    for (int i=0;i<numTiles;i++) {
+      const float t = (i+.5f)/numTiles;
+      tileCost[i] = .2f + 4.f*t*(1.f-t);
+    }
+  }
+
+  /*! runs one frame with given balancer, reporting timings to it;
+      returns the ratio of the slowest device's time to the average
+      device time */
+  float runFrame(LoadBalancer &balancer, std::mt19937 &rng)
+  {
+    std::uniform_real_distribution<float> noise(.97f,1.03f);
+    const std::vector<vec2i> ranges = balancer.assignTiles((int)tileCost.size());
+    checkCoverage(ranges,(int)tileCost.size());
+    float maxTime = 0.f, sumTime = 0.f;
+    for (int dev=0;dev<(int)msPerCost.size();dev++) {
+      float cost = 0.f;
+      for (int i=ranges[dev].x;i<ranges[dev].y;i++)
+        cost += tileCost[i];
+      const float ms = cost * msPerCost[dev] * noise(rng);
+      balancer.reportTime(dev,ranges[dev].y-ranges[dev].x,ms);
+      maxTime = std::max(maxTime,ms);
+      sumTime += ms;
+    }
+    return maxTime / (sumTime / msPerCost.size());
+  }
+  
+  std::vector<float> msPerCost;
+  std::vector<float> tileCost;
+};
+
+void testCoverage()
+{
+  std::mt19937 rng(0x1234);
+  std::uniform_real_distribution<float> ms(.1f,10.f);
+  for (int numDevices : { 1, 2, 3, 7 }) {
+    LoadBalancer balancer(numDevices);
+    // no measurements yet: equal split
+    const std::vector<vec2i> initial = balancer.assignTiles(10*numDevices);
+    for (auto range : initial)
+      CHECK(range.y-range.x == 10);
+    for (int numTiles : { 0, 1, 5, 33, 1000 }) {
+      for (int dev=0;dev<numDevices;dev++)
+        balancer.reportTime(dev,1+dev,ms(rng));
+      checkCoverage(balancer.assignTiles(numTiles),numTiles);
+    }
+  }
+  // a device that got measured as twice as fast gets twice the work;
+  // unmeasured ones count as average
+  LoadBalancer balancer(3);
+  balancer.reportTime(0,100,100.f);
+  balancer.reportTime(1,100,50.f);
+  const std::vector<vec2i> ranges = balancer.assignTiles(450);
+  CHECK(ranges[0] == vec2i(0,100));
+  CHECK(ranges[1] == vec2i(100,300));
+  CHECK(ranges[2] == vec2i(300,450));
+  LOG_OK("tile ranges always cover the launch");
+}
+
+void testConvergence()
+{
+  std::mt19937 rng(0x1234);
+  // a fast, a medium, and a slow GPU
+  Simulation sim(1080/16,{ 1.f, 2.5f, 6.f });
+  LoadBalancer balancer(3);
+
+  const float initialImbalance = sim.runFrame(balancer,rng);
+  float imbalance = initialImbalance;
+  for (int frame=0;frame<20;frame++)
+    imbalance = sim.runFrame(balancer,rng);
+  LOG("max/avg device time: first frame " << initialImbalance
+      << ", after 20 frames " << imbalance);
+  CHECK(initialImbalance > 1.5f);
+  CHECK(imbalance < 1.25f);
+
+  // the fast device becomes the slowest (eg, some other job on it)
+  sim.msPerCost[0] = 10.f;
+  for (int frame=0;frame<30;frame++)
+    imbalance = sim.runFrame(balancer,rng);
+  LOG("after slowing down device 0: " << imbalance);
+  CHECK(imbalance < 1.25f);
+  LOG_OK("per-device times converge");
+}
+
+/*! back-to-back async launches: each device has a ring of launch
+    slots, and a launch's timing only becomes available a few frames
+    after it got issued - so when the next launch gets assigned, the
+    previous ones are typically still running. Every launch's timing
+    has to get reported exactly once, oldest first, and the split
+    still has to converge */
+void testLateTimings()
+{
+  const int numSlots = 3;
+  const int latency  = 2;
+  const std::vector<float> msPerTile = { 1.f, 3.f };
+  const int numDevices = (int)msPerTile.size();
+  const int numTiles   = 120;
+  
+  struct Launch {
+    int   frame    = -1;
+    int   numTiles = 0;
+    float ms       = 0.f;
+  };
+  std::vector<std::vector<Launch>> slots(numDevices,std::vector<Launch>(numSlots));
+  std::vector<int> newestSlot(numDevices,numSlots-1);
+  std::vector<int> lastReportedFrame(numDevices,-1);
+  int numLaunched = 0, numReported = 0;
+  
+  LoadBalancer balancer(numDevices,.5f);
+  std::vector<vec2i> ranges;
+  for (int frame=0;frame<40;frame++) {
+    auto report = [&](int dev, int now) {
+      balancer.reportCompleted
+        (dev,numSlots,newestSlot[dev],
+         [&](int slot) -> int & { return slots[dev][slot].numTiles; },
+         [&](int slot, float &ms) {
+          const Launch &launch = slots[dev][slot];
+          if (now < launch.frame+latency)
+            return false;
+          // in launch order, and each only once
+          CHECK(launch.frame > lastReportedFrame[dev]);
+          lastReportedFrame[dev] = launch.frame;
+          numReported++;
+          ms = launch.ms;
+          return true;
+        });
+    };
+    for (int dev=0;dev<numDevices;dev++)
+      report(dev,frame);
+    ranges = balancer.assignTiles(numTiles);
+    checkCoverage(ranges,numTiles);
+    for (int dev=0;dev<numDevices;dev++) {
+      const int slot = (newestSlot[dev]+1) % numSlots;
+      Launch &launch = slots[dev][slot];
+      if (launch.numTiles) {
+        // the slot's launch is done once we waited for it; report it
+        // before re-using the slot
+        report(dev,launch.frame+latency);
+        CHECK(launch.numTiles == 0);
+      }
+      newestSlot[dev]  = slot;
+      launch.frame     = frame;
+      launch.numTiles  = ranges[dev].y-ranges[dev].x;
+      launch.ms        = launch.numTiles * msPerTile[dev];
+      numLaunched++;
+    }
+  }
+  // all but the ones still "running" got reported
+  CHECK(numReported == numLaunched - numDevices*latency);
+  const float ms0 = (ranges[0].y-ranges[0].x)*msPerTile[0];
+  const float ms1 = (ranges[1].y-ranges[1].x)*msPerTile[1];
+  LOG("with late timings, device times " << ms0 << " / " << ms1);
+  CHECK(std::max(ms0,ms1)/std::min(ms0,ms1) < 1.1f);
+  LOG_OK("late-completing launches still get balanced");
+}
+
+int main(int ac, char **av)
+{
+  testCoverage();
+  testConvergence();
+  testLateTimings();
+
+  bool threw = false;
+  try {
+    LoadBalancer balancer(2,0.f);
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  CHECK(threw);
+  LOG_OK("all load balancer tests passed");
+  return 0;
+}
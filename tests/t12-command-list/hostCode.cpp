@@ -0,0 +1,251 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+
+// Tests the host side of command lists: recording has to only work
+// in between begin and end, reject invalid commands, keep what it
+// records alive and in order, and pick the right replay strategy.
+
+#include "CommandRecorder.h"
+
+#define LOG(message)                                            \
+  std::cout << OWL_TERMINAL_BLUE;                               \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+#define LOG_OK(message)                                         \
+  std::cout << OWL_TERMINAL_LIGHT_BLUE;                         \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+
+#define CHECK(cond)                                                     \
+  if (!(cond))                                                          \
+    throw std::runtime_error(std::string("check failed: ")+#cond        \
+                             +" ("+__FILE__+":"+std::to_string(__LINE__)+")");
+
+#define CHECK_THROWS(statement)                                         \
+  {                                                                     \
+    bool threw = false;                                                 \
+    try { statement; } catch (const std::runtime_error &) { threw = true; } \
+    CHECK(threw);                                                       \
+  }
+
+using namespace owl;
+
+/*! stand-in for any owl object */
+struct FakeObject { int id; };
+
+std::shared_ptr<void> makeObject(int id)
+{
+  return std::make_shared<FakeObject>(FakeObject{id});
+}
+
+RecordedCommand upload(std::shared_ptr<void> buffer, const void *hostPtr,
+                       bool capturable = true)
+{
+  RecordedCommand command;
+  command.kind       = COMMAND_BUFFER_UPLOAD;
+  command.object     = buffer;
+  command.hostPtr    = hostPtr;
+  command.capturable = capturable;
+  return command;
+}
+
+RecordedCommand launch(std::shared_ptr<void> rayGen,
+                       std::shared_ptr<void> params,
+                       vec3i dims, bool capturable = true)
+{
+  RecordedCommand command;
+  command.kind       = COMMAND_LAUNCH;
+  command.object     = rayGen;
+  command.params     = params;
+  command.dims       = dims;
+  command.capturable = capturable;
+  return command;
+}
+
+RecordedCommand sync(std::shared_ptr<void> params)
+{
+  RecordedCommand command;
+  command.kind       = COMMAND_LAUNCH_SYNC;
+  command.params     = params;
+  command.capturable = true;
+  return command;
+}
+
+RecordedCommand refit(std::shared_ptr<void> group)
+{
+  RecordedCommand command;
+  command.kind   = COMMAND_GROUP_REFIT_ACCEL;
+  command.object = group;
+  return command;
+}
+
+void testBeginEnd()
+{
+  CommandRecorder recorder;
+  auto params = makeObject(0);
+  
+  CHECK(!recorder.isRecording());
+  CHECK_THROWS(recorder.record(sync(params)));
+  CHECK_THROWS(recorder.end());
+
+  recorder.begin();
+  CHECK(recorder.isRecording());
+  CHECK_THROWS(recorder.begin());
+  // nothing recorded
+  CHECK_THROWS(recorder.end());
+  CHECK(!recorder.isRecording());
+
+  // a second list doesn't see anything of the first
+  recorder.begin();
+  recorder.record(sync(params));
+  CHECK(recorder.end().size() == 1);
+  recorder.begin();
+  recorder.record(sync(params));
+  recorder.record(sync(params));
+  CHECK(recorder.end().size() == 2);
+  LOG_OK("begin/end pairing works");
+}
+
+void testValidation()
+{
+  CommandRecorder recorder;
+  auto buffer = makeObject(1), rayGen = makeObject(2), params = makeObject(3);
+  int data = 0;
+  
+  recorder.begin();
+  CHECK_THROWS(recorder.record(upload(nullptr,&data)));
+  CHECK_THROWS(recorder.record(upload(buffer,nullptr)));
+  CHECK_THROWS(recorder.record(launch(nullptr,params,vec3i(1))));
+  CHECK_THROWS(recorder.record(launch(rayGen,nullptr,vec3i(1))));
+  CHECK_THROWS(recorder.record(launch(rayGen,params,vec3i(16,0,1))));
+  CHECK_THROWS(recorder.record(launch(rayGen,params,vec3i(16,16,-1))));
+  CHECK_THROWS(recorder.record(sync(nullptr)));
+  CHECK_THROWS(recorder.record(refit(nullptr)));
+
+  // rejected commands don't end up in the list
+  recorder.record(upload(buffer,&data));
+  CHECK(recorder.end().size() == 1);
+  LOG_OK("invalid commands get rejected");
+}
+
+void testOrderAndLifetime()
+{
+  CommandRecorder recorder;
+  std::weak_ptr<void> weakGroup;
+  std::vector<RecordedCommand> commands;
+  {
+    auto group  = makeObject(1);
+    auto rayGen = makeObject(2);
+    auto params = makeObject(3);
+    weakGroup = group;
+    
+    recorder.begin();
+    recorder.record(refit(group));
+    recorder.record(launch(rayGen,params,vec3i(64,32,1)));
+    recorder.record(launch(rayGen,params,vec3i(128,1,1)));
+    recorder.record(sync(params));
+    commands = recorder.end();
+  }
+  // the app dropped its references, but the list still has them
+  CHECK(!weakGroup.expired());
+  CHECK(commands.size() == 4);
+  CHECK(commands[0].kind == COMMAND_GROUP_REFIT_ACCEL);
+  CHECK(commands[1].dims == vec3i(64,32,1));
+  CHECK(commands[2].dims == vec3i(128,1,1));
+  CHECK(commands[3].kind == COMMAND_LAUNCH_SYNC);
+  CHECK(((FakeObject*)commands[0].object.get())->id == 1);
+  commands.clear();
+  CHECK(weakGroup.expired());
+  LOG_OK("commands stay in order, and alive");
+}
+
+void testReplayPlan()
+{
+  auto buffer = makeObject(1), rayGen = makeObject(2), params = makeObject(3);
+  auto group  = makeObject(4);
+  int data = 0;
+
+  // uploads, launches, and syncs: graph, with a sync at the end
+  ReplayPlan plan = planReplay({ upload(buffer,&data),
+                                 launch(rayGen,params,vec3i(8,8,1)),
+                                 sync(params),
+                                 launch(rayGen,params,vec3i(8,8,1)) });
+  CHECK(plan.useGraph);
+  CHECK(plan.syncAtEnd);
+
+  // no sync anywhere: fully async
+  plan = planReplay({ launch(rayGen,params,vec3i(8,8,1)) });
+  CHECK(plan.useGraph);
+  CHECK(!plan.syncAtEnd);
+
+  // accel refits can't get captured
+  plan = planReplay({ refit(group), launch(rayGen,params,vec3i(8,8,1)) });
+  CHECK(!plan.useGraph);
+
+  // neither can any other command whose recorder says so
+  plan = planReplay({ upload(buffer,&data,false),
+                      launch(rayGen,params,vec3i(8,8,1)) });
+  CHECK(!plan.useGraph);
+  plan = planReplay({ launch(rayGen,params,vec3i(8,8,1),false) });
+  CHECK(!plan.useGraph);
+
+  // without any launch, a graph isn't worth it
+  plan = planReplay({ upload(buffer,&data) });
+  CHECK(!plan.useGraph);
+  LOG_OK("replay plans are right");
+}
+
+void testLaunchCapturability()
+{
+  auto rayGen = makeObject(2), params = makeObject(3);
+  const size_t maxLaunchSize = size_t(1)<<30;
+  const vec3i dims(1024,1024,1);
+
+  CHECK(launchIsCapturable(dims,maxLaunchSize,false,false));
+  CHECK(launchIsCapturable(vec3i(1<<15,1<<15,1),maxLaunchSize,false,false));
+  CHECK(!launchIsCapturable(vec3i(1<<15,1<<15,2),maxLaunchSize,false,false));
+  // tiled, load-balanced, or both: split up at launch time
+  CHECK(!launchIsCapturable(dims,maxLaunchSize,true,false));
+  CHECK(!launchIsCapturable(dims,maxLaunchSize,false,true));
+  CHECK(!launchIsCapturable(dims,maxLaunchSize,true,true));
+
+  // a load-balanced launch has to replay without a graph, so each
+  // device only traces its own part
+  ReplayPlan plan
+    = planReplay({ launch(rayGen,params,dims,
+                          launchIsCapturable(dims,maxLaunchSize,false,true)),
+                   sync(params) });
+  CHECK(!plan.useGraph);
+  CHECK(plan.syncAtEnd);
+  plan = planReplay({ launch(rayGen,params,dims,
+                             launchIsCapturable(dims,maxLaunchSize,false,false)),
+                      sync(params) });
+  CHECK(plan.useGraph);
+  LOG_OK("tiled and load-balanced launches don't get captured");
+}
+
+int main(int ac, char **av)
+{
+  testBeginEnd();
+  testValidation();
+  testOrderAndLifetime();
+  testReplayPlan();
+  testLaunchCapturability();
+  LOG_OK("all command list tests passed");
+  return 0;
+}
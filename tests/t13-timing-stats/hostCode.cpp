@@ -0,0 +1,107 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+
+// Tests the sliding window that per-device gpu timing stats get
+// computed over: last/min/mean/p99 have to be over exactly the most
+// recent measurements, the total count over all of them, and a reset
+// has to start over from scratch.
+
+#include "TimingWindow.h"
+
+#include <random>
+#include <algorithm>
+
+#define LOG(message)                                            \
+  std::cout << OWL_TERMINAL_BLUE;                               \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+#define LOG_OK(message)                                         \
+  std::cout << OWL_TERMINAL_LIGHT_BLUE;                         \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+
+#define CHECK(cond)                                                     \
+  if (!(cond))                                                          \
+    throw std::runtime_error(std::string("check failed: ")+#cond        \
+                             +" ("+__FILE__+":"+std::to_string(__LINE__)+")");
+
+using namespace owl;
+
+void testBasicStats()
+{
+  TimingWindow window(100);
+  OWLTimingStats stats = window.getStats();
+  CHECK(stats.count == 0 && stats.windowSize == 0);
+  CHECK(stats.last == 0.f && stats.p99 == 0.f);
+
+  // 1..100, shuffled: min 1, mean 50.5, p99 99
+  std::vector<float> times;
+  for (int i=1;i<=100;i++) times.push_back(float(i));
+  std::mt19937 rng(0x1234);
+  std::shuffle(times.begin(),times.end(),rng);
+  for (auto ms : times) window.add(ms);
+
+  stats = window.getStats();
+  CHECK(stats.count      == 100);
+  CHECK(stats.windowSize == 100);
+  CHECK(stats.last       == times.back());
+  CHECK(stats.min        == 1.f);
+  CHECK(stats.mean       == 50.5f);
+  CHECK(stats.p99        == 99.f);
+
+  // a single outlier shows up in p99 of a small window
+  TimingWindow small(10);
+  for (int i=0;i<9;i++) small.add(1.f);
+  small.add(50.f);
+  CHECK(small.getStats().p99  == 50.f);
+  CHECK(small.getStats().mean == 5.9f);
+  LOG_OK("stats over a window are correct");
+}
+
+void testSliding()
+{
+  TimingWindow window(10);
+  // a slow start, which has to drop out of the window ...
+  for (int i=0;i<10;i++) window.add(100.f);
+  // ... once enough faster ones came in
+  for (int i=0;i<25;i++) window.add(float(i));
+
+  const OWLTimingStats stats = window.getStats();
+  CHECK(stats.count      == 35);
+  CHECK(stats.windowSize == 10);
+  CHECK(stats.last       == 24.f);
+  CHECK(stats.min        == 15.f);
+  CHECK(stats.mean       == 19.5f);
+  CHECK(stats.p99        == 24.f);
+
+  window.reset();
+  CHECK(window.getStats().count == 0);
+  CHECK(window.getStats().windowSize == 0);
+  window.add(3.f);
+  CHECK(window.getStats().min == 3.f && window.getStats().p99 == 3.f);
+  CHECK(window.getStats().count == 1);
+  LOG_OK("window slides, and resets");
+}
+
+int main(int ac, char **av)
+{
+  testBasicStats();
+  testSliding();
+  LOG_OK("all timing stats tests passed");
+  return 0;
+}
@@ -0,0 +1,184 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+
+// Tests the host side of tracing: per-thread rings have to hand out
+// events in order, and count (rather than mangle) what got
+// overwritten; the tracer has to record nothing while disabled, keep
+// each thread's scopes properly nested, and write them out as chrome
+// trace-event json.
+
+#include "Trace.h"
+
+#include <thread>
+#include <cstring>
+
+#define LOG(message)                                            \
+  std::cout << OWL_TERMINAL_BLUE;                               \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+#define LOG_OK(message)                                         \
+  std::cout << OWL_TERMINAL_LIGHT_BLUE;                         \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+
+#define CHECK(cond)                                                     \
+  if (!(cond))                                                          \
+    throw std::runtime_error(std::string("check failed: ")+#cond        \
+                             +" ("+__FILE__+":"+std::to_string(__LINE__)+")");
+
+using namespace owl;
+
+/*! number of (non-overlapping) occurrences of 'what' in 's' */
+size_t countOf(const std::string &s, const std::string &what)
+{
+  size_t count = 0;
+  for (size_t pos = s.find(what); pos != std::string::npos;
+       pos = s.find(what,pos+what.size()))
+    count++;
+  return count;
+}
+
+void testRing()
+{
+  TraceRing ring(0,8);
+  std::vector<TraceEvent> events;
+  CHECK(ring.drain(events) == 0 && events.empty());
+
+  TraceEvent event = {};
+  for (int i=0;i<5;i++) {
+    event.timeNs = i;
+    ring.push(event);
+  }
+  CHECK(ring.drain(events) == 0);
+  CHECK(events.size() == 5);
+  for (int i=0;i<5;i++)
+    CHECK(events[i].timeNs == uint64_t(i));
+
+  // 20 more: only the last 8 survive, in order
+  for (int i=5;i<25;i++) {
+    event.timeNs = i;
+    ring.push(event);
+  }
+  events.clear();
+  CHECK(ring.drain(events) == 12);
+  CHECK(events.size() == 8);
+  for (int i=0;i<8;i++)
+    CHECK(events[i].timeNs == uint64_t(17+i));
+
+  events.clear();
+  CHECK(ring.drain(events) == 0 && events.empty());
+  LOG_OK("trace rings drain in order, and count overwritten events");
+}
+
+/*! checks that the B/E events of each thread in the trace are
+    properly nested and in time order */
+void checkNesting(const std::string &json, int numThreads)
+{
+  for (int tid=0;tid<numThreads;tid++) {
+    std::vector<std::string> open;
+    double lastTime = -1.;
+    const std::string tidTag = "\"tid\":"+std::to_string(tid)+",";
+    const std::string tidEnd = "\"tid\":"+std::to_string(tid)+"}";
+    size_t pos = 0;
+    while ((pos = json.find("{\"name\":\"",pos)) != std::string::npos) {
+      const size_t end = json.find('\n',pos);
+      const std::string line = json.substr(pos,end-pos);
+      pos = end;
+      if (line.find(tidTag) == std::string::npos
+          && line.find(tidEnd) == std::string::npos)
+        continue;
+      const std::string name = line.substr(9,line.find('"',9)-9);
+      const double time = std::stod(line.substr(line.find("\"ts\":")+5));
+      CHECK(time >= lastTime);
+      lastTime = time;
+      if (line.find("\"ph\":\"B\"") != std::string::npos)
+        open.push_back(name);
+      else {
+        CHECK(!open.empty() && open.back() == name);
+        open.pop_back();
+      }
+    }
+    CHECK(open.empty());
+  }
+}
+
+void testTracer()
+{
+  Tracer tracer;
+  
+  // nothing gets recorded while disabled
+  { TraceScope scope("owlIgnored","api",-1,tracer); }
+  CHECK(countOf(tracer.flush(),"\"ph\"") == 0);
+
+  tracer.setEnabled(true);
+  const int numThreads = 4;
+  const int numCalls   = 100;
+  auto work = [&]() {
+    for (int i=0;i<numCalls;i++) {
+      TraceScope api("owlGroupBuildAccel","api",-1,tracer);
+      for (int device=0;device<2;device++) {
+        TraceScope build("buildAccel","accel",device,tracer);
+        TraceScope compact("compactAccel","accel",device,tracer);
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i=0;i<numThreads;i++)
+    threads.push_back(std::thread(work));
+  for (auto &t : threads) t.join();
+  work();
+
+  // a scope that started while enabled still gets closed
+  {
+    TraceScope scope("owl\"Quoted\"\n","api",-1,tracer);
+    tracer.setEnabled(false);
+  }
+  
+  const std::string json = tracer.flush();
+  CHECK(json.find("{\"traceEvents\":[") == 0);
+  CHECK(json.find("\"droppedEvents\":0") != std::string::npos);
+  const size_t eventsPerThread = numCalls * (1+2*2) * 2;
+  CHECK(countOf(json,"\"ph\":\"B\"")+countOf(json,"\"ph\":\"E\"")
+        == (numThreads+1)*eventsPerThread + 2);
+  CHECK(countOf(json,"\"name\":\"compactAccel\"") == (numThreads+1)*numCalls*4);
+  CHECK(countOf(json,"\"args\":{\"device\":1}") == (numThreads+1)*numCalls*4);
+  CHECK(countOf(json,"\"name\":\"owl\\\"Quoted\\\"\\u000a\"") == 2);
+  checkNesting(json,numThreads+1);
+
+  // everything got flushed
+  CHECK(countOf(tracer.flush(),"\"ph\"") == 0);
+  LOG_OK("traces record, nest, and serialize correctly");
+
+  // a thread recording more than fits gets its oldest events dropped,
+  // and counted
+  Tracer small(16);
+  small.setEnabled(true);
+  for (int i=0;i<20;i++) small.begin("x","api");
+  const std::string overflown = small.flush();
+  CHECK(countOf(overflown,"\"ph\"") == 16);
+  CHECK(overflown.find("\"droppedEvents\":4") != std::string::npos);
+  LOG_OK("overflowing traces count dropped events");
+}
+
+int main(int ac, char **av)
+{
+  testRing();
+  testTracer();
+  LOG_OK("all trace tests passed");
+  return 0;
+}
@@ -0,0 +1,297 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+
+// Tests the host side of api captures: calls, with all their kinds
+// of arguments, have to come back out exactly as they went in; data
+// that gets passed over and over has to be stored only once; and
+// anything that isn't a valid capture has to get rejected rather
+// than misread.
+
+#include "Capture.h"
+
+#include <sstream>
+#include <cstring>
+
+#define LOG(message)                                            \
+  std::cout << OWL_TERMINAL_BLUE;                               \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+#define LOG_OK(message)                                         \
+  std::cout << OWL_TERMINAL_LIGHT_BLUE;                         \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+
+#define CHECK(cond)                                                     \
+  if (!(cond))                                                          \
+    throw std::runtime_error(std::string("check failed: ")+#cond        \
+                             +" ("+__FILE__+":"+std::to_string(__LINE__)+")");
+
+using namespace owl;
+
+/*! stand-ins for api handles; only their addresses matter */
+int fakeContext, fakeBuffer, fakeRayGen, fakeParams;
+
+/*! checks that parsing the given capture throws */
+bool rejects(const std::string &capture)
+{
+  try {
+    std::istringstream in(capture);
+    CaptureReader reader(in);
+    CaptureRecord record;
+    while (reader.next(record)) {
+      // buffer uploads refer to blobs
+      if (record.call == CAPTURE_BUFFER_UPLOAD) {
+        record.args.get<CaptureHandle>();
+        record.args.get<uint64_t>();
+        record.args.get<int64_t>();
+        record.args.get<CaptureBufferData>();
+        reader.getBlob(record.args.get<uint64_t>());
+      }
+    }
+  } catch (const std::runtime_error &) {
+    return true;
+  }
+  return false;
+}
+
+/*! writes a small capture: a context, a buffer, a raygen, params,
+    and a few frames of uploading the same data and launching */
+std::string writeCapture(CaptureWriter::Stats &stats, int numFrames)
+{
+  std::ostringstream out;
+  CaptureWriter writer(out);
+  
+  const int32_t deviceIDs[2] = { 1, 0 };
+  writer.call(CAPTURE_CONTEXT_CREATE,CaptureArgs()
+              .put(writer.newHandle(&fakeContext))
+              .put((int32_t)2)
+              .putBytes(deviceIDs,sizeof(deviceIDs)));
+
+  std::vector<float> data(100000);
+  for (size_t i=0;i<data.size();i++)
+    data[i] = float(i);
+  writer.call(CAPTURE_DEVICE_BUFFER_CREATE,CaptureArgs()
+              .put(writer.newHandle(&fakeBuffer))
+              .put(writer.handleID(&fakeContext))
+              .put((uint32_t)OWL_FLOAT)
+              .put((uint64_t)data.size())
+              .put(CAPTURE_BUFFER_DATA_NONE));
+
+  OWLVarDecl vars[] = {
+    { "fb",   OWL_BUFPTR, 0 },
+    { "dims", OWL_INT2,   8 },
+  };
+  writer.call(CAPTURE_RAY_GEN_CREATE,CaptureArgs()
+              .put(writer.newHandle(&fakeRayGen))
+              .put(writer.handleID(&fakeContext))
+              .put(writer.handleID(nullptr))
+              .putString("simpleRayGen")
+              .put((uint64_t)16)
+              .putVarDecls(std::vector<OWLVarDecl>(vars,vars+2)));
+  writer.call(CAPTURE_PARAMS_CREATE,CaptureArgs()
+              .put(writer.newHandle(&fakeParams))
+              .put(writer.handleID(&fakeContext))
+              .put((uint64_t)0)
+              .putVarDecls({}));
+  
+  for (int frame=0;frame<numFrames;frame++) {
+    writer.call(CAPTURE_BUFFER_UPLOAD,CaptureArgs()
+                .put(writer.handleID(&fakeBuffer))
+                .put((uint64_t)0)
+                .put((int64_t)-1)
+                .put(CAPTURE_BUFFER_DATA_BLOB)
+                .put(writer.blob(data.data(),data.size()*sizeof(float))));
+    writer.call(CAPTURE_ASYNC_LAUNCH,CaptureArgs()
+                .put(writer.handleID(&fakeRayGen))
+                .put(writer.handleID(&fakeParams))
+                .put((int32_t)800)
+                .put((int32_t)600)
+                .put((int32_t)1));
+  }
+  writer.flush();
+  stats = writer.getStats();
+  return out.str();
+}
+
+void testRoundTrip()
+{
+  CaptureWriter::Stats stats;
+  const std::string capture = writeCapture(stats,1);
+  CHECK(stats.numCalls == 6);
+  
+  std::istringstream in(capture);
+  CaptureReader reader(in);
+  CaptureRecord record;
+
+  CHECK(reader.next(record) && record.call == CAPTURE_CONTEXT_CREATE);
+  const CaptureHandle context = record.args.get<CaptureHandle>();
+  CHECK(context == 1);
+  CHECK(record.args.get<int32_t>() == 2);
+  const std::vector<uint8_t> deviceIDs = record.args.getBytes();
+  CHECK(deviceIDs.size() == 2*sizeof(int32_t));
+  CHECK(((const int32_t *)deviceIDs.data())[0] == 1);
+  CHECK(record.args.atEnd());
+
+  CHECK(reader.next(record) && record.call == CAPTURE_DEVICE_BUFFER_CREATE);
+  const CaptureHandle buffer = record.args.get<CaptureHandle>();
+  CHECK(buffer == 2);
+  CHECK(record.args.get<CaptureHandle>() == context);
+  CHECK(record.args.get<uint32_t>() == OWL_FLOAT);
+  CHECK(record.args.get<uint64_t>() == 100000);
+  CHECK(record.args.get<CaptureBufferData>() == CAPTURE_BUFFER_DATA_NONE);
+  CHECK(record.args.atEnd());
+  
+  CHECK(reader.next(record) && record.call == CAPTURE_RAY_GEN_CREATE);
+  const CaptureHandle rayGen = record.args.get<CaptureHandle>();
+  CHECK(record.args.get<CaptureHandle>() == context);
+  CHECK(record.args.get<CaptureHandle>() == 0);
+  CHECK(record.args.getString() == "simpleRayGen");
+  CHECK(record.args.get<uint64_t>() == 16);
+  std::vector<std::string> names;
+  const std::vector<OWLVarDecl> vars = record.args.getVarDecls(names);
+  CHECK(vars.size() == 2);
+  CHECK(std::string(vars[0].name) == "fb"   && vars[0].type == OWL_BUFPTR);
+  CHECK(std::string(vars[1].name) == "dims" && vars[1].offset == 8);
+  CHECK(record.args.atEnd());
+  
+  CHECK(reader.next(record) && record.call == CAPTURE_PARAMS_CREATE);
+  const CaptureHandle params = record.args.get<CaptureHandle>();
+  record.args.get<CaptureHandle>();
+  record.args.get<uint64_t>();
+  CHECK(record.args.getVarDecls(names).empty());
+  CHECK(rayGen == 3 && params == 4);
+
+  CHECK(reader.next(record) && record.call == CAPTURE_BUFFER_UPLOAD);
+  CHECK(record.args.get<CaptureHandle>() == buffer);
+  CHECK(record.args.get<uint64_t>() == 0);
+  CHECK(record.args.get<int64_t>() == -1);
+  CHECK(record.args.get<CaptureBufferData>() == CAPTURE_BUFFER_DATA_BLOB);
+  const std::vector<uint8_t> *blob = reader.getBlob(record.args.get<uint64_t>());
+  CHECK(blob && blob->size() == 100000*sizeof(float));
+  CHECK(((const float *)blob->data())[12345] == 12345.f);
+  
+  CHECK(reader.next(record) && record.call == CAPTURE_ASYNC_LAUNCH);
+  CHECK(record.args.get<CaptureHandle>() == rayGen);
+  CHECK(record.args.get<CaptureHandle>() == params);
+  CHECK(record.args.get<int32_t>() == 800);
+  CHECK(record.args.get<int32_t>() == 600);
+  CHECK(record.args.get<int32_t>() == 1);
+  CHECK(record.args.atEnd());
+  
+  CHECK(!reader.next(record));
+  CHECK(reader.getBlob(0) == nullptr);
+  LOG_OK("calls come back out the way they went in");
+}
+
+void testDedup()
+{
+  CaptureWriter::Stats oneFrame, manyFrames;
+  const std::string small = writeCapture(oneFrame,1);
+  const std::string large = writeCapture(manyFrames,100);
+  const size_t dataBytes = 100000*sizeof(float);
+  CHECK(manyFrames.numBlobs == 1);
+  CHECK(manyFrames.blobBytes == dataBytes);
+  CHECK(manyFrames.blobBytesSaved == 99*dataBytes);
+  // each extra frame adds only its two call records
+  CHECK(large.size()-small.size() < 99*100);
+  LOG("100 frames: " << prettyNumber(large.size()) << "B, vs "
+      << prettyNumber(100*dataBytes) << "B of uploaded data");
+
+  // a handle that never got created gets a fresh ID, not that of
+  // another object
+  std::ostringstream out;
+  CaptureWriter writer(out);
+  const CaptureHandle created = writer.newHandle(&fakeBuffer);
+  CHECK(writer.handleID(&fakeRayGen) != created);
+  CHECK(writer.handleID(&fakeBuffer) == created);
+  CHECK(writer.handleID(nullptr) == 0);
+  // re-used addresses get new IDs
+  CHECK(writer.newHandle(&fakeBuffer) != created);
+  LOG_OK("repeated data gets stored once");
+}
+
+void testInvalid()
+{
+  CaptureWriter::Stats stats;
+  const std::string capture = writeCapture(stats,2);
+  CHECK(!rejects(capture));
+
+  // not a capture at all
+  CHECK(rejects(""));
+  CHECK(rejects("OWLCAPX"+capture.substr(7)));
+  // wrong version
+  {
+    std::string badVersion = capture;
+    badVersion[sizeof(captureMagic)] = 99;
+    CHECK(rejects(badVersion));
+  }
+  // truncated anywhere inside a record
+  for (size_t size : { size_t(10), capture.size()/2, capture.size()-1 })
+    CHECK(rejects(capture.substr(0,size)));
+  // unknown record tag, and unknown call
+  {
+    std::string badTag = capture;
+    badTag[sizeof(captureMagic)+sizeof(captureVersion)] = 77;
+    CHECK(rejects(badTag));
+    std::string badCall = capture;
+    const uint16_t callID = 9999;
+    memcpy(&badCall[sizeof(captureMagic)+sizeof(captureVersion)+1],
+           &callID,sizeof(callID));
+    CHECK(rejects(badCall));
+  }
+  // an upload referring to data that isn't in the capture
+  {
+    std::ostringstream out;
+    CaptureWriter writer(out);
+    writer.call(CAPTURE_BUFFER_UPLOAD,CaptureArgs()
+                .put(writer.newHandle(&fakeBuffer))
+                .put((uint64_t)0)
+                .put((int64_t)-1)
+                .put(CAPTURE_BUFFER_DATA_BLOB)
+                .put((uint64_t)0x1234));
+    writer.flush();
+    CHECK(rejects(out.str()));
+  }
+  // reading past the end of a call's arguments
+  {
+    std::istringstream in(capture);
+    CaptureReader reader(in);
+    CaptureRecord record;
+    CHECK(reader.next(record) && record.call == CAPTURE_CONTEXT_CREATE);
+    record.args.get<CaptureHandle>();
+    record.args.get<int32_t>();
+    record.args.getBytes();
+    bool threw = false;
+    try {
+      record.args.get<uint64_t>();
+    } catch (const std::runtime_error &) {
+      threw = true;
+    }
+    CHECK(threw);
+  }
+  LOG_OK("invalid captures get rejected");
+}
+
+int main(int ac, char **av)
+{
+  testRoundTrip();
+  testDedup();
+  testInvalid();
+  LOG_OK("all api capture tests passed");
+  return 0;
+}
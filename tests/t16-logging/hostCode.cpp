@@ -0,0 +1,204 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+
+// Tests the host side of logging: the queue has to hand out every
+// message each thread pushed, in that thread's order, and refuse
+// (rather than overwrite) messages once full; the logger has to
+// filter by level and category before formatting anything, deliver
+// to the callback, say how many messages it had to drop, and write
+// errors right away.
+
+#include "Log.h"
+
+#include <map>
+
+#define LOG(message)                                            \
+  std::cout << OWL_TERMINAL_BLUE;                               \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+#define LOG_OK(message)                                         \
+  std::cout << OWL_TERMINAL_LIGHT_BLUE;                         \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+
+#define CHECK(cond)                                                     \
+  if (!(cond))                                                          \
+    throw std::runtime_error(std::string("check failed: ")+#cond        \
+                             +" ("+__FILE__+":"+std::to_string(__LINE__)+")");
+
+using namespace owl;
+
+void testQueue()
+{
+  LogQueue queue(5);
+  CHECK(queue.capacity == 8);
+  LogMessage message;
+  CHECK(!queue.pop(message));
+  for (int i=0;i<8;i++) {
+    message.text = std::to_string(i);
+    CHECK(queue.push(message));
+  }
+  message.text = "one too many";
+  CHECK(!queue.push(message));
+  CHECK(message.text == "one too many");
+  for (int i=0;i<8;i++) {
+    CHECK(queue.pop(message));
+    CHECK(message.text == std::to_string(i));
+  }
+  CHECK(!queue.pop(message));
+
+  // several producers, one consumer running concurrently
+  const int numThreads = 8;
+  const int numPerThread = 20000;
+  LogQueue shared(1024);
+  std::vector<std::thread> producers;
+  for (int t=0;t<numThreads;t++)
+    producers.push_back(std::thread([&shared,t,numPerThread](){
+          for (int i=0;i<numPerThread;i++) {
+            LogMessage m { OWL_LOG_LEVEL_INFO, uint32_t(t), std::to_string(i) };
+            while (!shared.push(m))
+              std::this_thread::yield();
+          }
+        }));
+  std::vector<int> next(numThreads,0);
+  for (int received=0;received<numThreads*numPerThread;) {
+    if (!shared.pop(message)) {
+      std::this_thread::yield();
+      continue;
+    }
+    CHECK(message.text == std::to_string(next[message.category]));
+    next[message.category]++;
+    received++;
+  }
+  for (auto &p : producers) p.join();
+  CHECK(!shared.pop(message));
+  LOG_OK("queue keeps every message, in order per thread");
+}
+
+/*! collects what a logger delivers */
+struct Received {
+  std::vector<std::pair<OWLLogLevel,std::string>> messages;
+  /*! to wait for the writer thread with */
+  std::atomic<int> numReceived { 0 };
+  static void callback(OWLLogLevel level, uint32_t category,
+                       const char *message, void *userData)
+  {
+    Received *received = (Received *)userData;
+    received->messages.push_back({level,message});
+    received->numReceived++;
+  }
+};
+
+int numFormatted = 0;
+std::string formatted(const std::string &s)
+{
+  numFormatted++;
+  return s;
+}
+
+void testLogger()
+{
+  Received received;
+  {
+    Logger logger(16,false);
+    logger.setCallback(Received::callback,&received);
+    logger.setLevel(OWL_LOG_LEVEL_INFO);
+    logger.setCategories(OWL_LOG_CATEGORY_ACCEL|OWL_LOG_CATEGORY_BUILD);
+
+    CHECK(logger.isEnabled(OWL_LOG_LEVEL_WARNING,OWL_LOG_CATEGORY_ACCEL));
+    CHECK(logger.isEnabled(OWL_LOG_LEVEL_INFO,OWL_LOG_CATEGORY_BUILD));
+    CHECK(!logger.isEnabled(OWL_LOG_LEVEL_DEBUG,OWL_LOG_CATEGORY_ACCEL));
+    CHECK(!logger.isEnabled(OWL_LOG_LEVEL_INFO,OWL_LOG_CATEGORY_CONTEXT));
+    logger.setLevel(OWL_LOG_LEVEL_NONE);
+    CHECK(!logger.isEnabled(OWL_LOG_LEVEL_ERROR,OWL_LOG_CATEGORY_ACCEL));
+    logger.setLevel(OWL_LOG_LEVEL_INFO);
+    
+    logger.log(OWL_LOG_LEVEL_INFO,OWL_LOG_CATEGORY_ACCEL,"first");
+    logger.log(OWL_LOG_LEVEL_WARNING,OWL_LOG_CATEGORY_BUILD,"second");
+    // nothing gets delivered before a flush ...
+    CHECK(received.messages.empty());
+    logger.flush();
+    CHECK(received.messages.size() == 2);
+    CHECK(received.messages[0].second == "first");
+    CHECK(received.messages[1].first == OWL_LOG_LEVEL_WARNING);
+
+    // ... except for errors, which flush everything before them
+    logger.log(OWL_LOG_LEVEL_INFO,OWL_LOG_CATEGORY_ACCEL,"third");
+    logger.log(OWL_LOG_LEVEL_ERROR,OWL_LOG_CATEGORY_ACCEL,"broken");
+    CHECK(received.messages.size() == 4);
+    CHECK(received.messages[3].second == "broken");
+    
+    // overflowing the queue drops, and says so
+    received.messages.clear();
+    for (int i=0;i<20;i++)
+      logger.log(OWL_LOG_LEVEL_INFO,OWL_LOG_CATEGORY_ACCEL,std::to_string(i));
+    CHECK(logger.getNumDropped() == 4);
+    logger.flush();
+    CHECK(received.messages.size() == 17);
+    CHECK(received.messages[15].second == "15");
+    CHECK(received.messages[16].first == OWL_LOG_LEVEL_WARNING);
+    CHECK(received.messages[16].second.find("4 log message(s) dropped") == 0);
+
+    // ... but never drops errors
+    received.messages.clear();
+    for (int i=0;i<16;i++)
+      logger.log(OWL_LOG_LEVEL_INFO,OWL_LOG_CATEGORY_ACCEL,std::to_string(i));
+    logger.log(OWL_LOG_LEVEL_INFO,OWL_LOG_CATEGORY_ACCEL,"dropped");
+    logger.log(OWL_LOG_LEVEL_ERROR,OWL_LOG_CATEGORY_ACCEL,"broken again");
+    CHECK(logger.getNumDropped() == 5);
+    CHECK(received.messages.size() == 18);
+    CHECK(received.messages[15].second == "15");
+    CHECK(received.messages[16].second.find("1 log message(s) dropped") == 0);
+    CHECK(received.messages[17].first == OWL_LOG_LEVEL_ERROR);
+    CHECK(received.messages[17].second == "broken again");
+    
+    // anything still queued gets written upon destruction
+    received.messages.clear();
+    logger.log(OWL_LOG_LEVEL_INFO,OWL_LOG_CATEGORY_ACCEL,"last words");
+  }
+  CHECK(received.messages.size() == 1);
+  LOG_OK("logger filters, delivers, and reports drops");
+
+  // the macros only format messages that get logged
+  Logger &logger = Logger::get();
+  received.messages.clear();
+  logger.setCallback(Received::callback,&received);
+  logger.setLevel(OWL_LOG_LEVEL_WARNING);
+  logger.setCategories(OWL_LOG_CATEGORY_ALL);
+  OWL_LOG_INFO(OWL_LOG_CATEGORY_ACCEL,"not " << formatted("this"));
+  CHECK(numFormatted == 0);
+  OWL_LOG_WARNING(OWL_LOG_CATEGORY_ACCEL,"but " << formatted("this") << " " << 42);
+  CHECK(numFormatted == 1);
+  
+  // the writer thread delivers without being asked to
+  for (int i=0;i<100 && received.numReceived == 0;i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  logger.setCallback(nullptr,nullptr);
+  CHECK(received.messages.size() == 1);
+  CHECK(received.messages[0].second == "but this 42");
+  OWL_LOG_WARNING(OWL_LOG_CATEGORY_ACCEL,"(this one goes to the console)");
+  LOG_OK("log macros format lazily, and get written in the background");
+}
+
+int main(int ac, char **av)
+{
+  testQueue();
+  testLogger();
+  LOG_OK("all logging tests passed");
+  return 0;
+}
@@ -0,0 +1,247 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+
+// Tests the host side of replicated multi-GPU uploads: for a range
+// of made-up topologies, the plan has to get the data onto every
+// device exactly once, only copy from devices that already have it,
+// only use links that exist, and take as few rounds (and PCIe copies)
+// as the topology allows. Also runs a chunked, byte-level simulation
+// of each plan, the same way the context executes it.
+
+#include "UploadReplication.h"
+
+#include <cstring>
+
+#define LOG(message)                                            \
+  std::cout << OWL_TERMINAL_BLUE;                               \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+#define LOG_OK(message)                                         \
+  std::cout << OWL_TERMINAL_LIGHT_BLUE;                         \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+
+#define CHECK(cond)                                                     \
+  if (!(cond))                                                          \
+    throw std::runtime_error(std::string("check failed: ")+#cond        \
+                             +" ("+__FILE__+":"+std::to_string(__LINE__)+")");
+
+using namespace owl;
+
+/*! connects all pairs of devices for which 'connected(i,j)' says so,
+    in both directions */
+template<typename Lambda>
+DeviceTopology makeTopology(int numDevices, PeerLink link, const Lambda &connected)
+{
+  DeviceTopology topology;
+  topology.resize(numDevices);
+  for (int i=0;i<numDevices;i++)
+    for (int j=0;j<numDevices;j++)
+      if (i != j && connected(i,j))
+        topology.setLink(i,j,link);
+  return topology;
+}
+
+int numSteps(const ReplicationPlan &plan, PeerLink link)
+{
+  int count = 0;
+  for (auto &step : plan.steps)
+    if (step.source >= 0 && step.link == link)
+      count++;
+  return count;
+}
+
+/*! checks that 'plan' is a valid one for 'topology', and that
+    executing it chunk by chunk leaves every device with the host's
+    data */
+void checkPlan(const DeviceTopology &topology, const ReplicationPlan &plan)
+{
+  const int numDevices = topology.numDevices();
+  std::vector<int> receivedInRound(numDevices,-1);
+  std::vector<int> lastSendRound(numDevices,-1);
+  int lastRound = 0;
+  for (auto &step : plan.steps) {
+    CHECK(step.target >= 0 && step.target < numDevices);
+    CHECK(receivedInRound[step.target] < 0);
+    CHECK(step.round >= lastRound);
+    lastRound = step.round;
+    if (step.source < 0) {
+      CHECK(step.round == 0);
+      CHECK(step.link == PEER_LINK_NONE);
+    } else {
+      CHECK(receivedInRound[step.source] >= 0);
+      CHECK(receivedInRound[step.source] < step.round);
+      CHECK(step.link != PEER_LINK_NONE);
+      CHECK(step.link == topology.getLink(step.source,step.target));
+      // one copy per source and round
+      CHECK(lastSendRound[step.source] < step.round);
+      lastSendRound[step.source] = step.round;
+    }
+    receivedInRound[step.target] = step.round;
+  }
+  for (int i=0;i<numDevices;i++)
+    CHECK(receivedInRound[i] >= 0);
+  CHECK(plan.numRounds == (plan.steps.empty() ? 0 : lastRound+1));
+
+  // simulate it, with a size that ends in a partial chunk
+  const size_t numBytes = 2*replicationChunkSize+12345;
+  std::vector<uint8_t> host(numBytes);
+  for (size_t i=0;i<numBytes;i++)
+    host[i] = uint8_t(i*7+(i>>12));
+  std::vector<std::vector<uint8_t>> devices(numDevices,
+                                            std::vector<uint8_t>(numBytes,0));
+  std::vector<std::vector<int>> timesWritten(numDevices,
+                                             std::vector<int>(3,0));
+  for (size_t begin=0;begin<numBytes;begin+=replicationChunkSize) {
+    const size_t chunkSize = std::min(replicationChunkSize,numBytes-begin);
+    for (auto &step : plan.steps) {
+      const uint8_t *source
+        = step.source < 0 ? host.data() : devices[step.source].data();
+      memcpy(devices[step.target].data()+begin,source+begin,chunkSize);
+      timesWritten[step.target][begin/replicationChunkSize]++;
+    }
+  }
+  for (int i=0;i<numDevices;i++) {
+    CHECK(devices[i] == host);
+    for (int count : timesWritten[i])
+      CHECK(count == 1);
+  }
+}
+
+void testTrivialTopologies()
+{
+  // a single device just gets uploaded to
+  {
+    DeviceTopology topology;
+    topology.resize(1);
+    ReplicationPlan plan = planReplication(topology);
+    checkPlan(topology,plan);
+    CHECK(plan.steps.size() == 1 && plan.numRounds == 1);
+  }
+  // without peer access, every device gets its own upload
+  {
+    DeviceTopology topology
+      = makeTopology(4,PEER_LINK_NONE,[](int,int){ return false; });
+    ReplicationPlan plan = planReplication(topology);
+    checkPlan(topology,plan);
+    CHECK(plan.numHostUploads() == 4 && plan.numRounds == 1);
+  }
+  LOG_OK("single device and no peer access work like plain uploads");
+}
+
+void testFullyConnected()
+{
+  for (PeerLink link : { PEER_LINK_NVLINK, PEER_LINK_PCIE }) {
+    for (int numDevices : { 2, 3, 4, 5, 8 }) {
+      DeviceTopology topology
+        = makeTopology(numDevices,link,[](int,int){ return true; });
+      ReplicationPlan plan = planReplication(topology);
+      checkPlan(topology,plan);
+      CHECK(plan.numHostUploads() == 1);
+      // a binary broadcast tree: 1+ceil(log2(N)) rounds
+      int expectedRounds = 1;
+      while ((1<<(expectedRounds-1)) < numDevices)
+        expectedRounds++;
+      CHECK(plan.numRounds == expectedRounds);
+    }
+  }
+  LOG_OK("fully connected devices get a single upload plus a broadcast tree");
+}
+
+void testNearestDevice()
+{
+  // all connected, but only device 2 is on the host's NUMA node
+  DeviceTopology topology
+    = makeTopology(4,PEER_LINK_PCIE,[](int,int){ return true; });
+  topology.hostDistance = { 1, 1, 0, 1 };
+  ReplicationPlan plan = planReplication(topology);
+  checkPlan(topology,plan);
+  CHECK(plan.steps[0].source == -1 && plan.steps[0].target == 2);
+
+  // all equally near: the one with the most NVLink peers goes first
+  topology = makeTopology(4,PEER_LINK_PCIE,[](int,int){ return true; });
+  topology.setLink(3,1,PEER_LINK_NVLINK);
+  topology.setLink(3,2,PEER_LINK_NVLINK);
+  plan = planReplication(topology);
+  checkPlan(topology,plan);
+  CHECK(plan.steps[0].source == -1 && plan.steps[0].target == 3);
+  LOG_OK("the data gets uploaded to the nearest device");
+}
+
+void testNVLinkIslands()
+{
+  // two sets of four devices, each connected by NVLink, and PCIe
+  // peer access between the two: only one copy should have to go
+  // over PCIe, and that early enough not to take any extra round
+  {
+    DeviceTopology topology
+      = makeTopology(8,PEER_LINK_PCIE,[](int,int){ return true; });
+    for (int i=0;i<8;i++)
+      for (int j=0;j<8;j++)
+        if (i != j && i/4 == j/4)
+          topology.setLink(i,j,PEER_LINK_NVLINK);
+    ReplicationPlan plan = planReplication(topology);
+    checkPlan(topology,plan);
+    CHECK(plan.numHostUploads() == 1);
+    CHECK(numSteps(plan,PEER_LINK_PCIE) == 1);
+    CHECK(plan.numRounds == 4);
+  }
+  // the same, without any peer access between the two: each gets
+  // its own host upload
+  {
+    DeviceTopology topology
+      = makeTopology(8,PEER_LINK_NVLINK,[](int i,int j){ return i/4 == j/4; });
+    ReplicationPlan plan = planReplication(topology);
+    checkPlan(topology,plan);
+    CHECK(plan.numHostUploads() == 2);
+    CHECK(numSteps(plan,PEER_LINK_NVLINK) == 6);
+    CHECK(plan.numRounds == 3);
+  }
+  // pairs of devices with peer access only within each pair (eg,
+  // NVLink bridges), plus one device without any
+  {
+    DeviceTopology topology
+      = makeTopology(5,PEER_LINK_NVLINK,[](int i,int j){ return i/2 == j/2; });
+    ReplicationPlan plan = planReplication(topology);
+    checkPlan(topology,plan);
+    CHECK(plan.numHostUploads() == 3);
+    CHECK(plan.numRounds == 2);
+  }
+  // one-way peer access only: 0 can be copied into 1, but not the
+  // other way around
+  {
+    DeviceTopology topology;
+    topology.resize(2);
+    topology.setLink(0,1,PEER_LINK_PCIE);
+    topology.hostDistance = { 1, 0 };
+    ReplicationPlan plan = planReplication(topology);
+    checkPlan(topology,plan);
+    CHECK(plan.numHostUploads() == 2);
+  }
+  LOG_OK("NVLink islands get one PCIe copy each, or their own upload");
+}
+
+int main(int ac, char **av)
+{
+  testTrivialTopologies();
+  testFullyConnected();
+  testNearestDevice();
+  testNVLinkIslands();
+  LOG_OK("all upload replication tests passed");
+  return 0;
+}
@@ -0,0 +1,130 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+
+// Tests the host-side PTX filter that comments out all lines using
+// internal optix symbols (for building the bounds programs as a plain
+// cuda module): its single-pass scan has to produce exactly what the
+// straightforward line-by-line rewrite it replaced did, including
+// for symbols on the first and last line, a last line without a
+// newline, adjacent matching lines, and '_optix_' without a leading
+// space.
+
+#include "PtxUtils.h"
+#include "owl/common.h"
+
+#include <random>
+#include <sstream>
+
+#define LOG(message)                                            \
+  std::cout << OWL_TERMINAL_BLUE;                               \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+#define LOG_OK(message)                                         \
+  std::cout << OWL_TERMINAL_LIGHT_BLUE;                         \
+  std::cout << "#owl.test(main): " << message << std::endl;     \
+  std::cout << OWL_TERMINAL_DEFAULT;
+
+#define CHECK(cond)                                                     \
+  if (!(cond))                                                          \
+    throw std::runtime_error(std::string("check failed: ")+#cond        \
+                             +" ("+__FILE__+":"+std::to_string(__LINE__)+")");
+
+using namespace owl;
+
+/*! the original, line-by-line version, as reference */
+std::string referenceFilter(const std::string &ptx)
+{
+  std::stringstream fixed;
+  for (const char *s = ptx.c_str(); *s; ) {
+    std::stringstream lineStream;
+    while (*s) {
+      char c = *s++;
+      lineStream << c;
+      if (c == '\n') break;
+    }
+    const std::string line = lineStream.str();
+    if (line.find(" _optix_") != line.npos)
+      fixed << "//dropped: " << line;
+    else
+      fixed << line;
+  }
+  return fixed.str();
+}
+
+void checkSame(const std::string &ptx)
+{
+  const std::string expected = referenceFilter(ptx);
+  const std::string fixed    = killAllInternalOptixSymbolsFromPtxString(ptx);
+  if (fixed != expected) {
+    LOG("mismatch for input '" << ptx << "':\n'" << fixed
+        << "'\nexpected:\n'" << expected << "'");
+  }
+  CHECK(fixed == expected);
+}
+
+void testEdgeCases()
+{
+  const std::string use = "\tcall (%r1), _optix_get_launch_index_x, ();";
+  checkSame("");
+  checkSame("\n");
+  checkSame(" _optix_");
+  checkSame(use);
+  checkSame(use+"\n");
+  // first line, last line (with and without newline)
+  checkSame(use+"\n\tret;\n");
+  checkSame("\tret;\n"+use);
+  checkSame("\tret;\n"+use+"\n");
+  // adjacent lines, and one line using two of them
+  checkSame("\tret;\n"+use+"\n"+use+"\n\tret;\n");
+  checkSame(use+" _optix_trace_0\n"+use);
+  // no leading space: stays
+  checkSame("\tcall _optix_get_x;\n\tmov.u32 %r1,_optix_x;\n");
+  checkSame("_optix_\n"+use+"\n_optix_");
+  // empty lines, and windows line endings
+  checkSame("\n\n"+use+"\n\n\n");
+  checkSame("\tret;\r\n"+use+"\r\n\tret;\r\n");
+  CHECK(killAllInternalOptixSymbolsFromPtxString("a\n"+use+"\nb")
+        == "a\n//dropped: "+use+"\nb");
+  LOG_OK("edge cases match the line-by-line version");
+}
+
+void testRandomPtx()
+{
+  std::mt19937 rng(0x1234);
+  const std::vector<std::string> pieces = {
+    "\tret;", " _optix_", "_optix_", " _optix", "\n", "\n", "\n",
+    " ", "\t", "ld.param.u64 %rd1, [x];", "\r\n", "//", "_"
+  };
+  std::uniform_int_distribution<int> piece(0,(int)pieces.size()-1);
+  std::uniform_int_distribution<int> length(0,40);
+  for (int i=0;i<20000;i++) {
+    std::string ptx;
+    for (int j=length(rng);j>0;j--)
+      ptx += pieces[piece(rng)];
+    checkSame(ptx);
+  }
+  LOG_OK("random ptx matches the line-by-line version");
+}
+
+int main(int ac, char **av)
+{
+  testEdgeCases();
+  testRandomPtx();
+  LOG_OK("all ptx filter tests passed");
+  return 0;
+}
@@ -0,0 +1,685 @@
+// ======================================================================== //
+// Copyright 2019-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+// owlReplay: replays an api capture (see owlCaptureBegin) against the
+// owl library it is linked with, and reports how long setup (object
+// creation, uploads, builds) and frames (launches) took. Useful for
+// comparing owl versions, or settings, on the exact same workload,
+// without needing the app that produced it.
+
+#include "owl/owl.h"
+#include "Capture.h"
+
+#include <chrono>
+#include <cstring>
+#include <map>
+
+#define LOG(message)                                            \
+  std::cout << OWL_TERMINAL_BLUE;                               \
+  std::cout << "#owl.replay: " << message << std::endl;         \
+  std::cout << OWL_TERMINAL_DEFAULT;
+#define LOG_OK(message)                                         \
+  std::cout << OWL_TERMINAL_LIGHT_BLUE;                         \
+  std::cout << "#owl.replay: " << message << std::endl;         \
+  std::cout << OWL_TERMINAL_DEFAULT;
+
+using namespace owl;
+
+/*! replays one capture file */
+struct Replayer {
+  Replayer(const std::string &fileName)
+    : reader(fileName)
+  {}
+
+  /*! replays all calls, measuring how long they took */
+  void run();
+
+  size_t numCalls    = 0;
+  size_t numLaunches = 0;
+  double setupTime   = 0.;
+  double frameTime   = 0.;
+  
+private:
+  /*! replays a single call */
+  void replay(CaptureCall call, CaptureArgsReader &args);
+
+  /*! registers the handle that replaying a call created */
+  void add(CaptureHandle id, void *handle)
+  {
+    if (id >= handles.size())
+      handles.resize(id+1,nullptr);
+    handles[id] = handle;
+  }
+  
+  /*! reads a handle, and returns what it refers to in this replay */
+  template<typename T>
+  T get(CaptureArgsReader &args)
+  {
+    return (T)lookup(args.get<CaptureHandle>());
+  }
+  void *lookup(CaptureHandle id)
+  {
+    if (id == 0)
+      return nullptr;
+    if (id >= handles.size() || !handles[id])
+      throw std::runtime_error("capture refers to object #"+std::to_string(id)
+                               +", which got created before the capture began");
+    return handles[id];
+  }
+  template<typename T>
+  std::vector<T> getHandles(CaptureArgsReader &args)
+  {
+    std::vector<T> result;
+    for (auto id : args.getHandles())
+      result.push_back((T)lookup(id));
+    return result;
+  }
+  
+  /*! reads a blob key, and returns its data */
+  const void *getBlob(CaptureArgsReader &args)
+  {
+    const std::vector<uint8_t> *blob = reader.getBlob(args.get<uint64_t>());
+    return blob ? blob->data() : nullptr;
+  }
+
+  /*! reads 'buffer data', and returns a pointer to it; handles get
+      stored in 'handleData' */
+  const void *getBufferData(CaptureArgsReader &args,
+                            std::vector<void *> &handleData)
+  {
+    switch (args.get<CaptureBufferData>()) {
+    case CAPTURE_BUFFER_DATA_NONE:
+      return nullptr;
+    case CAPTURE_BUFFER_DATA_BLOB:
+      return getBlob(args);
+    case CAPTURE_BUFFER_DATA_HANDLES:
+      handleData = getHandles<void *>(args);
+      return handleData.data();
+    default:
+      throw std::runtime_error("invalid capture: unknown kind of buffer data");
+    }
+  }
+
+  /*! reads 'buffer data' into 'bytes' (handles as an array of
+      handles of this replay); no data reads as no bytes */
+  void getBufferBytes(CaptureArgsReader &args,
+                      std::vector<uint8_t> &bytes)
+  {
+    switch (args.get<CaptureBufferData>()) {
+    case CAPTURE_BUFFER_DATA_NONE:
+      bytes.clear();
+      break;
+    case CAPTURE_BUFFER_DATA_BLOB: {
+      const std::vector<uint8_t> *blob = reader.getBlob(args.get<uint64_t>());
+      if (!blob)
+        throw std::runtime_error("invalid capture: unknown blob");
+      bytes = *blob;
+    } break;
+    case CAPTURE_BUFFER_DATA_HANDLES: {
+      const std::vector<void *> handleData = getHandles<void *>(args);
+      bytes.resize(handleData.size()*sizeof(void *));
+      if (!bytes.empty())
+        memcpy(bytes.data(),handleData.data(),bytes.size());
+    } break;
+    default:
+      throw std::runtime_error("invalid capture: unknown kind of buffer data");
+    }
+  }
+
+  void setValue(OWLVariable var, OWLDataType type, const void *value);
+  
+  /*! host memory that buffer uploads recorded into a command list
+      read from; one entry per recorded upload, in order. Command
+      lists read that memory every time they get replayed, so it is
+      owned by the replayer for as long as the list lives, and gets
+      refilled with each replay's data right before the replay */
+  typedef std::vector<std::vector<uint8_t>> UploadStorage;
+  
+  /*! uploads of the command list currently being recorded */
+  UploadStorage recordedUploads;
+  bool recordingCommandList = false;
+  std::map<void *,UploadStorage> commandListUploads;
+  
+  CaptureReader       reader;
+  std::vector<void *> handles;
+  bool warnedAboutPointers = false;
+};
+
+/*! sets a plain variable from its captured value */
+void Replayer::setValue(OWLVariable var, OWLDataType type, const void *value)
+{
+#define REPLAY_SET_VALUE(OT,T,abb)                                     \
+  case OT:      owlVariableSet1##abb(var,*(const T *)value); return;   \
+  case OT##2:   owlVariableSet2##abb##v(var,(const T *)value); return; \
+  case OT##3:   owlVariableSet3##abb##v(var,(const T *)value); return; \
+  case OT##4:   owlVariableSet4##abb##v(var,(const T *)value); return;
+
+  switch (type) {
+    REPLAY_SET_VALUE(OWL_BOOL,bool,b)
+    REPLAY_SET_VALUE(OWL_CHAR,int8_t,c)
+    REPLAY_SET_VALUE(OWL_UCHAR,uint8_t,uc)
+    REPLAY_SET_VALUE(OWL_SHORT,int16_t,s)
+    REPLAY_SET_VALUE(OWL_USHORT,uint16_t,us)
+    REPLAY_SET_VALUE(OWL_INT,int32_t,i)
+    REPLAY_SET_VALUE(OWL_UINT,uint32_t,ui)
+    REPLAY_SET_VALUE(OWL_FLOAT,float,f)
+    REPLAY_SET_VALUE(OWL_LONG,int64_t,l)
+    REPLAY_SET_VALUE(OWL_ULONG,uint64_t,ul)
+    REPLAY_SET_VALUE(OWL_DOUBLE,double,d)
+  default:
+    throw std::runtime_error("can't replay setting a variable of type #"
+                             +std::to_string((int)type));
+  }
+#undef REPLAY_SET_VALUE
+}
+
+void Replayer::replay(CaptureCall call, CaptureArgsReader &args)
+{
+  std::vector<std::string> names;
+  std::vector<void *> handleData;
+  switch (call) {
+  case CAPTURE_CONTEXT_CREATE: {
+    const CaptureHandle id = args.get<CaptureHandle>();
+    const int32_t numDevices = args.get<int32_t>();
+    std::vector<uint8_t> deviceIDs = args.getBytes();
+    add(id,owlContextCreate(deviceIDs.empty()
+                            ? nullptr
+                            : (int32_t *)deviceIDs.data(),
+                            numDevices));
+  } break;
+  case CAPTURE_CONTEXT_DESTROY:
+    owlContextDestroy(get<OWLContext>(args));
+    break;
+  case CAPTURE_CONTEXT_SET_RAY_TYPE_COUNT: {
+    OWLContext context = get<OWLContext>(args);
+    owlContextSetRayTypeCount(context,(size_t)args.get<int64_t>());
+  } break;
+  case CAPTURE_CONTEXT_SET_MAX_INSTANCING_DEPTH: {
+    OWLContext context = get<OWLContext>(args);
+    owlSetMaxInstancingDepth(context,(int32_t)args.get<int64_t>());
+  } break;
+  case CAPTURE_CONTEXT_SET_MAX_TRACE_DEPTH: {
+    OWLContext context = get<OWLContext>(args);
+    owlContextSetMaxTraceDepth(context,(int)args.get<int64_t>());
+  } break;
+  case CAPTURE_CONTEXT_SET_NUM_PAYLOAD_VALUES: {
+    OWLContext context = get<OWLContext>(args);
+    owlContextSetNumPayloadValues(context,(int)args.get<int64_t>());
+  } break;
+  case CAPTURE_CONTEXT_SET_NUM_ATTRIBUTE_VALUES: {
+    OWLContext context = get<OWLContext>(args);
+    owlContextSetNumAttributeValues(context,(int)args.get<int64_t>());
+  } break;
+  case CAPTURE_CONTEXT_SET_MAX_REGISTER_COUNT: {
+    OWLContext context = get<OWLContext>(args);
+    owlContextSetMaxRegisterCount(context,(int)args.get<int64_t>());
+  } break;
+  case CAPTURE_ENABLE_MOTION_BLUR:
+    owlEnableMotionBlur(get<OWLContext>(args));
+    break;
+  case CAPTURE_ENABLE_ACCEL_RELOCATION:
+    owlEnableAccelRelocation(get<OWLContext>(args));
+    break;
+  case CAPTURE_ENABLE_ACCEL_SPLITTING:
+    owlEnableAccelSplitting(get<OWLContext>(args));
+    break;
+  case CAPTURE_ENABLE_ACCEL_DEDUP:
+    owlEnableAccelDedup(get<OWLContext>(args));
+    break;
+  case CAPTURE_ENABLE_UPLOAD_REPLICATION:
+    owlEnableUploadReplication(get<OWLContext>(args));
+    break;
+  case CAPTURE_BUILD_PROGRAMS:
+    owlBuildPrograms(get<OWLContext>(args));
+    break;
+  case CAPTURE_BUILD_PIPELINE:
+    owlBuildPipeline(get<OWLContext>(args));
+    break;
+  case CAPTURE_BUILD_SBT: {
+    OWLContext context = get<OWLContext>(args);
+    owlBuildSBT(context,(OWLBuildSBTFlags)args.get<uint32_t>());
+  } break;
+    
+  case CAPTURE_MODULE_CREATE: {
+    const CaptureHandle id = args.get<CaptureHandle>();
+    OWLContext context = get<OWLContext>(args);
+    const std::vector<uint8_t> *ptx = reader.getBlob(args.get<uint64_t>());
+    const std::string ptxCode = ptx ? std::string(ptx->begin(),ptx->end()) : "";
+    add(id,owlModuleCreate(context,ptxCode.c_str()));
+  } break;
+  case CAPTURE_GEOM_TYPE_CREATE: {
+    const CaptureHandle id = args.get<CaptureHandle>();
+    OWLContext context = get<OWLContext>(args);
+    const OWLGeomKind kind = (OWLGeomKind)args.get<uint32_t>();
+    const size_t varStructSize = (size_t)args.get<uint64_t>();
+    std::vector<OWLVarDecl> vars = args.getVarDecls(names);
+    add(id,owlGeomTypeCreate(context,kind,varStructSize,
+                             vars.data(),(int)vars.size()));
+  } break;
+  case CAPTURE_GEOM_TYPE_SET_CLOSEST_HIT:
+  case CAPTURE_GEOM_TYPE_SET_ANY_HIT:
+  case CAPTURE_GEOM_TYPE_SET_INTERSECT_PROG: {
+    OWLGeomType type   = get<OWLGeomType>(args);
+    const int rayType  = args.get<int32_t>();
+    OWLModule module   = get<OWLModule>(args);
+    const std::string progName = args.getString();
+    if (call == CAPTURE_GEOM_TYPE_SET_CLOSEST_HIT)
+      owlGeomTypeSetClosestHit(type,rayType,module,progName.c_str());
+    else if (call == CAPTURE_GEOM_TYPE_SET_ANY_HIT)
+      owlGeomTypeSetAnyHit(type,rayType,module,progName.c_str());
+    else
+      owlGeomTypeSetIntersectProg(type,rayType,module,progName.c_str());
+  } break;
+  case CAPTURE_GEOM_TYPE_SET_BOUNDS_PROG: {
+    OWLGeomType type = get<OWLGeomType>(args);
+    OWLModule module = get<OWLModule>(args);
+    owlGeomTypeSetBoundsProg(type,module,args.getString().c_str());
+  } break;
+  case CAPTURE_GEOM_CREATE: {
+    const CaptureHandle id = args.get<CaptureHandle>();
+    OWLContext context = get<OWLContext>(args);
+    add(id,owlGeomCreate(context,get<OWLGeomType>(args)));
+  } break;
+  case CAPTURE_GEOM_SET_PRIM_COUNT: {
+    OWLGeom geom = get<OWLGeom>(args);
+    owlGeomSetPrimCount(geom,(size_t)args.get<uint64_t>());
+  } break;
+  case CAPTURE_USER_GEOM_SET_BOUNDS_BUFFER: {
+    OWLGeom geom = get<OWLGeom>(args);
+    owlUserGeomSetBoundsBuffer(geom,get<OWLBuffer>(args));
+  } break;
+  case CAPTURE_TRIANGLES_SET_VERTICES: {
+    OWLGeom triangles = get<OWLGeom>(args);
+    std::vector<OWLBuffer> vertexArrays = getHandles<OWLBuffer>(args);
+    const size_t count  = (size_t)args.get<uint64_t>();
+    const size_t stride = (size_t)args.get<uint64_t>();
+    const size_t offset = (size_t)args.get<uint64_t>();
+    owlTrianglesSetMotionVertices(triangles,vertexArrays.size(),vertexArrays.data(),
+                                  count,stride,offset);
+  } break;
+  case CAPTURE_TRIANGLES_SET_INDICES: {
+    OWLGeom triangles = get<OWLGeom>(args);
+    OWLBuffer indices = get<OWLBuffer>(args);
+    const size_t count  = (size_t)args.get<uint64_t>();
+    const size_t stride = (size_t)args.get<uint64_t>();
+    const size_t offset = (size_t)args.get<uint64_t>();
+    owlTrianglesSetIndices(triangles,indices,count,stride,offset);
+  } break;
+  case CAPTURE_TRIANGLES_SET_VERTEX_FORMAT: {
+    OWLGeom triangles = get<OWLGeom>(args);
+    owlTrianglesSetVertexFormat(triangles,(OWLVertexFormat)args.get<uint32_t>());
+  } break;
+  case CAPTURE_TRIANGLES_SET_INDEX_FORMAT: {
+    OWLGeom triangles = get<OWLGeom>(args);
+    owlTrianglesSetIndexFormat(triangles,(OWLIndexFormat)args.get<uint32_t>());
+  } break;
+
+  case CAPTURE_TRIANGLES_GEOM_GROUP_CREATE:
+  case CAPTURE_USER_GEOM_GROUP_CREATE: {
+    const CaptureHandle id = args.get<CaptureHandle>();
+    OWLContext context = get<OWLContext>(args);
+    std::vector<OWLGeom> geoms = getHandles<OWLGeom>(args);
+    add(id,call == CAPTURE_TRIANGLES_GEOM_GROUP_CREATE
+        ? owlTrianglesGeomGroupCreate(context,geoms.size(),geoms.data())
+        : owlUserGeomGroupCreate(context,geoms.size(),geoms.data()));
+  } break;
+  case CAPTURE_INSTANCE_GROUP_CREATE: {
+    const CaptureHandle id = args.get<CaptureHandle>();
+    OWLContext context = get<OWLContext>(args);
+    std::vector<OWLGroup> children = getHandles<OWLGroup>(args);
+    // transforms and IDs follow as separate calls
+    add(id,owlInstanceGroupCreate(context,children.size(),children.data()));
+  } break;
+  case CAPTURE_INSTANCE_GROUP_SET_CHILD: {
+    OWLGroup group = get<OWLGroup>(args);
+    const int whichChild = args.get<int32_t>();
+    owlInstanceGroupSetChild(group,whichChild,get<OWLGroup>(args));
+  } break;
+  case CAPTURE_INSTANCE_GROUP_SET_TRANSFORM: {
+    OWLGroup group = get<OWLGroup>(args);
+    const int whichChild = args.get<int32_t>();
+    const OWLMatrixFormat format = (OWLMatrixFormat)args.get<uint32_t>();
+    const std::vector<uint8_t> floats = args.getBytes();
+    owlInstanceGroupSetTransform(group,whichChild,
+                                 (const float *)floats.data(),format);
+  } break;
+  case CAPTURE_INSTANCE_GROUP_SET_TRANSFORMS: {
+    OWLGroup group = get<OWLGroup>(args);
+    const uint32_t timeStep = args.get<uint32_t>();
+    const OWLMatrixFormat format = (OWLMatrixFormat)args.get<uint32_t>();
+    owlInstanceGroupSetTransforms(group,timeStep,
+                                  (const float *)getBlob(args),format);
+  } break;
+  case CAPTURE_INSTANCE_GROUP_SET_INSTANCE_IDS: {
+    OWLGroup group = get<OWLGroup>(args);
+    owlInstanceGroupSetInstanceIDs(group,(const uint32_t *)getBlob(args));
+  } break;
+  case CAPTURE_INSTANCE_GROUP_SET_VISIBILITY_MASKS: {
+    OWLGroup group = get<OWLGroup>(args);
+    owlInstanceGroupSetVisibilityMasks(group,(const uint8_t *)getBlob(args));
+  } break;
+  case CAPTURE_INSTANCE_GROUP_SET_INSTANCE_FLAGS: {
+    OWLGroup group = get<OWLGroup>(args);
+    owlInstanceGroupSetInstanceFlags(group,(const uint32_t *)getBlob(args));
+  } break;
+  case CAPTURE_GROUP_BUILD_ACCEL:
+    owlGroupBuildAccel(get<OWLGroup>(args));
+    break;
+  case CAPTURE_GROUP_REFIT_ACCEL:
+    owlGroupRefitAccel(get<OWLGroup>(args));
+    break;
+
+  case CAPTURE_DEVICE_BUFFER_CREATE:
+  case CAPTURE_MANAGED_MEMORY_BUFFER_CREATE: {
+    const CaptureHandle id = args.get<CaptureHandle>();
+    OWLContext context = get<OWLContext>(args);
+    const OWLDataType type = (OWLDataType)args.get<uint32_t>();
+    const size_t count = (size_t)args.get<uint64_t>();
+    const void *init = getBufferData(args,handleData);
+    add(id,call == CAPTURE_DEVICE_BUFFER_CREATE
+        ? owlDeviceBufferCreate(context,type,count,init)
+        : owlManagedMemoryBufferCreate(context,type,count,init));
+  } break;
+  case CAPTURE_HOST_PINNED_BUFFER_CREATE: {
+    const CaptureHandle id = args.get<CaptureHandle>();
+    OWLContext context = get<OWLContext>(args);
+    const OWLDataType type = (OWLDataType)args.get<uint32_t>();
+    add(id,owlHostPinnedBufferCreate(context,type,(size_t)args.get<uint64_t>()));
+  } break;
+  case CAPTURE_BUFFER_RESIZE: {
+    OWLBuffer buffer = get<OWLBuffer>(args);
+    owlBufferResize(buffer,(size_t)args.get<uint64_t>());
+  } break;
+  case CAPTURE_BUFFER_UPLOAD: {
+    OWLBuffer buffer = get<OWLBuffer>(args);
+    const size_t  offset = (size_t)args.get<uint64_t>();
+    const int64_t count  = args.get<int64_t>();
+    const void *data = nullptr;
+    if (recordingCommandList) {
+      // the list will read this data whenever it gets replayed
+      recordedUploads.emplace_back();
+      getBufferBytes(args,recordedUploads.back());
+      if (!recordedUploads.back().empty())
+        data = recordedUploads.back().data();
+    } else
+      data = getBufferData(args,handleData);
+    owlBufferUpload(buffer,data,offset,
+                    count == -1 ? size_t(-1) : size_t(count));
+  } break;
+  case CAPTURE_BUFFER_DESTROY:
+    owlBufferDestroy(get<OWLBuffer>(args));
+    break;
+  case CAPTURE_TEXTURE_2D_CREATE: {
+    const CaptureHandle id = args.get<CaptureHandle>();
+    OWLContext context = get<OWLContext>(args);
+    const OWLTexelFormat texelFormat = (OWLTexelFormat)args.get<uint32_t>();
+    const uint32_t size_x = args.get<uint32_t>();
+    const uint32_t size_y = args.get<uint32_t>();
+    const void *texels = getBlob(args);
+    const OWLTextureFilterMode  filterMode  = (OWLTextureFilterMode)args.get<uint32_t>();
+    const OWLTextureAddressMode addressMode = (OWLTextureAddressMode)args.get<uint32_t>();
+    const OWLTextureColorSpace  colorSpace  = (OWLTextureColorSpace)args.get<uint32_t>();
+    const uint32_t linePitch = args.get<uint32_t>();
+    add(id,owlTexture2DCreate(context,texelFormat,size_x,size_y,texels,
+                              filterMode,addressMode,colorSpace,linePitch));
+  } break;
+  case CAPTURE_TEXTURE_2D_DESTROY:
+    owlTexture2DDestroy(get<OWLTexture>(args));
+    break;
+
+  case CAPTURE_RAY_GEN_CREATE:
+  case CAPTURE_MISS_PROG_CREATE: {
+    const CaptureHandle id = args.get<CaptureHandle>();
+    OWLContext context = get<OWLContext>(args);
+    OWLModule  module  = get<OWLModule>(args);
+    const std::string programName = args.getString();
+    const size_t varStructSize = (size_t)args.get<uint64_t>();
+    std::vector<OWLVarDecl> vars = args.getVarDecls(names);
+    if (call == CAPTURE_RAY_GEN_CREATE)
+      add(id,owlRayGenCreate(context,module,programName.c_str(),varStructSize,
+                             vars.data(),(int)vars.size()));
+    else
+      add(id,owlMissProgCreate(context,module,programName.c_str(),varStructSize,
+                               vars.data(),(int)vars.size()));
+  } break;
+  case CAPTURE_MISS_PROG_SET: {
+    OWLContext context = get<OWLContext>(args);
+    const int rayType  = args.get<int32_t>();
+    owlMissProgSet(context,rayType,get<OWLMissProg>(args));
+  } break;
+  case CAPTURE_PARAMS_CREATE: {
+    const CaptureHandle id = args.get<CaptureHandle>();
+    OWLContext context = get<OWLContext>(args);
+    const size_t varStructSize = (size_t)args.get<uint64_t>();
+    std::vector<OWLVarDecl> vars = args.getVarDecls(names);
+    add(id,owlParamsCreate(context,varStructSize,vars.data(),(int)vars.size()));
+  } break;
+  case CAPTURE_PARAMS_ENABLE_LAUNCH_TILING: {
+    OWLParams params = get<OWLParams>(args);
+    const std::string offsetVarName = args.getString();
+    owlParamsEnableLaunchTiling(params,offsetVarName.c_str(),
+                                (size_t)args.get<uint64_t>());
+  } break;
+  case CAPTURE_PARAMS_ENABLE_LOAD_BALANCING: {
+    OWLParams params = get<OWLParams>(args);
+    const std::string offsetVarName = args.getString();
+    const int   tileSize  = args.get<int32_t>();
+    const float smoothing = args.get<float>();
+    owlParamsEnableLoadBalancing(params,offsetVarName.c_str(),tileSize,smoothing);
+  } break;
+  case CAPTURE_PARAMS_SET_RING_SIZE: {
+    OWLParams params = get<OWLParams>(args);
+    owlParamsSetRingSize(params,args.get<int32_t>());
+  } break;
+
+  case CAPTURE_GET_VARIABLE: {
+    const CaptureHandle id = args.get<CaptureHandle>();
+    const CaptureObjectKind kind = args.get<CaptureObjectKind>();
+    void *object = get<void *>(args);
+    const std::string varName = args.getString();
+    switch (kind) {
+    case CAPTURE_OBJECT_GEOM:
+      add(id,owlGeomGetVariable((OWLGeom)object,varName.c_str())); break;
+    case CAPTURE_OBJECT_RAY_GEN:
+      add(id,owlRayGenGetVariable((OWLRayGen)object,varName.c_str())); break;
+    case CAPTURE_OBJECT_MISS_PROG:
+      add(id,owlMissProgGetVariable((OWLMissProg)object,varName.c_str())); break;
+    case CAPTURE_OBJECT_PARAMS:
+      add(id,owlParamsGetVariable((OWLParams)object,varName.c_str())); break;
+    default:
+      throw std::runtime_error("invalid capture: can't get variables of object kind #"
+                               +std::to_string((int)kind));
+    }
+  } break;
+  case CAPTURE_VARIABLE_SET_VALUE: {
+    OWLVariable var = get<OWLVariable>(args);
+    const OWLDataType type = (OWLDataType)args.get<uint32_t>();
+    const std::vector<uint8_t> value = args.getBytes();
+    setValue(var,type,value.data());
+  } break;
+  case CAPTURE_VARIABLE_SET_BUFFER: {
+    OWLVariable var = get<OWLVariable>(args);
+    owlVariableSetBuffer(var,get<OWLBuffer>(args));
+  } break;
+  case CAPTURE_VARIABLE_SET_GROUP: {
+    OWLVariable var = get<OWLVariable>(args);
+    owlVariableSetGroup(var,get<OWLGroup>(args));
+  } break;
+  case CAPTURE_VARIABLE_SET_TEXTURE: {
+    OWLVariable var = get<OWLVariable>(args);
+    owlVariableSetTexture(var,get<OWLTexture>(args));
+  } break;
+  case CAPTURE_VARIABLE_SET_RAW: {
+    OWLVariable var = get<OWLVariable>(args);
+    const std::vector<uint8_t> value = args.getBytes();
+    owlVariableSetRaw(var,value.data());
+  } break;
+  case CAPTURE_VARIABLE_SET_POINTER: {
+    OWLVariable var = get<OWLVariable>(args);
+    args.get<uint64_t>();
+    // whatever the app pointed to doesn't exist in this process
+    if (!warnedAboutPointers) {
+      LOG("warning: capture sets pointer variables; these get replayed as null");
+      warnedAboutPointers = true;
+    }
+    owlVariableSetPointer(var,nullptr);
+  } break;
+  case CAPTURE_RELEASE: {
+    const CaptureObjectKind kind = args.get<CaptureObjectKind>();
+    void *object = get<void *>(args);
+    switch (kind) {
+    case CAPTURE_OBJECT_GEOM:     owlGeomRelease((OWLGeom)object); break;
+    case CAPTURE_OBJECT_RAY_GEN:  owlRayGenRelease((OWLRayGen)object); break;
+    case CAPTURE_OBJECT_BUFFER:   owlBufferRelease((OWLBuffer)object); break;
+    case CAPTURE_OBJECT_MODULE:   owlModuleRelease((OWLModule)object); break;
+    case CAPTURE_OBJECT_GROUP:    owlGroupRelease((OWLGroup)object); break;
+    case CAPTURE_OBJECT_VARIABLE: owlVariableRelease((OWLVariable)object); break;
+    case CAPTURE_OBJECT_COMMAND_LIST:
+      owlCommandListRelease((OWLCommandList)object);
+      commandListUploads.erase(object);
+      break;
+    default:
+      throw std::runtime_error("invalid capture: can't release objects of kind #"
+                               +std::to_string((int)kind));
+    }
+  } break;
+
+  case CAPTURE_ASYNC_LAUNCH: {
+    OWLRayGen rayGen = get<OWLRayGen>(args);
+    OWLParams params = get<OWLParams>(args);
+    const int x = args.get<int32_t>();
+    const int y = args.get<int32_t>();
+    const int z = args.get<int32_t>();
+    owlAsyncLaunch3D(rayGen,x,y,z,params);
+    numLaunches++;
+  } break;
+  case CAPTURE_RAY_GEN_LAUNCH: {
+    OWLRayGen rayGen = get<OWLRayGen>(args);
+    const int x = args.get<int32_t>();
+    const int y = args.get<int32_t>();
+    const int z = args.get<int32_t>();
+    owlRayGenLaunch3D(rayGen,x,y,z);
+    numLaunches++;
+  } break;
+  case CAPTURE_LAUNCH_SYNC:
+    owlLaunchSync(get<OWLParams>(args));
+    break;
+    
+  case CAPTURE_COMMAND_LIST_BEGIN:
+    owlCommandListBegin(get<OWLContext>(args));
+    recordingCommandList = true;
+    recordedUploads.clear();
+    break;
+  case CAPTURE_COMMAND_LIST_END: {
+    const CaptureHandle id = args.get<CaptureHandle>();
+    OWLCommandList list = owlCommandListEnd(get<OWLContext>(args));
+    add(id,list);
+    recordingCommandList = false;
+    // moving the outer vector leaves the list's pointers to the
+    // entries' data valid
+    commandListUploads[list] = std::move(recordedUploads);
+    recordedUploads.clear();
+  } break;
+  case CAPTURE_COMMAND_LIST_REPLAY: {
+    OWLCommandList list = get<OWLCommandList>(args);
+    UploadStorage &uploads = commandListUploads[list];
+    std::vector<uint8_t> bytes;
+    for (auto &upload : uploads) {
+      getBufferBytes(args,bytes);
+      if (bytes.size() != upload.size())
+        throw std::runtime_error("can't replay capture: a command list upload"
+                                 " changed its size since the list got recorded");
+      if (!bytes.empty())
+        memcpy(upload.data(),bytes.data(),bytes.size());
+    }
+    owlCommandListReplay(list);
+  } break;
+    
+  default:
+    throw std::runtime_error("can't replay call #"+std::to_string((int)call));
+  }
+  if (!args.atEnd())
+    throw std::runtime_error("invalid capture: unexpected arguments for call #"
+                             +std::to_string((int)call));
+}
+
+void Replayer::run()
+{
+  CaptureRecord record;
+  while (reader.next(record)) {
+    const auto begin = std::chrono::steady_clock::now();
+    replay(record.call,record.args);
+    const double seconds
+      = std::chrono::duration<double>(std::chrono::steady_clock::now()-begin).count();
+    const bool isFrame
+      =  record.call == CAPTURE_ASYNC_LAUNCH
+      || record.call == CAPTURE_RAY_GEN_LAUNCH
+      || record.call == CAPTURE_LAUNCH_SYNC
+      || record.call == CAPTURE_COMMAND_LIST_REPLAY;
+    (isFrame ? frameTime : setupTime) += seconds;
+    numCalls++;
+  }
+}
+
+void usage(const std::string &error)
+{
+  if (error != "")
+    std::cerr << OWL_TERMINAL_RED << "error: " << error << OWL_TERMINAL_DEFAULT
+              << std::endl << std::endl;
+  std::cout << "usage: ./owlReplay [-n numRuns] capture.owlcap" << std::endl;
+  exit(error == "" ? 0 : 1);
+}
+
+int main(int ac, char **av)
+{
+  std::string fileName;
+  int numRuns = 1;
+  for (int i=1;i<ac;i++) {
+    const std::string arg = av[i];
+    if (arg == "-h" || arg == "--help")
+      usage("");
+    else if (arg == "-n" && i+1 < ac)
+      numRuns = std::stoi(av[++i]);
+    else if (arg[0] == '-')
+      usage("unknown option '"+arg+"'");
+    else
+      fileName = arg;
+  }
+  if (fileName == "")
+    usage("no capture file specified");
+  if (numRuns < 1)
+    usage("need at least one run");
+
+  try {
+    for (int run=0;run<numRuns;run++) {
+      Replayer replayer(fileName);
+      replayer.run();
+      LOG_OK("run #" << run << ": replayed " << replayer.numCalls << " calls"
+             << " - setup " << prettyDouble(replayer.setupTime) << "s"
+             << ", frames " << prettyDouble(replayer.frameTime) << "s"
+             << " (" << replayer.numLaunches << " launches, "
+             << prettyDouble(replayer.numLaunches
+                             ? replayer.frameTime/replayer.numLaunches
+                             : 0.) << "s per launch)");
+    }
+  } catch (const std::exception &e) {
+    std::cerr << OWL_TERMINAL_RED << "replay failed: " << e.what()
+              << OWL_TERMINAL_DEFAULT << std::endl;
+    return 1;
+  }
+  return 0;
+}